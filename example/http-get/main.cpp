@@ -128,16 +128,9 @@ run_request(http::client& client, http::client_request& req, std::condition_vari
 
     std::cout << http::status_text(resp.status_code) << '\n';
 
-    for (const auto& [k, vals] : resp.headers)
+    for (auto [name, value] : resp.headers)
     {
-        std::cout << k << ":";
-
-        for (const auto& v : vals)
-        {
-            std::cout << ' ' << v;
-        }
-
-        std::cout << '\n';
+        std::cout << name << ": " << value << '\n';
     }
 
     if (resp.body)
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <coroutine>
+#include <cstddef>
 #include <exception>
 #include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
@@ -134,7 +136,58 @@ public:
 
     void set_continuation(std::coroutine_handle<> handle) noexcept { continuation = handle; }
 
+    // Frames come from the heap - unless the coroutine's first parameters (after this, for a member function) are
+    // std::allocator_arg and a std::pmr::polymorphic_allocator, as for std::generator. Then they come from that
+    // allocator's resource, e.g. an arena that everything to do with a request comes out of.
+    //
+    // Either way, the resource is kept at the end of the frame, for it to be given back to.
+    static void* operator new(std::size_t size) { return allocate(size, std::pmr::new_delete_resource()); }
+
+    template<typename... Args>
+    static void* operator new(std::size_t size,
+                              std::allocator_arg_t /* tag */,
+                              const std::pmr::polymorphic_allocator<>& alloc,
+                              const Args&... /* args */)
+    {
+        return allocate(size, alloc.resource());
+    }
+
+    template<typename This, typename... Args>
+    static void* operator new(std::size_t size,
+                              const This& /* self */,
+                              std::allocator_arg_t /* tag */,
+                              const std::pmr::polymorphic_allocator<>& alloc,
+                              const Args&... /* args */)
+    {
+        return allocate(size, alloc.resource());
+    }
+
+    static void operator delete(void* frame, std::size_t size) noexcept
+    {
+        auto* resource = *resource_slot(frame, size);
+        resource->deallocate(frame, frame_size(size), alignof(std::max_align_t));
+    }
+
 private:
+    static constexpr std::size_t frame_size(std::size_t size) noexcept
+    {
+        constexpr auto align = alignof(std::pmr::memory_resource*);
+        return (size + align - 1) / align * align + sizeof(std::pmr::memory_resource*);
+    }
+
+    static std::pmr::memory_resource** resource_slot(void* frame, std::size_t size) noexcept
+    {
+        return reinterpret_cast<std::pmr::memory_resource**>(static_cast<std::byte*>(frame) + frame_size(size)
+                                                             - sizeof(std::pmr::memory_resource*));
+    }
+
+    static void* allocate(std::size_t size, std::pmr::memory_resource* resource)
+    {
+        void* frame                 = resource->allocate(frame_size(size), alignof(std::max_align_t));
+        *resource_slot(frame, size) = resource;
+        return frame;
+    }
+
     friend struct final_awaitable;
 
     struct final_awaitable
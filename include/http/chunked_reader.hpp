@@ -1,34 +1,195 @@
+#pragma once
+
+#include <algorithm>
 #include <cstddef>
+#include <limits>
 #include <memory>
 #include <span>
+#include <system_error>
 #include <utility>
 
 #include "coro/task.hpp"
+#include "io/concepts.hpp"
+#include "io/dynamic.hpp"
 #include "io/io.hpp"
 #include "io/reader.hpp"
 
 namespace net::http::http11
 {
 
-class chunked_reader : public io::reader
+// basic_chunked_reader decodes a chunked body out of Reader, which it holds either by value or through a pointer, and
+// calls directly. Chunk framing is mostly a byte at a time, so a buffered Reader pays for itself here: those bytes
+// come straight out of its buffer, without suspending.
+template<typename Reader>
+    requires io::async_reader<io::detail::deref_t<Reader>>
+class basic_chunked_reader
 {
 public:
-    constexpr chunked_reader(std::unique_ptr<io::reader>&& reader)
+    constexpr basic_chunked_reader() = default;
+
+    constexpr explicit basic_chunked_reader(Reader reader)
         : parent{std::move(reader)}
     {}
 
-    coro::task<io::result> read(std::span<std::byte> data) override;
+    // read returns how many bytes of the body it put in data; the framing around them isn't counted.
+    coro::task<io::result> read(std::span<std::byte> data)
+    {
+        // the last chunk's been read, and whatever comes after it isn't part of this body
+        if (done) co_return {.err = make_error_condition(io::status_condition::closed)};
+
+        std::size_t bytes_read = 0;
+
+        while (bytes_read < data.size())
+        {
+            // new chunk
+            if (current_chunk_size == 0)
+            {
+                auto res = co_await get_next_chunk_size();
+                if (res.err) co_return {.count = bytes_read, .err = res.err};
+
+                // final chunk is size 0
+                if (current_chunk_size == 0)
+                {
+                    res = co_await validate_end_of_chunk();
+                    if (res.err) co_return {.count = bytes_read, .err = res.err};
+
+                    done = true;
+                    break;
+                }
+            }
+
+            // plain read of current chunk
+            auto amount_to_read = std::min(data.size() - bytes_read, current_chunk_size);
+            auto res            = co_await read_some(data.subspan(bytes_read, amount_to_read));
+            current_chunk_size -= res.count;
+            bytes_read += res.count;
+            if (res.err) co_return {.count = bytes_read, .err = res.err};
 
-    using io::reader::read;
+            // end of chunk
+            if (current_chunk_size == 0)
+            {
+                res = co_await validate_end_of_chunk();
+                if (res.err) co_return {.count = bytes_read, .err = res.err};
+            }
+        }
 
-    [[nodiscard]] int native_handle() const noexcept override { return parent->native_handle(); }
+        co_return {.count = bytes_read, .err = {}};
+    }
+
+    [[nodiscard]] int native_handle() const noexcept { return io::detail::deref(parent).native_handle(); }
 
 private:
-    coro::task<io::result> get_next_chunk_size();
-    coro::task<io::result> validate_end_of_chunk();
+    coro::task<io::result> read_some(std::span<std::byte> data)
+    {
+        if (auto count = io::take_buffered(io::detail::deref(parent), data); count > 0)
+        {
+            co_return {.count = count, .err = {}};
+        }
+        co_return co_await io::detail::deref(parent).read(data);
+    }
+
+    coro::task<io::result> read_byte(std::byte& next)
+    {
+        if (io::take_buffered(io::detail::deref(parent), {&next, 1}) == 1) co_return {.count = 1, .err = {}};
+        co_return co_await io::detail::deref(parent).read({&next, 1});
+    }
+
+    // get_next_chunk_size reads a chunk's size line: its size in hex, then any extensions (";name=value"), which are
+    // skipped over.
+    coro::task<io::result> get_next_chunk_size()
+    {
+        constexpr std::size_t max_chunk_size = std::numeric_limits<std::size_t>::max() >> 4;
+
+        current_chunk_size = 0;
+
+        std::size_t digits        = 0;
+        bool        size_done     = false;
+        bool        in_extensions = false;
+
+        while (true)
+        {
+            std::byte next{};
+            auto      res = co_await read_byte(next);
+            if (res.err) co_return res;
+
+            const auto c = static_cast<char>(next);
+            if (c == '\r')
+            {
+                // end of size - next byte should be a '\n'
+                res = co_await read_byte(next);
+                if (res.err) co_return res;
 
-    std::unique_ptr<io::reader> parent             = nullptr;
-    std::size_t                 current_chunk_size = 0;
+                if (static_cast<char>(next) != '\n' || digits == 0)
+                {
+                    co_return {.err = std::make_error_condition(std::errc::illegal_byte_sequence)};
+                }
+
+                break;
+            }
+
+            if (in_extensions) continue;
+
+            if (auto digit = hex_digit(c); digit >= 0)
+            {
+                // whitespace may come between the size and its extensions, but not within the size
+                if (size_done) co_return {.err = std::make_error_condition(std::errc::illegal_byte_sequence)};
+                if (current_chunk_size > max_chunk_size)
+                {
+                    co_return {.err = std::make_error_condition(std::errc::value_too_large)};
+                }
+
+                current_chunk_size = (current_chunk_size << 4) | static_cast<std::size_t>(digit);
+                ++digits;
+            }
+            else if ((c == ' ' || c == '\t') && digits > 0)
+            {
+                size_done = true;
+            }
+            else if (c == ';' && digits > 0)
+            {
+                in_extensions = true;
+            }
+            else
+            {
+                co_return {.err = std::make_error_condition(std::errc::illegal_byte_sequence)};
+            }
+        }
+
+        co_return {};
+    }
+
+    coro::task<io::result> validate_end_of_chunk()
+    {
+        std::byte cr{};
+        std::byte lf{};
+
+        auto res = co_await read_byte(cr);
+        if (res.err) co_return res;
+
+        res = co_await read_byte(lf);
+        if (res.err) co_return res;
+
+        if (static_cast<char>(cr) != '\r' || static_cast<char>(lf) != '\n')
+        {
+            co_return {.err = std::make_error_condition(std::errc::illegal_byte_sequence)};
+        }
+
+        co_return {.count = 2, .err = {}};
+    }
+
+    static constexpr int hex_digit(char c) noexcept
+    {
+        if ('0' <= c && c <= '9') return c - '0';
+        if ('a' <= c && c <= 'f') return c - 'a' + 10;
+        if ('A' <= c && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    Reader      parent{};
+    std::size_t current_chunk_size = 0;
+    bool        done               = false;
 };
 
+using chunked_reader = io::dynamic_reader<basic_chunked_reader<std::unique_ptr<io::reader>>>;
+
 }
@@ -13,6 +13,7 @@
 #include "http/request.hpp"
 #include "http/response.hpp"
 #include "io/scheduler.hpp"
+#include "socket.hpp"
 #include "tcp.hpp"
 #include "util/resource_pool.hpp"
 
@@ -24,10 +25,12 @@ using namespace std::chrono_literals;
 class client
 {
 public:
+    // If unix_path is set, every request goes over the unix domain socket there, whatever the host in its URL.
     client(io::scheduler*            scheduler,
            std::size_t               max_connections_per_host = 2,
            std::chrono::microseconds timeout                  = 15us,
-           bool                      keepalives               = true);
+           bool                      keepalives               = true,
+           std::string               unix_path                = {});
 
     client(const client&)            = delete;
     client& operator=(const client&) = delete;
@@ -40,7 +43,7 @@ public:
     coro::task<std::expected<client_response, std::error_condition>> send(const client_request& request);
 
 private:
-    using host_connections = util::resource_pool<tcp_socket>;
+    using host_connections = util::resource_pool<socket>;
 
     host_connections::borrowed_resource get_connection(const std::string& host, const std::string& port);
 
@@ -53,6 +56,7 @@ private:
     std::size_t               max_connections_per_host;
     bool                      keepalives;
     std::chrono::microseconds timeout;
+    std::string               unix_path;
 };
 
 }
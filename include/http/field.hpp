@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "util/string_util.hpp"
+
+namespace net::http
+{
+
+// field is a header that's common enough to be known by number: headers keep these without their names, and find them
+// by comparing a byte rather than a string. Anything else is unknown, and goes by its name.
+enum class field : std::uint8_t
+{
+    accept,
+    accept_charset,
+    accept_encoding,
+    accept_language,
+    accept_ranges,
+    access_control_allow_origin,
+    age,
+    allow,
+    authorization,
+    cache_control,
+    connection,
+    content_disposition,
+    content_encoding,
+    content_language,
+    content_length,
+    content_location,
+    content_range,
+    content_type,
+    cookie,
+    date,
+    etag,
+    expect,
+    expires,
+    forwarded,
+    from,
+    host,
+    http2_settings,
+    if_match,
+    if_modified_since,
+    if_none_match,
+    if_range,
+    if_unmodified_since,
+    keep_alive,
+    last_modified,
+    link,
+    location,
+    max_forwards,
+    origin,
+    proxy_authenticate,
+    proxy_authorization,
+    range,
+    referer,
+    refresh,
+    retry_after,
+    server,
+    set_cookie,
+    strict_transport_security,
+    te,
+    traceparent,
+    tracestate,
+    trailer,
+    transfer_encoding,
+    upgrade,
+    user_agent,
+    vary,
+    via,
+    www_authenticate,
+    x_forwarded_for,
+    unknown,
+};
+
+namespace detail
+{
+
+using namespace std::string_view_literals;
+
+// indexed by field
+constexpr std::array<std::string_view, static_cast<std::size_t>(field::unknown)> field_names{
+    "Accept"sv,
+    "Accept-Charset"sv,
+    "Accept-Encoding"sv,
+    "Accept-Language"sv,
+    "Accept-Ranges"sv,
+    "Access-Control-Allow-Origin"sv,
+    "Age"sv,
+    "Allow"sv,
+    "Authorization"sv,
+    "Cache-Control"sv,
+    "Connection"sv,
+    "Content-Disposition"sv,
+    "Content-Encoding"sv,
+    "Content-Language"sv,
+    "Content-Length"sv,
+    "Content-Location"sv,
+    "Content-Range"sv,
+    "Content-Type"sv,
+    "Cookie"sv,
+    "Date"sv,
+    "ETag"sv,
+    "Expect"sv,
+    "Expires"sv,
+    "Forwarded"sv,
+    "From"sv,
+    "Host"sv,
+    "HTTP2-Settings"sv,
+    "If-Match"sv,
+    "If-Modified-Since"sv,
+    "If-None-Match"sv,
+    "If-Range"sv,
+    "If-Unmodified-Since"sv,
+    "Keep-Alive"sv,
+    "Last-Modified"sv,
+    "Link"sv,
+    "Location"sv,
+    "Max-Forwards"sv,
+    "Origin"sv,
+    "Proxy-Authenticate"sv,
+    "Proxy-Authorization"sv,
+    "Range"sv,
+    "Referer"sv,
+    "Refresh"sv,
+    "Retry-After"sv,
+    "Server"sv,
+    "Set-Cookie"sv,
+    "Strict-Transport-Security"sv,
+    "TE"sv,
+    "traceparent"sv,
+    "tracestate"sv,
+    "Trailer"sv,
+    "Transfer-Encoding"sv,
+    "Upgrade"sv,
+    "User-Agent"sv,
+    "Vary"sv,
+    "Via"sv,
+    "WWW-Authenticate"sv,
+    "X-Forwarded-For"sv,
+};
+
+// Names are looked up in an open-addressed hash table, built at compile time. The hash only looks at a name's length
+// and a few of its characters, folded to lower case, so it costs the same however long the name is - and whatever it
+// finds is compared in full anyway.
+constexpr std::size_t field_slots = 256;
+
+constexpr std::size_t field_hash(std::string_view name) noexcept
+{
+    constexpr auto fold = [](char c) { return static_cast<std::size_t>(static_cast<unsigned char>(c) | 0x20); };
+
+    if (name.empty()) return 0;
+    return (name.size() * 7 + fold(name[0]) * 31 + fold(name[name.size() / 2]) * 17 + fold(name.back()))
+         % field_slots;
+}
+
+constexpr auto field_table = []
+{
+    std::array<field, field_slots> table{};
+    table.fill(field::unknown);
+
+    for (std::size_t i = 0; i < field_names.size(); ++i)
+    {
+        auto slot = field_hash(field_names[i]);
+        while (table[slot] != field::unknown) slot = (slot + 1) % field_slots;
+
+        table[slot] = static_cast<field>(i);
+    }
+
+    return table;
+}();
+
+}
+
+// field_name is how a well-known header is spelled.
+constexpr std::string_view field_name(field f) noexcept
+{
+    if (f >= field::unknown) return {};
+    return detail::field_names[static_cast<std::size_t>(f)];
+}
+
+// find_field returns which well-known header name is, ignoring case, or field::unknown if it's none of them.
+constexpr field find_field(std::string_view name) noexcept
+{
+    for (auto slot = detail::field_hash(name);; slot = (slot + 1) % detail::field_slots)
+    {
+        auto f = detail::field_table[slot];
+        if (f == field::unknown) return field::unknown;
+        if (util::equal_ignore_case(name, field_name(f))) return f;
+    }
+}
+
+}
@@ -1,15 +1,22 @@
 #pragma once
 
+#include <array>
 #include <cctype>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-#include "util/string_map.hpp"
+#include "http/field.hpp"
 
 namespace net::http
 {
@@ -26,37 +33,130 @@ struct content_type
     }
 };
 
+// headers are a message's header fields, kept flat: one list of fields in the order they were added, and one string
+// holding their values (and the names of the ones that aren't well-known). That's one allocation for all the values,
+// and none for the list while there are no more than inline_fields of them - which covers most messages.
+//
+// A name can appear more than once, e.g. for Set-Cookie, and each is kept as a field of its own. Names are compared
+// ignoring case; well-known ones (see field) are found by number, and spelled the usual way when written back out.
+//
+// The views that headers hand out are only good until they're next changed. Both the list (once it's past its inline
+// room) and the string come from the allocator they're made with, e.g. a request's arena.
 class headers
 {
+public:
+    static constexpr std::size_t inline_fields = 16;
+
+    struct field_view
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
 private:
-    struct keyhash
+    struct entry
     {
-        using is_transparent   = void;
-        using string_type      = std::string;
-        using string_view_type = std::string_view;
+        // the name (if it's not well-known) followed by the value, in text
+        std::uint32_t offset       = 0;
+        std::uint32_t value_length = 0;
+        std::uint32_t name_length  = 0;
+        http::field   id           = http::field::unknown;
+    };
 
-        std::size_t operator()(const std::string& key) const noexcept;
-        std::size_t operator()(std::string_view key) const noexcept;
+    // key is what's being looked for: a well-known field, or some other name
+    struct key
+    {
+        http::field      id;
+        std::string_view name;
     };
 
-    struct keyequal
+public:
+    // iterator goes over every field, in order.
+    class iterator
     {
-        using is_transparent   = void;
-        using string_type      = std::string;
-        using string_view_type = std::string_view;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = field_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = field_view;
+
+        iterator() = default;
+
+        field_view operator*() const noexcept { return owner->view(index); }
+
+        iterator& operator++() noexcept
+        {
+            ++index;
+            return *this;
+        }
 
-        bool operator()(const std::string& lhs, const std::string& rhs) const noexcept;
-        bool operator()(std::string_view lhs, const std::string& rhs) const noexcept;
-        bool operator()(const std::string& lhs, std::string_view rhs) const noexcept;
+        iterator operator++(int) noexcept
+        {
+            auto prev = *this;
+            ++index;
+            return prev;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept = default;
+
+    private:
+        friend class headers;
+
+        iterator(const headers* owner, std::size_t index) noexcept
+            : owner{owner}
+            , index{index}
+        {}
+
+        const headers* owner = nullptr;
+        std::size_t    index = 0;
     };
 
-    using value_type = std::vector<std::string>;
-    using key_type   = std::string;
-    using map_type   = util::string_map<value_type, std::string, std::string_view, keyhash, keyequal>;
+    // value_iterator goes over the values of every field with the same name, in order.
+    class value_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = std::string_view;
 
-public:
-    using value_iterator = value_type::const_iterator;
-    using keys_iterator  = map_type::const_iterator;
+        value_iterator() = default;
+
+        std::string_view operator*() const noexcept { return owner->view(index).value; }
+
+        value_iterator& operator++() noexcept
+        {
+            index = owner->find(k, index + 1);
+            return *this;
+        }
+
+        value_iterator operator++(int) noexcept
+        {
+            auto prev = *this;
+            ++*this;
+            return prev;
+        }
+
+        friend bool operator==(const value_iterator& lhs, const value_iterator& rhs) noexcept
+        {
+            return lhs.index == rhs.index;
+        }
+
+    private:
+        friend class headers;
+
+        value_iterator(const headers* owner, key k, std::size_t index) noexcept
+            : owner{owner}
+            , k{k}
+            , index{index}
+        {}
+
+        const headers* owner = nullptr;
+        key            k{.id = http::field::unknown, .name = {}};
+        std::size_t    index = 0;
+    };
 
     struct values_range
     {
@@ -73,8 +173,24 @@ public:
         value_iterator end_it;
     };
 
+    using const_iterator = iterator;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
     headers() = default;
-    headers(std::initializer_list<map_type::value_type> init);
+    explicit headers(allocator_type alloc) noexcept
+        : overflow{alloc}
+        , text{alloc}
+    {}
+
+    headers(std::initializer_list<std::pair<std::string_view, std::initializer_list<std::string_view>>> init);
+
+    headers(const headers& other)            = default;
+    headers& operator=(const headers& other) = default;
+
+    headers(headers&& other) noexcept;
+    headers& operator=(headers&& other) noexcept;
+
+    ~headers() = default;
 
     headers& set(const std::string& key, std::string val);
     headers& set(const std::string& key, std::initializer_list<std::string> vals);
@@ -94,16 +210,26 @@ public:
     headers& set(std::string_view key, std::initializer_list<std::string_view> vals);
     headers& add(std::string_view key, std::string_view val);
 
+    headers& set(http::field f, std::string_view val);
+    headers& add(http::field f, std::string_view val);
+
     headers& set_content_length(std::size_t length);
     headers& set_content_type(const content_type& content_type);
 
+    // erase removes every field called key, and returns how many there were.
+    std::size_t erase(std::string_view key) noexcept;
+    std::size_t erase(http::field f) noexcept;
+
     [[nodiscard]] std::optional<std::string_view> get(const std::string& key) const;
     [[nodiscard]] std::optional<std::string_view> get(std::string_view key) const;
+    [[nodiscard]] std::optional<std::string_view> get(http::field f) const noexcept;
     [[nodiscard]] std::optional<std::string_view> operator[](const std::string& key) const;
     [[nodiscard]] std::optional<std::string_view> operator[](std::string_view key) const;
+    [[nodiscard]] std::optional<std::string_view> operator[](http::field f) const noexcept;
 
     [[nodiscard]] std::optional<values_range> get_all(const std::string& key) const;
     [[nodiscard]] std::optional<values_range> get_all(std::string_view key) const;
+    [[nodiscard]] std::optional<values_range> get_all(http::field f) const noexcept;
 
     // getters for well-known common headers
 
@@ -115,16 +241,61 @@ public:
 
     [[nodiscard]] bool is_chunked() const;
 
-    [[nodiscard]] keys_iterator begin() const;
-    [[nodiscard]] keys_iterator end() const;
+    [[nodiscard]] iterator begin() const noexcept { return {this, 0}; }
+    [[nodiscard]] iterator end() const noexcept { return {this, count}; }
+
+    [[nodiscard]] bool empty() const noexcept { return count == 0; }
 
-    [[nodiscard]] bool        empty() const noexcept;
-    [[nodiscard]] std::size_t size() const noexcept;
+    // size is how many fields there are, counting each of those with the same name.
+    [[nodiscard]] std::size_t size() const noexcept { return count; }
 
-    friend bool operator==(const headers& lhs, const headers& rhs) noexcept = default;
+    // reserve makes room for at least fields fields, with bytes of names and values between them.
+    void reserve(std::size_t fields, std::size_t bytes);
+    void clear() noexcept;
+
+    [[nodiscard]] allocator_type get_allocator() const noexcept { return text.get_allocator(); }
+
+    // Equal headers have the same values for the same names, in the same order for each name - but the names can come
+    // in any order.
+    friend bool operator==(const headers& lhs, const headers& rhs) noexcept;
 
 private:
-    map_type values;
+    [[nodiscard]] static key key_of(std::string_view name) noexcept { return {.id = find_field(name), .name = name}; }
+
+    [[nodiscard]] std::span<entry> entries() noexcept
+    {
+        return {spilled ? overflow.data() : local.data(), count};
+    }
+
+    [[nodiscard]] std::span<const entry> entries() const noexcept
+    {
+        return {spilled ? overflow.data() : local.data(), count};
+    }
+
+    [[nodiscard]] field_view view(std::size_t index) const noexcept;
+
+    // find returns the index of the first field from from on that matches k, or size() if there isn't one.
+    [[nodiscard]] std::size_t find(key k, std::size_t from = 0) const noexcept;
+
+    headers&    append(key k, std::string_view val);
+    headers&    replace(key k, std::string_view val);
+    std::size_t erase(key k) noexcept;
+
+    // compact drops what's left of erased fields from text.
+    void compact();
+
+    [[nodiscard]] std::optional<std::string_view> get(key k) const noexcept;
+    [[nodiscard]] std::optional<values_range>     get_all(key k) const noexcept;
+
+    std::array<entry, inline_fields> local{};
+    std::pmr::vector<entry>          overflow;
+    std::size_t                      count   = 0;
+    bool                             spilled = false;
+
+    std::pmr::string text;
+
+    // bytes in text that belonged to fields since erased, which are dropped once they're half of it
+    std::size_t dead = 0;
 };
 
 }
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "http/headers.hpp"
+
+namespace net::http::hpack
+{
+
+// HPACK is how HTTP/2 compresses header fields: https://httpwg.org/specs/rfc7541.html
+//
+// A field goes out either as an index into a table both ends keep - a static one of common fields, and a dynamic one
+// of fields sent lately - or as a literal name and value, each of which may be Huffman coded.
+
+inline constexpr std::size_t default_table_size = 4'096;
+
+// entry_overhead is what each field in the dynamic table counts for, on top of its name and value.
+inline constexpr std::size_t entry_overhead = 32;
+
+// static_table_size is how many fields the static table has. Indexes past it are into the dynamic table.
+inline constexpr std::size_t static_table_size = 61;
+
+// huffman_encoded_size is how many bytes text takes once Huffman coded.
+[[nodiscard]] std::size_t huffman_encoded_size(std::string_view text) noexcept;
+
+// huffman_encode appends text to out, Huffman coded.
+void huffman_encode(std::string_view text, std::vector<std::byte>& out);
+
+// huffman_decode appends what data decodes to to out, and returns false if it isn't valid Huffman code.
+bool huffman_decode(std::span<const std::byte> data, std::string& out);
+
+// dynamic_table is the table of fields sent lately, newest first, that both ends of a connection keep in step.
+//
+// Names and values are kept back to back in one ring of bytes, and the fields are views into it: adding a field
+// allocates nothing, and the oldest are dropped from the other end as new ones need the room. The ring has room for
+// twice what the table may hold, so there's always room for a field in one piece.
+class dynamic_table
+{
+public:
+    struct field
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    explicit dynamic_table(std::size_t capacity = default_table_size);
+
+    // insert adds a field as the newest, dropping the oldest to make room. A field bigger than the whole table just
+    // empties it. name may be one of the table's own.
+    void insert(std::string_view name, std::string_view value);
+
+    // get returns the field at index, 0 being the newest. The views are good until the next insert.
+    [[nodiscard]] std::optional<field> get(std::size_t index) const noexcept;
+
+    // find returns the index of the newest field with name and value, if there is one - or failing that, of the newest
+    // with just name, with exact set to false.
+    [[nodiscard]] std::optional<std::size_t> find(std::string_view name, std::string_view value, bool& exact) const;
+
+    // set_capacity changes how much the table may hold, dropping the oldest fields that no longer fit.
+    void set_capacity(std::size_t capacity);
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return max_size; }
+
+    // size is how much the table holds, counting entry_overhead for each field.
+    [[nodiscard]] std::size_t size() const noexcept { return used; }
+
+    // count is how many fields it holds.
+    [[nodiscard]] std::size_t count() const noexcept { return entries; }
+
+private:
+    struct entry
+    {
+        std::uint32_t offset;
+        std::uint32_t name_length;
+        std::uint32_t value_length;
+        std::uint32_t name_hash;
+    };
+
+    [[nodiscard]] const entry& at(std::size_t index) const noexcept
+    {
+        return slots[(newest + slots.size() - index) % slots.size()];
+    }
+
+    // evict drops the oldest fields until the table holds no more than limit.
+    void evict(std::size_t limit) noexcept;
+
+    // place returns where in the ring length more bytes can go, emptying the table if there's nowhere.
+    std::size_t place(std::size_t length) noexcept;
+
+    // rebuild moves every field into a new ring and slots, big enough for max_size.
+    void rebuild();
+
+    std::vector<char>  ring;
+    std::vector<entry> slots; // a ring of their own, as many as could fit in max_size
+    std::size_t        newest   = 0;
+    std::size_t        entries  = 0;
+    std::size_t        head     = 0; // where the next field's bytes go
+    std::size_t        used     = 0;
+    std::size_t        max_size = 0;
+};
+
+// decoder turns field blocks back into fields. It keeps the dynamic table that the encoder at the other end adds to,
+// so every block from a connection has to go through the same decoder, in the order they were sent.
+class decoder
+{
+public:
+    explicit decoder(std::size_t max_table_size = default_table_size);
+
+    // decode decodes a whole field block, and calls emit(name, value) for each field in it, in order. The views are
+    // only good until emit returns: they're into the block, the table, or a buffer Huffman coded text is decoded to.
+    //
+    // Returns std::errc::illegal_byte_sequence if the block is malformed - after which the table is out of step with
+    // the encoder's, and nothing more from the connection can be decoded.
+    template<typename Emit>
+        requires std::invocable<Emit&, std::string_view, std::string_view>
+    std::error_condition decode(std::span<const std::byte> block, Emit&& emit)
+    {
+        return decode_block(
+            block,
+            [](void* context, std::string_view name, std::string_view value)
+            { (*static_cast<std::remove_reference_t<Emit>*>(context))(name, value); },
+            &emit);
+    }
+
+    // decode decodes a whole field block into out, pseudo-header fields and all.
+    std::error_condition decode(std::span<const std::byte> block, headers& out);
+
+    // set_max_table_size sets the most the dynamic table may hold, i.e. what SETTINGS_HEADER_TABLE_SIZE was sent as.
+    // The encoder may only make its table as big as that.
+    void set_max_table_size(std::size_t size);
+
+    // table_size is how much the dynamic table holds, counting entry_overhead for each field.
+    [[nodiscard]] std::size_t table_size() const noexcept { return table.size(); }
+
+private:
+    using emit_fn = void (*)(void* context, std::string_view name, std::string_view value);
+
+    std::error_condition decode_block(std::span<const std::byte> block, emit_fn emit, void* context);
+
+    // lookup finds the field at index, counting the static table's first, and returns false if there isn't one.
+    [[nodiscard]] bool lookup(std::size_t index, std::string_view& name, std::string_view& value) const noexcept;
+
+    dynamic_table table;
+    std::size_t   max_size = 0; // as set by us, where the table's capacity is as last set by the encoder
+
+    // Huffman coded names and values are decoded into these, to hand out views of
+    std::string name_scratch;
+    std::string value_scratch;
+};
+
+// encoder turns fields into field blocks. Names go out in lower case, as HTTP/2 needs them to be.
+//
+// Fields in the static table go out as their index, found by hashing their name rather than by going through it.
+// Others are added to the dynamic table as they're sent, so a field that's sent again - e.g. the same content-type and
+// cache-control on every response - goes out as just an index the next time, and a set of fields that's sent over and
+// over takes a byte or two for each.
+//
+// That's not for every field though. Those whose values are different nearly every time (content-length, etag...)
+// would only push out the ones worth keeping, so they're sent as literals without indexing. Credentials (authorization,
+// set-cookie, and cookies short enough to guess) are sent as never indexed - which tells any intermediary not to index
+// them either, so they can't be probed for by seeing what compresses well:
+// https://httpwg.org/specs/rfc7541.html#never.indexed.literals
+class encoder
+{
+public:
+    // table_size is the most the encoder will have the dynamic table hold, whatever the decoder would allow.
+    explicit encoder(std::size_t table_size = default_table_size);
+
+    // encode appends a field to block. If sensitive, it's sent as never indexed, whatever its name.
+    void encode(std::string_view name, std::string_view value, std::vector<std::byte>& block, bool sensitive = false);
+
+    // encode appends every field in fields to block.
+    void encode(const headers& fields, std::vector<std::byte>& block);
+
+    // set_max_table_size sets the most the decoder will have the dynamic table hold, i.e. what it sent
+    // SETTINGS_HEADER_TABLE_SIZE as. It's to be called between blocks: the change is announced at the start of the
+    // next one.
+    void set_max_table_size(std::size_t size);
+
+    // table_size is how much the dynamic table holds, counting entry_overhead for each field.
+    [[nodiscard]] std::size_t table_size() const noexcept { return table.size(); }
+
+private:
+    dynamic_table table;
+    std::size_t   preferred_size;
+
+    // if the table's size has changed since the last block, the smallest it's been since
+    std::optional<std::size_t> smallest_update;
+
+    std::string lowered;
+};
+
+}
@@ -4,6 +4,8 @@
 #include <expected>
 #include <limits>
 #include <memory>
+#include <memory_resource>
+#include <utility>
 
 #include "coro/task.hpp"
 #include "http/request.hpp"
@@ -22,6 +24,18 @@ task<request_encoder_result> request_encode(io::writer* writer, const client_req
 
 task<response_encoder_result> response_encode(io::writer* writer, const server_response& resp) noexcept;
 
+// request_decode reads a request's head out of reader, and sets its body up to be read from it. The request's headers
+// and body, and the coroutine's frame, all come from alloc.
+//
+// reader is only borrowed, e.g. from a connection that goes on to read its next request from it - which it can do
+// once the body's been read to the end.
+task<request_decoder_result>
+request_decode(std::allocator_arg_t,
+               std::pmr::polymorphic_allocator<> alloc,
+               io::buffered_reader*              reader,
+               std::size_t max_header_bytes = std::numeric_limits<std::size_t>::max()) noexcept;
+
+// request_decode decodes a request that owns reader, from the heap.
 task<request_decoder_result>
 request_decode(std::unique_ptr<io::buffered_reader> reader,
                std::size_t max_header_bytes = std::numeric_limits<std::size_t>::max()) noexcept;
@@ -1,24 +1,93 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <spdlog/logger.h>
+#include <spdlog/spdlog.h>
 
 #include "coro/task.hpp"
 #include "http/request.hpp"
 #include "http/response.hpp"
+#include "http/router.hpp"
 #include "io/buffered_reader.hpp"
 #include "io/writer.hpp"
+#include "socket.hpp"
 
 namespace net::http::http2
 {
 
 using coro::task;
 
-task<request_encoder_result> request_encode(io::writer* writer, const client_request& req) noexcept;
+// client_preface is what a client starts an HTTP/2 connection with, before its first frame.
+inline constexpr std::string_view client_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+// settings are what one end of a connection tells the other about what it'll take from it:
+// https://httpwg.org/specs/rfc9113.html#SettingValues
+//
+// The defaults are what each end has to assume of the other until it's told otherwise.
+struct settings
+{
+    std::uint32_t header_table_size      = 4'096;
+    bool          enable_push            = true;
+    std::uint32_t max_concurrent_streams = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t initial_window_size    = 65'535;
+    std::uint32_t max_frame_size         = 16'384;
+    std::uint32_t max_header_list_size   = std::numeric_limits<std::uint32_t>::max();
+};
+
+struct server_options
+{
+    // what the server tells clients it'll take
+    settings local{.enable_push = false, .max_concurrent_streams = 100};
+
+    // Every connection starts out with a receive window of 65,535 bytes, shared between all its streams. It's raised to
+    // this straight away, so that a few uploads at once aren't held up waiting for it to be given back.
+    std::uint32_t connection_window = 1'024ull * 1'024;
+
+    // Requests with more than this in their header fields (counting 32 bytes for each, as HPACK does) are refused.
+    std::size_t max_header_bytes = 8'192;
+
+    // How long a connection may go without any streams open before it's closed. 0 is for as long as the client likes.
+    std::chrono::milliseconds idle_timeout{0};
 
+    std::shared_ptr<spdlog::logger> logger = spdlog::default_logger();
+};
+
+// serve serves an HTTP/2 connection, once its client preface is on its way into reader. If it was upgraded from
+// HTTP/1.1, upgraded is the request that asked for that - which is answered as the connection's first stream.
+//
+// Each request is handed to handler on a stream of its own, and they're all served at once: a handler that's waiting
+// for its request's body, or for the client to make room for its response, doesn't hold up the others.
+//
+// It returns once the connection's closed or gone away, and every handler has finished.
+task<std::error_condition> serve(socket&               sock,
+                                 io::buffered_reader&  reader,
+                                 const router&         handler,
+                                 const server_options& options,
+                                 const server_request* upgraded = nullptr);
+
+// response_encode sends a response's head, on the stream serve gave its handler writer for.
 task<response_encoder_result> response_encode(io::writer* writer, const server_response& resp) noexcept;
 
+// Requests on an HTTP/2 connection come in on streams, all at once, rather than one after another out of a reader -
+// see serve. The client side isn't done yet. These return std::errc::not_supported.
+
+task<request_encoder_result> request_encode(io::writer* writer, const client_request& req) noexcept;
+
+task<request_decoder_result>
+request_decode(std::allocator_arg_t,
+               std::pmr::polymorphic_allocator<> alloc,
+               io::buffered_reader*              reader,
+               std::size_t max_header_bytes = std::numeric_limits<std::size_t>::max()) noexcept;
+
 task<request_decoder_result>
 request_decode(std::unique_ptr<io::buffered_reader> reader,
                std::size_t max_header_bytes = std::numeric_limits<std::size_t>::max()) noexcept;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "http/http.hpp"
+
+namespace net::http::http11
+{
+
+// header_field is one header line, as it came in: its value is trimmed, but not split up on ','.
+struct header_field
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+// request_head is what request_parser makes of a request's head, all views into the buffer it was parsed from.
+struct request_head
+{
+    std::string_view              method;
+    std::string_view              target;
+    protocol_version              version{};
+    std::span<const header_field> fields;
+};
+
+// request_parser parses a request's head - its request line and headers - straight out of the buffer it was read
+// into, picohttpparser style: nothing is copied, and everything it hands out is a view into that buffer, which has to
+// stay put for as long as they're used.
+//
+// Input can come in bit by bit: parse() is given everything received so far each time, and only looks at what's new
+// for the end of the head. Once that's there, the head is parsed in one go.
+class request_parser
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit request_parser(std::size_t    max_head_bytes = std::numeric_limits<std::size_t>::max(),
+                            allocator_type alloc          = {}) noexcept
+        : max_head_bytes{max_head_bytes}
+        , fields{alloc}
+    {}
+
+    // parse returns the length of the head at the start of data once it's complete, or 0 if more is needed.
+    // Returns errc::value_too_large if the head is longer than max_head_bytes, counting the blank line that ends it,
+    // or errc::illegal_byte_sequence if it's malformed.
+    std::expected<std::size_t, std::error_condition> parse(std::string_view data);
+
+    // head is the request's head, once parse() has found all of it.
+    [[nodiscard]] const request_head& head() const noexcept { return parsed; }
+
+    // reset gets ready to parse the next request, keeping room for as many headers as the last one had.
+    void reset() noexcept;
+
+private:
+    std::error_condition parse_head(std::string_view head);
+
+    std::size_t max_head_bytes;
+
+    // how much of the input has already been looked through for the end of the head
+    std::size_t scanned = 0;
+
+    request_head                   parsed;
+    std::pmr::vector<header_field> fields;
+};
+
+}
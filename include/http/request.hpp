@@ -1,9 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <expected>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string_view>
 #include <system_error>
 
@@ -14,6 +17,7 @@
 #include "io/reader.hpp"
 #include "io/writer.hpp"
 #include "url.hpp"
+#include "util/arena.hpp"
 #include "util/string_util.hpp"
 
 namespace net::http
@@ -89,13 +93,19 @@ struct server_request
     url                uri{};
     net::http::headers headers;
 
-    std::unique_ptr<io::reader> body = nullptr;
+    // The body, and everything else the request holds, come from the allocator it was decoded with.
+    util::resource_ptr<io::reader> body = nullptr;
+
+    // When the request's first bytes arrived in the kernel, if the connection has timestamps enabled.
+    std::optional<std::chrono::system_clock::time_point> arrived_at;
 };
 
 using request_decoder_result = std::expected<server_request, std::error_condition>;
 using request_encoder_result = std::expected<io::writer*, std::error_condition>;
 
-using request_decoder = coro::task<request_decoder_result> (*)(std::unique_ptr<io::buffered_reader>,
+using request_decoder = coro::task<request_decoder_result> (*)(std::allocator_arg_t,
+                                                               std::pmr::polymorphic_allocator<>,
+                                                               io::buffered_reader*,
                                                                std::size_t) noexcept;
 using request_encoder = coro::task<request_encoder_result> (*)(io::writer*, const client_request&) noexcept;
 
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <expected>
 #include <memory>
+#include <span>
 #include <string_view>
 #include <system_error>
 #include <utility>
@@ -256,6 +257,13 @@ public:
     net::http::headers&     headers() noexcept;
     coro::task<io::writer*> send(status status_code, std::size_t content_length);
 
+    // send_encoded sends a whole response, head and body, the way encoded_by already encoded it for version - e.g. one
+    // kept from before. It returns false without sending anything if this writer would encode it some other way.
+    coro::task<bool> send_encoded(status                     status_code,
+                                  response_encoder           encoded_by,
+                                  protocol_version           version,
+                                  std::span<const std::byte> encoded);
+
 private:
     io::writer*      writer;
     server_response* resp;
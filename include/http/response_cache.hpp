@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "coro/task.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "http/router.hpp"
+#include "io/scheduler.hpp"
+#include "util/cache.hpp"
+#include "util/memory_budget.hpp"
+
+namespace net::http
+{
+
+struct response_cache_config
+{
+    // how many responses are kept, at most
+    std::size_t capacity = 1024;
+
+    // the largest response that's kept, head and body
+    std::size_t max_entry_bytes = 1024 * 1024;
+
+    // how long responses that don't say how long they're good for are kept; 0 is not at all
+    std::chrono::seconds default_max_age{0};
+
+    // if set, what's kept is reserved from it, and all of it is let go of when it comes under pressure
+    util::memory_budget* budget = nullptr;
+
+    // if set, requests that waited for another's response carry on there, instead of on the thread that answered it
+    io::scheduler* scheduler = nullptr;
+};
+
+// response_cache is middleware that answers GET requests from responses it keeps in memory, without calling the
+// handler behind it.
+//
+// Responses are told apart by the request's method, host, path and query (in any order), and the values of the
+// request fields they Vary by. They're kept for as long as their Cache-Control's s-maxage or max-age says, unless it
+// says no-store, no-cache or private, or they set a cookie. Requests with credentials, or that say no-store, always go
+// to the handler.
+//
+// A response is kept as HTTP/1.1 sends it, head and body in one piece, so answering an HTTP/1.1 request from the cache
+// is one write of it as it is. Other protocols get it sent again from its status, fields and body.
+//
+// A request with an If-None-Match that matches a kept response's ETag is answered 304. Once a response with an ETag is
+// stale, the handler is asked with If-None-Match whether it's still good, and if it answers 304 it's kept for longer.
+//
+// While the handler is working on a response, requests for the same one wait for it instead of calling the handler
+// too.
+class response_cache
+{
+public:
+    struct statistics
+    {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t collapsed;   // misses that waited for another request's response instead of calling the handler
+        std::uint64_t revalidated; // stale responses the handler said were still good
+        std::uint64_t stored;
+    };
+
+    explicit response_cache(response_cache_config config = {});
+
+    response_cache(const response_cache&)            = delete;
+    response_cache& operator=(const response_cache&) = delete;
+
+    response_cache(response_cache&&)            = delete;
+    response_cache& operator=(response_cache&&) = delete;
+
+    ~response_cache();
+
+    // wrap returns a handler that answers from the cache, and calls next for what isn't there. The cache has to last
+    // as long as the handler does.
+    template<typename H>
+        requires(
+            std::is_invocable_r_v<coro::task<void>, const std::decay_t<H>&, const server_request&, response_writer&>)
+    handler_func wrap(H&& next)
+    {
+        // NOTE: shared, as handler_func has to be copyable and e.g. a router isn't
+        auto         shared = std::make_shared<const std::decay_t<H>>(std::forward<H>(next));
+        handler_func h      = [shared](const server_request& req, response_writer& resp)
+        { return std::invoke(*shared, req, resp); };
+
+        return [this, h = std::move(h)](const server_request& req, response_writer& resp)
+        { return serve(req, resp, h); };
+    }
+
+    // purge lets go of every response that's kept.
+    void purge();
+
+    [[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+    [[nodiscard]] statistics  stats() const noexcept;
+
+private:
+    struct entry;
+    struct flight;
+
+    // flight_awaitable waits for the request that's calling the handler for the same response.
+    struct flight_awaitable
+    {
+        response_cache* cache;
+        flight*         f;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+        bool                         await_suspend(std::coroutine_handle<> handle);
+        constexpr void               await_resume() const noexcept {}
+    };
+
+    coro::task<void> serve(const server_request& req, response_writer& resp, const handler_func& next);
+
+    // fill calls next for a response, sending it to resp as it comes, and returns it if it's been kept.
+    coro::task<std::shared_ptr<const entry>> fill(const server_request&        req,
+                                                  response_writer&             resp,
+                                                  const handler_func&          next,
+                                                  const std::string&           primary,
+                                                  std::shared_ptr<const entry> stale);
+
+    // reply_with answers req with what's been kept.
+    static coro::task<void> reply_with(const entry& e, const server_request& req, response_writer& resp);
+
+    // lookup returns the response kept for key, fresh or not.
+    [[nodiscard]] std::shared_ptr<const entry> lookup(const std::string& key) noexcept;
+
+    // land hands what came of the request for key to those waiting for it.
+    void land(const std::string& key, const std::shared_ptr<flight>& f, std::shared_ptr<const entry> result) noexcept;
+
+    response_cache_config config;
+
+    // Both are kept by the hash of their key; entries have the whole of it, to tell them apart from others that hash
+    // the same. variants has what the responses for a primary key (all but what they Vary by) vary by.
+    util::cache<std::uint64_t, std::shared_ptr<const entry>>                    entries;
+    util::cache<std::uint64_t, std::shared_ptr<const std::vector<std::string>>> variants;
+
+    std::mutex                                               flights_mu;
+    std::unordered_map<std::string, std::shared_ptr<flight>> flights;
+
+    std::optional<std::size_t> shrinker;
+
+    std::atomic<std::uint64_t> hits        = 0;
+    std::atomic<std::uint64_t> misses      = 0;
+    std::atomic<std::uint64_t> collapsed   = 0;
+    std::atomic<std::uint64_t> revalidated = 0;
+    std::atomic<std::uint64_t> stored      = 0;
+};
+
+}
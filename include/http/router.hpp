@@ -1,91 +1,202 @@
 #pragma once
 
+#include <array>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
 #include <functional>
-#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "coro/task.hpp"
 #include "http/request.hpp"
 #include "http/response.hpp"
-#include "util/string_map.hpp"
 
 namespace net::http
 {
 
-using handler_func = std::function<coro::task<void>(const server_request&, response_writer&)>;
+// path_params are what a route's wildcards matched in a request's path, e.g. id=42 for /users/:id with /users/42.
+// The names are views into the router, and the values into the request's path.
+class path_params
+{
+public:
+    static constexpr std::size_t max_params = 8;
+
+    struct param
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    [[nodiscard]] std::optional<std::string_view> get(std::string_view name) const noexcept;
+
+    [[nodiscard]] const param* begin() const noexcept { return items.data(); }
+    [[nodiscard]] const param* end() const noexcept { return items.data() + count; }
+
+    [[nodiscard]] bool        empty() const noexcept { return count == 0; }
+    [[nodiscard]] std::size_t size() const noexcept { return count; }
 
-// TODO: it'd be neat if we could build a "perfect" router at compile time...
+private:
+    friend class router;
+
+    std::array<param, max_params> items{};
+    std::size_t                   count = 0;
+};
 
+using handler_func       = std::function<coro::task<void>(const server_request&, response_writer&)>;
+using param_handler_func = std::function<coro::task<void>(const server_request&, response_writer&, const path_params&)>;
+
+// router routes requests by their path and method, to handlers added as the program runs. For a set of routes that's
+// fixed at compile time, see static_router - which a router can fall back to.
+//
+// A route is a path, in which a segment that starts with ':' is a wildcard: it matches any segment that isn't empty,
+// and a handler that takes path_params gets what it matched. Where routes overlap, literal text is tried before a
+// wildcard.
+//
+// The routes are kept as a radix tree, flattened into one array of nodes, with the text of their edges in one string.
+// Finding a route walks the tree with the request's path as it is, and allocates nothing.
 class router final
 {
 public:
-    router& GET(std::string_view route, handler_func&& h)
+    // route_handler is what a route calls: one handler or the other.
+    struct route_handler
     {
-        return add(request_method::GET, route, std::forward<handler_func>(h));
+        handler_func       plain;
+        param_handler_func with_params;
+    };
+
+    template<typename H>
+    router& GET(std::string_view route, H&& h)
+    {
+        return add(request_method::GET, route, std::forward<H>(h));
     }
 
-    router& POST(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& POST(std::string_view route, H&& h)
     {
-        return add(request_method::POST, route, std::forward<handler_func>(h));
+        return add(request_method::POST, route, std::forward<H>(h));
     }
 
-    router& DELETE(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& DELETE(std::string_view route, H&& h)
     {
-        return add(request_method::DELETE, route, std::forward<handler_func>(h));
+        return add(request_method::DELETE, route, std::forward<H>(h));
     }
 
-    router& PUT(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& PUT(std::string_view route, H&& h)
     {
-        return add(request_method::PUT, route, std::forward<handler_func>(h));
+        return add(request_method::PUT, route, std::forward<H>(h));
     }
 
-    router& PATCH(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& PATCH(std::string_view route, H&& h)
     {
-        return add(request_method::PATCH, route, std::forward<handler_func>(h));
+        return add(request_method::PATCH, route, std::forward<H>(h));
     }
 
-    router& HEAD(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& HEAD(std::string_view route, H&& h)
     {
-        return add(request_method::HEAD, route, std::forward<handler_func>(h));
+        return add(request_method::HEAD, route, std::forward<H>(h));
     }
 
-    router& CONNECT(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& CONNECT(std::string_view route, H&& h)
     {
-        return add(request_method::CONNECT, route, std::forward<handler_func>(h));
+        return add(request_method::CONNECT, route, std::forward<H>(h));
     }
 
-    router& TRACE(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& TRACE(std::string_view route, H&& h)
     {
-        return add(request_method::TRACE, route, std::forward<handler_func>(h));
+        return add(request_method::TRACE, route, std::forward<H>(h));
     }
 
-    router& OPTIONS(std::string_view route, handler_func&& h)
+    template<typename H>
+    router& OPTIONS(std::string_view route, H&& h)
     {
-        return add(request_method::OPTIONS, route, std::forward<handler_func>(h));
+        return add(request_method::OPTIONS, route, std::forward<H>(h));
     }
 
+    // add adds a route, replacing any there was for the same method and path. It throws std::runtime_error if a
+    // wildcard has no name, has a different name than one already in the same place, or is one too many.
     router& add(request_method method, std::string_view route, handler_func&& h);
+    router& add(request_method method, std::string_view route, param_handler_func&& h);
 
+    // subrouter adds the routes sub_builder adds to a router of its own, under route.
     template<std::invocable<router&> I>
     router& subrouter(std::string_view route, I&& sub_builder)
     {
-        auto& sub = get_subrouter(route);
+        router sub;
         std::invoke(std::forward<I>(sub_builder), sub);
+        return merge(route, std::move(sub));
     }
 
+    // fallback sets a handler for the requests that no route matches, instead of answering them 404 or 405.
+    router& fallback(handler_func&& h);
+
+    // find returns the handler for method on path, and fills in params with what its wildcards matched - or
+    // status::NOT_FOUND or status::METHOD_NOT_ALLOWED.
+    [[nodiscard]] std::expected<const route_handler*, status>
+    find(request_method method, std::string_view path, path_params& params) const noexcept;
+
     coro::task<void> operator()(const server_request&, response_writer&) const;
 
 private:
-    router& get_subrouter(std::string_view route);
+    struct node
+    {
+        // the text leading to the node from its parent, in labels - or for a wildcard, its name
+        std::uint32_t label_offset = 0;
+        std::uint32_t label_length = 0;
+        char          lead         = 0; // the label's first character
+
+        // literal children are linked through next_sibling; there's at most one wildcard child
+        std::int32_t first_child    = -1;
+        std::int32_t next_sibling   = -1;
+        std::int32_t wildcard_child = -1;
+
+        // which methods have routes here, as bits by request_method, and where their handlers are in route_sets
+        std::uint16_t methods   = 0;
+        std::int32_t  route_set = -1;
+    };
+
+    static constexpr std::size_t method_count = static_cast<std::size_t>(request_method::NONE);
+
+    struct route_record
+    {
+        request_method method;
+        std::string    route;
+    };
+
+    router& add(request_method method, std::string_view route, route_handler&& h);
+    router& merge(std::string_view route, router&& sub);
+
+    [[nodiscard]] std::string_view label(const node& n) const noexcept
+    {
+        return {labels.data() + n.label_offset, n.label_length};
+    }
+
+    // insert returns the node for route, adding what it has to to get there.
+    std::size_t insert(std::string_view route);
+    std::size_t add_node(std::string_view text);
+
+    // split splits a node's label in two, at length.
+    void split(std::size_t at, std::size_t length);
+
+    // match returns the node that the rest of path leads to from at, or -1.
+    [[nodiscard]] std::int32_t match(std::size_t at, std::string_view path, path_params& params) const noexcept;
 
-    std::unordered_map<request_method, handler_func> method_handlers;
-    util::string_map<router>                         children;
-    std::unique_ptr<router>                          wildcard;
-    std::string                                      wildcard_name;
+    std::vector<node>                                    nodes;
+    std::string                                          labels;
+    std::vector<std::array<std::uint32_t, method_count>> route_sets; // indexes into handlers
+    std::vector<route_handler>                           handlers;
+    std::vector<route_record>                            records; // as handlers, for merging into another router
+    handler_func                                         fallback_handler;
 };
 
 }
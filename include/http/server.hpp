@@ -5,6 +5,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -13,12 +15,19 @@
 #include <spdlog/spdlog.h>
 
 #include "coro/task.hpp"
+#include "http/http2.hpp"
 #include "http/request.hpp"
 #include "http/response.hpp"
 #include "http/router.hpp"
+#include "instrument/prometheus/histogram.hpp"
+#include "io/buffered_reader.hpp"
+#include "io/buffered_writer.hpp"
 #include "io/scheduler.hpp"
+#include "util/arena.hpp"
+#include "util/memory_budget.hpp"
 
 #include "listen.hpp"
+#include "socket.hpp"
 #include "tcp.hpp"
 
 namespace net::http
@@ -33,11 +42,73 @@ struct server_config
     std::size_t                     max_header_bytes        = 8'192;
     std::chrono::seconds            header_read_timeout     = 5s;
     std::uint16_t                   max_pending_connections = 512;
+    std::size_t                     max_accept_batch        = listener::default_accept_batch;
     std::shared_ptr<spdlog::logger> logger                  = spdlog::default_logger();
     bool                            http11                  = true;
     bool                            http2                   = false;
     bool                            http3                   = false;
     std::size_t                     num_threads             = std::thread::hardware_concurrency();
+
+    // How long a connection may sit idle between requests (over HTTP/2, without any streams open), and how long one
+    // write to it may take. 0 is no limit.
+    // header_read_timeout starts once a request does, and caps how long its headers may take to arrive.
+    std::chrono::seconds idle_timeout  = 60s;
+    std::chrono::seconds write_timeout = 30s;
+
+    // Once a connection has gone this long without a new request, its buffers go back to the pool, and it waits for
+    // the next one without any - an idle keep-alive connection then costs little more than its socket. 0 sheds them
+    // as soon as a response is sent.
+    std::chrono::milliseconds idle_shed_after = 1s;
+
+    // Requests with a larger body than this are turned away with 413 Payload Too Large, before any of it is read. 0 is
+    // no limit.
+    std::size_t max_body_bytes = 0;
+
+    // Whatever a handler leaves unread of its request's body is read past before the next request on the connection.
+    // If there's more than this left, the connection is closed instead.
+    std::size_t max_unread_body_bytes = 256ull * 1'024;
+
+    // Responses to requests that were pipelined (sent before the responses to earlier ones came back) are held back
+    // while the next one's already in, and sent together in one write - up to this many of them at a time.
+    std::size_t max_pipeline_depth = 16;
+
+    // What connection buffers and request bodies are counted against. While it's under pressure, connections don't
+    // read their next request, and a request whose body doesn't fit is turned away with 503 Service Unavailable.
+    util::memory_budget* budget = &util::memory_budget::shared();
+
+    // If set, connections have the kernel timestamp what comes in (see socket::enable_rx_timestamps), so requests know
+    // when they arrived, and how long each one waited before its handler was called goes into the
+    // net_http_request_queueing_seconds histogram - time spent in socket buffers, the reactor and the scheduler.
+    bool rx_timestamps = false;
+
+    // One in this many connections has its TCP_INFO (see socket::tcp_info) sampled as it closes, into the
+    // net_tcp_rtt_seconds, net_tcp_retransmits and net_tcp_cwnd_segments histograms. 0 samples none.
+    std::size_t tcp_info_sample_every = 0;
+
+    // If set, the listener's accept queue length and limit (see listener::backlog) are sampled into the
+    // net_listener_backlog and net_listener_backlog_limit gauges whenever metrics are recorded.
+    bool sample_backlog = false;
+
+    // Each connection allocates what its requests need - headers, bodies, coroutine frames - from an arena that starts
+    // out with a block of this many bytes. It's reset between requests, and let go of while the connection is parked.
+    std::size_t request_arena_bytes = util::arena::default_block_size;
+
+    // Writes to a connection of at least this many bytes are sent with MSG_ZEROCOPY, if supported. 0 disables it.
+    std::size_t zerocopy_threshold = 0;
+
+    // Set on the listener and on every connection. The default favours latency: small responses go out right away
+    // instead of stalling on Nagle's algorithm or delayed ACKs.
+    tcp_options tcp = tcp_options::low_latency();
+
+    // With http2 set, connections that open with HTTP/2's preface, or ask to be upgraded to h2c, are served HTTP/2 -
+    // with these settings, and a receive window of http2_connection_window bytes shared between each one's streams.
+    // max_header_bytes applies to each stream's request.
+    http2::settings http2_settings{.enable_push = false, .max_concurrent_streams = 100};
+    std::uint32_t   http2_connection_window = 1'024ull * 1'024;
+
+    // If set, the server listens on this unix domain socket instead of on host and port.
+    // A leading '@' puts it in the abstract namespace.
+    std::string unix_path;
 };
 
 class server
@@ -56,10 +127,37 @@ public:
     void         close();
     coro::task<> serve();
 
+    // open_connections returns how many connections are being served, and parked_connections how many of those are
+    // idle, and have shed their buffers.
+    [[nodiscard]] std::size_t open_connections() const noexcept { return num_open.load(std::memory_order::relaxed); }
+    [[nodiscard]] std::size_t parked_connections() const noexcept
+    {
+        return num_parked.load(std::memory_order::relaxed);
+    }
+
 private:
-    coro::task<>     serve_connection(tcp_socket conn) noexcept;
-    void             serve_http11(tcp_socket conn) noexcept;
-    void             serve_http2(tcp_socket conn) noexcept;
+    // connection is what a connection keeps from one request to the next.
+    struct connection
+    {
+        connection(socket& sock, std::size_t arena_bytes);
+
+        socket&             sock;
+        io::buffered_reader reader;
+        io::buffered_writer writer;
+        util::arena         arena;
+
+        // how many responses are waiting in writer, for the requests pipelined behind them
+        std::size_t pipelined = 0;
+    };
+
+    coro::task<>     serve_connection(socket sock) noexcept;
+    coro::task<bool> wait_for_room();
+    coro::task<bool> wait_for_request(connection& conn);
+    coro::task<bool> serve_request(std::allocator_arg_t, std::pmr::polymorphic_allocator<> alloc, connection& conn);
+    coro::task<>     refuse_request(connection& conn, const server_request& req, status code);
+    void             sample_tcp_info(const socket& conn) noexcept;
+    void             serve_http11(socket conn) noexcept;
+    coro::task<>     serve_http2(connection& conn, const server_request* upgraded);
     std::string_view upgrade_to_protocol(const server_request& req) const noexcept;
     bool             is_protocol_supported(std::string_view protocol) const noexcept;
     bool             enforce_protocol(const server_request& req, response_writer& resp) noexcept;
@@ -70,8 +168,33 @@ private:
     std::shared_ptr<spdlog::logger> logger;
     io::scheduler*                  scheduler;
 
-    std::size_t   max_header_bytes;
-    std::uint16_t max_pending_connections;
+    std::size_t               max_header_bytes;
+    std::chrono::milliseconds header_read_timeout;
+    std::chrono::milliseconds idle_timeout;
+    std::chrono::milliseconds write_timeout;
+    std::chrono::milliseconds idle_shed_after;
+    std::size_t               max_body_bytes;
+    util::memory_budget*      budget;
+    std::size_t               request_arena_bytes;
+    std::size_t               max_unread_body_bytes;
+    std::size_t               max_pipeline_depth;
+    std::uint16_t             max_pending_connections;
+    std::size_t               max_accept_batch;
+    std::size_t               zerocopy_threshold;
+    bool                      rx_timestamps;
+    std::size_t               tcp_info_sample_every;
+    bool                      http2_enabled;
+    http2::server_options     http2_options;
+
+    instrument::prometheus::histogram* queueing_delay  = nullptr;
+    instrument::prometheus::histogram* tcp_rtt         = nullptr;
+    instrument::prometheus::histogram* tcp_retransmits = nullptr;
+    instrument::prometheus::histogram* tcp_cwnd        = nullptr;
+    std::optional<std::size_t>         backlog_collector;
+
+    std::atomic_size_t num_open   = 0;
+    std::atomic_size_t num_parked = 0;
+    std::atomic_size_t num_closed = 0;
 };
 
 }
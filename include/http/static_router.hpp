@@ -0,0 +1,460 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "coro/task.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "util/hash.hpp"
+
+namespace net::http
+{
+
+// route_string is a route's pattern as a template argument, e.g. "/users/:id/posts/:slug". A segment that starts with
+// ':' captures whatever's in its place.
+template<std::size_t N>
+struct route_string
+{
+    consteval route_string(const char (&text)[N]) noexcept { std::copy_n(text, N, chars.begin()); }
+
+    [[nodiscard]] constexpr std::string_view view() const noexcept { return {chars.data(), N - 1}; }
+
+    std::array<char, N> chars{};
+};
+
+// route is one entry of a static_router's table: requests for Method on a path that matches Pattern go to Handler.
+//
+// Handler is a function, or a lambda that captures nothing, called as Handler(req, resp, captures...) - with a
+// parameter for each of Pattern's captures, in order. Their types say what the captures have to be: a
+// std::string_view or std::string takes anything, and an integer only digits that fit.
+template<request_method Method, route_string Pattern, auto Handler>
+struct route
+{
+    static constexpr request_method   method  = Method;
+    static constexpr std::string_view pattern = Pattern.view();
+    static constexpr auto             handler = Handler;
+};
+
+// route_capture is what a captured segment can be passed to a handler as.
+template<typename T>
+concept route_capture = std::same_as<T, std::string_view> || std::same_as<T, std::string>
+                     || (std::integral<T> && !std::same_as<T, bool>);
+
+namespace detail
+{
+
+inline constexpr std::size_t method_count = static_cast<std::size_t>(request_method::NONE);
+
+// handler_captures is the types of a handler's parameters past the request and response.
+template<typename F>
+struct handler_captures : handler_captures<decltype(&F::operator())>
+{};
+
+template<typename R, typename Req, typename Resp, typename... Captures>
+struct handler_captures<R (*)(Req, Resp, Captures...)>
+{
+    using type = std::tuple<std::remove_cvref_t<Captures>...>;
+
+    // whether the handler takes any of them by reference, which has to outlive the call to it
+    static constexpr bool by_reference = (std::is_reference_v<Captures> || ...);
+};
+
+template<typename R, typename Req, typename Resp, typename... Captures>
+struct handler_captures<R (*)(Req, Resp, Captures...) noexcept> : handler_captures<R (*)(Req, Resp, Captures...)>
+{};
+
+template<typename C, typename R, typename Req, typename Resp, typename... Captures>
+struct handler_captures<R (C::*)(Req, Resp, Captures...) const> : handler_captures<R (*)(Req, Resp, Captures...)>
+{};
+
+template<typename C, typename R, typename Req, typename Resp, typename... Captures>
+struct handler_captures<R (C::*)(Req, Resp, Captures...) const noexcept>
+    : handler_captures<R (*)(Req, Resp, Captures...)>
+{};
+
+// for_each_segment calls f with each of a path's segments: "/" has none, and "/a//b/" has "a", "", "b" and "".
+template<typename F>
+constexpr void for_each_segment(std::string_view path, F&& f)
+{
+    if (path.starts_with('/')) path.remove_prefix(1);
+    if (path.empty()) return;
+
+    for (;;)
+    {
+        auto end = path.find('/');
+        f(path.substr(0, end));
+        if (end == std::string_view::npos) return;
+
+        path.remove_prefix(end + 1);
+    }
+}
+
+constexpr bool is_capture(std::string_view segment) noexcept { return segment.starts_with(':'); }
+
+constexpr std::size_t count_captures(std::string_view pattern)
+{
+    std::size_t count = 0;
+    for_each_segment(pattern, [&](std::string_view segment) { count += is_capture(segment) ? 1 : 0; });
+
+    return count;
+}
+
+// segment_hash is FNV-1a, mixed with a seed so that a seed can be found that gives every segment leaving a node a
+// slot of its own.
+constexpr std::size_t segment_hash(std::string_view segment, std::size_t seed) noexcept
+{
+    std::size_t hash = 0xcbf29ce484222325;
+    for (unsigned char c : segment) hash = (hash ^ c) * 0x00000100000001b3;
+
+    return util::detail::distribute(hash ^ seed);
+}
+
+// trie_node is a node of the routes' tree while it's being built, with a child for each literal segment that leads
+// on from it, and one for any capture.
+struct trie_node
+{
+    std::vector<std::pair<std::string_view, std::size_t>> children;
+    std::int32_t                                          capture = -1;
+    std::array<std::int16_t, method_count>                routes  = make_no_routes();
+
+    static constexpr std::array<std::int16_t, method_count> make_no_routes() noexcept
+    {
+        std::array<std::int16_t, method_count> none{};
+        none.fill(-1);
+        return none;
+    }
+};
+
+constexpr std::vector<trie_node> make_trie(std::span<const std::string_view> patterns,
+                                           std::span<const request_method>   methods)
+{
+    std::vector<trie_node> nodes(1);
+    for (std::size_t i = 0; i < patterns.size(); ++i)
+    {
+        if (!patterns[i].starts_with('/')) throw std::logic_error{"a route has to start with '/'"};
+
+        std::size_t at = 0;
+        for_each_segment(patterns[i],
+                         [&](std::string_view segment)
+                         {
+                             if (is_capture(segment))
+                             {
+                                 if (segment.size() == 1) throw std::logic_error{"a capture has to have a name"};
+
+                                 if (nodes[at].capture < 0)
+                                 {
+                                     nodes[at].capture = static_cast<std::int32_t>(nodes.size());
+                                     nodes.emplace_back();
+                                 }
+                                 at = static_cast<std::size_t>(nodes[at].capture);
+                                 return;
+                             }
+
+                             auto& children = nodes[at].children;
+                             auto  named    = [&](const auto& child) { return child.first == segment; };
+                             if (auto it = std::ranges::find_if(children, named); it != children.end())
+                             {
+                                 at = it->second;
+                                 return;
+                             }
+
+                             children.emplace_back(segment, nodes.size());
+                             at = nodes.size();
+                             nodes.emplace_back();
+                         });
+
+        auto& route = nodes[at].routes[static_cast<std::size_t>(methods[i])];
+        if (route >= 0) throw std::logic_error{"two routes for the same method and path"};
+        route = static_cast<std::int16_t>(i);
+    }
+
+    return nodes;
+}
+
+// slot_count is how many slots a node's literal children get: twice as many as there are, rounded up to a power of
+// two, which makes a perfect hash quick to find.
+constexpr std::size_t slot_count(std::size_t children) noexcept
+{
+    return children == 0 ? 0 : std::bit_ceil(children * 2);
+}
+
+struct table_sizes
+{
+    std::size_t nodes    = 0;
+    std::size_t slots    = 0;
+    std::size_t captures = 0;
+};
+
+consteval table_sizes measure(std::span<const std::string_view> patterns, std::span<const request_method> methods)
+{
+    table_sizes sizes;
+    for (const auto& node : make_trie(patterns, methods))
+    {
+        ++sizes.nodes;
+        sizes.slots += slot_count(node.children.size());
+    }
+    for (auto pattern : patterns) sizes.captures = std::max(sizes.captures, count_captures(pattern));
+
+    return sizes;
+}
+
+// route_table is the routes' tree, flattened: each node's literal children are in a perfect hash table of their own,
+// in slots, so following a segment is one hash and one comparison.
+template<std::size_t Nodes, std::size_t Slots>
+struct route_table
+{
+    struct node
+    {
+        std::uint32_t                          first_slot = 0;
+        std::uint32_t                          slots      = 0;
+        std::size_t                            seed       = 0;
+        std::int32_t                           capture    = -1;
+        bool                                   any_routes = false;
+        std::array<std::int16_t, method_count> routes{};
+    };
+
+    struct slot
+    {
+        std::string_view segment;
+        std::int32_t     child = -1;
+    };
+
+    std::array<node, Nodes> nodes{};
+    std::array<slot, Slots> slots{};
+};
+
+template<std::size_t Nodes, std::size_t Slots>
+consteval route_table<Nodes, Slots> make_table(std::span<const std::string_view> patterns,
+                                               std::span<const request_method>   methods)
+{
+    auto trie = make_trie(patterns, methods);
+
+    route_table<Nodes, Slots> table;
+    std::size_t               next_slot = 0;
+    for (std::size_t i = 0; i < trie.size(); ++i)
+    {
+        const auto& from = trie[i];
+        auto&       to   = table.nodes[i];
+
+        to.capture    = from.capture;
+        to.routes     = from.routes;
+        to.any_routes = std::ranges::any_of(from.routes, [](auto route) { return route >= 0; });
+        to.first_slot = static_cast<std::uint32_t>(next_slot);
+        to.slots      = static_cast<std::uint32_t>(slot_count(from.children.size()));
+        if (to.slots == 0) continue;
+
+        // the first seed that puts every child in a slot of its own
+        auto fits = [&](std::size_t seed)
+        {
+            std::vector<char> taken(to.slots);
+            for (const auto& [segment, child] : from.children)
+            {
+                auto slot = segment_hash(segment, seed) & (to.slots - 1);
+                if (taken[slot] != 0) return false;
+                taken[slot] = 1;
+            }
+            return true;
+        };
+
+        while (!fits(to.seed))
+        {
+            if (++to.seed == 1U << 16U) throw std::logic_error{"no perfect hash for a route's segments"};
+        }
+
+        for (const auto& [segment, child] : from.children)
+        {
+            auto slot = segment_hash(segment, to.seed) & (to.slots - 1);
+            table.slots[next_slot + slot] = {.segment = segment, .child = static_cast<std::int32_t>(child)};
+        }
+        next_slot += to.slots;
+    }
+
+    return table;
+}
+
+template<route_capture T>
+bool parse_capture(std::string_view text, T& out)
+{
+    if constexpr (std::integral<T>)
+    {
+        const auto* end   = text.data() + text.size();
+        auto [parsed, ec] = std::from_chars(text.data(), end, out);
+        return ec == std::errc{} && parsed == end;
+    }
+    else
+    {
+        out = T{text};
+        return true;
+    }
+}
+
+inline coro::task<void> reply(response_writer& resp, status code) { co_await resp.send(code, 0); }
+
+// call_holding calls a handler that takes its captures by reference, and keeps them for as long as it runs.
+template<typename H, typename Values, std::size_t... C>
+coro::task<void> call_holding(const H&                 h,
+                              const server_request&    req,
+                              response_writer&         resp,
+                              Values                   parsed,
+                              std::index_sequence<C...> /* captures */)
+{
+    co_await std::invoke(h, req, resp, std::get<C>(parsed)...);
+}
+
+}
+
+// static_router routes requests by a table of routes fixed at compile time, e.g.
+//
+//     using api = http::static_router<
+//         http::route<http::request_method::GET, "/", index>,
+//         http::route<http::request_method::GET, "/users/:id", show_user>, // show_user(req, resp, std::uint64_t id)
+//         http::route<http::request_method::PUT, "/users/:id", save_user>>;
+//
+// Its tree is built by the compiler, with a perfect hash for the literal segments leading on from each node, and
+// mistakes in it - two routes for the same method and path, or a handler without a parameter for each capture - don't
+// compile. Matching a path allocates nothing, and handlers are called directly, not through a std::function.
+//
+// As with router, a literal segment is tried before a capture, and there's no going back to try the capture if the
+// literal leads nowhere. A capture doesn't match an empty segment, nor one that isn't what its handler takes, e.g. an
+// integer; either way the request gets a 404.
+template<typename... Routes>
+class static_router final
+{
+    static constexpr std::array<std::string_view, sizeof...(Routes)> patterns{Routes::pattern...};
+    static constexpr std::array<request_method, sizeof...(Routes)>   methods{Routes::method...};
+
+    static constexpr auto sizes = detail::measure(patterns, methods);
+    static constexpr auto table = detail::make_table<sizes.nodes, sizes.slots>(patterns, methods);
+
+    template<typename Route>
+    using handler_captures_of = detail::handler_captures<std::remove_cvref_t<decltype(Route::handler)>>;
+
+    template<typename Route>
+    using captures_of = typename handler_captures_of<Route>::type;
+
+    static_assert(((std::tuple_size_v<captures_of<Routes>> == detail::count_captures(Routes::pattern)) && ...),
+                  "a route's handler has to take a parameter for each of its captures");
+
+    using captures = std::array<std::string_view, sizes.captures>;
+
+public:
+    coro::task<void> operator()(const server_request& req, response_writer& resp) const
+    {
+        captures   found{};
+        const auto at = match(req.uri.path, found);
+        if (at < 0) return detail::reply(resp, status::NOT_FOUND);
+
+        const auto& node   = table.nodes[static_cast<std::size_t>(at)];
+        const auto  method = static_cast<std::size_t>(req.method);
+        if (!node.any_routes) return detail::reply(resp, status::NOT_FOUND);
+        if (method >= detail::method_count || node.routes[method] < 0)
+        {
+            return detail::reply(resp, status::METHOD_NOT_ALLOWED);
+        }
+
+        return dispatch(static_cast<std::size_t>(node.routes[method]),
+                        req,
+                        resp,
+                        found,
+                        std::index_sequence_for<Routes...>{});
+    }
+
+private:
+    // match returns the node that path leads to, or -1 if it doesn't lead anywhere, and fills in found with what the
+    // captures along the way matched.
+    static std::int32_t match(std::string_view path, captures& found) noexcept
+    {
+        std::int32_t at    = 0;
+        std::size_t  count = 0;
+        detail::for_each_segment(path,
+                                 [&](std::string_view segment)
+                                 {
+                                     if (at < 0) return;
+
+                                     const auto& node = table.nodes[static_cast<std::size_t>(at)];
+                                     if (node.slots != 0)
+                                     {
+                                         auto hash = detail::segment_hash(segment, node.seed) & (node.slots - 1);
+
+                                         const auto& slot = table.slots[node.first_slot + hash];
+                                         if (slot.child >= 0 && slot.segment == segment)
+                                         {
+                                             at = slot.child;
+                                             return;
+                                         }
+                                     }
+
+                                     if (node.capture >= 0 && !segment.empty() && count < found.size())
+                                     {
+                                         found[count++] = segment;
+                                         at             = node.capture;
+                                         return;
+                                     }
+
+                                     at = -1;
+                                 });
+
+        return at;
+    }
+
+    template<std::size_t... I>
+    static coro::task<void> dispatch(std::size_t                route,
+                                     const server_request&      req,
+                                     response_writer&           resp,
+                                     const captures&            found,
+                                     std::index_sequence<I...> /* routes */)
+    {
+        coro::task<void> called;
+        static_cast<void>(((route == I && (called = invoke<I>(req, resp, found), true)) || ...));
+
+        return called;
+    }
+
+    template<std::size_t I>
+    static coro::task<void> invoke(const server_request& req, response_writer& resp, const captures& found)
+    {
+        using chosen = std::tuple_element_t<I, std::tuple<Routes...>>;
+        using values = captures_of<chosen>;
+
+        return [&]<std::size_t... C>(std::index_sequence<C...> /* captures */)
+        {
+            values parsed;
+            if (!(detail::parse_capture(found[C], std::get<C>(parsed)) && ...))
+            {
+                return detail::reply(resp, status::NOT_FOUND);
+            }
+
+            // A handler's task only starts once it's awaited, so what it takes by reference has to be kept for it.
+            if constexpr (handler_captures_of<chosen>::by_reference)
+            {
+                return detail::call_holding(chosen::handler,
+                                            req,
+                                            resp,
+                                            std::move(parsed),
+                                            std::index_sequence<C...>{});
+            }
+            else
+            {
+                return coro::task<void>{std::invoke(chosen::handler, req, resp, std::get<C>(std::move(parsed))...)};
+            }
+        }(std::make_index_sequence<std::tuple_size_v<values>>{});
+    }
+};
+
+}
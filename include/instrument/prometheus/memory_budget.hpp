@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+#include "util/memory_budget.hpp"
+
+namespace net::instrument::prometheus
+{
+
+// export_memory_budget registers gauges for how much of budget is reserved and used, against its limit, and how many
+// reservations it's refused. They're sampled whenever metrics are recorded.
+void export_memory_budget(const util::memory_budget& budget = util::memory_budget::shared(),
+                          const std::string&         prefix = "net_memory_budget");
+
+}
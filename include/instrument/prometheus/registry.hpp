@@ -84,6 +84,11 @@ public:
             .transform([](metric_ref val) -> std::reference_wrapper<T> { return std::ref(std::get<T>(val.get())); });
     }
 
+    // add_collector registers a callback that's run whenever metrics are recorded, to bring those that are sampled,
+    // rather than updated as things happen, up to date. It returns an id to remove it by, once what it samples is gone.
+    static std::size_t add_collector(std::function<void()>&& collect);
+    static void        remove_collector(std::size_t id);
+
     static coro::task<io::result> record(io::writer& writer);
 
 private:
@@ -103,8 +108,10 @@ private:
     std::optional<metric_ref> get_metric(std::string_view name, const metric_labels& labels);
     coro::task<io::result>    record_all(io::writer& out) const;
 
-    std::shared_mutex  mutex;
-    std::deque<metric> metrics;
+    std::shared_mutex                                          mutex;
+    std::deque<metric>                                         metrics;
+    std::vector<std::pair<std::size_t, std::function<void()>>> collectors;
+    std::size_t                                                next_collector_id = 0;
 
     lookup_table lookup;
 };
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "util/buffer_pool.hpp"
+#include "util/memory_budget.hpp"
+
+namespace net::io
+{
+
+using namespace std::chrono_literals;
+
+// buffer_policy decides how big the buffer of a buffered_reader or buffered_writer is, and how that changes.
+//
+// A buffer starts out at initial bytes. Whenever a read fills it to the brim, or a write doesn't fit, it doubles (up
+// to max), so a connection moving lots of data ends up doing so in fewer, larger system calls. Once it hasn't needed
+// to be that big for shrink_after, it drops back down to min the next time it's empty, so connections that are
+// mostly idle don't hang on to memory they aren't using.
+//
+// Every buffer is reserved from budget. A buffer doesn't grow if the budget won't allow it, but a connection always
+// gets its first one.
+struct buffer_policy
+{
+    std::size_t               initial      = 1'024;
+    std::size_t               min          = 1'024;
+    std::size_t               max          = 64ull * 1'024;
+    std::chrono::milliseconds shrink_after = 5s;
+
+    // Where buffers come from, and go back to once they're done with. If null, they're simply allocated and freed.
+    util::sized_buffer_pool* pool = &util::sized_buffer_pool::shared();
+
+    // What buffers are counted against. If null, they aren't.
+    util::memory_budget* budget = &util::memory_budget::shared();
+
+    // fixed returns a policy for a buffer of exactly size bytes, that never grows or shrinks.
+    static buffer_policy fixed(std::size_t size) noexcept
+    {
+        return {.initial = size, .min = size, .max = size, .shrink_after = 0ms, .pool = nullptr};
+    }
+};
+
+// buffer_stats counts what buffered readers and writers have done with their buffers, all together.
+struct buffer_stats
+{
+    std::uint64_t grows;
+    std::uint64_t shrinks;
+    std::uint64_t bytes_held; // the capacity of every buffer currently in use
+};
+
+[[nodiscard]] buffer_stats buffer_usage() noexcept;
+
+namespace detail
+{
+
+using buffer_clock = std::chrono::steady_clock;
+
+// acquire returns an empty buffer with a capacity of at least size.
+std::vector<std::byte> acquire_buffer(const buffer_policy& policy, std::size_t size);
+
+// release gives buf back (or frees it), leaving it empty.
+void release_buffer(const buffer_policy& policy, std::vector<std::byte>& buf) noexcept;
+
+// resize_buffer swaps buf for one with a capacity of at least capacity, keeping its contents - which have to fit.
+void resize_buffer(const buffer_policy& policy, std::vector<std::byte>& buf, std::size_t capacity);
+
+// grow_buffer doubles buf's capacity, up to the policy's max, and returns whether it did.
+bool grow_buffer(const buffer_policy& policy, std::vector<std::byte>& buf);
+
+// shrink_buffer drops an empty buf back down to the policy's min, and returns whether it did.
+bool shrink_buffer(const buffer_policy& policy, std::vector<std::byte>& buf);
+
+}
+
+}
@@ -7,6 +7,7 @@
 #include <tuple>
 #include <vector>
 
+#include "buffer_policy.hpp"
 #include "coro/task.hpp"
 #include "io.hpp"
 #include "reader.hpp"
@@ -14,10 +15,24 @@
 namespace net::io
 {
 
-class buffered_reader : public reader
+class buffered_reader final : public reader
 {
 public:
-    buffered_reader(reader* impl, std::size_t bufsize = 1'024);
+    // The buffer adapts to how the reader is used, as set out by policy.
+    explicit buffered_reader(reader* impl, const buffer_policy& policy = {});
+
+    // The buffer is exactly bufsize bytes, always.
+    buffered_reader(reader* impl, std::size_t bufsize);
+
+    buffered_reader(const buffered_reader&)            = delete;
+    buffered_reader& operator=(const buffered_reader&) = delete;
+
+    buffered_reader(buffered_reader&&) noexcept = default;
+
+    // Lets go of this one's buffer first, so it's given back to its pool and budget.
+    buffered_reader& operator=(buffered_reader&& other) noexcept;
+
+    ~buffered_reader() override;
 
     coro::task<result> read(std::span<std::byte> data) override;
 
@@ -41,13 +56,28 @@ public:
         return read_until(std::as_bytes(std::span{delim.begin(), delim.end()}));
     }
 
+    // read_buffered copies whatever's buffered already into data, without reading any more, and returns how much that
+    // was. Layers stacked on top use it to skip suspending while there's data at hand (see io::take_buffered).
+    std::size_t read_buffered(std::span<std::byte> data) noexcept;
+
+    // buffered is a view of what's in the buffer, for parsing in place. It's good until the next read, or consume().
+    [[nodiscard]] std::span<const std::byte> buffered() const noexcept { return std::span{buf}.subspan(head); }
+
+    // more reads some more into the buffer, after what's there already, and returns how much that was. The buffer
+    // grows first if it's full, and the policy allows it. If nothing could be read, error() says why - or if there's
+    // no error, the buffer is full.
+    coro::task<std::size_t> more();
+
+    // consume drops the first count bytes of the buffer, once what they hold has been dealt with.
+    void consume(std::size_t count) noexcept;
+
     // peek sets next to the next byte and returns true, if available.
     //
     // If no next byte is available, next is not modified, and false is returned.
     [[nodiscard]] coro::task<std::tuple<std::byte, bool>> peek();
 
     [[nodiscard]] std::size_t capacity() const noexcept { return buf.capacity(); }
-    [[nodiscard]] std::size_t size() const noexcept { return buf.size(); }
+    [[nodiscard]] std::size_t size() const noexcept { return buf.size() - head; }
 
     // reset clears the buffer, and if other is not null, switches to it.
     // If other is null, the current reader is kept.
@@ -57,6 +87,13 @@ public:
     // reset clears the buffer.
     void reset();
 
+    // shrink drops the buffer back down to the policy's minimum size, if it's empty, and returns whether it did.
+    bool shrink();
+
+    // release gives the buffer back, if it's empty, and returns whether it did - e.g. while whatever's being read from
+    // is idle. A new one is taken for the next read.
+    bool release() noexcept;
+
     // error returns the current error, if any.
     // Potentially useful if e.g. peek() fails.
     [[nodiscard]] std::error_condition error() const;
@@ -66,9 +103,12 @@ public:
 private:
     coro::task<void> fill();
 
-    reader*                impl;
-    std::vector<std::byte> buf;
-    std::error_condition   err;
+    reader*                          impl;
+    buffer_policy                    policy;
+    std::vector<std::byte>           buf;
+    std::size_t                      head = 0; // where what's unread in buf starts; what's before it is consumed
+    std::error_condition             err;
+    detail::buffer_clock::time_point last_full;
 };
 
 }
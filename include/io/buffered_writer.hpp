@@ -4,6 +4,7 @@
 #include <span>
 #include <vector>
 
+#include "buffer_policy.hpp"
 #include "coro/task.hpp"
 #include "io.hpp"
 #include "writer.hpp"
@@ -11,10 +12,24 @@
 namespace net::io
 {
 
-class buffered_writer : public writer
+class buffered_writer final : public writer
 {
 public:
-    buffered_writer(writer* underlying, std::size_t bufsize = 1'024);
+    // The buffer adapts to how the writer is used, as set out by policy.
+    explicit buffered_writer(writer* underlying, const buffer_policy& policy = {});
+
+    // The buffer is exactly bufsize bytes, always.
+    buffered_writer(writer* underlying, std::size_t bufsize);
+
+    buffered_writer(const buffered_writer&)            = delete;
+    buffered_writer& operator=(const buffered_writer&) = delete;
+
+    buffered_writer(buffered_writer&&) noexcept = default;
+
+    // Lets go of this one's buffer first, so it's given back to its pool and budget.
+    buffered_writer& operator=(buffered_writer&& other) noexcept;
+
+    ~buffered_writer() override;
 
     coro::task<result> write(std::span<const std::byte> data) override;
 
@@ -37,11 +52,19 @@ public:
     // reset clears the buffer.
     void reset();
 
+    // shrink drops the buffer back down to the policy's minimum size, if it's empty, and returns whether it did.
+    bool shrink();
+
+    // release gives the buffer back, if it's empty, and returns whether it did. A new one is taken for the next write.
+    bool release() noexcept;
+
 private:
     coro::task<result> flush_available();
 
-    writer*                impl;
-    std::vector<std::byte> buf;
+    writer*                          impl;
+    buffer_policy                    policy;
+    std::vector<std::byte>           buf;
+    detail::buffer_clock::time_point last_full;
 };
 
 }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "coro/task.hpp"
+#include "io.hpp"
+
+namespace net::io
+{
+
+// async_reader is anything that reads like io::reader, without having to derive from it. Readers that only need to
+// know what they read from at compile time take one of these by value (see e.g. basic_limit_reader), so a whole
+// stack of them is one object, with no virtual calls from one layer to the next.
+template<typename T>
+concept async_reader = requires(T& r, const T& cr, std::span<std::byte> data)
+// clang-format off
+{
+    { r.read(data) }         -> std::same_as<coro::task<result>>;
+    { cr.native_handle() }   -> std::convertible_to<int>;
+};
+// clang-format on
+
+// async_writer is anything that writes like io::writer, without having to derive from it.
+template<typename T>
+concept async_writer = requires(T& w, const T& cw, std::span<const std::byte> data)
+// clang-format off
+{
+    { w.write(data) }        -> std::same_as<coro::task<result>>;
+    { cw.native_handle() }   -> std::convertible_to<int>;
+};
+// clang-format on
+
+// buffered_source is a reader that can hand out what it already has buffered right away, without suspending.
+template<typename T>
+concept buffered_source = async_reader<T> && requires(T& r, std::span<std::byte> data)
+// clang-format off
+{
+    { r.read_buffered(data) } -> std::same_as<std::size_t>;
+};
+// clang-format on
+
+namespace detail
+{
+
+// deref lets a layer hold what it reads from (or writes to) either by value, or through a pointer - e.g. a
+// std::unique_ptr to a reader shared with whoever comes next.
+template<typename T>
+constexpr T& deref(T& value) noexcept
+{
+    return value;
+}
+
+template<typename T>
+constexpr T& deref(T* value) noexcept
+{
+    return *value;
+}
+
+template<typename T, typename D>
+constexpr T& deref(std::unique_ptr<T, D>& value) noexcept
+{
+    return *value;
+}
+
+template<typename T, typename D>
+constexpr T& deref(const std::unique_ptr<T, D>& value) noexcept
+{
+    return *value;
+}
+
+template<typename T>
+using deref_t = std::remove_cvref_t<decltype(deref(std::declval<T&>()))>;
+
+}
+
+// take_buffered copies into data whatever r has buffered already, and returns how much that was. It's always 0 for
+// readers that don't buffer.
+template<async_reader R>
+std::size_t take_buffered(R& r, std::span<std::byte> data) noexcept
+{
+    if constexpr (buffered_source<R>) return r.read_buffered(data);
+    else return 0;
+}
+
+}
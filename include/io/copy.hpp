@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+#include "coro/task.hpp"
+#include "io/io.hpp"
+#include "io/reader.hpp"
+#include "io/writer.hpp"
+
+namespace net::io
+{
+
+// copy moves up to limit bytes from in to out, stopping early if in runs out. Running out of input is not an error.
+//
+// If out can pull from in directly (see writer::read_from), the bytes never enter user space: e.g. a socket reading
+// from a regular file uses sendfile(2), and from another socket or a pipe uses splice(2).
+// Otherwise, the bytes are moved through a buffer borrowed from a shared pool.
+coro::task<result> copy(reader& in, writer& out, std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+}
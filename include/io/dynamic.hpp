@@ -0,0 +1,93 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <utility>
+
+#include "concepts.hpp"
+#include "coro/task.hpp"
+#include "io.hpp"
+#include "reader.hpp"
+#include "util/arena.hpp"
+#include "writer.hpp"
+
+namespace net::io
+{
+
+// dynamic_reader puts a statically composed reader behind the io::reader interface, for where its type can't be
+// known, e.g. a request body handed to a handler. Only the outermost layer is called virtually - everything below it
+// is called directly, and lives inside this one object.
+template<typename Reader>
+    requires async_reader<detail::deref_t<Reader>>
+class dynamic_reader final : public reader
+{
+public:
+    template<typename... Args>
+        requires std::constructible_from<Reader, Args...>
+    explicit dynamic_reader(Args&&... args)
+        : inner(std::forward<Args>(args)...)
+    {}
+
+    coro::task<result> read(std::span<std::byte> data) override { return detail::deref(inner).read(data); }
+
+    using reader::read;
+
+    [[nodiscard]] int native_handle() const noexcept override { return detail::deref(inner).native_handle(); }
+
+    [[nodiscard]] Reader&       get() noexcept { return inner; }
+    [[nodiscard]] const Reader& get() const noexcept { return inner; }
+
+private:
+    Reader inner;
+};
+
+// dynamic_writer puts a statically composed writer behind the io::writer interface.
+template<typename Writer>
+    requires async_writer<detail::deref_t<Writer>>
+class dynamic_writer final : public writer
+{
+public:
+    template<typename... Args>
+        requires std::constructible_from<Writer, Args...>
+    explicit dynamic_writer(Args&&... args)
+        : inner(std::forward<Args>(args)...)
+    {}
+
+    coro::task<result> write(std::span<const std::byte> data) override { return detail::deref(inner).write(data); }
+
+    using writer::write;
+
+    [[nodiscard]] int native_handle() const noexcept override { return detail::deref(inner).native_handle(); }
+
+    [[nodiscard]] Writer&       get() noexcept { return inner; }
+    [[nodiscard]] const Writer& get() const noexcept { return inner; }
+
+private:
+    Writer inner;
+};
+
+// make_dynamic_reader type-erases r, with the one allocation that takes.
+template<typename Reader>
+std::unique_ptr<reader> make_dynamic_reader(Reader&& r)
+{
+    return std::make_unique<dynamic_reader<std::remove_cvref_t<Reader>>>(std::forward<Reader>(r));
+}
+
+// make_dynamic_reader type-erases r, allocating from alloc - e.g. for a request body that's gone once the request is.
+template<typename Reader>
+util::resource_ptr<reader> make_dynamic_reader(std::pmr::polymorphic_allocator<> alloc, Reader&& r)
+{
+    return util::allocate_unique<dynamic_reader<std::remove_cvref_t<Reader>>>(alloc, std::forward<Reader>(r));
+}
+
+// make_dynamic_writer type-erases w, with the one allocation that takes.
+template<typename Writer>
+std::unique_ptr<writer> make_dynamic_writer(Writer&& w)
+{
+    return std::make_unique<dynamic_writer<std::remove_cvref_t<Writer>>>(std::forward<Writer>(w));
+}
+
+}
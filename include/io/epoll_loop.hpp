@@ -7,9 +7,10 @@
 #    include <atomic>
 #    include <chrono>
 #    include <coroutine>
+#    include <map>
 #    include <memory>
 #    include <mutex>
-#    include <queue>
+#    include <unordered_map>
 
 #    include <spdlog/logger.h>
 #    include <spdlog/sinks/null_sink.h>
@@ -38,7 +39,7 @@ public:
 
     ~epoll_loop();
 
-    void register_handle(handle handle);
+    bool register_handle(handle handle);
     void deregister_handle(handle handle);
 
     coro::task<result>                   queue(handle handle, poll_op op, std::chrono::milliseconds timeout);
@@ -47,7 +48,7 @@ public:
     void shutdown() noexcept;
 
 private:
-    using clock = std::chrono::high_resolution_clock;
+    using clock = std::chrono::steady_clock;
 
     class operation
     {
@@ -78,26 +79,29 @@ private:
     struct timeout_operation
     {
         std::coroutine_handle<promise> handle;
-        clock::time_point              timeout_at;
-
-        constexpr bool operator<(const timeout_operation& other) const noexcept
-        {
-            return timeout_at < other.timeout_at;
-        }
+        io::handle                     fd;
     };
 
+    // ordered by when they time out
+    using timeout_list_type = std::multimap<clock::time_point, timeout_operation>;
+
     void queue(std::coroutine_handle<promise> awaiting, handle handle, poll_op op, std::chrono::milliseconds timeout);
-    void disable_events(handle handle);
-    void update_timer(std::chrono::milliseconds timeout);
+    void update_timer(clock::duration timeout);
+
+    // cancel_timeout forgets the timeout for an operation that completed before it. Requires timeout_list_mu.
+    void cancel_timeout(std::coroutine_handle<promise> handle) noexcept;
 
     int epoll_fd;
     int timer_fd;
     int shutdown_fd;
 
-    std::atomic<bool>                      running;
-    std::shared_ptr<spdlog::logger>        logger;
-    std::priority_queue<timeout_operation> timeout_list;
-    std::mutex                             timeout_list_mu;
+    std::atomic<bool>               running;
+    std::shared_ptr<spdlog::logger> logger;
+    timeout_list_type               timeout_list;
+    std::mutex                      timeout_list_mu;
+
+    // so a timeout can be found again, when its operation completes first
+    std::unordered_map<void*, timeout_list_type::iterator> timeouts_by_handle;
 };
 
 }
@@ -61,7 +61,7 @@ concept EventLoop = std::is_default_constructible_v<T>
         { t->queue(handle, op, timeout) } -> std::same_as<coro::task<result>>;
         { t->dispatch() } -> std::same_as<coro::generator<event>>;
         { t->shutdown() } -> std::same_as<void>;
-        { t->register_handle(handle) } -> std::same_as<void>;
+        { t->register_handle(handle) } -> std::same_as<bool>;
         { t->deregister_handle(handle) } -> std::same_as<void>;
     };
 // clang-format on
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "coro/task.hpp"
+#include "coro/thread_pool.hpp"
+#include "io/io.hpp"
+#include "io/reader.hpp"
+#include "io/scheduler.hpp"
+#include "io/writer.hpp"
+
+namespace net::io
+{
+
+// Disks don't do readiness: a regular file is always "ready", and read(2) on it simply blocks until the data is in.
+// So file_reader and file_writer run their blocking calls on a separate pool of threads (ideally one that does
+// nothing else), and come back to the scheduler's workers once they're done - a slow disk stalls that pool, instead
+// of every connection sharing a worker with it.
+//
+// Reaching the end of a file reads as status_condition::closed, the same as a socket whose peer has gone away.
+
+// file_reader reads a file from start to end, on pool.
+class file_reader : public reader
+{
+public:
+    // Throws std::system_error if path can't be opened.
+    file_reader(scheduler* scheduler, std::shared_ptr<coro::thread_pool> pool, const std::string& path);
+
+    file_reader(const file_reader&)            = delete;
+    file_reader& operator=(const file_reader&) = delete;
+
+    file_reader(file_reader&& other) noexcept;
+    file_reader& operator=(file_reader&& other) noexcept;
+
+    ~file_reader() override;
+
+    coro::task<result> read(std::span<std::byte> data) override;
+
+    using reader::read;
+
+    // read_at reads from offset, without moving the position read() continues from (pread(2)).
+    coro::task<result> read_at(std::span<std::byte> data, std::uint64_t offset);
+
+    // size returns the size of the file, or 0 if it can't be determined.
+    [[nodiscard]] std::uint64_t size() const noexcept;
+
+    [[nodiscard]] int native_handle() const noexcept override { return fd; }
+
+    // read() advances the file's own position, so a socket can pick up where it left off with sendfile(2).
+    [[nodiscard]] handle direct_handle() const noexcept override { return fd; }
+
+private:
+    scheduler*                         sched;
+    std::shared_ptr<coro::thread_pool> pool;
+    int                                fd;
+};
+
+// mapped_file_reader reads a file by mapping it into memory. There's no system call per read, and next() hands out
+// the file's bytes without copying them at all.
+//
+// Pages that aren't in memory yet are still faulted in on whichever thread touches them - the mapping is advised as
+// sequential, and readahead bytes past the current position are requested up front (MADV_WILLNEED), so for files
+// read from start to end that rarely has to wait on the disk. For cold files on slow disks, file_reader is the
+// safer choice.
+class mapped_file_reader : public reader
+{
+public:
+    static constexpr std::size_t default_readahead = 2ull * 1024 * 1024;
+
+    // Throws std::system_error if path can't be opened or mapped.
+    explicit mapped_file_reader(const std::string& path, std::size_t readahead = default_readahead);
+
+    mapped_file_reader(const mapped_file_reader&)            = delete;
+    mapped_file_reader& operator=(const mapped_file_reader&) = delete;
+
+    mapped_file_reader(mapped_file_reader&& other) noexcept;
+    mapped_file_reader& operator=(mapped_file_reader&& other) noexcept;
+
+    ~mapped_file_reader() override;
+
+    coro::task<result> read(std::span<std::byte> data) override;
+
+    using reader::read;
+
+    // next returns up to max of the next bytes in the file, straight out of the mapping, and moves past them.
+    // The span is valid for as long as this reader is. It's empty at the end of the file.
+    [[nodiscard]] std::span<const std::byte> next(std::size_t max) noexcept;
+
+    // data returns the whole file, regardless of how much of it has been read.
+    [[nodiscard]] std::span<const std::byte> data() const noexcept { return {base, length}; }
+
+    [[nodiscard]] std::size_t size() const noexcept { return length; }
+    [[nodiscard]] std::size_t remaining() const noexcept { return length - position; }
+
+    [[nodiscard]] int native_handle() const noexcept override { return fd; }
+
+private:
+    // advise asks for the readahead window past position to be paged in, once position gets near where the last
+    // request ended.
+    void advise() noexcept;
+
+    int         fd;
+    std::byte*  base     = nullptr;
+    std::size_t length   = 0;
+    std::size_t position = 0;
+    std::size_t advised  = 0;
+    std::size_t readahead;
+};
+
+// file_writer writes to a file, on pool.
+class file_writer : public writer
+{
+public:
+    enum class mode : std::uint8_t
+    {
+        truncate, // start over, creating the file if need be
+        append,   // add to the end, creating the file if need be
+    };
+
+    // Throws std::system_error if path can't be opened.
+    file_writer(scheduler*                         scheduler,
+                std::shared_ptr<coro::thread_pool> pool,
+                const std::string&                 path,
+                mode                               how = mode::truncate);
+
+    file_writer(const file_writer&)            = delete;
+    file_writer& operator=(const file_writer&) = delete;
+
+    file_writer(file_writer&& other) noexcept;
+    file_writer& operator=(file_writer&& other) noexcept;
+
+    ~file_writer() override;
+
+    // write writes all of data, unless there's an error.
+    coro::task<result> write(std::span<const std::byte> data) override;
+
+    using writer::write;
+
+    // write_at writes all of data at offset, without moving the position write() continues from (pwrite(2)).
+    coro::task<result> write_at(std::span<const std::byte> data, std::uint64_t offset);
+
+    // sync waits until everything written so far is on the disk (fdatasync(2)).
+    coro::task<std::error_condition> sync();
+
+    [[nodiscard]] int native_handle() const noexcept override { return fd; }
+
+private:
+    scheduler*                         sched;
+    std::shared_ptr<coro::thread_pool> pool;
+    int                                fd;
+};
+
+}
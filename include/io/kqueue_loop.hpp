@@ -45,7 +45,7 @@ public:
 
     ~kqueue_loop() noexcept;
 
-    void register_handle(handle fd) { /* noop - for now? */ }
+    bool register_handle(handle fd) { /* noop - for now? */ return true; }
     void deregister_handle(handle fd) { /* noop - for now? */ }
 
     coro::task<result> queue(handle fd, poll_op op, std::chrono::milliseconds timeout);
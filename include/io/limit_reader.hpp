@@ -1,39 +1,62 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <span>
 #include <utility>
 
+#include "concepts.hpp"
 #include "coro/task.hpp"
+#include "dynamic.hpp"
 #include "io/io.hpp"
 #include "io/reader.hpp"
 
 namespace net::io
 {
 
-class limit_reader : public reader
+// basic_limit_reader reads no more than limit bytes from Reader, which it holds either by value or through a pointer,
+// and calls directly. Whatever's still buffered in Reader is handed out without suspending.
+template<typename Reader>
+    requires async_reader<detail::deref_t<Reader>>
+class basic_limit_reader
 {
 public:
-    constexpr limit_reader()
-        : limit_reader(nullptr, 0)
-    {}
+    constexpr basic_limit_reader() = default;
 
-    constexpr limit_reader(std::unique_ptr<reader>&& reader, std::size_t limit)
+    constexpr basic_limit_reader(Reader reader, std::size_t limit)
         : parent{std::move(reader)}
         , limit{limit}
     {}
 
-    coro::task<result> read(std::span<std::byte> data) override;
+    coro::task<result> read(std::span<std::byte> data)
+    {
+        if (progress >= limit) co_return {.err = make_error_condition(status_condition::closed)};
+
+        data = data.first(std::min(data.size(), limit - progress));
+
+        if (auto count = take_buffered(detail::deref(parent), data); count > 0)
+        {
+            progress += count;
+            co_return {.count = count, .err = {}};
+        }
 
-    using reader::read;
+        auto res = co_await detail::deref(parent).read(data);
+        progress += res.count;
+        co_return res;
+    }
 
-    [[nodiscard]] int native_handle() const noexcept override { return parent->native_handle(); }
+    [[nodiscard]] int native_handle() const noexcept { return detail::deref(parent).native_handle(); }
+
+    // remaining returns how many more bytes may be read.
+    [[nodiscard]] std::size_t remaining() const noexcept { return limit - std::min(progress, limit); }
 
 private:
-    std::unique_ptr<reader> parent   = nullptr;
-    std::size_t             limit    = 0;
-    std::size_t             progress = 0;
+    Reader      parent{};
+    std::size_t limit    = 0;
+    std::size_t progress = 0;
 };
 
+using limit_reader = dynamic_reader<basic_limit_reader<std::unique_ptr<reader>>>;
+
 }
@@ -10,6 +10,9 @@ enum class poll_op : std::uint8_t
     read       = 1 << 0,
     write      = 1 << 1,
     read_write = read | write,
+
+    // error only waits for errors, e.g. for notifications on a socket's error queue
+    error = 1 << 2,
 };
 
 poll_op operator&(poll_op lhs, poll_op rhs) noexcept;
@@ -18,6 +21,7 @@ poll_op operator|(poll_op lhs, poll_op rhs) noexcept;
 
 bool is_readable(poll_op op) noexcept;
 bool is_writable(poll_op op) noexcept;
+bool is_error(poll_op op) noexcept;
 
 enum class poll_status
 {
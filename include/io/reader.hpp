@@ -27,6 +27,11 @@ public:
 
     [[nodiscard]] virtual int native_handle() const noexcept = 0;
 
+    // direct_handle returns the handle that read() pulls bytes straight out of, or -1 if bytes are buffered, framed,
+    // or otherwise transformed on their way through this reader.
+    // Writers use it to move bytes in-kernel (see writer::read_from).
+    [[nodiscard]] virtual handle direct_handle() const noexcept { return -1; }
+
 protected:
     reader() = default;
 };
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include <spdlog/logger.h>
 #include <spdlog/sinks/null_sink.h>
@@ -36,15 +37,19 @@ public:
 
     ~scheduler() noexcept;
 
-    void register_handle(handle handle);
+    // register_handle returns false if handle was registered already.
+    bool register_handle(handle handle);
     void deregister_handle(handle handle);
 
     bool               schedule(coro::task<>&& task) noexcept;
+    std::size_t        schedule(std::vector<coro::task<>>&& batch);
     coro::task<result> schedule(handle handle, poll_op op, std::chrono::milliseconds timeout);
     bool               resume(std::coroutine_handle<> handle) noexcept;
 
     void run();
 
+    [[nodiscard]] bool is_running() const noexcept { return running.load(std::memory_order::acquire); }
+
     template<typename T>
     T run_to_completion(coro::task<T>&& task)
     {
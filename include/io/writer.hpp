@@ -1,12 +1,15 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
 
 #include "coro/task.hpp"
 #include "io.hpp"
+#include "reader.hpp"
 
 namespace net::io
 {
@@ -31,6 +34,14 @@ public:
 
     [[nodiscard]] virtual int native_handle() const noexcept = 0;
 
+    // read_from copies up to limit bytes out of in, for writers that can do better than a read/write loop through a
+    // user space buffer (e.g. sendfile(2) or splice(2)).
+    // Writers that can't handle in return std::errc::not_supported, and io::copy() falls back to its buffered loop.
+    virtual coro::task<result> read_from(reader& /*in*/, std::size_t /*limit*/)
+    {
+        co_return result{.err = std::make_error_condition(std::errc::not_supported)};
+    }
+
 protected:
     writer() = default;
 };
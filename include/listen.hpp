@@ -2,43 +2,57 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>
+#include <spdlog/spdlog.h>
 
 #include "coro/task.hpp"
 #include "io/scheduler.hpp"
 
 #include "ip_addr.hpp"
+#include "socket.hpp"
 #include "tcp.hpp"
+#include "unix.hpp"
 
 namespace net
 {
 
 using namespace std::chrono_literals;
 
-enum class network
-{
-    tcp,
-    udp,
-};
-
 class listener
 {
 public:
-    listener(io::scheduler*            scheduler,
-             const std::string&        port,
-             network                   net,
-             protocol                  proto   = protocol::not_care,
-             std::chrono::microseconds timeout = 5s)
-        : listener{scheduler, "", port, net, proto, timeout}
+    listener(io::scheduler*                  scheduler,
+             const std::string&              port,
+             network                         net,
+             protocol                        proto   = protocol::not_care,
+             std::chrono::microseconds       timeout = 5s,
+             const tcp_options&              options = {},
+             std::shared_ptr<spdlog::logger> logger  = spdlog::default_logger())
+        : listener{scheduler, "", port, net, proto, timeout, options, std::move(logger)}
     {}
 
-    listener(io::scheduler*            scheduler,
-             const std::string&        host,
-             const std::string&        port,
-             network                   net,
-             protocol                  proto   = protocol::not_care,
-             std::chrono::microseconds timeout = 5s);
+    // For network::tcp, options are set on the listening socket, and on each accepted connection. A connection is
+    // still handed out if the system rejects some of its options, which are logged to logger.
+    listener(io::scheduler*                  scheduler,
+             const std::string&              host,
+             const std::string&              port,
+             network                         net,
+             protocol                        proto   = protocol::not_care,
+             std::chrono::microseconds       timeout = 5s,
+             const tcp_options&              options = {},
+             std::shared_ptr<spdlog::logger> logger  = spdlog::default_logger());
+
+    // Listens on a unix domain socket, with net either network::unix_stream or network::unix_seqpacket.
+    // A path in the file system is removed again on shutdown().
+    listener(io::scheduler* scheduler, const unix_addr& addr, network net = network::unix_stream);
 
     listener(const listener&)            = delete;
     listener& operator=(const listener&) = delete;
@@ -48,17 +62,50 @@ public:
 
     ~listener() noexcept;
 
-    void                                 listen(std::uint16_t max_backlog);
-    [[nodiscard]] coro::task<tcp_socket> accept() const;
+    // How many connections accept_many() takes per wake up by default: enough to clear a burst quickly, without
+    // starving everything else waiting on the event loop.
+    static constexpr std::size_t default_accept_batch = 64;
+
+    void listen(std::uint16_t max_backlog);
+
+    // accept waits for the next connection. Socket is what to hand it out as: tcp_socket for network::tcp,
+    // unix_socket for the unix networks, or just socket where it doesn't matter.
+    template<typename Socket = tcp_socket>
+    [[nodiscard]] coro::task<Socket> accept() const;
+
+    // accept_many waits for at least one connection, then accepts whatever else is already pending, up to max.
+    // An empty result means the listener was shut down.
+    template<typename Socket = tcp_socket>
+    [[nodiscard]] coro::task<std::vector<Socket>> accept_many(std::size_t max = default_accept_batch) const;
 
     [[nodiscard]] int native_handle() const noexcept { return main_fd; }
 
+    struct backlog_statistics
+    {
+        // connections that are established, and waiting to be accepted
+        std::uint32_t queued = 0;
+        std::uint32_t limit  = 0;
+    };
+
+    // backlog returns how full the accept queue is right now. Only TCP listeners on Linux can tell - for anything else
+    // it's nullopt.
+    [[nodiscard]] std::optional<backlog_statistics> backlog() const noexcept;
+
     void shutdown() noexcept;
 
 private:
-    io::scheduler*    scheduler;
-    std::atomic<bool> is_listening;
-    int               main_fd;
+    template<typename Socket>
+    [[nodiscard]] Socket make_connection(int fd) const;
+
+    io::scheduler*                  scheduler;
+    std::atomic<bool>               is_listening;
+    int                             main_fd;
+    network                         net;
+    tcp_options                     options;
+    std::shared_ptr<spdlog::logger> logger = spdlog::default_logger();
+
+    // for unix sockets bound to a path, to clean up after
+    std::string unix_path;
 };
 
 }
@@ -2,13 +2,19 @@
 
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <span>
 #include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
 
 #include <sys/socket.h>
 
 #include "coro/task.hpp"
 #include "io/io.hpp"
+#include "io/poll.hpp"
 #include "io/reader.hpp"
 #include "io/scheduler.hpp"
 #include "io/writer.hpp"
@@ -18,6 +24,39 @@ namespace net
 
 using namespace std::chrono_literals;
 
+enum class network
+{
+    tcp,
+    udp,
+
+    // unix domain sockets: a byte stream like TCP, or a connection of datagrams with their boundaries kept
+    unix_stream,
+    unix_seqpacket,
+};
+
+// tcp_statistics is what the kernel keeps track of for a TCP connection (TCP_INFO): round trips, losses and its
+// congestion window. On a listening socket, unacked and sacked are its accept queue's length and limit instead.
+struct tcp_statistics
+{
+    std::chrono::microseconds rtt{0};
+    std::chrono::microseconds rtt_var{0};
+    std::chrono::microseconds rto{0};
+
+    // in segments of mss bytes
+    std::uint32_t mss      = 0;
+    std::uint32_t cwnd     = 0;
+    std::uint32_t ssthresh = 0;
+    std::uint32_t unacked  = 0;
+    std::uint32_t sacked   = 0;
+    std::uint32_t lost     = 0;
+
+    // over the lifetime of the connection
+    std::uint32_t retransmits = 0;
+
+    // of reads TCP_INFO from fd. Returns nullopt if fd isn't a TCP socket, or the system doesn't have TCP_INFO.
+    [[nodiscard]] static std::optional<tcp_statistics> of(int fd) noexcept;
+};
+
 class socket
     : public io::reader
     , public io::writer
@@ -35,6 +74,14 @@ public:
 
     ~socket() override;
 
+    using clock = std::chrono::steady_clock;
+
+    // duplicate returns another socket for the same connection, with the same timeouts. The scheduler only has one
+    // wait at a time on a socket, so this lets one coroutine wait to write while another waits to read.
+    [[nodiscard]] socket duplicate() const;
+
+    [[nodiscard]] io::scheduler* get_scheduler() const noexcept { return scheduler; }
+
     [[nodiscard]] bool        valid() const noexcept;
     [[nodiscard]] std::string local_addr() const;
     [[nodiscard]] std::string remote_addr() const;
@@ -46,8 +93,54 @@ public:
     using io::writer::write;
 
     [[nodiscard]] io::handle native_handle() const noexcept override { return fd; }
+    [[nodiscard]] io::handle direct_handle() const noexcept override { return fd; }
+
+    // read_from sends bytes from in without copying them through user space, when in is backed directly by a file
+    // descriptor: regular files go through sendfile(2), sockets and pipes through splice(2).
+    // If sending fails part way through a splice, count includes what had been taken out of in for it: that's gone from
+    // in either way, and err says the write came up short.
+    coro::task<io::result> read_from(io::reader& in, std::size_t limit) override;
+
+    // Writes smaller than this are cheaper to copy than to pin and wait for the kernel to release.
+    static constexpr std::size_t default_zerocopy_threshold = 64ull * 1024;
+
+    // enable_zerocopy makes writes of at least threshold bytes use MSG_ZEROCOPY: the kernel sends straight out of the
+    // caller's buffer, and write() doesn't complete until the kernel is done with it.
+    // Returns false if the socket doesn't support it (e.g. not Linux, or not TCP/UDP), leaving writes as they were.
+    bool enable_zerocopy(std::size_t threshold = default_zerocopy_threshold) noexcept;
+
+    // enable_rx_timestamps has the kernel stamp data in software as it comes in (SO_TIMESTAMPING, or SO_TIMESTAMPNS
+    // where that's not to be had), so rx_timestamp() can tell how long it sat in the socket's buffers before a read()
+    // got round to it. Returns false if the socket doesn't support either, leaving reads as they were.
+    bool enable_rx_timestamps() noexcept;
+
+    // rx_timestamp returns when the data the last read() returned arrived in the kernel, if it was stamped.
+    [[nodiscard]] std::optional<std::chrono::system_clock::time_point> rx_timestamp() const noexcept
+    {
+        if (last_rx == std::chrono::system_clock::time_point{}) return std::nullopt;
+        return last_rx;
+    }
 
-    void close(bool graceful = true, std::chrono::seconds graceful_timeout = 5s) const noexcept;
+    // tcp_info returns what the kernel knows about this connection, if it's a TCP one. It's a system call, so it's
+    // best sampled rather than read on every request.
+    [[nodiscard]] std::optional<tcp_statistics> tcp_info() const noexcept { return tcp_statistics::of(fd); }
+
+    // Timeouts on waiting for the other end, kept by the scheduler's timers. A read() or write() that runs out of
+    // time returns status_condition::timed_out. 0 turns a timeout off, which is the default.
+    //
+    // The read and write timeouts are per call, while the idle timeout is how long the socket may go without any
+    // traffic either way. The read deadline is when all reads must be done by (e.g. a request's headers), until
+    // cleared with clock::time_point::max().
+    void set_read_timeout(std::chrono::milliseconds timeout) noexcept { read_timeout = timeout; }
+    void set_write_timeout(std::chrono::milliseconds timeout) noexcept { write_timeout = timeout; }
+    void set_idle_timeout(std::chrono::milliseconds timeout) noexcept;
+    void set_read_deadline(clock::time_point deadline) noexcept { read_deadline = deadline; }
+
+    // wait waits until the socket is ready for op, within the same timeouts a read() or write() would get, but without
+    // reading or writing anything - e.g. so a quiet connection can wait for its next request without holding a buffer.
+    coro::task<std::error_condition> wait(io::poll_op op) noexcept;
+
+    void close(bool graceful = true, std::chrono::seconds graceful_timeout = 5s) noexcept;
 
 protected:
     static constexpr int invalid_fd = -1;
@@ -55,13 +148,63 @@ protected:
     template<typename T>
     static bool set_option(int fd, int flag, T* value) noexcept
     {
-        int sts = ::setsockopt(fd, SOL_SOCKET, flag, value, sizeof(T));
+        return set_option(fd, SOL_SOCKET, flag, value);
+    }
+
+    template<typename T>
+    static bool set_option(int fd, int level, int flag, T* value) noexcept
+    {
+        int sts = ::setsockopt(fd, level, flag, value, sizeof(T));
         return sts == 0;
     }
 
-private:
+    // deadline_for is when an operation starting now has to be done by, with its timeout and the idle timeout.
+    [[nodiscard]] clock::time_point deadline_for(std::chrono::milliseconds timeout,
+                                                 clock::time_point         deadline) const noexcept;
+
+    // time_left is how long a wait may take to be done by deadline: 0 if there's no deadline, negative if it's passed.
+    [[nodiscard]] static std::chrono::milliseconds time_left(clock::time_point deadline) noexcept;
+
+    // touch notes some traffic, pushing back the idle timeout.
+    void touch() noexcept
+    {
+        if (idle_timeout.count() > 0) last_active = clock::now();
+    }
+
     io::scheduler* scheduler;
     int            fd;
+
+    std::chrono::milliseconds read_timeout{0};
+    std::chrono::milliseconds write_timeout{0};
+    std::chrono::milliseconds idle_timeout{0};
+    clock::time_point         read_deadline = clock::time_point::max();
+    clock::time_point         last_active;
+
+private:
+    // wait_writable waits for room to send into, until deadline. Writes send first, and only wait once there's none.
+    coro::task<std::error_condition> wait_writable(clock::time_point deadline);
+
+    coro::task<io::result> send_file(io::handle src, std::size_t limit);
+    coro::task<io::result> splice_from(io::handle src, std::size_t limit);
+
+    // recv_timestamped is recv(2), picking up the kernel's timestamp for the data along the way.
+    std::int64_t recv_timestamped(std::byte* data, std::size_t length) noexcept;
+
+    coro::task<io::result>           write_zerocopy(std::span<const std::byte> data);
+    coro::task<std::error_condition> wait_zerocopy_completions(std::uint32_t until, clock::time_point deadline);
+    bool                             read_zerocopy_completions() noexcept;
+    void                             zerocopy_completed(std::uint32_t first, std::uint32_t last) noexcept;
+
+    // 0 means zerocopy is off.
+    // zerocopy_sent follows the kernel's per-socket counter of MSG_ZEROCOPY sends. The kernel is done with every send
+    // before zerocopy_done, and with the ranges [first, last) in zerocopy_ahead, which completed out of order.
+    std::size_t                                          zerocopy_threshold = 0;
+    std::uint32_t                                        zerocopy_sent      = 0;
+    std::uint32_t                                        zerocopy_done      = 0;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> zerocopy_ahead;
+
+    bool                                  rx_timestamps = false;
+    std::chrono::system_clock::time_point last_rx;
 };
 
 }
@@ -1,8 +1,14 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string_view>
 
+#include "coro/task.hpp"
+#include "coro/thread_pool.hpp"
 #include "io/scheduler.hpp"
 
 #include "ip_addr.hpp"
@@ -13,6 +19,76 @@ namespace net
 
 using namespace std::chrono_literals;
 
+// tcp_options tune TCP sockets. Anything left unset keeps the system default.
+// Options a platform doesn't have are skipped.
+struct tcp_options
+{
+    // TCP_NODELAY: send small writes right away, instead of waiting to coalesce them (Nagle's algorithm).
+    std::optional<bool> no_delay;
+
+    // TCP_CORK: only send full frames until uncorked. Useful around writing a header and body separately.
+    std::optional<bool> cork;
+
+    // TCP_NOTSENT_LOWAT: only report the socket as writable while less than this many bytes are waiting to be sent,
+    // keeping data in user space (where it can still be reprioritized) rather than queued in the kernel.
+    std::optional<std::uint32_t> notsent_lowat;
+
+    // TCP_FASTOPEN_CONNECT: send data with the SYN when connecting to a server that's been seen before.
+    std::optional<bool> fastopen_connect;
+
+    // TCP_FASTOPEN: (listeners only) how many pending fast open requests to allow.
+    std::optional<int> fastopen_queue;
+
+    // TCP_DEFER_ACCEPT: (listeners only) don't wake up accept() until the client has sent something, or this passes.
+    std::optional<std::chrono::seconds> defer_accept;
+
+    // SO_RCVBUF and SO_SNDBUF. Setting these turns off the kernel's automatic buffer sizing.
+    std::optional<int> recv_buffer;
+    std::optional<int> send_buffer;
+
+    // TCP_QUICKACK: ACK right away instead of delaying. The kernel can drop back to delayed ACKs on its own, so this is
+    // re-applied to every accepted connection, and may need to be set again later via tcp_socket::set_options().
+    std::optional<bool> quick_ack;
+
+    // SO_RCVLOWAT: don't report the socket as readable until at least this many bytes are available.
+    std::optional<int> recv_lowat;
+
+    // low_latency is aimed at request/response traffic made of many small messages.
+    static tcp_options low_latency() noexcept;
+
+    // apply sets the options for a connection on fd.
+    // Throws std::system_error if the system rejects one.
+    void apply(int fd) const;
+
+    // try_apply sets as many of the options for a connection on fd as the system takes, and calls failed with what
+    // each one it rejects was, and its errno.
+    void try_apply(int fd, const std::function<void(const char* what, int err)>& failed) const;
+
+    // apply_listener sets the options that need to be in place on a listening socket before it starts listening.
+    // Throws std::system_error if the system rejects one.
+    void apply_listener(int fd) const;
+};
+
+// connect_options controls how tcp_socket::connect() gets a connection.
+struct connect_options
+{
+    protocol proto     = protocol::not_care;
+    bool     keepalive = true;
+
+    // How long connecting may take in all, across every address tried. 0 waits as long as the system does.
+    std::chrono::milliseconds timeout = 5s;
+
+    // How long an attempt has to itself before the next address is tried alongside it.
+    // RFC 8305 calls this the "Connection Attempt Delay", and recommends 250ms.
+    std::chrono::milliseconds attempt_delay = 250ms;
+
+    tcp_options tcp;
+
+    // Where host is resolved: getaddrinfo(3) blocks, so it's kept off the scheduler's workers. If unset, a small pool
+    // shared by every connect() is used.
+    std::shared_ptr<coro::thread_pool> resolver;
+};
+
 class tcp_socket : public socket
 {
 public:
@@ -24,14 +100,28 @@ public:
                std::string_view          port,
                protocol                  proto     = protocol::not_care,
                bool                      keepalive = true,
-               std::chrono::microseconds timeout   = 5s);
+               std::chrono::microseconds timeout   = 5s,
+               const tcp_options&        options   = {});
+
+    // connect resolves host and connects to it without blocking the calling thread.
+    // When host has several addresses, they're raced Happy Eyeballs style (RFC 8305): alternating between IPv6 and
+    // IPv4, each attempt gets a head start of options.attempt_delay before the next one joins in, and the first to
+    // connect wins. Throws std::system_error if none of them do.
+    [[nodiscard]] static coro::task<tcp_socket> connect(io::scheduler*   scheduler,
+                                                        std::string_view host,
+                                                        std::string_view port,
+                                                        connect_options  options = {});
+
+    // set_options applies options to this connection. Throws std::system_error if the system rejects one.
+    void set_options(const tcp_options& options) const;
 
 private:
     static int open(std::string_view          host,
                     std::string_view          port,
                     protocol                  proto,
                     bool                      keepalive,
-                    std::chrono::microseconds timeout);
+                    std::chrono::microseconds timeout,
+                    const tcp_options&        options);
 };
 
 }
@@ -1,7 +1,16 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
 #include <string_view>
 
+#include <sys/socket.h>
+
+#include "coro/task.hpp"
+#include "io/io.hpp"
 #include "io/scheduler.hpp"
 
 #include "ip_addr.hpp"
@@ -10,16 +19,90 @@
 namespace net
 {
 
+// udp_addr is the address of a datagram's peer: an IP address and a port.
+class udp_addr
+{
+public:
+    udp_addr() noexcept = default;
+    udp_addr(const ip_addr& ip, std::uint16_t port) noexcept;
+
+    [[nodiscard]] std::optional<ip_addr> ip() const noexcept;
+    [[nodiscard]] std::uint16_t          port() const noexcept;
+    [[nodiscard]] std::string            to_string() const;
+
+    [[nodiscard]] const sockaddr* native() const noexcept { return reinterpret_cast<const sockaddr*>(&storage); }
+    [[nodiscard]] sockaddr*       native() noexcept { return reinterpret_cast<sockaddr*>(&storage); }
+    [[nodiscard]] socklen_t       native_size() const noexcept { return size; }
+
+    // for filling in from a system call, e.g. recvmsg()
+    void set_native_size(socklen_t native_size) noexcept { size = native_size; }
+
+private:
+    friend class udp_socket;
+
+    sockaddr_storage storage{};
+    socklen_t        size = sizeof(storage);
+};
+
+// incoming_datagram is a buffer for recv_many() to receive one datagram into.
+struct incoming_datagram
+{
+    std::span<std::byte> data;
+
+    // set by recv_many()
+    std::size_t size      = 0;
+    udp_addr    from      = {};
+    bool        truncated = false;
+
+    // With GRO enabled, several datagrams from the same peer may arrive coalesced in data,
+    // each segment_size bytes long (except possibly the last). 0 means data holds a single datagram.
+    std::uint16_t segment_size = 0;
+};
+
+// outgoing_datagram is one datagram (or, with segment_size set, a run of them) for send_many() to send.
+struct outgoing_datagram
+{
+    std::span<const std::byte> data;
+
+    // nullptr sends to the connected peer
+    const udp_addr* to = nullptr;
+
+    // If not 0, the kernel (or the NIC) splits data into datagrams of segment_size bytes (UDP GSO).
+    std::uint16_t segment_size = 0;
+};
+
 class udp_socket : public socket
 {
 public:
+    // Most batches are smaller than this, and it keeps the per-call bookkeeping on the stack.
+    static constexpr std::size_t max_batch = 64;
+
     udp_socket(io::scheduler* scheduler, int fd) noexcept;
+
+    // These bind to host:port, or to all local addresses if host is empty.
     udp_socket(io::scheduler* scheduler, std::string_view port, protocol proto = protocol::not_care);
     udp_socket(io::scheduler*   scheduler,
                std::string_view host,
                std::string_view port,
                protocol         proto = protocol::not_care);
 
+    [[nodiscard]] udp_addr local_udp_addr() const;
+
+    coro::task<io::result> send_to(std::span<const std::byte> data, const udp_addr& to);
+    coro::task<io::result> recv_from(std::span<std::byte> data, udp_addr& from);
+
+    // recv_many waits for at least one datagram, then receives as many as are ready, up to msgs.size().
+    // The result's count is the number of datagrams received, filled into the front of msgs.
+    coro::task<io::result> recv_many(std::span<incoming_datagram> msgs);
+
+    // send_many sends all of msgs, in as few system calls as it can.
+    // The result's count is the number of messages sent.
+    coro::task<io::result> send_many(std::span<const outgoing_datagram> msgs);
+
+    // enable_gro lets the kernel coalesce datagrams from the same flow into one receive (UDP_GRO).
+    // See incoming_datagram::segment_size. Returns false if not supported.
+    bool enable_gro() noexcept;
+
 private:
     static int open(std::string_view host, std::string_view port, protocol proto);
 };
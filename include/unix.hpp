@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "coro/task.hpp"
+#include "io/io.hpp"
+#include "io/scheduler.hpp"
+
+#include "socket.hpp"
+
+namespace net
+{
+
+// unix_addr is the address of a unix domain socket: a path in the file system, or a name in the abstract namespace.
+class unix_addr
+{
+public:
+    unix_addr() noexcept = default;
+
+    // A path starting with '@' is in the abstract namespace (Linux only): it never shows up in the file system, and
+    // goes away with the last socket bound to it. Throws net::exception if path is too long to fit.
+    explicit unix_addr(std::string_view path);
+
+    [[nodiscard]] bool        is_abstract() const noexcept;
+    [[nodiscard]] std::string to_string() const;
+
+    [[nodiscard]] const sockaddr* native() const noexcept { return reinterpret_cast<const sockaddr*>(&storage); }
+    [[nodiscard]] socklen_t       native_size() const noexcept { return size; }
+
+private:
+    sockaddr_un storage{.sun_family = AF_UNIX, .sun_path = {}};
+    socklen_t   size = sizeof(sa_family_t);
+};
+
+class unix_socket : public socket
+{
+public:
+    // The most descriptors one message can carry (SCM_MAX_FD on Linux).
+    static constexpr std::size_t max_fds = 253;
+
+    unix_socket(io::scheduler* scheduler) noexcept;
+    unix_socket(io::scheduler* scheduler, int fd) noexcept;
+
+    // connect connects to a listener at addr. net is network::unix_stream or network::unix_seqpacket.
+    [[nodiscard]] static coro::task<unix_socket> connect(io::scheduler*   scheduler,
+                                                         const unix_addr& addr,
+                                                         network          net = network::unix_stream);
+
+    // pair returns both ends of a new connection (socketpair(2)), e.g. for talking to a child process.
+    [[nodiscard]] static std::array<unix_socket, 2> pair(io::scheduler* scheduler, network net = network::unix_stream);
+
+    // send_fds sends data, with fds riding along on its first byte. The other end gets its own copies of fds.
+    // data can't be empty, since there'd be nothing for the descriptors to ride along on.
+    coro::task<io::result> send_fds(std::span<const std::byte> data, std::span<const int> fds);
+
+    // recv_fds receives into data, the same as read(), and any descriptors sent along with it into fds, setting
+    // num_fds to how many there were. The descriptors belong to the caller, and are close-on-exec.
+    // If more were sent than fit in fds, the rest are closed, and the result's err is std::errc::message_size.
+    coro::task<io::result> recv_fds(std::span<std::byte> data, std::span<int> fds, std::size_t& num_fds);
+};
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace net::util
+{
+
+// arena hands out memory by bumping a pointer through blocks it gets from upstream, and frees none of it until reset().
+// It's for things that all go at once, e.g. everything to do with one request: they're allocated for next to nothing,
+// and deallocating them costs nothing at all.
+//
+// reset() keeps a block for next time, as big as all the blocks so far put together. So an arena that's reset between
+// uses of about the same size soon settles into not going upstream at all. release() gives everything back, e.g. while
+// its owner has nothing to do.
+//
+// Like std::pmr::monotonic_buffer_resource, it's not safe to share between threads.
+class arena final : public std::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t default_block_size = 4ull * 1024;
+
+    explicit arena(std::size_t                 block_size = default_block_size,
+                   std::pmr::memory_resource* upstream   = std::pmr::get_default_resource()) noexcept;
+
+    arena(const arena&)            = delete;
+    arena& operator=(const arena&) = delete;
+
+    arena(arena&&)            = delete;
+    arena& operator=(arena&&) = delete;
+
+    ~arena() override { release(); }
+
+    // reset frees everything allocated so far, all at once, but keeps the memory for what's allocated next.
+    void reset() noexcept;
+
+    // release frees everything allocated so far, and gives all its memory back upstream.
+    void release() noexcept;
+
+    // used is how much has been allocated since the last reset(), give or take alignment.
+    [[nodiscard]] std::size_t used() const noexcept { return in_use; }
+
+    // capacity is how much memory it's holding on to from upstream, all told.
+    [[nodiscard]] std::size_t capacity() const noexcept { return held; }
+
+private:
+    struct block
+    {
+        block*      next;
+        std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void  do_deallocate(void* /* p */, std::size_t /* bytes */, std::size_t /* alignment */) noexcept override {}
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    // grow gets a new block from upstream, with room for at least bytes at alignment.
+    void grow(std::size_t bytes, std::size_t alignment);
+
+    std::pmr::memory_resource* upstream;
+    std::size_t                block_size;
+
+    // newest first
+    block*      blocks = nullptr;
+    std::byte*  next   = nullptr;
+    std::size_t left   = 0;
+
+    std::size_t in_use = 0;
+    std::size_t held   = 0;
+};
+
+// resource_delete is std::default_delete for what's allocated from a memory resource: it destroys it, and gives its
+// memory back to where it came from. Without a resource, it's just delete - so that whatever owns one can still take
+// ownership of something made with new.
+template<typename T>
+struct resource_delete
+{
+    std::pmr::memory_resource* resource  = nullptr;
+    std::size_t                size      = 0;
+    std::size_t                alignment = 0;
+
+    constexpr resource_delete() noexcept = default;
+
+    constexpr resource_delete(std::pmr::memory_resource* resource, std::size_t size, std::size_t alignment) noexcept
+        : resource{resource}
+        , size{size}
+        , alignment{alignment}
+    {}
+
+    template<typename U>
+        requires std::is_convertible_v<U*, T*>
+    constexpr resource_delete(const resource_delete<U>& other) noexcept // NOLINT(google-explicit-constructor)
+        : resource{other.resource}
+        , size{other.size}
+        , alignment{other.alignment}
+    {}
+
+    template<typename U>
+        requires std::is_convertible_v<U*, T*>
+    constexpr resource_delete(const std::default_delete<U>& /* other */) noexcept // NOLINT(google-explicit-constructor)
+    {}
+
+    void operator()(T* ptr) const noexcept
+    {
+        if (resource == nullptr)
+        {
+            delete ptr;
+            return;
+        }
+
+        ptr->~T();
+        resource->deallocate(const_cast<std::remove_cv_t<T>*>(ptr), size, alignment); // NOLINT
+    }
+};
+
+template<typename T>
+using resource_ptr = std::unique_ptr<T, resource_delete<T>>;
+
+// allocate_unique makes a T with memory from alloc's resource, which is given back when it's destroyed.
+template<typename T, typename... Args>
+resource_ptr<T> allocate_unique(std::pmr::polymorphic_allocator<> alloc, Args&&... args)
+{
+    auto* resource = alloc.resource();
+    void* memory   = resource->allocate(sizeof(T), alignof(T));
+
+    try
+    {
+        auto* ptr = ::new (memory) T(std::forward<Args>(args)...);
+        return resource_ptr<T>{ptr, resource_delete<T>{resource, sizeof(T), alignof(T)}};
+    }
+    catch (...)
+    {
+        resource->deallocate(memory, sizeof(T), alignof(T));
+        throw;
+    }
+}
+
+}
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <forward_list>
+#include <mutex>
+#include <optional>
 #include <vector>
 
 #include "io/reader.hpp"
@@ -19,10 +25,72 @@ public:
 
     buffer_pool(std::size_t buffer_size = 16ull * 1024, std::size_t num_buffers = 128, std::size_t max_buffers = 256);
 
+    // get blocks until a buffer is available.
+    [[nodiscard]] pool_t::borrowed_resource get() { return buffers.get(); }
+
+    // try_get returns std::nullopt instead of blocking if all buffers are borrowed.
+    [[nodiscard]] std::optional<pool_t::borrowed_resource> try_get() { return buffers.try_get(); }
+
 private:
     pool_t buffers;
 };
 
+// sized_buffer_pool hands out buffers in power of two size classes, and keeps returned ones around for the next
+// caller that wants one of the same size. Unlike buffer_pool, buffers can be any size, and get() never blocks - if
+// nothing is cached, a new buffer is allocated. Safe to share between threads.
+class sized_buffer_pool
+{
+public:
+    using buffer_t = std::vector<std::byte>;
+
+    static constexpr std::size_t min_class = 512;
+    static constexpr std::size_t max_class = 1024ull * 1024;
+    static constexpr std::size_t num_classes =
+        std::countr_zero(max_class) - std::countr_zero(min_class) + 1;
+
+    struct statistics
+    {
+        std::uint64_t hits;   // get() calls served from the cache
+        std::uint64_t misses; // get() calls that had to allocate
+        std::uint64_t cached; // bytes sitting in the cache, waiting for a get()
+    };
+
+    // max_cached is how many buffers of each size class are kept around at most, once returned.
+    explicit sized_buffer_pool(std::size_t max_cached = 64);
+
+    // shared returns the pool for buffers that aren't tied to anything in particular, e.g. per connection buffers. It
+    // lets go of everything it has cached whenever the shared memory_budget comes under pressure.
+    static sized_buffer_pool& shared();
+
+    // get returns an empty buffer with a capacity of at least size: its size class, or exactly size if that's larger
+    // than the largest class.
+    [[nodiscard]] buffer_t get(std::size_t size);
+
+    // put hands buf back for re-use. It's freed instead if its capacity isn't a size class, or enough of them are
+    // cached already.
+    void put(buffer_t&& buf) noexcept;
+
+    // size_class returns the capacity get(size) hands out.
+    [[nodiscard]] static std::size_t size_class(std::size_t size) noexcept;
+
+    // trim frees every cached buffer.
+    void trim() noexcept;
+
+    [[nodiscard]] statistics stats() const noexcept;
+
+private:
+    static std::size_t class_index(std::size_t size_class) noexcept;
+
+    std::size_t max_cached;
+
+    mutable std::mutex                            mu;
+    std::array<std::vector<buffer_t>, num_classes> free;
+
+    std::atomic<std::uint64_t> hits   = 0;
+    std::atomic<std::uint64_t> misses = 0;
+    std::atomic<std::uint64_t> cached = 0;
+};
+
 // TODO: rename to just "buffer" and then also implement io::writer?
 class buffer_pool_reader : public io::reader
 {
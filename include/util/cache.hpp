@@ -105,6 +105,7 @@ public:
 
         entries.clear();
         lookup.clear();
+        hand = entries.end();
     }
 
 private:
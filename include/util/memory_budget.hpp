@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "io/scheduler.hpp"
+
+namespace net::util
+{
+
+// memory_budget keeps count of the memory set aside for buffers, request bodies and the like, against a limit for the
+// whole process. It doesn't allocate anything itself: whoever allocates reserves from the budget first, and releases
+// what they reserved once they've freed it.
+//
+// Reservations that would go over the limit are refused by try_reserve(), so e.g. a buffer doesn't grow, or an
+// oversized request is turned away before its body is read. Past pressure_ratio of the limit, the budget is under
+// pressure: those that can hold off wait_for_room() (e.g. a connection that doesn't read its next request until
+// there's memory for it), and shrinkers are asked to let go of memory they can do without (e.g. caches).
+class memory_budget
+{
+public:
+    struct statistics
+    {
+        std::size_t   limit;         // 0 is no limit
+        std::size_t   reserved;      // set aside by reservations, all told
+        std::size_t   used;          // actually allocated, out of what's reserved
+        std::size_t   peak_reserved; // the most that's ever been reserved at once
+        std::uint64_t refused;       // reservations refused for going over the limit
+        std::size_t   waiting;       // waiting for room
+    };
+
+    using shrinker = std::function<void()>;
+
+    // A limit of 0 means no limit: reservations are still counted, but never refused.
+    explicit memory_budget(std::size_t limit = 0, double pressure_ratio = 0.9) noexcept;
+
+    memory_budget(const memory_budget&)            = delete;
+    memory_budget& operator=(const memory_budget&) = delete;
+
+    memory_budget(memory_budget&&)            = delete;
+    memory_budget& operator=(memory_budget&&) = delete;
+
+    ~memory_budget() = default;
+
+    // shared returns the budget for the whole process. It has no limit until one is set.
+    static memory_budget& shared();
+
+    void                      set_limit(std::size_t limit) noexcept;
+    [[nodiscard]] std::size_t limit() const noexcept { return max_bytes.load(std::memory_order::relaxed); }
+
+    // try_reserve reserves bytes, unless that would go over the limit.
+    [[nodiscard]] bool try_reserve(std::size_t bytes) noexcept;
+
+    // reserve reserves bytes whatever the limit, for memory that can't be done without, e.g. the first buffer of a
+    // connection that's already been accepted.
+    void reserve(std::size_t bytes) noexcept;
+
+    // release gives back bytes reserved earlier, waking up whoever's waiting for room once there's enough of it.
+    void release(std::size_t bytes) noexcept;
+
+    // note_allocated and note_freed keep track of how much of what's reserved has actually been allocated.
+    void note_allocated(std::size_t bytes) noexcept { used.fetch_add(bytes, std::memory_order::relaxed); }
+    void note_freed(std::size_t bytes) noexcept { used.fetch_sub(bytes, std::memory_order::relaxed); }
+
+    [[nodiscard]] bool under_pressure() const noexcept;
+
+    // reservation releases what it holds when it goes away. An empty one holds nothing.
+    class reservation
+    {
+    public:
+        reservation() noexcept = default;
+
+        reservation(const reservation&)            = delete;
+        reservation& operator=(const reservation&) = delete;
+
+        reservation(reservation&& other) noexcept
+            : budget{std::exchange(other.budget, nullptr)}
+            , bytes{std::exchange(other.bytes, 0)}
+        {}
+
+        reservation& operator=(reservation&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                budget = std::exchange(other.budget, nullptr);
+                bytes  = std::exchange(other.bytes, 0);
+            }
+            return *this;
+        }
+
+        ~reservation() { reset(); }
+
+        void reset() noexcept
+        {
+            if (budget != nullptr) std::exchange(budget, nullptr)->release(std::exchange(bytes, 0));
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept { return bytes; }
+        explicit                  operator bool() const noexcept { return budget != nullptr; }
+
+    private:
+        friend class memory_budget;
+
+        reservation(memory_budget* budget, std::size_t bytes) noexcept
+            : budget{budget}
+            , bytes{bytes}
+        {}
+
+        memory_budget* budget = nullptr;
+        std::size_t    bytes  = 0;
+    };
+
+    // try_hold is try_reserve, with a reservation to give it back. It's empty if there wasn't room.
+    [[nodiscard]] reservation try_hold(std::size_t bytes) noexcept;
+
+    class room_awaitable
+    {
+    public:
+        [[nodiscard]] bool      await_ready() const noexcept { return !budget->under_pressure() || gave_up(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle);
+        constexpr void          await_resume() const noexcept {}
+
+    private:
+        friend class memory_budget;
+
+        room_awaitable(memory_budget* budget, io::scheduler* scheduler, const std::atomic<bool>* keep_waiting) noexcept
+            : budget{budget}
+            , scheduler{scheduler}
+            , keep_waiting{keep_waiting}
+        {}
+
+        [[nodiscard]] bool gave_up() const noexcept
+        {
+            return keep_waiting != nullptr && !keep_waiting->load(std::memory_order::acquire);
+        }
+
+        memory_budget*           budget;
+        io::scheduler*           scheduler;
+        const std::atomic<bool>* keep_waiting;
+    };
+
+    // wait_for_room waits until the budget isn't under pressure any more, and carries on on scheduler.
+    //
+    // If keep_waiting is given, it also stops waiting once that's false, as of the next wake_all() - e.g. a server
+    // that's closing. Whoever waited has to check why it's been woken.
+    [[nodiscard]] room_awaitable wait_for_room(io::scheduler*           scheduler,
+                                               const std::atomic<bool>* keep_waiting = nullptr) noexcept
+    {
+        return {this, scheduler, keep_waiting};
+    }
+
+    // wake_all wakes up everyone waiting for room, whether there's any or not.
+    void wake_all() noexcept;
+
+    // add_shrinker registers a callback to let go of some memory when the budget comes under pressure, and returns an
+    // id to remove it by. Shrinkers may be called from any thread, but never more than one at a time.
+    std::size_t add_shrinker(shrinker&& shrink);
+    void        remove_shrinker(std::size_t id);
+
+    [[nodiscard]] statistics stats() const noexcept;
+
+private:
+    struct waiter
+    {
+        std::coroutine_handle<> handle;
+        io::scheduler*          scheduler;
+    };
+
+    // pressure_point is how much may be reserved before the budget is under pressure, for a given limit.
+    [[nodiscard]] std::size_t pressure_point(std::size_t limit) const noexcept;
+
+    void added(std::size_t old_total, std::size_t new_total) noexcept;
+    void wake_waiters(bool even_under_pressure = false) noexcept;
+    void shrink() noexcept;
+
+    double pressure_ratio;
+
+    std::atomic<std::size_t>   max_bytes;
+    std::atomic<std::size_t>   reserved      = 0;
+    std::atomic<std::size_t>   used          = 0;
+    std::atomic<std::size_t>   peak_reserved = 0;
+    std::atomic<std::uint64_t> refused       = 0;
+    std::atomic<std::size_t>   num_waiting   = 0;
+
+    std::mutex          waiters_mu;
+    std::vector<waiter> waiters;
+
+    std::mutex                                     shrinkers_mu;
+    std::vector<std::pair<std::size_t, shrinker>> shrinkers;
+    std::size_t                                    next_shrinker_id = 0;
+    std::atomic_flag                               shrinking;
+};
+
+}
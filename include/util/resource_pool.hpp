@@ -106,7 +106,13 @@ public:
     [[nodiscard]] std::optional<borrowed_resource> try_get()
     {
         std::unique_lock lock{mu};
-        if (pool.empty()) return std::nullopt;
+        if (pool.empty())
+        {
+            if (num_borrowed >= max_size) return std::nullopt;
+
+            ++num_borrowed;
+            return std::make_optional(borrowed_resource{this, make()});
+        }
 
         ++num_borrowed;
 
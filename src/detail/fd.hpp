@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+
+// Helpers for working with file descriptors directly, shared by the socket types' sources. Not part of the library's
+// interface.
+
+namespace net::detail
+{
+
+// would_block is whether err just means a non-blocking call has to wait for the descriptor to be ready.
+inline bool would_block(int err) noexcept { return err == EAGAIN || err == EWOULDBLOCK; }
+
+inline std::error_condition errno_condition(int err) noexcept
+{
+    return std::make_error_condition(static_cast<std::errc>(err));
+}
+
+// set_nonblocking makes fd non-blocking and close-on-exec. Returns false and sets errno if it can't.
+inline bool set_nonblocking(int fd) noexcept
+{
+    int flags = ::fcntl(fd, F_GETFL);
+    if (flags == -1) return false;
+    if (::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) return false;
+    return ::fcntl(fd, F_SETFD, FD_CLOEXEC) != -1;
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <coroutine>
+
+#include "io/scheduler.hpp"
+
+// Ways of getting a coroutine going again on a scheduler, shared by the library's sources. Not part of the library's
+// interface.
+
+namespace net::detail
+{
+
+// resume_on continues the awaiting coroutine on sched's workers, after a blocking call on another pool. If sched won't
+// take it (e.g. it's shutting down), the coroutine just carries on where it is.
+struct resume_on
+{
+    io::scheduler* sched;
+
+    constexpr bool await_ready() noexcept { return false; }
+    constexpr void await_resume() noexcept {}
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        if (sched->resume(handle)) return std::noop_coroutine();
+        return handle;
+    }
+};
+
+// resume_on_or_here hands handle to sched's workers. If there's no scheduler, or it won't take it (e.g. it's shutting
+// down), the coroutine carries on right here instead.
+inline void resume_on_or_here(io::scheduler* sched, std::coroutine_handle<> handle) noexcept
+{
+    if (sched == nullptr || !sched->resume(handle)) handle.resume();
+}
+
+}
@@ -19,7 +19,9 @@
 #include "http/response.hpp"
 #include "io/buffered_reader.hpp"
 #include "io/scheduler.hpp"
+#include "socket.hpp"
 #include "tcp.hpp"
+#include "unix.hpp"
 
 namespace net::http
 {
@@ -27,11 +29,13 @@ namespace net::http
 client::client(io::scheduler*            scheduler,
                std::size_t               max_connections_per_host,
                std::chrono::microseconds timeout,
-               bool                      keepalives)
+               bool                      keepalives,
+               std::string               unix_path)
     : scheduler{scheduler}
     , max_connections_per_host{max_connections_per_host}
     , keepalives{keepalives}
     , timeout{timeout}
+    , unix_path{std::move(unix_path)}
 {}
 
 client::client(client&& other) noexcept
@@ -39,6 +43,7 @@ client::client(client&& other) noexcept
     , max_connections_per_host{std::exchange(other.max_connections_per_host, 0)}
     , keepalives{std::exchange(other.keepalives, false)}
     , timeout{std::exchange(other.timeout, 0us)}
+    , unix_path{std::move(other.unix_path)}
 {
     std::unique_lock lock{other.connections_mu};
     connections = std::exchange(other.connections, connection_pool{});
@@ -50,6 +55,7 @@ client& client::operator=(client&& other) noexcept
 
     max_connections_per_host = std::exchange(other.max_connections_per_host, 0);
     connections              = std::exchange(other.connections, connection_pool{});
+    unix_path                = std::move(other.unix_path);
 
     return *this;
 }
@@ -76,6 +82,27 @@ coro::task<std::expected<client_response, std::error_condition>> client::send(co
     }
 
     auto conn = get_connection(request.uri.host, request.uri.port);
+    if (!conn->valid())
+    {
+        try
+        {
+            if (!unix_path.empty())
+            {
+                *conn.get() = co_await unix_socket::connect(scheduler, unix_addr{unix_path});
+            }
+            else
+            {
+                *conn.get() = co_await tcp_socket::connect(scheduler,
+                                                           request.uri.host,
+                                                           !request.uri.port.empty() ? request.uri.port : "80");
+            }
+        }
+        catch (const std::system_error& ex)
+        {
+            co_return std::unexpected(ex.code().default_error_condition());
+        }
+    }
+
     auto res  = co_await encode(conn.get(), request);
     if (!res.has_value()) co_return std::unexpected(res.error());
 
@@ -107,7 +134,8 @@ client::host_connections::borrowed_resource client::get_connection(const std::st
                 connections[connection_host] = std::make_unique<host_connections>(
                     max_connections_per_host,
                     max_connections_per_host,
-                    [&, this] { return std::make_unique<tcp_socket>(scheduler, host, (!port.empty() ? port : "80")); });
+                    // connected on first use, in send(), so connecting doesn't hold up a worker
+                    [this] { return std::make_unique<socket>(scheduler, -1); });
             }
         }
 
@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <cctype>
 #include <charconv>
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -17,100 +19,112 @@ namespace net::http
 using namespace std::string_literals;
 using namespace std::string_view_literals;
 
-std::size_t headers::keyhash::operator()(const std::string& key) const noexcept
+headers::headers(std::initializer_list<std::pair<std::string_view, std::initializer_list<std::string_view>>> init)
 {
-    return operator()(static_cast<std::string_view>(key));
-}
-
-std::size_t headers::keyhash::operator()(std::string_view key) const noexcept
-{
-    // variant of Fowler-Noll-Vo
-
-    std::size_t result = 2'166'136'261;
-
-    for (auto c : key)
+    for (const auto& [name, vals] : init)
     {
-        result = (result * 16'777'619) ^ static_cast<std::size_t>(std::tolower(c));
+        for (auto val : vals) add(name, val);
     }
-
-    return result;
-}
-
-bool headers::keyequal::operator()(const std::string& lhs, const std::string& rhs) const noexcept
-{
-    return net::util::equal_ignore_case(lhs, rhs);
 }
 
-bool headers::keyequal::operator()(std::string_view lhs, const std::string& rhs) const noexcept
+headers::headers(headers&& other) noexcept
+    : local{other.local}
+    , overflow{std::move(other.overflow)}
+    , count{other.count}
+    , spilled{other.spilled}
+    , text{std::move(other.text)}
+    , dead{other.dead}
 {
-    return net::util::equal_ignore_case(lhs, static_cast<std::string_view>(rhs));
+    other.clear();
 }
 
-bool headers::keyequal::operator()(const std::string& lhs, std::string_view rhs) const noexcept
+headers& headers::operator=(headers&& other) noexcept
 {
-    return net::util::equal_ignore_case(static_cast<std::string_view>(lhs), rhs);
-}
+    if (this == &other) return *this;
 
-headers::headers(std::initializer_list<map_type::value_type> init)
-    : values(init)
-{}
+    local    = other.local;
+    overflow = std::move(other.overflow);
+    count    = other.count;
+    spilled  = other.spilled;
+    text     = std::move(other.text);
+    dead     = other.dead;
 
-headers& headers::set(const std::string& key, std::string val)
-{
-    values.insert_or_assign(key, std::vector{std::move(val)});
+    other.clear();
     return *this;
 }
 
+headers& headers::set(const std::string& key, std::string val) { return replace(key_of(key), val); }
+
 headers& headers::set(const std::string& key, std::initializer_list<std::string> vals)
 {
-    values.insert_or_assign(key, vals);
-    return *this;
+    return set(std::string_view{key}, vals);
 }
 
-headers& headers::add(const std::string& key, std::string val)
+headers& headers::set(const std::string& key, std::vector<std::string>&& vals)
 {
-    values[key].push_back(std::move(val));
-    return *this;
+    return set(std::string_view{key}, std::move(vals));
 }
 
-headers& headers::set(std::string_view key, std::string val) { return set(std::string(key), std::move(val)); }
+headers& headers::add(const std::string& key, std::string val) { return append(key_of(key), val); }
+
+headers& headers::set(std::string_view key, std::string val) { return replace(key_of(key), val); }
 
 headers& headers::set(std::string_view key, std::initializer_list<std::string> vals)
 {
-    return set(std::string(key), vals);
-}
+    auto k = key_of(key);
 
-headers& headers::add(std::string_view key, std::string val) { return add(std::string(key), std::move(val)); }
+    erase(k);
+    for (const auto& val : vals) append(k, val);
 
-headers& headers::set(const std::string& key, std::string_view val) { return set(key, std::string(val)); }
+    return *this;
+}
 
-headers& headers::set(const std::string& key, std::initializer_list<std::string_view> vals)
+headers& headers::set(std::string_view key, std::vector<std::string>&& vals)
 {
-    value_type tmp;
-    tmp.resize(vals.size());
+    auto k = key_of(key);
 
-    std::transform(vals.begin(), vals.end(), tmp.begin(), [](std::string_view view) { return std::string(view); });
+    erase(k);
+    for (const auto& val : vals) append(k, val);
 
-    values[key] = tmp;
     return *this;
 }
 
-headers& headers::add(const std::string& key, std::string_view val)
+headers& headers::add(std::string_view key, std::string val) { return append(key_of(key), val); }
+
+headers& headers::set(const std::string& key, std::string_view val) { return replace(key_of(key), val); }
+
+headers& headers::set(const std::string& key, std::initializer_list<std::string_view> vals)
 {
-    values[key].emplace_back(val);
-    return *this;
+    return set(std::string_view{key}, vals);
 }
 
-headers& headers::set(std::string_view key, std::string_view val) { return set(std::string(key), std::string(val)); }
+headers& headers::add(const std::string& key, std::string_view val) { return append(key_of(key), val); }
+
+headers& headers::set(std::string_view key, std::string_view val) { return replace(key_of(key), val); }
 
 headers& headers::set(std::string_view key, std::initializer_list<std::string_view> vals)
 {
-    return set(std::string(key), vals);
+    auto k = key_of(key);
+
+    erase(k);
+    for (auto val : vals) append(k, val);
+
+    return *this;
 }
 
-headers& headers::add(std::string_view key, std::string_view val) { return add(std::string(key), val); }
+headers& headers::add(std::string_view key, std::string_view val) { return append(key_of(key), val); }
+
+headers& headers::set(http::field f, std::string_view val) { return replace({.id = f, .name = {}}, val); }
 
-headers& headers::set_content_length(std::size_t length) { return set("Content-Length"sv, std::to_string(length)); }
+headers& headers::add(http::field f, std::string_view val) { return append({.id = f, .name = {}}, val); }
+
+headers& headers::set_content_length(std::size_t length)
+{
+    std::array<char, 24> digits; // NOLINT(cppcoreguidelines-pro-type-member-init)
+    auto [end, _] = std::to_chars(digits.data(), digits.data() + digits.size(), length);
+
+    return set(field::content_length, std::string_view{digits.data(), end});
+}
 
 headers& headers::set_content_type(const content_type& content_type)
 {
@@ -123,50 +137,44 @@ headers& headers::set_content_type(const content_type& content_type)
     std::ranges::for_each(content_type.parameters,
                           [&](const auto& param) { ss << ": " << param.first << '=' << param.second; });
 
-    return set("Content-Type"sv, ss.str());
+    return set(field::content_type, ss.str());
 }
 
-[[nodiscard]] std::optional<std::string_view> headers::get(const std::string& key) const
-{
-    auto iter = values.find(key);
-    if (iter == values.end()) return std::nullopt;
-    if (iter->second.empty()) return std::nullopt;
+std::size_t headers::erase(std::string_view key) noexcept { return erase(key_of(key)); }
 
-    std::string_view view = iter->second.front();
-    return {view};
-}
+std::size_t headers::erase(http::field f) noexcept { return erase({.id = f, .name = {}}); }
 
-[[nodiscard]] std::optional<std::string_view> headers::get(std::string_view key) const
-{
-    auto iter = values.find(key);
-    if (iter == values.end()) return std::nullopt;
-    if (iter->second.empty()) return std::nullopt;
+[[nodiscard]] std::optional<std::string_view> headers::get(const std::string& key) const { return get(key_of(key)); }
+
+[[nodiscard]] std::optional<std::string_view> headers::get(std::string_view key) const { return get(key_of(key)); }
 
-    std::string_view view = iter->second.front();
-    return {view};
+[[nodiscard]] std::optional<std::string_view> headers::get(http::field f) const noexcept
+{
+    return get({.id = f, .name = {}});
 }
 
 [[nodiscard]] std::optional<std::string_view> headers::operator[](const std::string& key) const { return get(key); }
 [[nodiscard]] std::optional<std::string_view> headers::operator[](std::string_view key) const { return get(key); }
+[[nodiscard]] std::optional<std::string_view> headers::operator[](http::field f) const noexcept { return get(f); }
 
 [[nodiscard]] std::optional<headers::values_range> headers::get_all(const std::string& key) const
 {
-    return get_all(std::string_view{key});
+    return get_all(key_of(key));
 }
 
 [[nodiscard]] std::optional<headers::values_range> headers::get_all(std::string_view key) const
 {
-    auto iter = values.find(key);
-    if (iter == values.end()) return std::nullopt;
+    return get_all(key_of(key));
+}
 
-    return {
-        {iter->second.begin(), iter->second.end()}
-    };
+[[nodiscard]] std::optional<headers::values_range> headers::get_all(http::field f) const noexcept
+{
+    return get_all({.id = f, .name = {}});
 }
 
 [[nodiscard]] std::optional<std::size_t> headers::get_content_length() const
 {
-    auto maybe = get("Content-Length"sv);
+    auto maybe = get(field::content_length);
     if (!maybe.has_value()) return std::nullopt;
 
     std::size_t length; // NOLINT(cppcoreguidelines-init-variables)
@@ -178,7 +186,7 @@ headers& headers::set_content_type(const content_type& content_type)
 
 [[nodiscard]] std::optional<content_type> headers::get_content_type() const
 {
-    auto maybe = get("Content-Type"sv);
+    auto maybe = get(field::content_type);
     if (!maybe.has_value()) return std::nullopt;
 
     const std::string_view type  = maybe.value();
@@ -224,12 +232,12 @@ headers& headers::set_content_type(const content_type& content_type)
 
 [[nodiscard]] std::optional<headers::values_range> headers::get_content_encoding() const
 {
-    return get_all("Content-Encoding"sv);
+    return get_all(field::content_encoding);
 }
 
 [[nodiscard]] std::optional<headers::values_range> headers::get_transfer_encoding() const
 {
-    return get_all("Transfer-Encoding"sv);
+    return get_all(field::transfer_encoding);
 }
 
 [[nodiscard]] bool headers::is_chunked() const
@@ -238,11 +246,17 @@ headers& headers::set_content_type(const content_type& content_type)
         .transform(
             [](auto range)
             {
-                for (auto val : range)
+                for (std::string_view val : range)
                 {
-                    val = util::trim_string(val);
-
-                    if (util::equal_ignore_case(val, "chunked"s)) return true;
+                    // one field can list several codings, e.g. "gzip, chunked"
+                    while (true)
+                    {
+                        auto comma = val.find(',');
+                        if (util::equal_ignore_case(util::trim_string(val.substr(0, comma)), "chunked"sv)) return true;
+                        if (comma == std::string_view::npos) break;
+
+                        val.remove_prefix(comma + 1);
+                    }
                 }
 
                 return false;
@@ -250,11 +264,206 @@ headers& headers::set_content_type(const content_type& content_type)
         .value_or(false);
 }
 
-[[nodiscard]] headers::keys_iterator headers::begin() const { return values.begin(); }
-[[nodiscard]] headers::keys_iterator headers::end() const { return values.end(); }
+void headers::reserve(std::size_t fields, std::size_t bytes)
+{
+    if (fields > inline_fields && !spilled)
+    {
+        overflow.assign(local.begin(), local.begin() + static_cast<std::ptrdiff_t>(count));
+        spilled = true;
+    }
+
+    if (spilled) overflow.reserve(fields);
+    text.reserve(bytes);
+}
+
+void headers::clear() noexcept
+{
+    overflow.clear();
+    count   = 0;
+    spilled = false;
+
+    text.clear();
+    dead = 0;
+}
+
+bool operator==(const headers& lhs, const headers& rhs) noexcept
+{
+    if (lhs.size() != rhs.size()) return false;
+
+    for (std::size_t i = 0; i < lhs.count; ++i)
+    {
+        auto k = headers::key{.id = lhs.entries()[i].id, .name = lhs.view(i).name};
+
+        // each name only needs comparing once, where it first appears
+        if (lhs.find(k) != i) continue;
+
+        auto l = lhs.find(k);
+        auto r = rhs.find(k);
 
-[[nodiscard]] bool headers::empty() const noexcept { return values.empty(); }
+        while (l != lhs.count && r != rhs.count)
+        {
+            if (lhs.view(l).value != rhs.view(r).value) return false;
+
+            l = lhs.find(k, l + 1);
+            r = rhs.find(k, r + 1);
+        }
+
+        if (l != lhs.count || r != rhs.count) return false;
+    }
+
+    return true;
+}
 
-[[nodiscard]] std::size_t headers::size() const noexcept { return values.size(); }
+headers::field_view headers::view(std::size_t index) const noexcept
+{
+    const auto& e = entries()[index];
+
+    auto name = e.id == field::unknown ? std::string_view{text}.substr(e.offset, e.name_length) : field_name(e.id);
+    return {.name = name, .value = std::string_view{text}.substr(e.offset + e.name_length, e.value_length)};
+}
+
+std::size_t headers::find(key k, std::size_t from) const noexcept
+{
+    auto all = entries();
+
+    // well-known fields are a byte to compare, the rest a name
+    if (k.id != field::unknown)
+    {
+        for (; from < count; ++from)
+        {
+            if (all[from].id == k.id) return from;
+        }
+
+        return count;
+    }
+
+    for (; from < count; ++from)
+    {
+        const auto& e = all[from];
+        if (e.id != field::unknown || e.name_length != k.name.size()) continue;
+
+        if (util::equal_ignore_case(std::string_view{text}.substr(e.offset, e.name_length), k.name)) return from;
+    }
+
+    return count;
+}
+
+headers& headers::append(key k, std::string_view val)
+{
+    auto name = k.id == field::unknown ? k.name : std::string_view{};
+
+    // what's added could be a view of what's already here (the name too, e.g. copying a field over from another one),
+    // which growing or compacting text would leave dangling
+    auto offset_of = [this](std::string_view s)
+    { return reinterpret_cast<std::uintptr_t>(s.data()) - reinterpret_cast<std::uintptr_t>(text.data()); };
+
+    auto name_offset  = offset_of(name);
+    auto val_offset   = offset_of(val);
+    bool name_aliased = !name.empty() && name_offset < text.size();
+    bool val_aliased  = !val.empty() && val_offset < text.size();
+
+    if (name_aliased || val_aliased)
+    {
+        text.reserve(text.size() + name.size() + val.size());
+        if (name_aliased) name = std::string_view{text}.substr(name_offset, name.size());
+        if (val_aliased) val = std::string_view{text}.substr(val_offset, val.size());
+    }
+    else if (dead > text.size() / 2)
+    {
+        compact();
+    }
+
+    entry e{
+        .offset       = static_cast<std::uint32_t>(text.size()),
+        .value_length = static_cast<std::uint32_t>(val.size()),
+        .name_length  = static_cast<std::uint32_t>(name.size()),
+        .id           = k.id,
+    };
+
+    text.append(name);
+    text.append(val);
+
+    if (!spilled && count == inline_fields)
+    {
+        overflow.reserve(inline_fields * 2);
+        overflow.assign(local.begin(), local.end());
+        spilled = true;
+    }
+
+    if (spilled) overflow.push_back(e);
+    else local[count] = e;
+
+    ++count;
+    return *this;
+}
+
+headers& headers::replace(key k, std::string_view val)
+{
+    // the value could be in one of the fields about to go, which only ever leaves its bytes behind
+    erase(k);
+    return append(k, val);
+}
+
+std::size_t headers::erase(key k) noexcept
+{
+    auto all = entries();
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto& e = all[i];
+
+        bool match = k.id != field::unknown
+                       ? e.id == k.id
+                       : e.id == field::unknown
+                             && util::equal_ignore_case(std::string_view{text}.substr(e.offset, e.name_length), k.name);
+
+        if (match) dead += e.name_length + e.value_length;
+        else all[kept++] = e;
+    }
+
+    auto erased = count - kept;
+    count       = kept;
+    if (spilled) overflow.resize(count);
+
+    return erased;
+}
+
+void headers::compact()
+{
+    std::pmr::string live{text.get_allocator()};
+    live.reserve(text.size() - dead);
+
+    for (auto& e : entries())
+    {
+        auto offset = static_cast<std::uint32_t>(live.size());
+        live.append(std::string_view{text}.substr(e.offset, e.name_length + e.value_length));
+        e.offset = offset;
+    }
+
+    text = std::move(live);
+    dead = 0;
+}
+
+[[nodiscard]] std::optional<std::string_view> headers::get(key k) const noexcept
+{
+    auto index = find(k);
+    if (index == count) return std::nullopt;
+
+    return view(index).value;
+}
+
+[[nodiscard]] std::optional<headers::values_range> headers::get_all(key k) const noexcept
+{
+    auto index = find(k);
+    if (index == count) return std::nullopt;
+
+    // look for the rest of them by the name they're stored with, which lives as long as they do
+    k.name = view(index).name;
+    return values_range{
+        {this, k, index},
+        {this, k, count}
+    };
+}
 
 }
@@ -0,0 +1,752 @@
+#include "http/hpack.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "http/headers.hpp"
+
+namespace
+{
+
+using namespace std::string_view_literals;
+
+struct static_field
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+// https://httpwg.org/specs/rfc7541.html#static.table.definition - index 1 is the first
+constexpr std::array<static_field, net::http::hpack::static_table_size> static_table{{
+    {":authority"sv,                 ""sv},
+    {":method"sv,                    "GET"sv},
+    {":method"sv,                    "POST"sv},
+    {":path"sv,                      "/"sv},
+    {":path"sv,                      "/index.html"sv},
+    {":scheme"sv,                    "http"sv},
+    {":scheme"sv,                    "https"sv},
+    {":status"sv,                    "200"sv},
+    {":status"sv,                    "204"sv},
+    {":status"sv,                    "206"sv},
+    {":status"sv,                    "304"sv},
+    {":status"sv,                    "400"sv},
+    {":status"sv,                    "404"sv},
+    {":status"sv,                    "500"sv},
+    {"accept-charset"sv,             ""sv},
+    {"accept-encoding"sv,            "gzip, deflate"sv},
+    {"accept-language"sv,            ""sv},
+    {"accept-ranges"sv,              ""sv},
+    {"accept"sv,                     ""sv},
+    {"access-control-allow-origin"sv, ""sv},
+    {"age"sv,                        ""sv},
+    {"allow"sv,                      ""sv},
+    {"authorization"sv,              ""sv},
+    {"cache-control"sv,              ""sv},
+    {"content-disposition"sv,        ""sv},
+    {"content-encoding"sv,           ""sv},
+    {"content-language"sv,           ""sv},
+    {"content-length"sv,             ""sv},
+    {"content-location"sv,           ""sv},
+    {"content-range"sv,              ""sv},
+    {"content-type"sv,               ""sv},
+    {"cookie"sv,                     ""sv},
+    {"date"sv,                       ""sv},
+    {"etag"sv,                       ""sv},
+    {"expect"sv,                     ""sv},
+    {"expires"sv,                    ""sv},
+    {"from"sv,                       ""sv},
+    {"host"sv,                       ""sv},
+    {"if-match"sv,                   ""sv},
+    {"if-modified-since"sv,          ""sv},
+    {"if-none-match"sv,              ""sv},
+    {"if-range"sv,                   ""sv},
+    {"if-unmodified-since"sv,        ""sv},
+    {"last-modified"sv,              ""sv},
+    {"link"sv,                       ""sv},
+    {"location"sv,                   ""sv},
+    {"max-forwards"sv,               ""sv},
+    {"proxy-authenticate"sv,         ""sv},
+    {"proxy-authorization"sv,        ""sv},
+    {"range"sv,                      ""sv},
+    {"referer"sv,                    ""sv},
+    {"refresh"sv,                    ""sv},
+    {"retry-after"sv,                ""sv},
+    {"server"sv,                     ""sv},
+    {"set-cookie"sv,                 ""sv},
+    {"strict-transport-security"sv,  ""sv},
+    {"transfer-encoding"sv,          ""sv},
+    {"user-agent"sv,                 ""sv},
+    {"vary"sv,                       ""sv},
+    {"via"sv,                        ""sv},
+    {"www-authenticate"sv,           ""sv},
+}};
+
+struct huffman_code
+{
+    std::uint32_t code;
+    std::uint8_t  bits;
+};
+
+// https://httpwg.org/specs/rfc7541.html#huffman.code - by symbol, with EOS last
+constexpr std::array<huffman_code, 257> huffman_codes{{
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28},
+    {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28}, {0xfffffea, 28},
+    {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28},
+    {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28}, {0xffffff4, 28},
+    {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28},
+    {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+    {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5},
+    {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7},
+    {0x60, 7}, {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7}, {0x69, 7},
+    {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7}, {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8},
+    {0x73, 7}, {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6}, {0x7ffd, 15}, {0x3, 5},
+    {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6},
+    {0x77, 7}, {0x78, 7}, {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13},
+    {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22}, {0x3fffd4, 22},
+    {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23},
+    {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+    {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22},
+    {0x7fffe5, 23}, {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23},
+    {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+    {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23},
+    {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22},
+    {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22},
+    {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26},
+    {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21}, {0x1fffe5, 21},
+    {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20},
+    {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+    {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26},
+    {0x7ffff4, 23}, {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27},
+    {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27},
+    {0x7ffffed, 27}, {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+}};
+
+constexpr std::uint16_t eos = 256;
+
+// name_hash is FNV-1a, for finding names in the tables without comparing them to every one.
+constexpr std::uint32_t name_hash(std::string_view name) noexcept
+{
+    std::uint32_t hash = 2'166'136'261U;
+    for (unsigned char c : name) hash = (hash ^ c) * 16'777'619U;
+
+    return hash;
+}
+
+// static_names finds a name's fields in the static table: the name hashes to a slot (or the first free one after),
+// which holds the index of the first field with that name, and how many in a row have it.
+struct static_name
+{
+    std::uint8_t first = 0;
+    std::uint8_t count = 0;
+};
+
+constexpr std::size_t static_name_slots = 128;
+
+consteval std::array<static_name, static_name_slots> make_static_names() noexcept
+{
+    std::array<static_name, static_name_slots> slots{};
+    for (std::size_t i = 0; i < static_table.size();)
+    {
+        auto same = i;
+        while (same < static_table.size() && static_table[same].name == static_table[i].name) ++same;
+
+        auto slot = name_hash(static_table[i].name) % static_name_slots;
+        while (slots[slot].count != 0) slot = (slot + 1) % static_name_slots;
+
+        slots[slot] = {.first = static_cast<std::uint8_t>(i + 1), .count = static_cast<std::uint8_t>(same - i)};
+        i           = same;
+    }
+
+    return slots;
+}
+
+constexpr auto static_names = make_static_names();
+
+// find_static returns the static table's index for name and value, with exact set - or for just name, without. It
+// returns 0 if name isn't there at all.
+std::size_t find_static(std::string_view name, std::string_view value, bool& exact) noexcept
+{
+    exact = false;
+    for (auto slot = name_hash(name) % static_name_slots; static_names[slot].count != 0;
+         slot      = (slot + 1) % static_name_slots)
+    {
+        const auto& found = static_names[slot];
+        if (static_table[found.first - 1].name != name) continue;
+
+        for (std::size_t i = 0; i < found.count; ++i)
+        {
+            if (static_table[found.first - 1 + i].value == value)
+            {
+                exact = true;
+                return found.first + i;
+            }
+        }
+
+        return found.first;
+    }
+
+    return 0;
+}
+
+// Huffman coded text is decoded four bits at a time, by a state machine: each state is a node of the code's tree
+// (there are 256 that aren't leaves), and each step from one takes in four bits, and says where they lead to, and
+// which symbol they finished on the way, if any. No code is shorter than five bits, so no step finishes two.
+struct huffman_step
+{
+    std::uint8_t state  = 0;
+    std::uint8_t flags  = 0;
+    std::uint8_t symbol = 0;
+};
+
+// step flags
+constexpr std::uint8_t emits   = 0x1; // a symbol was finished
+constexpr std::uint8_t accepts = 0x2; // the text may end here: what's left since the last symbol is valid padding
+constexpr std::uint8_t fails   = 0x4; // EOS was finished, which can't be in the text
+
+using huffman_machine = std::array<std::array<huffman_step, 16>, 256>;
+
+consteval huffman_machine make_huffman_machine() noexcept
+{
+    // The tree, with the root first. Children that are leaves are -1 - their symbol; 0 is none yet.
+    std::array<std::array<std::int16_t, 2>, 256> children{};
+
+    std::int16_t nodes = 1;
+    for (std::int16_t symbol = 0; symbol < static_cast<std::int16_t>(huffman_codes.size()); ++symbol)
+    {
+        const auto& code = huffman_codes[symbol];
+
+        std::size_t node = 0;
+        for (unsigned bit = code.bits - 1U; bit > 0; --bit)
+        {
+            auto& child = children[node][(code.code >> bit) & 1U];
+            if (child == 0) child = nodes++;
+            node = static_cast<std::size_t>(child);
+        }
+
+        children[node][code.code & 1U] = static_cast<std::int16_t>(-1 - symbol);
+    }
+
+    // Padding is the start of EOS, which is all ones, and shorter than a byte.
+    std::array<bool, 256> can_end{};
+    std::size_t           node = 0;
+    can_end[node]              = true;
+    for (int depth = 1; depth < 8; ++depth)
+    {
+        node          = static_cast<std::size_t>(children[node][1]);
+        can_end[node] = true;
+    }
+
+    huffman_machine machine{};
+    for (std::size_t state = 0; state < machine.size(); ++state)
+    {
+        for (unsigned nibble = 0; nibble < 16; ++nibble)
+        {
+            huffman_step step;
+            std::size_t  at = state;
+            for (int bit = 3; bit >= 0; --bit)
+            {
+                auto child = children[at][(nibble >> static_cast<unsigned>(bit)) & 1U];
+                if (child >= 0)
+                {
+                    at = static_cast<std::size_t>(child);
+                    continue;
+                }
+
+                auto symbol = -1 - child;
+                if (symbol == eos) step.flags |= fails;
+                step.flags |= emits;
+                step.symbol = static_cast<std::uint8_t>(symbol);
+                at          = 0;
+            }
+
+            step.state = static_cast<std::uint8_t>(at);
+            if (can_end[at]) step.flags |= accepts;
+            machine[state][nibble] = step;
+        }
+    }
+
+    return machine;
+}
+
+constexpr auto huffman_steps = make_huffman_machine();
+
+std::error_condition malformed() noexcept { return std::make_error_condition(std::errc::illegal_byte_sequence); }
+
+// encode_integer appends value with a prefix bits long prefix, after the flags in first.
+// https://httpwg.org/specs/rfc7541.html#integer.representation
+void encode_integer(std::vector<std::byte>& out, std::uint8_t first, unsigned prefix, std::size_t value)
+{
+    const std::size_t max = (1U << prefix) - 1;
+    if (value < max)
+    {
+        out.push_back(static_cast<std::byte>(first | value));
+        return;
+    }
+
+    out.push_back(static_cast<std::byte>(first | max));
+    for (value -= max; value >= 0x80; value >>= 7U)
+    {
+        out.push_back(static_cast<std::byte>((value & 0x7fU) | 0x80U));
+    }
+    out.push_back(static_cast<std::byte>(value));
+}
+
+// decode_integer takes an integer with a prefix bits long prefix off the front of in, and returns false if it's cut
+// short - or too big to be any sensible length or index.
+bool decode_integer(std::span<const std::byte>& in, unsigned prefix, std::size_t& value) noexcept
+{
+    if (in.empty()) return false;
+
+    const std::size_t max = (1U << prefix) - 1;
+    value                 = std::to_integer<std::size_t>(in.front()) & max;
+    in                    = in.subspan(1);
+    if (value < max) return true;
+
+    for (unsigned shift = 0; !in.empty() && shift <= 28; shift += 7)
+    {
+        auto b = std::to_integer<std::size_t>(in.front());
+        in     = in.subspan(1);
+
+        value += (b & 0x7fU) << shift;
+        if ((b & 0x80U) == 0) return true;
+    }
+
+    return false;
+}
+
+// encode_string appends text as a string literal, Huffman coded if that makes it shorter.
+// https://httpwg.org/specs/rfc7541.html#string.literal.representation
+void encode_string(std::vector<std::byte>& out, std::string_view text)
+{
+    auto coded = net::http::hpack::huffman_encoded_size(text);
+    if (coded < text.size())
+    {
+        encode_integer(out, 0x80, 7, coded);
+        net::http::hpack::huffman_encode(text, out);
+        return;
+    }
+
+    encode_integer(out, 0x00, 7, text.size());
+    auto bytes = std::as_bytes(std::span{text});
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+// decode_string takes a string literal off the front of in. If it's Huffman coded, it's decoded into scratch;
+// otherwise text is a view into in.
+bool decode_string(std::span<const std::byte>& in, std::string& scratch, std::string_view& text)
+{
+    if (in.empty()) return false;
+
+    const bool  huffman = (std::to_integer<std::uint8_t>(in.front()) & 0x80U) != 0;
+    std::size_t length  = 0;
+    if (!decode_integer(in, 7, length) || length > in.size()) return false;
+
+    auto data = in.first(length);
+    in        = in.subspan(length);
+
+    if (!huffman)
+    {
+        text = {reinterpret_cast<const char*>(data.data()), data.size()};
+        return true;
+    }
+
+    scratch.clear();
+    if (!net::http::hpack::huffman_decode(data, scratch)) return false;
+
+    text = scratch;
+    return true;
+}
+
+// is_sensitive returns whether a field is a credential, which shouldn't be indexed anywhere along the way.
+bool is_sensitive(std::string_view name, std::string_view value) noexcept
+{
+    // a short cookie could be guessed at, a byte at a time, by seeing what compresses
+    if (name == "cookie"sv) return value.size() < 20;
+
+    return name == "authorization"sv || name == "proxy-authorization"sv || name == "set-cookie"sv;
+}
+
+// is_volatile returns whether a field's value is likely to be different every time it's sent, so indexing it would
+// only push fields that are worth keeping out of the table.
+bool is_volatile(std::string_view name) noexcept
+{
+    return name == "content-length"sv || name == "content-range"sv || name == "etag"sv || name == "last-modified"sv;
+}
+
+}
+
+namespace net::http::hpack
+{
+
+std::size_t huffman_encoded_size(std::string_view text) noexcept
+{
+    std::size_t bits = 0;
+    for (unsigned char c : text) bits += huffman_codes[c].bits;
+
+    return (bits + 7) / 8;
+}
+
+void huffman_encode(std::string_view text, std::vector<std::byte>& out)
+{
+    // NOTE: only the low bits of acc matter - the ones from before the last byte out are shifted off the top
+    std::uint64_t acc  = 0;
+    unsigned      bits = 0;
+
+    for (unsigned char c : text)
+    {
+        const auto& code = huffman_codes[c];
+        acc              = (acc << code.bits) | code.code;
+        bits += code.bits;
+
+        for (; bits >= 8; bits -= 8) out.push_back(static_cast<std::byte>(acc >> (bits - 8)));
+    }
+
+    // padded out with the start of EOS, which is all ones
+    if (bits > 0) out.push_back(static_cast<std::byte>((acc << (8 - bits)) | (0xffU >> bits)));
+}
+
+bool huffman_decode(std::span<const std::byte> data, std::string& out)
+{
+    // NOTE: the shortest codes are five bits, so this is as long as the text can be
+    out.reserve(out.size() + data.size() * 8 / 5);
+
+    std::uint8_t state   = 0;
+    bool         can_end = true;
+    for (auto b : data)
+    {
+        for (auto nibble : {std::to_integer<unsigned>(b) >> 4U, std::to_integer<unsigned>(b) & 0xfU})
+        {
+            const auto& step = huffman_steps[state][nibble];
+            if ((step.flags & fails) != 0) return false;
+            if ((step.flags & emits) != 0) out.push_back(static_cast<char>(step.symbol));
+
+            state   = step.state;
+            can_end = (step.flags & accepts) != 0;
+        }
+    }
+
+    return can_end;
+}
+
+dynamic_table::dynamic_table(std::size_t capacity)
+    : max_size{capacity}
+{
+    rebuild();
+}
+
+void dynamic_table::insert(std::string_view name, std::string_view value)
+{
+    const auto length = name.size() + value.size();
+    if (length + entry_overhead > max_size)
+    {
+        evict(0);
+        return;
+    }
+
+    evict(max_size - length - entry_overhead);
+
+    // NOTE: name can be in the bytes the fields just evicted left behind, which are about to be written over
+    auto offset = place(length);
+    std::memmove(ring.data() + offset, name.data(), name.size());
+    std::ranges::copy(value, ring.data() + offset + name.size());
+
+    newest        = (newest + 1) % slots.size();
+    slots[newest] = {
+        .offset       = static_cast<std::uint32_t>(offset),
+        .name_length  = static_cast<std::uint32_t>(name.size()),
+        .value_length = static_cast<std::uint32_t>(value.size()),
+        .name_hash    = name_hash(name),
+    };
+
+    ++entries;
+    used += length + entry_overhead;
+    head = offset + length;
+}
+
+std::optional<dynamic_table::field> dynamic_table::get(std::size_t index) const noexcept
+{
+    if (index >= entries) return std::nullopt;
+
+    const auto& e = at(index);
+    return field{
+        .name  = {ring.data() + e.offset, e.name_length},
+        .value = {ring.data() + e.offset + e.name_length, e.value_length},
+    };
+}
+
+std::optional<std::size_t> dynamic_table::find(std::string_view name, std::string_view value, bool& exact) const
+{
+    const auto hash = name_hash(name);
+
+    std::optional<std::size_t> named;
+    for (std::size_t i = 0; i < entries; ++i)
+    {
+        const auto& e = at(i);
+        if (e.name_hash != hash || e.name_length != name.size()) continue;
+        if (std::string_view{ring.data() + e.offset, e.name_length} != name) continue;
+
+        if (std::string_view{ring.data() + e.offset + e.name_length, e.value_length} == value)
+        {
+            exact = true;
+            return i;
+        }
+
+        if (!named) named = i;
+    }
+
+    exact = false;
+    return named;
+}
+
+void dynamic_table::set_capacity(std::size_t capacity)
+{
+    max_size = capacity;
+    evict(max_size);
+
+    if (ring.size() < max_size * 2) rebuild();
+}
+
+void dynamic_table::evict(std::size_t limit) noexcept
+{
+    for (; used > limit && entries > 0; --entries)
+    {
+        const auto& oldest = at(entries - 1);
+        used -= oldest.name_length + oldest.value_length + entry_overhead;
+    }
+
+    if (entries == 0) head = 0;
+}
+
+std::size_t dynamic_table::place(std::size_t length) noexcept
+{
+    if (entries == 0) return 0;
+
+    // The fields are in the ring oldest first, from tail on - wrapping around to the start once they reach the end.
+    const auto tail = at(entries - 1).offset;
+    if (at(0).offset >= tail)
+    {
+        if (ring.size() - head >= length) return head;
+        if (tail >= length) return 0;
+    }
+    else if (tail - head >= length)
+    {
+        return head;
+    }
+
+    // With the ring twice the size of the table, that's not to happen. But if it did, moving everything down to the
+    // start makes room.
+    rebuild();
+    return head;
+}
+
+void dynamic_table::rebuild()
+{
+    std::vector<char>  new_ring(std::max(max_size * 2, ring.size()));
+    std::vector<entry> new_slots(std::max(max_size / entry_overhead + 1, slots.size()));
+
+    // oldest first, from the start
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < entries; ++i)
+    {
+        auto e = at(entries - 1 - i);
+        std::memcpy(new_ring.data() + offset, ring.data() + e.offset, e.name_length + e.value_length);
+
+        e.offset     = static_cast<std::uint32_t>(offset);
+        new_slots[i] = e;
+        offset += e.name_length + e.value_length;
+    }
+
+    ring   = std::move(new_ring);
+    slots  = std::move(new_slots);
+    newest = (entries + slots.size() - 1) % slots.size();
+    head   = offset;
+}
+
+decoder::decoder(std::size_t max_table_size)
+    : table{max_table_size}
+    , max_size{max_table_size}
+{}
+
+std::error_condition decoder::decode(std::span<const std::byte> block, headers& out)
+{
+    return decode(block, [&](std::string_view name, std::string_view value) { out.add(name, value); });
+}
+
+void decoder::set_max_table_size(std::size_t size)
+{
+    max_size = size;
+    if (table.capacity() > max_size) table.set_capacity(max_size);
+}
+
+std::error_condition decoder::decode_block(std::span<const std::byte> block, emit_fn emit, void* context)
+{
+    bool any_fields = false;
+
+    while (!block.empty())
+    {
+        auto first = std::to_integer<std::uint8_t>(block.front());
+
+        // https://httpwg.org/specs/rfc7541.html#indexed.header.representation
+        if ((first & 0x80U) != 0)
+        {
+            std::size_t      index = 0;
+            std::string_view name;
+            std::string_view value;
+            if (!decode_integer(block, 7, index) || !lookup(index, name, value)) return malformed();
+
+            emit(context, name, value);
+            any_fields = true;
+            continue;
+        }
+
+        // https://httpwg.org/specs/rfc7541.html#encoding.context.update
+        if ((first & 0xe0U) == 0x20)
+        {
+            std::size_t capacity = 0;
+            if (any_fields || !decode_integer(block, 5, capacity) || capacity > max_size) return malformed();
+
+            table.set_capacity(capacity);
+            continue;
+        }
+
+        // https://httpwg.org/specs/rfc7541.html#literal.header.representation
+        // with incremental indexing (01), without indexing (0000) or never indexed (0001)
+        const bool indexing = (first & 0xc0U) == 0x40;
+
+        std::size_t      index = 0;
+        std::string_view name;
+        std::string_view value;
+        if (!decode_integer(block, indexing ? 6 : 4, index)) return malformed();
+
+        if (index == 0)
+        {
+            if (!decode_string(block, name_scratch, name)) return malformed();
+        }
+        else
+        {
+            std::string_view unused;
+            if (!lookup(index, name, unused)) return malformed();
+        }
+
+        if (!decode_string(block, value_scratch, value)) return malformed();
+        any_fields = true;
+
+        emit(context, name, value);
+        if (indexing) table.insert(name, value);
+    }
+
+    return {};
+}
+
+bool decoder::lookup(std::size_t index, std::string_view& name, std::string_view& value) const noexcept
+{
+    if (index == 0) return false;
+
+    if (index <= static_table.size())
+    {
+        name  = static_table[index - 1].name;
+        value = static_table[index - 1].value;
+        return true;
+    }
+
+    auto found = table.get(index - static_table.size() - 1);
+    if (!found) return false;
+
+    name  = found->name;
+    value = found->value;
+    return true;
+}
+
+encoder::encoder(std::size_t table_size)
+    : table{std::min(table_size, default_table_size)}
+    , preferred_size{table_size}
+{
+    // the decoder takes it to be default_table_size until it's told otherwise
+    if (table.capacity() < default_table_size) smallest_update = table.capacity();
+}
+
+void encoder::set_max_table_size(std::size_t size)
+{
+    auto capacity = std::min(size, preferred_size);
+    if (capacity == table.capacity()) return;
+
+    table.set_capacity(capacity);
+    smallest_update = std::min(smallest_update.value_or(capacity), capacity);
+}
+
+void encoder::encode(std::string_view name, std::string_view value, std::vector<std::byte>& block, bool sensitive)
+{
+    // If the table's been made smaller and then bigger again since the last block, the decoder has to hear about both,
+    // so it evicts what it would have.
+    if (smallest_update)
+    {
+        if (*smallest_update < table.capacity()) encode_integer(block, 0x20, 5, *smallest_update);
+        encode_integer(block, 0x20, 5, table.capacity());
+        smallest_update.reset();
+    }
+
+    if (std::ranges::any_of(name, [](char c) { return c >= 'A' && c <= 'Z'; }))
+    {
+        lowered.assign(name);
+        std::ranges::transform(lowered,
+                               lowered.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        name = lowered;
+    }
+
+    bool exact = false;
+    auto index = find_static(name, value, exact);
+    if (exact)
+    {
+        encode_integer(block, 0x80, 7, index);
+        return;
+    }
+
+    if (auto found = table.find(name, value, exact))
+    {
+        auto dynamic_index = static_table.size() + 1 + *found;
+        if (exact)
+        {
+            encode_integer(block, 0x80, 7, dynamic_index);
+            return;
+        }
+
+        if (index == 0) index = dynamic_index;
+    }
+
+    // Fields that take up more than half the table aren't worth everything they'd push out.
+    sensitive           = sensitive || is_sensitive(name, value);
+    const bool indexing = !sensitive && !is_volatile(name)
+                       && name.size() + value.size() + entry_overhead <= table.capacity() / 2;
+
+    if (sensitive) encode_integer(block, 0x10, 4, index);
+    else if (indexing) encode_integer(block, 0x40, 6, index);
+    else encode_integer(block, 0x00, 4, index);
+
+    if (index == 0) encode_string(block, name);
+    encode_string(block, value);
+
+    if (indexing) table.insert(name, value);
+}
+
+void encoder::encode(const headers& fields, std::vector<std::byte>& block)
+{
+    for (auto [name, value] : fields) encode(name, value, block);
+}
+
+}
@@ -6,7 +6,7 @@
 #include <cstdint>
 #include <expected>
 #include <memory>
-#include <ranges>
+#include <memory_resource>
 #include <span>
 #include <string>
 #include <string_view>
@@ -19,9 +19,13 @@
 #include "http/chunked_reader.hpp"
 #include "http/headers.hpp"
 #include "http/http.hpp"
+#include "http/parser.hpp"
 #include "http/request.hpp"
 #include "http/response.hpp"
 #include "io/buffered_reader.hpp"
+#include "io/buffered_writer.hpp"
+#include "io/concepts.hpp"
+#include "io/dynamic.hpp"
 #include "io/io.hpp"
 #include "io/limit_reader.hpp"
 #include "io/util.hpp"
@@ -38,16 +42,20 @@ using namespace std::string_view_literals;
 using net::url;
 using net::coro::task;
 using net::http::client_response;
+using net::http::field;
 using net::http::headers;
+using net::http::http11::request_parser;
 using net::http::parse_method;
 using net::http::parse_status;
 using net::http::protocol_version;
+using net::http::request_decoder_result;
 using net::http::request_method;
 using net::http::server_request;
 using net::http::status;
+using net::io::async_writer;
 using net::io::buffered_reader;
+using net::io::buffered_writer;
 using net::util::result;
-using net::util::split_string;
 using net::util::trim_string;
 
 result<std::uint32_t, std::errc> from_chars(std::string_view str) noexcept
@@ -116,45 +124,6 @@ task<std::error_condition> parse_status_line(buffered_reader* reader, client_res
     co_return std::error_condition{};
 }
 
-task<std::error_condition> parse_request_line(buffered_reader* reader, server_request& req) noexcept
-{
-    // TODO: max bytes to read
-
-    auto result = co_await readline(reader);
-    if (result.has_error()) co_return result.to_error();
-
-    auto line = result.to_value();
-    if (line.empty()) co_return make_error_condition(net::io::status_condition::closed);
-    auto view = static_cast<std::string_view>(line);
-
-    auto method_end = view.find(' ');
-    if (method_end == std::string_view::npos) co_return std::make_error_condition(std::errc::illegal_byte_sequence);
-
-    req.method = parse_method(view.substr(0, method_end));
-    if (req.method == request_method::NONE) co_return std::make_error_condition(std::errc::illegal_byte_sequence);
-
-    auto uri_start = method_end + 1;
-    auto uri_end   = view.find(' ', uri_start);
-    if (uri_end == std::string_view::npos) co_return std::make_error_condition(std::errc::illegal_byte_sequence);
-
-    auto uri = view.substr(uri_start, uri_end - uri_start);
-
-    // clang-format off
-    if (uri == "*")
-        req.uri.host = "*";
-    else
-        url::parse(uri)
-            .if_value([&](const url& u) { req.uri = u; })
-            .if_error([&](auto) { req.uri.path = "/"; });
-    // clang-format on
-
-    auto res = parse_http_version(view.substr(uri_end + 1));
-    if (res.has_error()) co_return res.to_error();
-    req.version = res.to_value();
-
-    co_return std::error_condition{};
-}
-
 task<std::error_condition> parse_headers(buffered_reader* reader, std::size_t max_read, headers& headers) noexcept
 {
     std::size_t amount_read = 0;
@@ -183,68 +152,164 @@ task<std::error_condition> parse_headers(buffered_reader* reader, std::size_t ma
 
         // TODO: validate key
 
-        for (auto v : split_string(val, ','))
-        {
-            headers.add(key, v);
-        }
+        headers.add(key, val);
     }
 
     co_return std::make_error_condition(std::errc::value_too_large);
 }
 
-task<std::error_condition> write_headers(net::io::writer& writer, const headers& headers) noexcept
+// set_target sets uri to what a request's target says.
+void set_target(url& uri, std::string_view target)
 {
-    for (const auto& header : headers)
+    if (target == "*"sv)
     {
-        auto res = co_await writer.write(header.first);
-        if (res.err) co_return res.err;
+        uri.host = "*";
+        return;
+    }
 
-        res = co_await writer.write(": "sv);
-        if (res.err) co_return res.err;
+    // Most targets are just a path, with nothing to decode: there's no need for the full parser for those.
+    if (target.starts_with('/') && target.find_first_of("?#%"sv) == std::string_view::npos)
+    {
+        uri.path = target;
+        return;
+    }
 
-        if (!header.second.empty())
-        {
-            res = co_await writer.write(header.second.front());
-            if (res.err) co_return res.err;
+    // clang-format off
+    url::parse(target)
+        .if_value([&](const url& u) { uri = u; })
+        .if_error([&](auto) { uri.path = "/"; });
+    // clang-format on
+}
+
+// read_head reads into reader until it has a request's whole head, and parses it in place.
+task<std::expected<std::size_t, std::error_condition>> read_head(std::allocator_arg_t,
+                                                                 std::pmr::polymorphic_allocator<> /* alloc */,
+                                                                 buffered_reader* reader,
+                                                                 request_parser&  parser)
+{
+    while (true)
+    {
+        auto data = reader->buffered();
+        auto res  = parser.parse({reinterpret_cast<const char*>(data.data()), data.size()});
+        if (!res.has_value() || *res > 0) co_return res;
 
-            for (const auto& value : std::ranges::drop_view(header.second, 1))
-            {
-                res = co_await writer.write(", "sv);
-                if (res.err) co_return res.err;
+        if (co_await reader->more() == 0)
+        {
+            auto err = reader->error();
 
-                res = co_await writer.write(value);
-                if (res.err) co_return res.err;
-            }
+            // nothing could be read, but there wasn't an error either: there's no room left for the rest of it
+            if (!err) err = std::make_error_condition(std::errc::value_too_large);
+            co_return std::unexpected(err);
         }
+    }
+}
 
-        res = co_await writer.write("\r\n"sv);
-        if (res.err) co_return res.err;
+// The body of a message is read straight out of the buffered reader its head was parsed from, through a static stack:
+// handlers see a single io::reader, and only calls to that are virtual. The stack either owns that reader, or (on a
+// server's connection, which goes on to read the next request from it) borrows it.
+template<typename Reader>
+using chunked_body = net::http::http11::basic_chunked_reader<Reader>;
+
+template<typename Reader>
+using limited_body = net::io::basic_limit_reader<Reader>;
+
+//
+// erase puts the stack behind that interface, e.g. with net::io::make_dynamic_reader.
+template<typename Reader, typename Erase>
+auto make_body(const headers& headers, Reader reader, Erase erase)
+{
+    if (headers.is_chunked()) return erase(chunked_body<Reader>{std::move(reader)});
+
+    const std::size_t content_length = headers.get_content_length().value_or(0);
+    return erase(limited_body<Reader>{std::move(reader), content_length});
+}
+
+// decode_request is request_decode, for a reader that's either owned or borrowed.
+template<typename Reader>
+task<request_decoder_result> decode_request(std::allocator_arg_t,
+                                            std::pmr::polymorphic_allocator<> alloc,
+                                            Reader                            reader,
+                                            std::size_t                       max_header_bytes) noexcept
+{
+    auto& buffered = net::io::detail::deref(reader);
+
+    request_parser parser{max_header_bytes, alloc};
+
+    auto head_length = co_await read_head(std::allocator_arg, alloc, &buffered, parser);
+    if (!head_length.has_value()) co_return std::unexpected(head_length.error());
+
+    // The head is parsed in place, so what's kept of it has to be copied out before it's consumed.
+    const auto& head = parser.head();
+
+    server_request req{.headers = headers{alloc}, .arrived_at = {}};
+
+    req.method = parse_method(head.method);
+    if (req.method == request_method::NONE)
+    {
+        co_return std::unexpected(std::make_error_condition(std::errc::illegal_byte_sequence));
     }
 
-    co_return std::error_condition{};
+    req.version = head.version;
+    set_target(req.uri, head.target);
+
+    req.headers.reserve(head.fields.size(), *head_length);
+    for (const auto& f : head.fields) req.headers.add(f.name, f.value);
+
+    buffered.consume(*head_length);
+
+    if (req.uri.host.empty()) req.uri.host = req.headers.get(field::host).value_or(""sv);
+
+    req.body = make_body(req.headers,
+                         std::move(reader),
+                         [&](auto&& body) { return net::io::make_dynamic_reader(alloc, std::move(body)); });
+
+    // TODO: trailers
+
+    co_return req;
 }
 
+template<async_writer Writer>
+task<net::io::result> write_text(Writer& writer, std::string_view text)
+{
+    return writer.write(std::as_bytes(std::span{text}));
 }
 
-namespace net::http::http11
+template<async_writer Writer>
+task<std::error_condition> write_headers(Writer& writer, const headers& headers) noexcept
 {
+    for (auto [name, value] : headers)
+    {
+        auto res = co_await write_text(writer, name);
+        if (res.err) co_return res.err;
 
-using coro::task;
+        res = co_await write_text(writer, ": "sv);
+        if (res.err) co_return res.err;
 
-task<request_encoder_result> request_encode(io::writer* writer, const client_request& req) noexcept
+        res = co_await write_text(writer, value);
+        if (res.err) co_return res.err;
+
+        res = co_await write_text(writer, "\r\n"sv);
+        if (res.err) co_return res.err;
+    }
+
+    co_return std::error_condition{};
+}
+
+template<async_writer Writer>
+task<std::error_condition> encode_request(Writer& writer, const net::http::client_request& req) noexcept
 {
-    auto res = co_await writer->write(method_string(req.method));
-    if (res.err) co_return std::unexpected(res.err);
+    auto res = co_await write_text(writer, method_string(req.method));
+    if (res.err) co_return res.err;
 
-    res = co_await writer->write(' ');
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, " "sv);
+    if (res.err) co_return res.err;
 
     // TODO: don't build the uri before writing it
-    res = co_await writer->write(req.uri.build());
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, req.uri.build());
+    if (res.err) co_return res.err;
 
-    res = co_await writer->write(" HTTP/"sv);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, " HTTP/"sv);
+    if (res.err) co_return res.err;
 
     auto major_version = req.version.major;
     auto minor_version = req.version.minor;
@@ -261,27 +326,27 @@ task<request_encoder_result> request_encode(io::writer* writer, const client_req
         ' ',
     };
 
-    res = co_await writer->write(version_buf);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, {version_buf.data(), version_buf.size()});
+    if (res.err) co_return res.err;
 
-    res = co_await writer->write("\r\n"sv);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, "\r\n"sv);
+    if (res.err) co_return res.err;
 
-    res.err = co_await write_headers(*writer, req.headers);
-    if (res.err) co_return std::unexpected(res.err);
+    if (auto err = co_await write_headers(writer, req.headers); err) co_return err;
 
-    res = co_await writer->write("\r\n"sv);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, "\r\n"sv);
+    if (res.err) co_return res.err;
 
     // TODO: copy req.body to writer
 
-    co_return writer;
+    co_return std::error_condition{};
 }
 
-task<response_encoder_result> response_encode(io::writer* writer, const server_response& resp) noexcept
+template<async_writer Writer>
+task<std::error_condition> encode_response(Writer& writer, const net::http::server_response& resp) noexcept
 {
-    auto res = co_await writer->write("HTTP/"sv);
-    if (res.err) co_return std::unexpected(res.err);
+    auto res = co_await write_text(writer, "HTTP/"sv);
+    if (res.err) co_return res.err;
 
     std::array<char, 4> version_buf{
         static_cast<char>(resp.version.major + '0'),
@@ -290,50 +355,66 @@ task<response_encoder_result> response_encode(io::writer* writer, const server_r
         ' ',
     };
 
-    res = co_await writer->write(version_buf);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, {version_buf.data(), version_buf.size()});
+    if (res.err) co_return res.err;
 
-    res = co_await writer->write(status_text(resp.status_code));
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, status_text(resp.status_code));
+    if (res.err) co_return res.err;
 
-    res = co_await writer->write("\r\n"sv);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, "\r\n"sv);
+    if (res.err) co_return res.err;
 
-    res.err = co_await write_headers(*writer, resp.headers);
-    if (res.err) co_return std::unexpected(res.err);
+    if (auto err = co_await write_headers(writer, resp.headers); err) co_return err;
 
-    res = co_await writer->write("\r\n"sv);
-    if (res.err) co_return std::unexpected(res.err);
+    res = co_await write_text(writer, "\r\n"sv);
+    if (res.err) co_return res.err;
 
-    co_return writer;
+    co_return std::error_condition{};
 }
 
-task<request_decoder_result> request_decode(std::unique_ptr<io::buffered_reader> reader,
-                                            std::size_t                          max_header_bytes) noexcept
+}
+
+namespace net::http::http11
 {
-    server_request req;
 
-    auto err = co_await parse_request_line(reader.get(), req);
-    if (err) co_return std::unexpected(err);
+using coro::task;
+
+// The head of a message is written as lots of small pieces, so when writer is the usual buffered_writer, they're
+// written to it directly instead of each going through a virtual call.
+
+task<request_encoder_result> request_encode(io::writer* writer, const client_request& req) noexcept
+{
+    auto* buffered = dynamic_cast<io::buffered_writer*>(writer);
 
-    err = co_await parse_headers(reader.get(), max_header_bytes, req.headers);
+    auto err = buffered != nullptr ? co_await encode_request(*buffered, req) : co_await encode_request(*writer, req);
     if (err) co_return std::unexpected(err);
 
-    if (req.uri.host.empty()) req.uri.host = req.headers.get("Host"sv).value_or(""sv);
+    co_return writer;
+}
 
-    if (req.headers.is_chunked())
-    {
-        req.body = std::make_unique<chunked_reader>(std::move(reader));
-    }
-    else
-    {
-        std::size_t content_length = req.headers.get_content_length().value_or(0);
-        req.body                   = std::make_unique<io::limit_reader>(std::move(reader), content_length);
-    }
+task<response_encoder_result> response_encode(io::writer* writer, const server_response& resp) noexcept
+{
+    auto* buffered = dynamic_cast<io::buffered_writer*>(writer);
 
-    // TODO: trailers
+    auto err = buffered != nullptr ? co_await encode_response(*buffered, resp)
+                                   : co_await encode_response(*writer, resp);
+    if (err) co_return std::unexpected(err);
 
-    co_return req;
+    co_return writer;
+}
+
+task<request_decoder_result> request_decode(std::allocator_arg_t,
+                                            std::pmr::polymorphic_allocator<> alloc,
+                                            io::buffered_reader*              reader,
+                                            std::size_t                       max_header_bytes) noexcept
+{
+    return decode_request(std::allocator_arg, alloc, reader, max_header_bytes);
+}
+
+task<request_decoder_result> request_decode(std::unique_ptr<io::buffered_reader> reader,
+                                            std::size_t                          max_header_bytes) noexcept
+{
+    return decode_request(std::allocator_arg, {}, std::move(reader), max_header_bytes);
 }
 
 coro::task<response_decoder_result> response_decode(std::unique_ptr<io::buffered_reader> reader,
@@ -345,15 +426,9 @@ coro::task<response_decoder_result> response_decode(std::unique_ptr<io::buffered
     if (auto err = co_await parse_headers(reader.get(), max_header_bytes, resp.headers); err)
         co_return std::unexpected(err);
 
-    if (resp.headers.is_chunked())
-    {
-        resp.body = std::make_unique<chunked_reader>(std::move(reader));
-    }
-    else
-    {
-        const std::size_t content_length = resp.headers.get_content_length().value_or(0);
-        resp.body                        = std::make_unique<io::limit_reader>(std::move(reader), content_length);
-    }
+    resp.body = make_body(resp.headers,
+                          std::move(reader),
+                          [](auto&& body) { return net::io::make_dynamic_reader(std::move(body)); });
 
     // TODO: trailers
 
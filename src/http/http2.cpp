@@ -1,28 +1,53 @@
 #include "http/http2.hpp"
 
+#include <algorithm>
 #include <array>
+#include <charconv>
+#include <chrono>
+#include <coroutine>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
 #include <expected>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
 
 #include "coro/task.hpp"
+#include "encoding/base64.hpp"
+#include "http/headers.hpp"
+#include "http/hpack.hpp"
 #include "http/request.hpp"
 #include "http/response.hpp"
+#include "http/router.hpp"
 #include "io/buffered_reader.hpp"
+#include "io/io.hpp"
+#include "io/reader.hpp"
 #include "io/writer.hpp"
-#include "util/packed.hpp"
-#include "util/result.hpp"
+#include "socket.hpp"
+#include "url.hpp"
+#include "util/arena.hpp"
+#include "util/string_util.hpp"
 
 namespace net::http::http2
 {
 
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
 using coro::task;
 using net::http::client_request;
 using net::http::server_response;
-using util::result;
 
 // https://httpwg.org/specs/rfc9113.html#ErrorCodes
 // Unknown or unsupported error codes MUST NOT trigger any special behavior.
@@ -69,47 +94,6 @@ enum class frame_flags : std::uint8_t
     PRIORITY    = 0x20,
 };
 
-struct NET_PACKED frame_header
-{
-    std::uint32_t length : 24;
-    frame_type    type;
-    frame_flags   flags;
-    std::uint32_t _                 : 1;
-    std::uint32_t stream_identifier : 31;
-};
-
-static_assert(sizeof(frame_header) == 9);
-
-struct NET_PACKED data_frame
-{
-    std::uint8_t pad_length; // only present if PADDED is set.
-    // data...
-    // ...padding;
-};
-
-struct NET_PACKED headers_frame
-{
-    std::uint8_t  pad_length;             // only present if PADDED is set.
-    std::uint32_t exclusive         : 1;  // only present if PRIORITY is set.
-    std::uint32_t stream_dependency : 31; // only present if PRIORITY is set.
-    std::uint8_t  weight;                 // only present if PRIORITY is set.
-    // field_block_fragment fragment;
-    // padding...
-};
-
-// NOTE: priority_frame is deprecated.
-struct NET_PACKED priority_frame
-{
-    std::uint32_t exclusive         : 1;
-    std::uint32_t stream_dependency : 31;
-    std::uint8_t  weight;
-};
-
-struct NET_PACKED rst_stream_frame
-{
-    enum error_code error_code;
-};
-
 // From: https://httpwg.org/specs/rfc9113.html#SettingValues
 // NOTE: unknown ids must be ignored
 // NOLINTNEXTLINE(performance-enum-size, "size defined by RFC")
@@ -123,51 +107,6 @@ enum class setting_id : std::uint16_t
     SETTINGS_MAX_HEADER_LIST_SIZE   = 0x06,
 };
 
-struct NET_PACKED setting
-{
-    setting_id    identifier;
-    std::uint32_t value;
-};
-
-struct NET_PACKED settings_frame
-{
-    std::span<setting> settings;
-};
-
-struct NET_PACKED push_promise_frame
-{
-    std::uint8_t  pad_length;             // only present if PADDED is set.
-    std::uint32_t _                 : 1;  // RESERVED
-    std::uint32_t stream_dependency : 31; // only present if PRIORITY is set.
-    // field_block_fragment_id fragment_id;
-    // padding...
-};
-
-struct NET_PACKED ping_frame
-{
-    std::array<std::byte, 8> opaque_data;
-};
-
-struct NET_PACKED goaway_frame
-{
-    std::uint32_t   _              : 1;
-    std::uint32_t   last_stream_id : 31;
-    enum error_code error_code;
-    // additional debug data
-};
-
-struct NET_PACKED window_update_frame
-{
-    std::uint32_t _                     : 1;
-    std::uint32_t window_size_increment : 31;
-};
-
-struct NET_PACKED continuation_frame{
-    // field_block_fragment fragment;
-};
-
-// TODO: psuedo-headers
-
 // https://httpwg.org/specs/rfc9113.html#StreamStates
 // idle:
 //   recv PUSH_PROMISE -> reserved (remote)
@@ -214,35 +153,1484 @@ enum class stream_state
     closed,
 };
 
-struct stream
+namespace
+{
+
+constexpr std::size_t   frame_header_size = 9;
+constexpr std::uint32_t default_window    = 65'535;
+constexpr std::uint32_t max_window        = 0x7fff'ffff;
+
+// Handlers sending DATA hold off while there's more than this waiting to be written, until it has been - and so does
+// the loop, before it reads any more.
+constexpr std::size_t max_pending_output = 256ull * 1'024;
+
+constexpr std::uint8_t flag(frame_flags f) noexcept { return static_cast<std::uint8_t>(f); }
+
+// frame is a frame's header: https://httpwg.org/specs/rfc9113.html#FrameHeader
+struct frame
+{
+    std::uint32_t length;
+    frame_type    type;
+    std::uint8_t  flags;
+    std::uint32_t stream_id;
+
+    [[nodiscard]] bool has(frame_flags f) const noexcept { return (flags & flag(f)) != 0; }
+};
+
+std::uint32_t read_u32(std::span<const std::byte> data) noexcept
+{
+    return (std::to_integer<std::uint32_t>(data[0]) << 24U) | (std::to_integer<std::uint32_t>(data[1]) << 16U)
+         | (std::to_integer<std::uint32_t>(data[2]) << 8U) | std::to_integer<std::uint32_t>(data[3]);
+}
+
+frame read_frame_header(std::span<const std::byte> data) noexcept
+{
+    return {
+        .length = (std::to_integer<std::uint32_t>(data[0]) << 16U) | (std::to_integer<std::uint32_t>(data[1]) << 8U)
+                | std::to_integer<std::uint32_t>(data[2]),
+        .type      = static_cast<frame_type>(data[3]),
+        .flags     = std::to_integer<std::uint8_t>(data[4]),
+        .stream_id = read_u32(data.subspan(5)) & max_window, // without the reserved bit
+    };
+}
+
+void put_u32(std::vector<std::byte>& out, std::uint32_t value)
+{
+    out.push_back(static_cast<std::byte>(value >> 24U));
+    out.push_back(static_cast<std::byte>(value >> 16U));
+    out.push_back(static_cast<std::byte>(value >> 8U));
+    out.push_back(static_cast<std::byte>(value));
+}
+
+void put_frame_header(std::vector<std::byte>& out,
+                      std::size_t             length,
+                      frame_type              type,
+                      std::uint8_t            flags,
+                      std::uint32_t           stream_id)
+{
+    out.push_back(static_cast<std::byte>(length >> 16U));
+    out.push_back(static_cast<std::byte>(length >> 8U));
+    out.push_back(static_cast<std::byte>(length));
+    out.push_back(static_cast<std::byte>(type));
+    out.push_back(static_cast<std::byte>(flags));
+    put_u32(out, stream_id);
+}
+
+// strip_padding takes the padding off a DATA or HEADERS frame's payload, and returns false if there's more padding
+// than payload.
+bool strip_padding(const frame& f, std::span<const std::byte>& payload) noexcept
+{
+    if (!f.has(frame_flags::PADDED)) return true;
+    if (payload.empty()) return false;
+
+    auto padding = std::to_integer<std::size_t>(payload.front());
+    if (padding >= payload.size()) return false;
+
+    payload = payload.subspan(1, payload.size() - 1 - padding);
+    return true;
+}
+
+// is_connection_specific returns whether name is a field that's only about one HTTP/1.1 connection, which HTTP/2
+// doesn't have: https://httpwg.org/specs/rfc9113.html#ConnectionSpecific
+bool is_connection_specific(std::string_view name) noexcept
 {
-    stream_state state;
-    std::int64_t window;
+    return util::equal_ignore_case(name, "connection"sv) || util::equal_ignore_case(name, "keep-alive"sv)
+        || util::equal_ignore_case(name, "proxy-connection"sv) || util::equal_ignore_case(name, "transfer-encoding"sv)
+        || util::equal_ignore_case(name, "upgrade"sv);
+}
+
+// set_target sets uri to what a request's :path says.
+void set_target(url& uri, std::string_view target)
+{
+    // Most targets are just a path, with nothing to decode: there's no need for the full parser for those.
+    if (target.starts_with('/') && target.find_first_of("?#%"sv) == std::string_view::npos)
+    {
+        uri.path = target;
+        return;
+    }
+
+    // clang-format off
+    url::parse(target)
+        .if_value([&](const url& u) { uri.path = u.path; uri.query = u.query; uri.fragment = u.fragment; })
+        .if_error([&](auto) { uri.path = "/"; });
+    // clang-format on
+}
+
+class session;
+struct stream;
+
+// stream_reader reads a request's body, as it comes in on its stream.
+class stream_reader final : public io::reader
+{
+public:
+    explicit stream_reader(stream& owner) noexcept
+        : owner{&owner}
+    {}
+
+    coro::task<io::result> read(std::span<std::byte> data) override;
+
+    using io::reader::read;
+
+    [[nodiscard]] int native_handle() const noexcept override { return -1; }
+
+private:
+    stream* owner;
 };
 
-struct connection
+// stream_writer sends a response on its stream: its head in HEADERS, and its body in DATA, as the client makes room.
+class stream_writer final : public io::writer
 {
-    std::unordered_map<std::uint32_t, stream> streams;
+public:
+    explicit stream_writer(stream& owner) noexcept
+        : owner{&owner}
+    {}
+
+    coro::task<io::result> write(std::span<const std::byte> data) override;
+
+    using io::writer::write;
 
-    // The following are from: https://httpwg.org/specs/rfc9113.html#SettingValues
-    std::uint32_t header_table_size; // Default is 4096.
-    bool          push_enabled;
-    std::uint32_t max_concurrent_streams; // Default is no limit. Should be no smaller than 100. 0 is not special.
-    std::uint32_t initial_window_size;    // Default is 65535.
-    std::uint32_t max_frame_size;         // Default is 16384. Must be between that and 16777215.
-    std::uint32_t max_header_list_size;   // Default is unlimited.
+    std::error_condition send_head(const server_response& resp);
+
+    [[nodiscard]] int native_handle() const noexcept override { return -1; }
+
+private:
+    stream* owner;
 };
 
-task<request_encoder_result> request_encode(io::writer* writer, const client_request& req) noexcept {}
+// stream is one request and its response, from the request's HEADERS coming in until its handler's done.
+struct stream
+{
+    stream(session& owner, std::uint32_t id, std::int64_t send_window, std::int64_t recv_window);
+
+    session&      owner;
+    std::uint32_t id;
+    stream_state  state = stream_state::open;
+    bool          reset = false; // by either end
+
+    // how much may be sent before the client makes room for more, and how much the client may send before we do
+    std::int64_t send_window;
+    std::int64_t recv_window;
+
+    // read by the handler, but not given back to the client yet
+    std::size_t unacked = 0;
+
+    // everything to do with the request and its response comes out of the arena
+    util::arena           arena;
+    stream_writer         writer{*this};
+    server_request        request;
+    const server_request* req = &request;
+    server_response       response;
+
+    // what's come in of the request's body, and how much of that the handler's read
+    std::vector<std::byte> inbox;
+    std::size_t            inbox_read = 0;
 
-task<response_encoder_result> response_encode(io::writer* writer, const server_response& resp) noexcept {}
+    bool                       head_sent = false;
+    std::optional<std::size_t> content_length;
+    std::size_t                sent = 0;
 
-task<request_decoder_result> request_decode(std::unique_ptr<io::buffered_reader> reader,
-                                            std::size_t                          max_header_bytes) noexcept
+    // The handler, and where it's waiting for the client: to send more of the request's body, or to make room for more
+    // of the response's. Only the connection's loop resumes it from there.
+    coro::task<>            handler;
+    std::coroutine_handle<> waiting_for_body;
+    std::coroutine_handle<> waiting_for_room;
+    bool                    done = false;
+
+    [[nodiscard]] bool received_all() const noexcept
+    {
+        return state == stream_state::half_closed_remote || state == stream_state::closed;
+    }
+
+    [[nodiscard]] bool sent_all() const noexcept
+    {
+        return state == stream_state::half_closed_local || state == stream_state::closed;
+    }
+
+    void end_receiving() noexcept
+    {
+        state = state == stream_state::half_closed_local ? stream_state::closed : stream_state::half_closed_remote;
+    }
+
+    void end_sending() noexcept
+    {
+        state = state == stream_state::half_closed_remote ? stream_state::closed : stream_state::half_closed_local;
+    }
+};
+
+stream::stream(session& owner, std::uint32_t id, std::int64_t send_window, std::int64_t recv_window)
+    : owner{owner}
+    , id{id}
+    , send_window{send_window}
+    , recv_window{recv_window}
+    , request{.headers = headers{&arena}, .arrived_at = {}}
+    , response{.version = {2, 0}, .headers = headers{&arena}, .body = &writer}
 {}
 
-task<response_decoder_result> response_decode(std::unique_ptr<io::buffered_reader> reader,
-                                              std::size_t                          max_header_bytes) noexcept
+// session is an HTTP/2 connection being served.
+//
+// The loop (see run) reads frames, and deals with a whole batch of them at a time. It starts each request's handler
+// as soon as its HEADERS are in, and resumes handlers as what they're waiting for comes in. Handlers run until they
+// next wait, and then the loop carries on - so it's one thread at a time, like an HTTP/1.1 connection, unless a
+// handler waits on something else, and is resumed elsewhere.
+//
+// Everything that's sent - control frames, and whatever handlers send - is queued in out, and written by the sender
+// (see send), which is all that writes to the connection. It writes through a duplicate of the socket, so it can wait
+// for the client to make room while the loop waits for the client to send more. Whoever queues something has the
+// scheduler resume the sender, if it's waiting for something to send.
+//
+// mu guards everything a handler and the loop can both get at. The streams themselves are only added and removed by the
+// loop.
+class session
+{
+public:
+    session(socket& sock, io::buffered_reader& reader, const router& handler, const server_options& options);
+
+    task<std::error_condition> run(const server_request* upgraded);
+
+    // for the streams' readers and writers, from their handlers
+    task<io::result>     read_body(stream& st, std::span<std::byte> data);
+    task<io::result>     write_body(stream& st, std::span<const std::byte> data);
+    std::error_condition send_head(stream& st, const server_response& resp);
+
+private:
+    // until waits for ready() to hold, and is checked again each time the loop resumes it from slot.
+    template<typename Ready>
+    struct until
+    {
+        session&                 self;
+        std::coroutine_handle<>& slot;
+        Ready                    ready;
+
+        [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> waiter)
+        {
+            std::lock_guard lock{self.mu};
+            if (ready()) return false;
+
+            slot = waiter;
+            return true;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    template<typename Ready>
+    until<Ready> wait(std::coroutine_handle<>& slot, Ready ready)
+    {
+        return {*this, slot, std::move(ready)};
+    }
+
+    // finished marks a stream's handler done, once it's suspended for good, and resumes the loop if it's the last one
+    // the loop's waiting for. The loop can then free it whenever it likes.
+    struct finished
+    {
+        session& self;
+        stream&  st;
+
+        [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> /* handler */) noexcept
+        {
+            std::coroutine_handle<> next = std::noop_coroutine();
+            {
+                std::lock_guard lock{self.mu};
+                st.done = true;
+                if (--self.running == 0 && self.drained_loop != nullptr)
+                {
+                    next = std::exchange(self.drained_loop, nullptr);
+                }
+            }
+
+            return next;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    // drained waits for every handler to be finished.
+    struct drained
+    {
+        session& self;
+
+        [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> loop)
+        {
+            std::lock_guard lock{self.mu};
+            if (self.running == 0) return false;
+
+            self.drained_loop = loop;
+            return true;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    // stopped marks the sender done, once it's suspended for good, and resumes the loop if it's waiting for that.
+    struct stopped
+    {
+        session& self;
+
+        [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> /* sender */) noexcept
+        {
+            std::lock_guard lock{self.mu};
+            self.sender_done = true;
+
+            auto next = std::exchange(self.loop_waiting, nullptr);
+            return next != nullptr ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    task<bool> read_preface();
+    task<bool> receive();
+
+    // send writes whatever's queued, as it's queued, until the loop stops it.
+    task<> send();
+
+    // process deals with every whole frame that's been read.
+    error_code process();
+    error_code handle(const frame& f, std::span<const std::byte> payload);
+    error_code on_data(const frame& f, std::span<const std::byte> payload);
+    error_code on_headers(const frame& f, std::span<const std::byte> payload);
+    error_code on_continuation(const frame& f, std::span<const std::byte> payload);
+    error_code on_header_block(std::uint32_t id, std::uint8_t flags, std::span<const std::byte> block);
+    error_code on_reset(const frame& f, std::span<const std::byte> payload);
+    error_code on_settings(const frame& f, std::span<const std::byte> payload);
+    error_code on_ping(const frame& f, std::span<const std::byte> payload);
+    error_code on_window_update(const frame& f, std::span<const std::byte> payload);
+    error_code apply_settings(std::span<const std::byte> payload);
+    error_code open_upgraded(const server_request& req);
+
+    task<> respond(std::allocator_arg_t, std::pmr::polymorphic_allocator<> alloc, stream& st);
+    void   start_handlers();
+    void   finish(stream& st);
+    void   reap();
+
+    // notify_sender has the scheduler resume the sender, if it's waiting and there's something to send.
+    void notify_sender();
+
+    // Frames are queued in out, with mu held.
+    void queue_settings();
+    void queue_window_update(std::uint32_t id, std::size_t increment);
+    void queue_head(std::uint32_t id, status code, const headers* fields, bool end_stream);
+    void queue_block(std::uint32_t id, std::span<const std::byte> block, bool end_stream);
+    void queue_data(std::uint32_t id, std::span<const std::byte> data, bool end_stream);
+    void queue_reset(std::uint32_t id, error_code code);
+    void queue_goaway(error_code code);
+
+    // give_back makes room for count more bytes from the client, once it's done with that many. Window updates are
+    // only sent once there's a good bit to give back, to save on frames.
+    void give_back(stream* st, std::size_t count);
+
+    // reset resets st, and wakes its handler up to find out.
+    void reset(stream& st, error_code code);
+
+    // wake and wake_writers have handlers resumed by the loop, once it's let go of mu. wake_writers only wakes those
+    // that can send something now.
+    void wake(std::coroutine_handle<>& slot);
+    void wake_writers();
+    void resume_woken();
+
+    // room is how much of st's response may be queued right now.
+    [[nodiscard]] std::int64_t room(const stream& st) const noexcept;
+
+    socket&                         sock;
+    io::buffered_reader&            reader;
+    const router&                   handler;
+    const server_options&           options;
+    std::shared_ptr<spdlog::logger> logger;
+
+    std::mutex mu;
+
+    settings       remote;
+    hpack::decoder decoder;
+    hpack::encoder encoder;
+
+    std::unordered_map<std::uint32_t, std::unique_ptr<stream>> streams;
+    std::uint32_t                                              last_stream_id = 0;
+    std::vector<stream*>                                       starting;
+    bool                                                       got_settings = false;
+
+    // a header block that's still coming in CONTINUATION frames
+    std::uint32_t          header_stream = 0;
+    std::uint8_t           header_flags  = 0;
+    std::vector<std::byte> header_block;
+    std::vector<std::byte> head_scratch;
+
+    // the connection's own flow control windows, and what's been read but not given back yet
+    std::int64_t send_window = default_window;
+    std::int64_t recv_window = default_window;
+    std::size_t  unacked     = 0;
+
+    std::vector<std::byte> out;
+    std::vector<std::byte> sending;
+    bool                   closing   = false;
+    bool                   peer_gone = false;
+
+    // the sender, where it waits for something to send, and why it couldn't
+    socket                  send_sock;
+    io::scheduler*          scheduler;
+    task<>                  sender;
+    std::coroutine_handle<> sender_idle;
+    std::error_condition    send_err;
+    bool                    stopping    = false;
+    bool                    sender_done = false;
+
+    // where the loop waits for the sender: to make room in out, or to be done
+    std::coroutine_handle<> loop_waiting;
+
+    std::vector<std::coroutine_handle<>> woken;
+
+    std::size_t             running = 0;
+    std::coroutine_handle<> drained_loop;
+};
+
+coro::task<io::result> stream_reader::read(std::span<std::byte> data)
+{
+    return owner->owner.read_body(*owner, data);
+}
+
+coro::task<io::result> stream_writer::write(std::span<const std::byte> data)
+{
+    return owner->owner.write_body(*owner, data);
+}
+
+std::error_condition stream_writer::send_head(const server_response& resp)
+{
+    return owner->owner.send_head(*owner, resp);
+}
+
+session::session(socket& sock, io::buffered_reader& reader, const router& handler, const server_options& options)
+    : sock{sock}
+    , reader{reader}
+    , handler{handler}
+    , options{options}
+    , logger{options.logger}
+    , decoder{options.local.header_table_size}
+    , send_sock{sock.duplicate()}
+    , scheduler{sock.get_scheduler()}
 {}
 
+task<std::error_condition> session::run(const server_request* upgraded)
+{
+    auto failure = error_code::NO_ERROR;
+    {
+        std::lock_guard lock{mu};
+        queue_settings();
+        if (options.connection_window > default_window)
+        {
+            queue_window_update(0, options.connection_window - default_window);
+            recv_window = options.connection_window;
+        }
+
+        if (upgraded != nullptr) failure = open_upgraded(*upgraded);
+    }
+
+    sender = send();
+    sender.get_handle().resume();
+
+    start_handlers();
+
+    bool preface = false;
+    while (failure == error_code::NO_ERROR)
+    {
+        if (!preface)
+        {
+            auto got = reader.buffered().first(std::min(reader.buffered().size(), client_preface.size()));
+            if (!std::ranges::equal(got, std::as_bytes(std::span{client_preface}).first(got.size())))
+            {
+                logger->debug("http2: bad client preface");
+                failure = error_code::PROTOCOL_ERROR;
+                break;
+            }
+
+            if (got.size() == client_preface.size())
+            {
+                reader.consume(client_preface.size());
+                preface = true;
+            }
+        }
+
+        if (preface) failure = process();
+        reap();
+        notify_sender();
+
+        // A client that doesn't read what it's sent doesn't get to have more and more queued up for it.
+        co_await wait(loop_waiting, [&] { return out.size() < max_pending_output || send_err; });
+        if (send_err)
+        {
+            logger->debug("http2: error sending: {}", send_err.message());
+            break;
+        }
+
+        if (failure != error_code::NO_ERROR || (peer_gone && streams.empty())) break;
+        if (!co_await receive()) break;
+    }
+
+    if (failure != error_code::NO_ERROR)
+    {
+        logger->debug("http2: connection error {}", static_cast<std::uint32_t>(failure));
+    }
+
+    // Whatever's still running finds its stream closed, next time it reads or writes, and it's waited for.
+    {
+        std::lock_guard lock{mu};
+        closing = true;
+        queue_goaway(failure);
+        for (auto& [id, st] : streams)
+        {
+            wake(st->waiting_for_body);
+            wake(st->waiting_for_room);
+        }
+    }
+
+    resume_woken();
+    co_await drained{*this};
+
+    // the client may well have gone, in which case there's no one to tell
+    {
+        std::lock_guard lock{mu};
+        streams.clear();
+        stopping = true;
+        wake(sender_idle);
+    }
+
+    resume_woken();
+    while (true)
+    {
+        {
+            std::lock_guard lock{mu};
+            if (sender_done) break;
+        }
+
+        co_await wait(loop_waiting, [&] { return sender_done; });
+    }
+
+    if (failure != error_code::NO_ERROR) co_return std::make_error_condition(std::errc::protocol_error);
+    if (peer_gone) co_return std::error_condition{};
+    if (send_err) co_return send_err;
+    co_return reader.error();
+}
+
+task<bool> session::receive()
+{
+    // a connection without any streams open is idle, and only kept for so long
+    bool idle = false;
+    {
+        std::lock_guard lock{mu};
+        idle = streams.empty();
+    }
+
+    if (idle && options.idle_timeout > 0ms) sock.set_read_deadline(socket::clock::now() + options.idle_timeout);
+    auto got = co_await reader.more();
+    sock.set_read_deadline(socket::clock::time_point::max());
+
+    co_return got > 0;
+}
+
+task<> session::send()
+{
+    while (true)
+    {
+        co_await wait(sender_idle, [&] { return !out.empty() || stopping; });
+        {
+            std::lock_guard lock{mu};
+
+            // once the connection's broken, there's no one to send anything to
+            if (send_err) out.clear();
+
+            if (out.empty())
+            {
+                if (stopping) break;
+                continue;
+            }
+
+            sending.swap(out);
+        }
+
+        auto res = co_await send_sock.write(sending);
+        {
+            std::lock_guard lock{mu};
+            sending.clear();
+
+            if (res.err)
+            {
+                send_err = res.err;
+                closing  = true;
+                for (auto& [id, st] : streams) wake(st->waiting_for_body);
+            }
+
+            // sending made room, for handlers waiting to queue more, and for the loop
+            wake_writers();
+            if (!stopping) wake(loop_waiting);
+        }
+
+        // The loop may well be waiting for the client, who isn't there anymore: this has it find out.
+        if (res.err) ::shutdown(send_sock.native_handle(), SHUT_RDWR);
+
+        resume_woken();
+    }
+
+    co_await stopped{*this};
+}
+
+void session::notify_sender()
+{
+    std::coroutine_handle<> idle;
+    {
+        std::lock_guard lock{mu};
+        if (out.empty()) return;
+        idle = std::exchange(sender_idle, nullptr);
+    }
+
+    // on one of the scheduler's threads, rather than whoever's queued something
+    if (idle != nullptr && !scheduler->resume(idle)) idle.resume();
+}
+
+error_code session::process()
+{
+    auto data    = reader.buffered();
+    auto used    = std::size_t{0};
+    auto failure = error_code::NO_ERROR;
+    {
+        std::lock_guard lock{mu};
+        while (data.size() - used >= frame_header_size)
+        {
+            auto f = read_frame_header(data.subspan(used));
+            if (f.length > options.local.max_frame_size)
+            {
+                failure = error_code::FRAME_SIZE_ERROR;
+                break;
+            }
+
+            if (data.size() - used - frame_header_size < f.length) break;
+
+            auto payload = data.subspan(used + frame_header_size, f.length);
+            used += frame_header_size + f.length;
+
+            // the client's first frame has to be its SETTINGS
+            if (!got_settings && f.type != frame_type::SETTINGS)
+            {
+                failure = error_code::PROTOCOL_ERROR;
+                break;
+            }
+
+            got_settings = true;
+            failure      = handle(f, payload);
+            if (failure != error_code::NO_ERROR) break;
+        }
+    }
+
+    reader.consume(used);
+
+    start_handlers();
+    resume_woken();
+    return failure;
+}
+
+error_code session::handle(const frame& f, std::span<const std::byte> payload)
+{
+    // a header block can't be interrupted, not even by frames for other streams
+    if (header_stream != 0 && f.type != frame_type::CONTINUATION) return error_code::PROTOCOL_ERROR;
+
+    switch (f.type)
+    {
+    case frame_type::DATA: return on_data(f, payload);
+    case frame_type::HEADERS: return on_headers(f, payload);
+    case frame_type::CONTINUATION: return on_continuation(f, payload);
+    case frame_type::RST_STREAM: return on_reset(f, payload);
+    case frame_type::SETTINGS: return on_settings(f, payload);
+    case frame_type::PING: return on_ping(f, payload);
+    case frame_type::WINDOW_UPDATE: return on_window_update(f, payload);
+
+    case frame_type::PRIORITY:
+        // Priorities are only a hint, and this one's ignored.
+        if (f.stream_id == 0) return error_code::PROTOCOL_ERROR;
+        if (f.length != 5) queue_reset(f.stream_id, error_code::FRAME_SIZE_ERROR);
+        return error_code::NO_ERROR;
+
+    case frame_type::GOAWAY:
+        if (f.stream_id != 0) return error_code::PROTOCOL_ERROR;
+        peer_gone = true;
+        return error_code::NO_ERROR;
+
+    // clients can't push
+    case frame_type::PUSH_PROMISE: return error_code::PROTOCOL_ERROR;
+
+    // frames of unknown types are to be ignored
+    default: return error_code::NO_ERROR;
+    }
+}
+
+error_code session::on_data(const frame& f, std::span<const std::byte> payload)
+{
+    if (f.stream_id == 0) return error_code::PROTOCOL_ERROR;
+
+    // the whole frame counts against flow control, padding and all
+    if (f.length > recv_window) return error_code::FLOW_CONTROL_ERROR;
+    recv_window -= f.length;
+
+    if (!strip_padding(f, payload)) return error_code::PROTOCOL_ERROR;
+
+    auto it = streams.find(f.stream_id);
+    if (it == streams.end() || it->second->received_all() || it->second->reset)
+    {
+        give_back(nullptr, f.length);
+        if (f.stream_id > last_stream_id) return error_code::PROTOCOL_ERROR;
+
+        // Streams that have been reset may still have data on the way; those that are gone have been for a while.
+        if (it != streams.end() && !it->second->reset) reset(*it->second, error_code::STREAM_CLOSED);
+        return error_code::NO_ERROR;
+    }
+
+    auto& st = *it->second;
+    if (f.length > st.recv_window)
+    {
+        give_back(nullptr, f.length);
+        reset(st, error_code::FLOW_CONTROL_ERROR);
+        return error_code::NO_ERROR;
+    }
+
+    st.recv_window -= f.length;
+
+    // What the handler's read already is only dropped once it's half of the inbox, so it isn't moved down every time.
+    if (st.inbox_read > 0 && st.inbox_read >= st.inbox.size() / 2)
+    {
+        st.inbox.erase(st.inbox.begin(), st.inbox.begin() + static_cast<std::ptrdiff_t>(st.inbox_read));
+        st.inbox_read = 0;
+    }
+
+    st.inbox.insert(st.inbox.end(), payload.begin(), payload.end());
+    if (f.has(frame_flags::END_STREAM)) st.end_receiving();
+
+    give_back(&st, f.length - payload.size());
+    wake(st.waiting_for_body);
+    return error_code::NO_ERROR;
+}
+
+error_code session::on_headers(const frame& f, std::span<const std::byte> payload)
+{
+    if (f.stream_id == 0) return error_code::PROTOCOL_ERROR;
+    if (!strip_padding(f, payload)) return error_code::PROTOCOL_ERROR;
+
+    if (f.has(frame_flags::PRIORITY))
+    {
+        if (payload.size() < 5) return error_code::FRAME_SIZE_ERROR;
+        payload = payload.subspan(5);
+    }
+
+    if (f.has(frame_flags::END_HEADERS)) return on_header_block(f.stream_id, f.flags, payload);
+
+    header_stream = f.stream_id;
+    header_flags  = f.flags;
+    header_block.assign(payload.begin(), payload.end());
+    return error_code::NO_ERROR;
+}
+
+error_code session::on_continuation(const frame& f, std::span<const std::byte> payload)
+{
+    if (header_stream == 0 || f.stream_id != header_stream) return error_code::PROTOCOL_ERROR;
+
+    // A block can't be decoded in part, so one that's too big can't be refused on its own, as a stream error: the
+    // decoder's table would be out of step after it. It takes the connection down with it instead.
+    if (header_block.size() + payload.size() > options.max_header_bytes + options.local.max_frame_size)
+    {
+        return error_code::ENHANCE_YOUR_CALM;
+    }
+
+    header_block.insert(header_block.end(), payload.begin(), payload.end());
+    if (!f.has(frame_flags::END_HEADERS)) return error_code::NO_ERROR;
+
+    auto id  = std::exchange(header_stream, 0);
+    auto err = on_header_block(id, header_flags, header_block);
+    header_block.clear();
+    return err;
+}
+
+error_code session::on_header_block(std::uint32_t id, std::uint8_t flags, std::span<const std::byte> block)
+{
+    const bool end_stream = (flags & flag(frame_flags::END_STREAM)) != 0;
+
+    // trailers, on a stream that's already open - which are decoded, to keep the decoder's table in step, and dropped
+    if (auto it = streams.find(id); it != streams.end() || id <= last_stream_id)
+    {
+        if (decoder.decode(block, [](std::string_view, std::string_view) {})) return error_code::COMPRESSION_ERROR;
+        if (it == streams.end()) return error_code::STREAM_CLOSED;
+
+        auto& st = *it->second;
+        if (st.reset) return error_code::NO_ERROR;
+        if (st.received_all()) reset(st, error_code::STREAM_CLOSED);
+        else if (!end_stream) reset(st, error_code::PROTOCOL_ERROR);
+        else
+        {
+            st.end_receiving();
+            wake(st.waiting_for_body);
+        }
+
+        return error_code::NO_ERROR;
+    }
+
+    // streams the client opens are odd-numbered, and each is numbered higher than the last
+    if (id % 2 == 0) return error_code::PROTOCOL_ERROR;
+    last_stream_id = id;
+
+    auto  st  = std::make_unique<stream>(*this, id, remote.initial_window_size, options.local.initial_window_size);
+    auto& req = st->request;
+
+    bool        has_method = false;
+    bool        has_path   = false;
+    bool        has_scheme = false;
+    bool        has_host   = false;
+    bool        regular    = false;
+    bool        malformed  = false;
+    std::size_t bytes      = 0;
+
+    auto err = decoder.decode(
+        block,
+        [&](std::string_view name, std::string_view value)
+        {
+            bytes += name.size() + value.size() + hpack::entry_overhead;
+            if (malformed || bytes > options.max_header_bytes) return;
+
+            // https://httpwg.org/specs/rfc9113.html#PseudoHeaderFields
+            if (name.starts_with(':'))
+            {
+                if (regular) malformed = true;
+                else if (name == ":method"sv && !has_method)
+                {
+                    req.method = parse_method(value);
+                    has_method = req.method != request_method::NONE;
+                    malformed  = !has_method;
+                }
+                else if (name == ":path"sv && !has_path && !value.empty())
+                {
+                    set_target(req.uri, value);
+                    has_path = true;
+                }
+                else if (name == ":scheme"sv && !has_scheme) has_scheme = true;
+                else if (name == ":authority"sv && !has_host)
+                {
+                    req.uri.host = value;
+                    has_host     = true;
+                }
+                else malformed = true;
+
+                return;
+            }
+
+            // names have to be sent in lower case, and there's no such thing as a connection-specific field
+            regular = true;
+            if (std::ranges::any_of(name, [](char c) { return c >= 'A' && c <= 'Z'; }) || is_connection_specific(name)
+                || (name == "te"sv && value != "trailers"sv))
+            {
+                malformed = true;
+                return;
+            }
+
+            req.headers.add(name, value);
+        });
+
+    if (err) return error_code::COMPRESSION_ERROR;
+
+    if (bytes > options.max_header_bytes)
+    {
+        queue_head(id, status::REQUEST_HEADER_FIELDS_TOO_LARGE, nullptr, true);
+        if (!end_stream) queue_reset(id, error_code::NO_ERROR);
+        return error_code::NO_ERROR;
+    }
+
+    if (malformed || !has_method || !has_path || !has_scheme)
+    {
+        queue_reset(id, error_code::PROTOCOL_ERROR);
+        return error_code::NO_ERROR;
+    }
+
+    if (streams.size() >= options.local.max_concurrent_streams)
+    {
+        queue_reset(id, error_code::REFUSED_STREAM);
+        return error_code::NO_ERROR;
+    }
+
+    if (!has_host)
+    {
+        if (auto host = req.headers.get(field::host)) req.uri.host = *host;
+    }
+
+    req.version    = {2, 0};
+    req.arrived_at = sock.rx_timestamp();
+    req.body       = util::allocate_unique<stream_reader>(&st->arena, *st);
+    if (end_stream) st->end_receiving();
+
+    starting.push_back(st.get());
+    streams.emplace(id, std::move(st));
+    return error_code::NO_ERROR;
+}
+
+error_code session::on_reset(const frame& f, std::span<const std::byte> payload)
+{
+    if (f.stream_id == 0 || f.stream_id > last_stream_id) return error_code::PROTOCOL_ERROR;
+    if (payload.size() != 4) return error_code::FRAME_SIZE_ERROR;
+
+    if (auto it = streams.find(f.stream_id); it != streams.end())
+    {
+        auto& st = *it->second;
+        st.reset = true;
+        st.state = stream_state::closed;
+        wake(st.waiting_for_body);
+        wake(st.waiting_for_room);
+    }
+
+    return error_code::NO_ERROR;
+}
+
+error_code session::on_settings(const frame& f, std::span<const std::byte> payload)
+{
+    if (f.stream_id != 0) return error_code::PROTOCOL_ERROR;
+
+    if (f.has(frame_flags::ACK)) return payload.empty() ? error_code::NO_ERROR : error_code::FRAME_SIZE_ERROR;
+    if (payload.size() % 6 != 0) return error_code::FRAME_SIZE_ERROR;
+
+    if (auto err = apply_settings(payload); err != error_code::NO_ERROR) return err;
+
+    put_frame_header(out, 0, frame_type::SETTINGS, flag(frame_flags::ACK), 0);
+    return error_code::NO_ERROR;
+}
+
+error_code session::apply_settings(std::span<const std::byte> payload)
+{
+    for (; payload.size() >= 6; payload = payload.subspan(6))
+    {
+        auto id    = (std::to_integer<std::uint16_t>(payload[0]) << 8U) | std::to_integer<std::uint16_t>(payload[1]);
+        auto value = read_u32(payload.subspan(2));
+
+        switch (static_cast<setting_id>(id))
+        {
+        // The encoder's table can only be as big as the client's decoder lets it be. Heads are encoded whole, so this
+        // falls between blocks, and the change goes out at the start of the next.
+        case setting_id::SETTINGS_HEADER_TABLE_SIZE:
+            remote.header_table_size = value;
+            encoder.set_max_table_size(value);
+            break;
+
+        case setting_id::SETTINGS_ENABLE_PUSH:
+            if (value > 1) return error_code::PROTOCOL_ERROR;
+            remote.enable_push = value == 1;
+            break;
+
+        case setting_id::SETTINGS_MAX_CONCURRENT_STREAMS: remote.max_concurrent_streams = value; break;
+
+        case setting_id::SETTINGS_INITIAL_WINDOW_SIZE:
+        {
+            if (value > max_window) return error_code::FLOW_CONTROL_ERROR;
+
+            // it changes every stream's window, by however much it's changed
+            auto delta = static_cast<std::int64_t>(value) - remote.initial_window_size;
+            for (auto& [stream_id, st] : streams)
+            {
+                st->send_window += delta;
+                if (st->send_window > max_window) return error_code::FLOW_CONTROL_ERROR;
+            }
+
+            remote.initial_window_size = value;
+            wake_writers();
+            break;
+        }
+
+        case setting_id::SETTINGS_MAX_FRAME_SIZE:
+            if (value < 16'384 || value > 16'777'215) return error_code::PROTOCOL_ERROR;
+            remote.max_frame_size = value;
+            break;
+
+        case setting_id::SETTINGS_MAX_HEADER_LIST_SIZE: remote.max_header_list_size = value; break;
+
+        // settings this doesn't know of are to be ignored
+        default: break;
+        }
+    }
+
+    return error_code::NO_ERROR;
+}
+
+error_code session::on_ping(const frame& f, std::span<const std::byte> payload)
+{
+    if (f.stream_id != 0) return error_code::PROTOCOL_ERROR;
+    if (payload.size() != 8) return error_code::FRAME_SIZE_ERROR;
+    if (f.has(frame_flags::ACK)) return error_code::NO_ERROR;
+
+    put_frame_header(out, payload.size(), frame_type::PING, flag(frame_flags::ACK), 0);
+    out.insert(out.end(), payload.begin(), payload.end());
+    return error_code::NO_ERROR;
+}
+
+error_code session::on_window_update(const frame& f, std::span<const std::byte> payload)
+{
+    if (payload.size() != 4) return error_code::FRAME_SIZE_ERROR;
+
+    auto increment = read_u32(payload) & max_window;
+    if (f.stream_id == 0)
+    {
+        if (increment == 0) return error_code::PROTOCOL_ERROR;
+        if (send_window + increment > max_window) return error_code::FLOW_CONTROL_ERROR;
+
+        send_window += increment;
+        wake_writers();
+        return error_code::NO_ERROR;
+    }
+
+    auto it = streams.find(f.stream_id);
+    if (it == streams.end()) return f.stream_id > last_stream_id ? error_code::PROTOCOL_ERROR : error_code::NO_ERROR;
+
+    auto& st = *it->second;
+    if (st.reset) return error_code::NO_ERROR;
+
+    if (increment == 0) reset(st, error_code::PROTOCOL_ERROR);
+    else if (st.send_window + increment > max_window) reset(st, error_code::FLOW_CONTROL_ERROR);
+    else
+    {
+        st.send_window += increment;
+        wake(st.waiting_for_room);
+    }
+
+    return error_code::NO_ERROR;
+}
+
+error_code session::open_upgraded(const server_request& req)
+{
+    // The settings come base64url-coded, in the request: https://httpwg.org/specs/rfc7540.html#Http2SettingsHeader
+    auto field = req.headers.get("HTTP2-Settings"sv);
+    if (!field) return error_code::PROTOCOL_ERROR;
+
+    auto coded = *field;
+    while (coded.ends_with('=')) coded.remove_suffix(1);
+
+    auto payload = encoding::base64::encoding{encoding::base64::url_alphabet(), 0}.decode(coded);
+    if (!payload || payload->size() % 6 != 0) return error_code::PROTOCOL_ERROR;
+
+    // they're acknowledged by the 101 having been sent
+    if (auto err = apply_settings(*payload); err != error_code::NO_ERROR) return err;
+
+    // The request's answered on stream 1, which is half-closed already: the request was all sent on HTTP/1.1.
+    last_stream_id = 1;
+
+    auto st   = std::make_unique<stream>(*this, 1, remote.initial_window_size, options.local.initial_window_size);
+    st->req   = &req;
+    st->state = stream_state::half_closed_remote;
+
+    starting.push_back(st.get());
+    streams.emplace(1, std::move(st));
+    return error_code::NO_ERROR;
+}
+
+void session::start_handlers()
+{
+    std::vector<stream*> now;
+    {
+        std::lock_guard lock{mu};
+        now.swap(starting);
+        running += now.size();
+    }
+
+    // Each runs until it first waits, for its request's body, say, or the client to make room for its response.
+    for (auto* st : now)
+    {
+        st->handler = respond(std::allocator_arg, &st->arena, *st);
+        st->handler.get_handle().resume();
+    }
+}
+
+task<> session::respond(std::allocator_arg_t /* tag */, std::pmr::polymorphic_allocator<> /* alloc */, stream& st)
+{
+    response_writer writer{&st.writer, &st.response, response_encode};
+
+    try
+    {
+        co_await handler(*st.req, writer);
+    }
+    catch (const std::exception& ex)
+    {
+        logger->error("http2: handler failed on stream {}: {}", st.id, ex.what());
+    }
+    catch (...)
+    {
+        // e.g. the error_condition response_writer::send throws, when the stream's been reset
+        logger->debug("http2: handler failed on stream {}", st.id);
+    }
+
+    finish(st);
+    notify_sender();
+    co_await finished{*this, st};
+}
+
+void session::finish(stream& st)
+{
+    std::lock_guard lock{mu};
+    if (st.reset || closing) return;
+
+    if (!st.head_sent)
+    {
+        queue_head(st.id, status::INTERNAL_SERVER_ERROR, nullptr, true);
+        st.head_sent = true;
+        st.end_sending();
+    }
+    else if (!st.sent_all())
+    {
+        // A body that's come up short can't be ended as if it hadn't.
+        if (st.content_length.has_value() && st.sent < *st.content_length)
+        {
+            reset(st, error_code::INTERNAL_ERROR);
+            return;
+        }
+
+        queue_data(st.id, {}, true);
+        st.end_sending();
+    }
+
+    // the client needn't send the rest of a request that's been answered without it
+    if (!st.received_all()) reset(st, error_code::NO_ERROR);
+}
+
+void session::reap()
+{
+    std::lock_guard lock{mu};
+    std::erase_if(streams,
+                  [&](const auto& entry)
+                  {
+                      auto& st = *entry.second;
+                      if (!st.done) return false;
+
+                      // what was sent, but never read, still counts against the connection's window
+                      give_back(nullptr, st.inbox.size() - st.inbox_read);
+                      return true;
+                  });
+}
+
+task<io::result> session::read_body(stream& st, std::span<std::byte> data)
+{
+    if (data.empty()) co_return io::result{};
+
+    while (true)
+    {
+        io::result res;
+        {
+            std::lock_guard lock{mu};
+            if (st.inbox_read < st.inbox.size())
+            {
+                res.count = std::min(data.size(), st.inbox.size() - st.inbox_read);
+                std::copy_n(st.inbox.data() + st.inbox_read, res.count, data.data());
+
+                st.inbox_read += res.count;
+                if (st.inbox_read == st.inbox.size())
+                {
+                    st.inbox.clear();
+                    st.inbox_read = 0;
+                }
+
+                give_back(&st, res.count);
+            }
+            else if (st.reset || closing || st.received_all())
+            {
+                res.err = io::make_error_condition(io::status_condition::closed);
+            }
+        }
+
+        if (res.count > 0)
+        {
+            notify_sender();
+            co_return res;
+        }
+
+        if (res.err) co_return res;
+
+        co_await wait(st.waiting_for_body,
+                      [&] { return st.inbox_read < st.inbox.size() || st.reset || closing || st.received_all(); });
+    }
+}
+
+task<io::result> session::write_body(stream& st, std::span<const std::byte> data)
+{
+    // the head said how long it would be, but a response to HEAD doesn't have one
+    if (st.req->method == request_method::HEAD) co_return io::result{.count = data.size(), .err = {}};
+
+    std::size_t written = 0;
+    while (written < data.size())
+    {
+        io::result res{.count = written, .err = {}};
+        bool       queued = false;
+        {
+            std::lock_guard lock{mu};
+            if (st.reset || closing)
+            {
+                res.err = io::make_error_condition(io::status_condition::closed);
+            }
+            else if (!st.head_sent || st.sent_all())
+            {
+                res.err = std::make_error_condition(std::errc::operation_not_permitted);
+            }
+            else if (auto n = static_cast<std::size_t>(std::max<std::int64_t>(room(st), 0)); n > 0)
+            {
+                n = std::min(n, data.size() - written);
+                if (st.content_length.has_value()) n = std::min(n, *st.content_length - st.sent);
+
+                st.sent += n;
+                st.send_window -= static_cast<std::int64_t>(n);
+                send_window -= static_cast<std::int64_t>(n);
+
+                const bool end = st.content_length.has_value() && st.sent == *st.content_length;
+                queue_data(st.id, data.subspan(written, n), end);
+                if (end) st.end_sending();
+
+                written += n;
+                queued = true;
+            }
+        }
+
+        if (res.err) co_return res;
+
+        if (queued)
+        {
+            notify_sender();
+            continue;
+        }
+
+        co_await wait(st.waiting_for_room, [&] { return st.reset || closing || room(st) > 0; });
+    }
+
+    co_return io::result{.count = written, .err = {}};
+}
+
+std::error_condition session::send_head(stream& st, const server_response& resp)
+{
+    {
+        std::lock_guard lock{mu};
+        if (st.reset || closing) return io::make_error_condition(io::status_condition::closed);
+        if (st.head_sent) return std::make_error_condition(std::errc::operation_not_permitted);
+
+        st.content_length = resp.headers.get_content_length();
+
+        const bool end = st.content_length == 0 || st.req->method == request_method::HEAD;
+        queue_head(st.id, resp.status_code, &resp.headers, end);
+        st.head_sent = true;
+        if (end) st.end_sending();
+    }
+
+    notify_sender();
+    return {};
+}
+
+void session::queue_settings()
+{
+    std::vector<std::pair<setting_id, std::uint32_t>> changed;
+
+    // only those that aren't what the client assumes already
+    const settings defaults;
+    const auto&    local = options.local;
+    if (local.header_table_size != defaults.header_table_size)
+    {
+        changed.emplace_back(setting_id::SETTINGS_HEADER_TABLE_SIZE, local.header_table_size);
+    }
+    if (local.enable_push != defaults.enable_push)
+    {
+        changed.emplace_back(setting_id::SETTINGS_ENABLE_PUSH, local.enable_push ? 1 : 0);
+    }
+    if (local.max_concurrent_streams != defaults.max_concurrent_streams)
+    {
+        changed.emplace_back(setting_id::SETTINGS_MAX_CONCURRENT_STREAMS, local.max_concurrent_streams);
+    }
+    if (local.initial_window_size != defaults.initial_window_size)
+    {
+        changed.emplace_back(setting_id::SETTINGS_INITIAL_WINDOW_SIZE, local.initial_window_size);
+    }
+    if (local.max_frame_size != defaults.max_frame_size)
+    {
+        changed.emplace_back(setting_id::SETTINGS_MAX_FRAME_SIZE, local.max_frame_size);
+    }
+    if (local.max_header_list_size != defaults.max_header_list_size)
+    {
+        changed.emplace_back(setting_id::SETTINGS_MAX_HEADER_LIST_SIZE, local.max_header_list_size);
+    }
+
+    put_frame_header(out, changed.size() * 6, frame_type::SETTINGS, 0, 0);
+    for (auto [id, value] : changed)
+    {
+        out.push_back(static_cast<std::byte>(static_cast<std::uint16_t>(id) >> 8U));
+        out.push_back(static_cast<std::byte>(id));
+        put_u32(out, value);
+    }
+}
+
+void session::queue_window_update(std::uint32_t id, std::size_t increment)
+{
+    put_frame_header(out, 4, frame_type::WINDOW_UPDATE, 0, id);
+    put_u32(out, static_cast<std::uint32_t>(increment));
+}
+
+void session::queue_head(std::uint32_t id, status code, const headers* fields, bool end_stream)
+{
+    std::array<char, 10> digits{};
+    auto [end, ec] = std::to_chars(digits.data(), digits.data() + digits.size(), static_cast<std::uint32_t>(code));
+
+    head_scratch.clear();
+    encoder.encode(":status"sv, std::string_view{digits.data(), end}, head_scratch);
+    if (fields != nullptr)
+    {
+        for (auto [name, value] : *fields)
+        {
+            if (!is_connection_specific(name)) encoder.encode(name, value, head_scratch);
+        }
+    }
+
+    // A block that's bigger than a frame goes on in CONTINUATION frames, straight after.
+    std::span<const std::byte> block = head_scratch;
+
+    auto type  = frame_type::HEADERS;
+    auto flags = end_stream ? flag(frame_flags::END_STREAM) : std::uint8_t{0};
+    do
+    {
+        auto part = block.first(std::min<std::size_t>(block.size(), remote.max_frame_size));
+        block     = block.subspan(part.size());
+        if (block.empty()) flags |= flag(frame_flags::END_HEADERS);
+
+        put_frame_header(out, part.size(), type, flags, id);
+        out.insert(out.end(), part.begin(), part.end());
+
+        type  = frame_type::CONTINUATION;
+        flags = 0;
+    } while (!block.empty());
+}
+
+void session::queue_data(std::uint32_t id, std::span<const std::byte> data, bool end_stream)
+{
+    put_frame_header(out, data.size(), frame_type::DATA, end_stream ? flag(frame_flags::END_STREAM) : 0, id);
+    out.insert(out.end(), data.begin(), data.end());
+}
+
+void session::queue_reset(std::uint32_t id, error_code code)
+{
+    put_frame_header(out, 4, frame_type::RST_STREAM, 0, id);
+    put_u32(out, static_cast<std::uint32_t>(code));
+}
+
+void session::queue_goaway(error_code code)
+{
+    put_frame_header(out, 8, frame_type::GOAWAY, 0, 0);
+    put_u32(out, last_stream_id);
+    put_u32(out, static_cast<std::uint32_t>(code));
+}
+
+void session::give_back(stream* st, std::size_t count)
+{
+    unacked += count;
+    if (unacked >= options.connection_window / 2)
+    {
+        queue_window_update(0, unacked);
+        recv_window += static_cast<std::int64_t>(std::exchange(unacked, 0));
+    }
+
+    // there's no more to come on a stream that's closed, so no need to make room for it
+    if (st == nullptr || st->received_all() || st->reset) return;
+
+    st->unacked += count;
+    if (st->unacked >= options.local.initial_window_size / 2)
+    {
+        queue_window_update(st->id, st->unacked);
+        st->recv_window += static_cast<std::int64_t>(std::exchange(st->unacked, 0));
+    }
+}
+
+void session::reset(stream& st, error_code code)
+{
+    queue_reset(st.id, code);
+    st.reset = true;
+    st.state = stream_state::closed;
+    wake(st.waiting_for_body);
+    wake(st.waiting_for_room);
+}
+
+void session::wake(std::coroutine_handle<>& slot)
+{
+    if (slot != nullptr) woken.push_back(std::exchange(slot, nullptr));
+}
+
+void session::wake_writers()
+{
+    for (auto& [id, st] : streams)
+    {
+        if (closing || st->reset || room(*st) > 0) wake(st->waiting_for_room);
+    }
+}
+
+std::int64_t session::room(const stream& st) const noexcept
+{
+    if (out.size() >= max_pending_output) return 0;
+    return std::min({st.send_window, send_window, static_cast<std::int64_t>(remote.max_frame_size)});
+}
+
+void session::resume_woken()
+{
+    // NOTE: the loop and the sender both resume what they've woken, so each does it from a list of its own
+    std::vector<std::coroutine_handle<>> resuming;
+    while (true)
+    {
+        {
+            std::lock_guard lock{mu};
+            if (woken.empty()) return;
+            resuming.swap(woken);
+        }
+
+        for (auto handle : resuming) handle.resume();
+        resuming.clear();
+    }
+}
+
+}
+
+task<std::error_condition> serve(socket&               sock,
+                                 io::buffered_reader&  reader,
+                                 const router&         handler,
+                                 const server_options& options,
+                                 const server_request* upgraded)
+{
+    session s{sock, reader, handler, options};
+    co_return co_await s.run(upgraded);
+}
+
+task<response_encoder_result> response_encode(io::writer* writer, const server_response& resp) noexcept
+{
+    auto* out = dynamic_cast<stream_writer*>(writer);
+    if (out == nullptr) co_return std::unexpected{std::make_error_condition(std::errc::not_supported)};
+
+    if (auto err = out->send_head(resp); err) co_return std::unexpected{err};
+    co_return writer;
+}
+
+task<request_encoder_result> request_encode(io::writer* /* writer */, const client_request& /* req */) noexcept
+{
+    co_return std::unexpected{std::make_error_condition(std::errc::not_supported)};
+}
+
+task<request_decoder_result> request_decode(std::allocator_arg_t /* tag */,
+                                            std::pmr::polymorphic_allocator<> /* alloc */,
+                                            io::buffered_reader* /* reader */,
+                                            std::size_t /* max_header_bytes */) noexcept
+{
+    co_return std::unexpected{std::make_error_condition(std::errc::not_supported)};
+}
+
+task<request_decoder_result> request_decode(std::unique_ptr<io::buffered_reader> /* reader */,
+                                            std::size_t /* max_header_bytes */) noexcept
+{
+    co_return std::unexpected{std::make_error_condition(std::errc::not_supported)};
+}
+
+task<response_decoder_result> response_decode(std::unique_ptr<io::buffered_reader> /* reader */,
+                                              std::size_t /* max_header_bytes */) noexcept
+{
+    co_return std::unexpected{std::make_error_condition(std::errc::not_supported)};
+}
+
 }
@@ -0,0 +1,217 @@
+#include "http/parser.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <string_view>
+#include <system_error>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+#include "http/http.hpp"
+
+namespace
+{
+
+using namespace std::string_view_literals;
+
+// tchar from RFC 9110, section 5.6.2: what methods and header names are made of.
+constexpr auto token_chars = []
+{
+    std::array<bool, 256> table{};
+
+    for (unsigned char c = '0'; c <= '9'; ++c) table[c] = true;
+    for (unsigned char c = 'a'; c <= 'z'; ++c) table[c] = true;
+    for (unsigned char c = 'A'; c <= 'Z'; ++c) table[c] = true;
+    for (unsigned char c : "!#$%&'*+-.^_`|~"sv) table[c] = true;
+
+    return table;
+}();
+
+constexpr bool is_token(char c) noexcept { return token_chars[static_cast<unsigned char>(c)]; }
+
+constexpr bool is_ows(char c) noexcept { return c == ' ' || c == '\t'; }
+
+constexpr bool is_digit(char c) noexcept { return '0' <= c && c <= '9'; }
+
+// find_ctl returns the index of the first byte in data, from from on, that's below min or is DEL - or data.size() if
+// there isn't one. With tab_ok, horizontal tabs don't count, even if min is above them.
+//
+// Targets and header values are where the bulk of a head's bytes are, and they're looked through 16 bytes at a time.
+// That's SSE2, which every x86-64 has, so there's no need for any special build flags or checks at runtime.
+std::size_t find_ctl(std::string_view data, std::size_t from, unsigned char min, bool tab_ok) noexcept
+{
+#if defined(__SSE2__)
+    const auto below = _mm_set1_epi8(static_cast<char>(min - 1));
+    const auto del   = _mm_set1_epi8(0x7f);
+    const auto tab   = _mm_set1_epi8(tab_ok ? '\t' : 0x7f);
+
+    for (; from + 16 <= data.size(); from += 16)
+    {
+        const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + from));
+
+        // SSE2 only compares signed bytes, but it has an unsigned min: c < min is min(c, min-1) == c
+        auto ctl = _mm_cmpeq_epi8(_mm_min_epu8(chunk, below), chunk);
+        ctl      = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, tab), ctl);
+        ctl      = _mm_or_si128(ctl, _mm_cmpeq_epi8(chunk, del));
+
+        if (auto mask = static_cast<unsigned>(_mm_movemask_epi8(ctl)); mask != 0)
+        {
+            return from + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+#endif
+
+    for (; from < data.size(); ++from)
+    {
+        const auto c = static_cast<unsigned char>(data[from]);
+        if ((c < min && !(tab_ok && c == '\t')) || c == 0x7f) return from;
+    }
+
+    return from;
+}
+
+// find_token_end returns the index of the first byte from from on that isn't a tchar.
+std::size_t find_token_end(std::string_view data, std::size_t from) noexcept
+{
+    while (from < data.size() && is_token(data[from])) ++from;
+    return from;
+}
+
+// skip_line_end moves pos past the CRLF (or bare LF) at pos, and returns whether there was one.
+bool skip_line_end(std::string_view data, std::size_t& pos) noexcept
+{
+    if (pos < data.size() && data[pos] == '\n')
+    {
+        pos += 1;
+        return true;
+    }
+
+    if (pos + 1 < data.size() && data[pos] == '\r' && data[pos + 1] == '\n')
+    {
+        pos += 2;
+        return true;
+    }
+
+    return false;
+}
+
+std::error_condition malformed() noexcept { return std::make_error_condition(std::errc::illegal_byte_sequence); }
+
+}
+
+namespace net::http::http11
+{
+
+std::expected<std::size_t, std::error_condition> request_parser::parse(std::string_view data)
+{
+    // The head ends with a blank line, so its end is an LF right after another one (give or take a CR). An LF's
+    // predecessors are always there to check, so whatever was looked through last time needn't be again.
+    std::size_t end = 0;
+    for (auto lf = data.find('\n', scanned); lf != std::string_view::npos; lf = data.find('\n', lf + 1))
+    {
+        if ((lf >= 1 && data[lf - 1] == '\n') || (lf >= 2 && data[lf - 1] == '\r' && data[lf - 2] == '\n'))
+        {
+            end = lf + 1;
+            break;
+        }
+    }
+
+    if (end == 0)
+    {
+        scanned = data.size();
+
+        // there's at least one more byte to come
+        if (data.size() >= max_head_bytes)
+        {
+            return std::unexpected(std::make_error_condition(std::errc::value_too_large));
+        }
+        return 0;
+    }
+
+    if (end > max_head_bytes) return std::unexpected(std::make_error_condition(std::errc::value_too_large));
+
+    if (auto err = parse_head(data.substr(0, end)); err) return std::unexpected(err);
+    return end;
+}
+
+void request_parser::reset() noexcept
+{
+    scanned = 0;
+    parsed  = {};
+    fields.clear();
+}
+
+std::error_condition request_parser::parse_head(std::string_view head)
+{
+    std::size_t pos = 0;
+
+    // a server should ignore empty lines ahead of the request line (RFC 9112, section 2.2)
+    while (skip_line_end(head, pos))
+    {}
+
+    // request-line = method SP request-target SP HTTP-version CRLF
+
+    auto method_end = find_token_end(head, pos);
+    if (method_end == pos || method_end >= head.size() || head[method_end] != ' ') return malformed();
+
+    parsed.method = head.substr(pos, method_end - pos);
+    pos           = method_end + 1;
+
+    // the target can be anything visible, up until the next space
+    auto target_end = find_ctl(head, pos, '!', false);
+    if (target_end == pos || target_end >= head.size() || head[target_end] != ' ') return malformed();
+
+    parsed.target = head.substr(pos, target_end - pos);
+    pos           = target_end + 1;
+
+    static constexpr auto http_name = "HTTP/"sv;
+    if (head.size() - pos < http_name.size() + 3 || head.substr(pos, http_name.size()) != http_name) return malformed();
+
+    pos += http_name.size();
+    if (!is_digit(head[pos]) || head[pos + 1] != '.' || !is_digit(head[pos + 2])) return malformed();
+
+    parsed.version = {
+        .major = static_cast<std::uint32_t>(head[pos] - '0'),
+        .minor = static_cast<std::uint32_t>(head[pos + 2] - '0'),
+    };
+    pos += 3;
+
+    if (!skip_line_end(head, pos)) return malformed();
+
+    // field-line = field-name ":" OWS field-value OWS
+
+    fields.clear();
+
+    while (!skip_line_end(head, pos))
+    {
+        // NOTE: obsolete line folding (a line starting with whitespace) is rejected, which RFC 9112 allows
+        auto name_end = find_token_end(head, pos);
+        if (name_end == pos || name_end >= head.size() || head[name_end] != ':') return malformed();
+
+        auto name = head.substr(pos, name_end - pos);
+        pos       = name_end + 1;
+
+        while (pos < head.size() && is_ows(head[pos])) ++pos;
+
+        // the value runs up to the line's end - any other control character in there makes it invalid
+        auto value_end = find_ctl(head, pos, ' ', true);
+        auto value     = head.substr(pos, value_end - pos);
+        while (!value.empty() && is_ows(value.back())) value.remove_suffix(1);
+
+        pos = value_end;
+        if (!skip_line_end(head, pos)) return malformed();
+
+        fields.push_back({.name = name, .value = value});
+    }
+
+    parsed.fields = fields;
+
+    return {};
+}
+
+}
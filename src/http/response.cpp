@@ -3,6 +3,7 @@
 #include <charconv>
 #include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string_view>
 
 #include "coro/task.hpp"
@@ -45,4 +46,21 @@ coro::task<io::writer*> response_writer::send(status status_code, std::size_t co
     co_return resp->body;
 }
 
+coro::task<bool> response_writer::send_encoded(status                     status_code,
+                                               response_encoder           encoded_by,
+                                               protocol_version           version,
+                                               std::span<const std::byte> encoded)
+{
+    if (encode != encoded_by || resp->version != version) co_return false;
+
+    resp->status_code = status_code;
+    auto res          = co_await writer->write(encoded);
+    if (res.err)
+    {
+        throw(res.err);
+    }
+
+    co_return true;
+}
+
 }
@@ -0,0 +1,604 @@
+#include "http/response_cache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "coro/task.hpp"
+#include "detail/resume.hpp"
+#include "http/field.hpp"
+#include "http/headers.hpp"
+#include "http/http11.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "io/io.hpp"
+#include "io/writer.hpp"
+#include "util/memory_budget.hpp"
+#include "util/string_util.hpp"
+
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
+namespace
+{
+
+using net::http::field;
+using net::http::headers;
+using net::http::response_encoder_result;
+using net::http::response_writer;
+using net::http::server_request;
+using net::http::server_response;
+using net::http::status;
+
+using clock = std::chrono::steady_clock;
+
+constexpr net::http::protocol_version http11_version{.major = 1, .minor = 1};
+
+// cache_directives are what a Cache-Control field says that the cache minds.
+struct cache_directives
+{
+    bool                                no_store   = false;
+    bool                                no_cache   = false;
+    bool                                is_private = false;
+    std::optional<std::chrono::seconds> max_age;
+    std::optional<std::chrono::seconds> s_maxage;
+};
+
+// for_each_item calls f with each item of the comma separated lists in every field called f.
+template<typename F>
+void for_each_item(const headers& h, field name, F&& f)
+{
+    auto values = h.get_all(name);
+    if (!values) return;
+
+    for (auto value : *values)
+    {
+        for (auto item : net::util::split_string(value, ','))
+        {
+            item = net::util::trim_string(item);
+            if (!item.empty()) f(item);
+        }
+    }
+}
+
+std::optional<std::chrono::seconds> seconds_of(std::string_view text) noexcept
+{
+    text = net::util::unquote(text);
+
+    std::int64_t n  = 0;
+    auto [end, err] = std::from_chars(text.data(), text.data() + text.size(), n);
+    if (err != std::errc{} || end != text.data() + text.size() || n < 0) return std::nullopt;
+
+    return std::chrono::seconds{n};
+}
+
+cache_directives directives_of(const headers& h)
+{
+    cache_directives d;
+    for_each_item(h,
+                  field::cache_control,
+                  [&d](std::string_view item)
+                  {
+                      auto eq   = item.find('=');
+                      auto name = net::util::trim_string(item.substr(0, eq));
+                      auto arg  = eq == std::string_view::npos ? ""sv : net::util::trim_string(item.substr(eq + 1));
+
+                      using net::util::equal_ignore_case;
+                      if (equal_ignore_case(name, "no-store"sv)) d.no_store = true;
+                      else if (equal_ignore_case(name, "no-cache"sv)) d.no_cache = true;
+                      else if (equal_ignore_case(name, "private"sv)) d.is_private = true;
+                      else if (equal_ignore_case(name, "max-age"sv)) d.max_age = seconds_of(arg).value_or(0s);
+                      else if (equal_ignore_case(name, "s-maxage"sv)) d.s_maxage = seconds_of(arg).value_or(0s);
+                  });
+
+    return d;
+}
+
+// kept_status is whether responses with code can be kept without being told how long for.
+constexpr bool kept_status(status code) noexcept
+{
+    using enum status;
+    switch (code)
+    {
+    case OK:
+    case NON_AUTHORITATIVE_INFORMATION:
+    case NO_CONTENT:
+    case MULTIPLE_CHOICES:
+    case MOVED_PERMANENTLY:
+    case NOT_FOUND:
+    case GONE:
+    case PERMANENT_REDIRECT: return true;
+    default: return false;
+    }
+}
+
+// append_part adds part to key, after its length, so that no two lists of parts make the same key.
+void append_part(std::string& key, std::string_view part)
+{
+    key += std::to_string(part.size());
+    key += ':';
+    key += part;
+}
+
+// primary_key is what tells responses apart, but for what they vary by.
+std::string primary_key(const server_request& req)
+{
+    std::string key;
+    append_part(key, net::http::method_string(req.method));
+
+    std::string host = req.uri.host.empty() ? std::string{req.headers.get(field::host).value_or(""sv)} : req.uri.host;
+    std::ranges::transform(host, host.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    append_part(key, host);
+    append_part(key, req.uri.path);
+
+    // the query's parameters in order of their names, whatever order they came in
+    std::vector<std::pair<std::string_view, std::string_view>> params;
+    for (const auto& [name, values] : req.uri.query)
+    {
+        for (const auto& value : values) params.emplace_back(name, value);
+    }
+    std::ranges::stable_sort(params, {}, &std::pair<std::string_view, std::string_view>::first);
+
+    for (auto [name, value] : params)
+    {
+        append_part(key, name);
+        append_part(key, value);
+    }
+
+    return key;
+}
+
+// variant_key adds to primary the values of the request's fields named in vary.
+std::string variant_key(const std::string& primary, const server_request& req, const std::vector<std::string>& vary)
+{
+    auto key = primary;
+    for (const auto& name : vary)
+    {
+        key += '\n';
+        append_part(key, name);
+
+        auto values = req.headers.get_all(std::string_view{name});
+        if (!values) continue;
+
+        for (auto value : *values) append_part(key, value);
+    }
+
+    return key;
+}
+
+std::uint64_t hash_of(std::string_view key) noexcept { return std::hash<std::string_view>{}(key); }
+
+// etag_matches is whether an If-None-Match in h matches etag, comparing them weakly.
+bool etag_matches(const headers& h, std::string_view etag) noexcept
+{
+    auto weak = [](std::string_view tag) { return tag.starts_with("W/"sv) ? tag.substr(2) : tag; };
+
+    bool matched = false;
+    for_each_item(h,
+                  field::if_none_match,
+                  [&](std::string_view item) { matched = matched || item == "*"sv || weak(item) == weak(etag); });
+
+    return matched;
+}
+
+// capture is where the handler behind the cache writes its response: it's passed on to the client as it comes, and a
+// copy of it kept, as HTTP/1.1 would send it, for as long as it fits.
+class capture final : public net::io::writer
+{
+public:
+    capture(response_writer* client, std::size_t limit) noexcept
+        : client{client}
+        , limit{limit}
+    {}
+
+    net::coro::task<net::io::result> write(std::span<const std::byte> data) override
+    {
+        keep(data);
+        if (out == nullptr) co_return net::io::result{.count = data.size(), .err = {}};
+
+        auto res = co_await out->write(data);
+        if (res.err) keeping = false;
+
+        co_return res;
+    }
+
+    // NOTE: there's no one descriptor to write to, so nothing can go around this
+    [[nodiscard]] int native_handle() const noexcept override { return -1; }
+
+    // complete is whether the whole of a response, head and body, has been kept.
+    [[nodiscard]] bool complete(const server_response& resp) const
+    {
+        return sent && keeping && bytes.size() - head_length == resp.headers.get_content_length().value_or(0);
+    }
+
+    response_writer*       client;
+    net::io::writer*       out = nullptr; // the client's body, once its head's been sent
+    std::vector<std::byte> bytes;
+    std::size_t            head_length = 0;
+    std::size_t            limit;
+    bool                   keeping      = true;
+    bool                   sent         = false;
+    bool                   revalidating = false; // whether a 304 is for the cache, not the client
+
+private:
+    void keep(std::span<const std::byte> data)
+    {
+        if (!keeping) return;
+
+        if (data.size() > limit - bytes.size())
+        {
+            keeping = false;
+            bytes   = {};
+            return;
+        }
+
+        bytes.insert(bytes.end(), data.begin(), data.end());
+    }
+};
+
+// capture_encode keeps the head of a response, encoded as HTTP/1.1, and sends it on to the client the way the client's
+// writer encodes it.
+net::coro::task<response_encoder_result> capture_encode(net::io::writer* writer, const server_response& resp) noexcept
+{
+    auto& c = static_cast<capture&>(*writer);
+    c.sent  = true;
+
+    if (auto res = co_await net::http::http11::response_encode(&c, resp); !res) c.keeping = false;
+    c.head_length = c.bytes.size();
+
+    if (c.revalidating && resp.status_code == status::NOT_MODIFIED) co_return writer;
+
+    for (auto [name, value] : resp.headers)
+    {
+        if (!net::util::equal_ignore_case(name, "content-length"sv)) c.client->headers().add(name, value);
+    }
+
+    try
+    {
+        c.out = co_await c.client->send(resp.status_code, resp.headers.get_content_length().value_or(0));
+    }
+    catch (const std::error_condition& err)
+    {
+        c.keeping = false;
+        co_return std::unexpected(err);
+    }
+
+    co_return writer;
+}
+
+}
+
+namespace net::http
+{
+
+struct response_cache::entry
+{
+    std::string              key;
+    std::vector<std::string> vary; // the names of the request fields in key, past the primary key
+    status                   code = status::NONE;
+    http::headers            fields;
+    std::string              etag;
+    std::vector<std::byte>   encoded; // as HTTP/1.1 sends it, head and body
+    std::size_t              head_length = 0;
+    std::chrono::seconds     lifetime{0};
+
+    // when the response was made, or last said to still be good
+    mutable std::atomic<clock::rep> refreshed;
+
+    util::memory_budget::reservation held;
+
+    [[nodiscard]] std::span<const std::byte> body() const noexcept
+    {
+        return std::span{encoded}.subspan(head_length);
+    }
+
+    [[nodiscard]] clock::duration age(clock::time_point now) const noexcept
+    {
+        return now - clock::time_point{clock::duration{refreshed.load(std::memory_order::relaxed)}};
+    }
+
+    // fresh_for is whether the response can still answer a request that asked for what it did.
+    [[nodiscard]] bool fresh_for(const cache_directives& asked, clock::time_point now) const noexcept
+    {
+        if (asked.no_cache) return false;
+
+        auto aged = age(now);
+        return aged < lifetime && (!asked.max_age || aged <= *asked.max_age);
+    }
+
+    void refresh(clock::time_point now) const noexcept
+    {
+        refreshed.store(now.time_since_epoch().count(), std::memory_order::relaxed);
+    }
+};
+
+struct response_cache::flight
+{
+    std::shared_ptr<const entry>         result; // if the response was kept
+    bool                                 done = false;
+    std::vector<std::coroutine_handle<>> waiters;
+};
+
+response_cache::response_cache(response_cache_config config)
+    : config{config}
+    , entries{config.capacity}
+    , variants{config.capacity}
+{
+    if (config.budget != nullptr) shrinker = config.budget->add_shrinker([this] { purge(); });
+}
+
+response_cache::~response_cache()
+{
+    if (shrinker) config.budget->remove_shrinker(*shrinker);
+}
+
+void response_cache::purge()
+{
+    entries.purge();
+    variants.purge();
+}
+
+response_cache::statistics response_cache::stats() const noexcept
+{
+    return {
+        .hits        = hits.load(std::memory_order::relaxed),
+        .misses      = misses.load(std::memory_order::relaxed),
+        .collapsed   = collapsed.load(std::memory_order::relaxed),
+        .revalidated = revalidated.load(std::memory_order::relaxed),
+        .stored      = stored.load(std::memory_order::relaxed),
+    };
+}
+
+bool response_cache::flight_awaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    std::lock_guard lock{cache->flights_mu};
+    if (f->done) return false;
+
+    f->waiters.push_back(handle);
+    return true;
+}
+
+std::shared_ptr<const response_cache::entry> response_cache::lookup(const std::string& key) noexcept
+{
+    auto found = entries.get(hash_of(key)).value_or(nullptr);
+    if (found == nullptr || found->key != key) return nullptr;
+
+    return found;
+}
+
+void response_cache::land(const std::string&             key,
+                          const std::shared_ptr<flight>& f,
+                          std::shared_ptr<const entry>   result) noexcept
+{
+    std::vector<std::coroutine_handle<>> waiters;
+
+    {
+        std::lock_guard lock{flights_mu};
+        f->result = std::move(result);
+        f->done   = true;
+        waiters.swap(f->waiters);
+        flights.erase(key);
+    }
+
+    for (auto handle : waiters) net::detail::resume_on_or_here(config.scheduler, handle);
+}
+
+coro::task<void> response_cache::reply_with(const entry& e, const server_request& req, response_writer& resp)
+{
+    if (!e.etag.empty() && etag_matches(req.headers, e.etag))
+    {
+        resp.headers().set(field::etag, e.etag);
+        if (auto cc = e.fields.get(field::cache_control)) resp.headers().set(field::cache_control, *cc);
+        co_await resp.send(status::NOT_MODIFIED, 0);
+        co_return;
+    }
+
+    if (co_await resp.send_encoded(e.code, http11::response_encode, http11_version, e.encoded)) co_return;
+
+    for (auto [name, value] : e.fields)
+    {
+        if (!util::equal_ignore_case(name, "content-length"sv)) resp.headers().add(name, value);
+    }
+
+    auto* body = co_await resp.send(e.code, e.body().size());
+    if (e.body().empty()) co_return;
+
+    if (auto res = co_await body->write(e.body()); res.err)
+    {
+        throw(res.err);
+    }
+}
+
+coro::task<void> response_cache::serve(const server_request& req, response_writer& resp, const handler_func& next)
+{
+    auto asked = directives_of(req.headers);
+    if (req.method != request_method::GET || asked.no_store || req.headers.get(field::authorization))
+    {
+        co_await next(req, resp);
+        co_return;
+    }
+
+    auto primary = primary_key(req);
+    auto vary    = variants.get(hash_of(primary)).value_or(nullptr);
+    auto key     = vary ? variant_key(primary, req, *vary) : primary;
+
+    // NOTE: at most twice - the second time for this request's own variant, see below
+    for (int attempt = 0;; ++attempt)
+    {
+        auto found = lookup(key);
+        if (found != nullptr && found->fresh_for(asked, clock::now()))
+        {
+            hits.fetch_add(1, std::memory_order::relaxed);
+            co_await reply_with(*found, req, resp);
+            co_return;
+        }
+
+        std::shared_ptr<flight> f;
+        bool                    leading = false;
+        {
+            std::lock_guard lock{flights_mu};
+
+            auto [it, added] = flights.try_emplace(key);
+            if (added) it->second = std::make_shared<flight>();
+
+            f       = it->second;
+            leading = added;
+        }
+
+        if (!leading)
+        {
+            collapsed.fetch_add(1, std::memory_order::relaxed);
+            co_await flight_awaitable{this, f.get()};
+
+            // NOTE: a response that wasn't kept, e.g. a private one, has to be asked for again
+            if (f->result == nullptr)
+            {
+                co_await next(req, resp);
+                co_return;
+            }
+
+            // What was in flight can vary by something this request doesn't have in common with the one that asked
+            // for it, which was only known once it came: then this request goes again, for its own variant.
+            auto own = variant_key(primary, req, f->result->vary);
+            if (own == f->result->key)
+            {
+                co_await reply_with(*f->result, req, resp);
+                co_return;
+            }
+
+            if (attempt == 0)
+            {
+                key = std::move(own);
+                continue;
+            }
+
+            co_await next(req, resp);
+            co_return;
+        }
+
+        misses.fetch_add(1, std::memory_order::relaxed);
+
+        std::shared_ptr<const entry> kept;
+        try
+        {
+            kept = co_await fill(req, resp, next, primary, std::move(found));
+        }
+        catch (...)
+        {
+            land(key, f, nullptr);
+            throw;
+        }
+
+        land(key, f, std::move(kept));
+        co_return;
+    }
+}
+
+coro::task<std::shared_ptr<const response_cache::entry>> response_cache::fill(const server_request&        req,
+                                                                             response_writer&             resp,
+                                                                             const handler_func&          next,
+                                                                             const std::string&           primary,
+                                                                             std::shared_ptr<const entry> stale)
+{
+    capture         c{&resp, config.max_entry_bytes};
+    server_response captured{.version = http11_version, .headers = {}, .body = &c};
+    response_writer inner{&c, &captured, capture_encode};
+
+    if (stale != nullptr && !stale->etag.empty())
+    {
+        // the handler's asked whether what's kept is still good, and if so the client gets that
+        server_request conditional{
+            .method     = req.method,
+            .version    = req.version,
+            .uri        = req.uri,
+            .headers    = req.headers,
+            .arrived_at = req.arrived_at,
+        };
+        conditional.headers.set(field::if_none_match, stale->etag);
+        c.revalidating = true;
+
+        co_await next(conditional, inner);
+        if (captured.status_code == status::NOT_MODIFIED)
+        {
+            revalidated.fetch_add(1, std::memory_order::relaxed);
+            stale->refresh(clock::now());
+            co_await reply_with(*stale, req, resp);
+            co_return stale;
+        }
+    }
+    else
+    {
+        co_await next(req, inner);
+    }
+
+    if (!c.complete(captured) || !kept_status(captured.status_code)) co_return nullptr;
+
+    auto said = directives_of(captured.headers);
+    if (said.no_store || said.no_cache || said.is_private || captured.headers.get(field::set_cookie)) co_return nullptr;
+
+    auto lifetime = said.s_maxage.or_else([&] { return said.max_age; }).value_or(config.default_max_age);
+    if (lifetime <= 0s) co_return nullptr;
+
+    std::vector<std::string> vary;
+    bool                     vary_all = false;
+    for_each_item(captured.headers,
+                  field::vary,
+                  [&](std::string_view name)
+                  {
+                      vary_all = vary_all || name == "*"sv;
+
+                      auto& lowered = vary.emplace_back(name);
+                      std::ranges::transform(lowered,
+                                             lowered.begin(),
+                                             [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+                  });
+    if (vary_all) co_return nullptr;
+
+    std::ranges::sort(vary);
+    vary.erase(std::ranges::unique(vary).begin(), vary.end());
+
+    auto e = std::make_shared<entry>();
+    if (config.budget != nullptr)
+    {
+        e->held = config.budget->try_hold(c.bytes.size() + primary.size());
+        if (!e->held) co_return nullptr;
+    }
+
+    e->key         = variant_key(primary, req, vary);
+    e->vary        = vary;
+    e->code        = captured.status_code;
+    e->fields      = captured.headers;
+    e->etag        = std::string{captured.headers.get(field::etag).value_or(""sv)};
+    e->encoded     = std::move(c.bytes);
+    e->head_length = c.head_length;
+    e->lifetime    = lifetime;
+    e->refresh(clock::now());
+
+    // NOTE: what responses vary by is kept even once they don't, so that those kept from before aren't still found
+    auto primary_hash = hash_of(primary);
+    if (!vary.empty() || variants.get(primary_hash).has_value())
+    {
+        variants.set(primary_hash, std::make_shared<const std::vector<std::string>>(std::move(vary)));
+    }
+    entries.set(hash_of(e->key), e);
+    stored.fetch_add(1, std::memory_order::relaxed);
+
+    co_return e;
+}
+
+}
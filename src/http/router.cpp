@@ -1,102 +1,288 @@
 #include "http/router.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
 #include <functional>
-#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "coro/task.hpp"
 #include "http/request.hpp"
 #include "http/response.hpp"
-#include "util/string_util.hpp"
 
-namespace net::http
+using namespace std::string_view_literals;
+
+namespace
 {
 
-router& router::add(request_method method, std::string_view route, handler_func&& h)
+using net::http::path_params;
+using net::http::response_writer;
+using net::http::router;
+using net::http::server_request;
+using net::http::status;
+
+net::coro::task<void> reply(response_writer& resp, status code) { co_await resp.send(code, 0); }
+
+// call_with_params keeps params for as long as h runs.
+net::coro::task<void> call_with_params(const router::route_handler& h,
+                                       const server_request&        req,
+                                       response_writer&             resp,
+                                       path_params                  params)
+{
+    co_await std::invoke(h.with_params, req, resp, params);
+}
+
+// normalize returns route with the one leading '/' that every path has.
+std::string normalize(std::string_view route)
 {
-    auto& sub                   = get_subrouter(route);
-    sub.method_handlers[method] = h;
+    std::string out;
+    if (!route.starts_with('/')) out.push_back('/');
+    out.append(route);
 
-    return *this;
+    return out;
 }
 
-coro::task<void> router::operator()(const server_request& req, response_writer& resp) const
+}
+
+namespace net::http
 {
-    std::string_view route = req.uri.path;
 
-    if (route.starts_with('/'))
+std::optional<std::string_view> path_params::get(std::string_view name) const noexcept
+{
+    for (const auto& p : *this)
     {
-        route = route.substr(1);
+        if (p.name == name) return p.value;
     }
 
-    auto* parent = this;
-    for (const auto part : util::split_string(route, '/'))
+    return std::nullopt;
+}
+
+router& router::add(request_method method, std::string_view route, handler_func&& h)
+{
+    return add(method, route, route_handler{.plain = std::move(h), .with_params = {}});
+}
+
+router& router::add(request_method method, std::string_view route, param_handler_func&& h)
+{
+    return add(method, route, route_handler{.plain = {}, .with_params = std::move(h)});
+}
+
+router& router::add(request_method method, std::string_view route, route_handler&& h)
+{
+    const auto m = static_cast<std::size_t>(method);
+    if (m >= method_count) throw std::runtime_error{"no such method"};
+
+    auto  normalized = normalize(route);
+    auto& n          = nodes[insert(normalized)];
+
+    if (n.route_set < 0)
     {
-        auto iter = parent->children.find(part);
-        if (iter != parent->children.end())
-        {
-            parent = &iter->second;
-        }
-        else if (parent->wildcard != nullptr)
-        {
-            parent = parent->wildcard.get();
-        }
-        else
-        {
-            co_await resp.send(status::NOT_FOUND, 0);
-            co_return;
-        }
+        n.route_set = static_cast<std::int32_t>(route_sets.size());
+        route_sets.emplace_back();
     }
 
-    auto iter = parent->method_handlers.find(req.method);
-    if (iter == parent->method_handlers.end())
+    auto& slot = route_sets[static_cast<std::size_t>(n.route_set)][m];
+    if ((n.methods & (1U << m)) != 0)
     {
-        co_await resp.send(status::METHOD_NOT_ALLOWED, 0);
-        co_return;
+        handlers[slot] = std::move(h);
+        return *this;
     }
 
-    co_await std::invoke(iter->second, req, resp);
+    n.methods |= static_cast<std::uint16_t>(1U << m);
+    slot = static_cast<std::uint32_t>(handlers.size());
+    handlers.push_back(std::move(h));
+    records.push_back({.method = method, .route = std::move(normalized)});
+
+    return *this;
 }
 
-router& router::get_subrouter(std::string_view route)
+router& router::merge(std::string_view route, router&& sub)
 {
-    if (route.starts_with('/'))
+    auto prefix = normalize(route);
+    if (prefix.ends_with('/')) prefix.pop_back();
+
+    for (std::size_t i = 0; i < sub.handlers.size(); ++i)
     {
-        route = route.substr(1);
+        add(sub.records[i].method, prefix + sub.records[i].route, std::move(sub.handlers[i]));
     }
 
-    auto* current = this;
-    for (const auto part : util::split_string(route, '/'))
+    return *this;
+}
+
+router& router::fallback(handler_func&& h)
+{
+    fallback_handler = std::move(h);
+
+    return *this;
+}
+
+std::size_t router::add_node(std::string_view text)
+{
+    node n;
+    n.label_offset = static_cast<std::uint32_t>(labels.size());
+    n.label_length = static_cast<std::uint32_t>(text.size());
+    n.lead         = text.empty() ? '\0' : text.front();
+
+    labels.append(text);
+    nodes.push_back(n);
+
+    return nodes.size() - 1;
+}
+
+void router::split(std::size_t at, std::size_t length)
+{
+    // the node keeps the start of its label, and a new one takes the rest, with everything that hung off the node
+    node tail = nodes[at];
+    tail.label_offset += static_cast<std::uint32_t>(length);
+    tail.label_length -= static_cast<std::uint32_t>(length);
+    tail.lead         = labels[tail.label_offset];
+    tail.next_sibling = -1;
+    nodes.push_back(tail);
+
+    auto& head          = nodes[at];
+    head.label_length   = static_cast<std::uint32_t>(length);
+    head.first_child    = static_cast<std::int32_t>(nodes.size() - 1);
+    head.wildcard_child = -1;
+    head.methods        = 0;
+    head.route_set      = -1;
+}
+
+std::size_t router::insert(std::string_view route)
+{
+    if (nodes.empty()) add_node({});
+
+    std::size_t at            = 0;
+    std::size_t wildcards     = 0;
+    bool        segment_start = false;
+    while (!route.empty())
     {
-        // wildcard
-        if (part.starts_with(':'))
+        // a wildcard is a whole segment
+        if (segment_start && route.front() == ':')
         {
-            if (part.length() == 1)
-            {
-                throw std::runtime_error{"wildcard name must not be empty"};
-            }
+            auto name = route.substr(1, route.find('/') - 1);
+            if (name.empty()) throw std::runtime_error{"wildcard name must not be empty"};
+            if (++wildcards > path_params::max_params) throw std::runtime_error{"too many wildcards"};
 
-            if (current->wildcard == nullptr)
+            auto child = nodes[at].wildcard_child;
+            if (child < 0)
             {
-                current->wildcard      = std::make_unique<router>();
-                current->wildcard_name = part.substr(1);
+                child                    = static_cast<std::int32_t>(add_node(name));
+                nodes[at].wildcard_child = child;
             }
-            else if (current->wildcard_name != part.substr(1))
+            else if (label(nodes[static_cast<std::size_t>(child)]) != name)
             {
                 throw std::runtime_error{"mismatched wildcard name"};
             }
 
-            current = current->wildcard.get();
+            at            = static_cast<std::size_t>(child);
+            segment_start = false;
+            route.remove_prefix(name.size() + 1);
+            continue;
+        }
+
+        // literal text, as far as the next wildcard
+        auto literal = route.substr(0, std::min(route.find("/:"sv), route.size() - 1) + 1);
+
+        auto child = nodes[at].first_child;
+        while (child >= 0 && nodes[static_cast<std::size_t>(child)].lead != literal.front())
+        {
+            child = nodes[static_cast<std::size_t>(child)].next_sibling;
+        }
+
+        std::size_t consumed = literal.size();
+        if (child < 0)
+        {
+            auto added                = add_node(literal);
+            nodes[added].next_sibling = nodes[at].first_child;
+            nodes[at].first_child     = static_cast<std::int32_t>(added);
+            at                        = added;
         }
         else
         {
-            current = &current->children[part];
+            auto existing = label(nodes[static_cast<std::size_t>(child)]);
+            consumed      = static_cast<std::size_t>(std::ranges::mismatch(existing, literal).in1 - existing.begin());
+            if (consumed < existing.size()) split(static_cast<std::size_t>(child), consumed);
+
+            at = static_cast<std::size_t>(child);
         }
+
+        segment_start = literal[consumed - 1] == '/';
+        route.remove_prefix(consumed);
+    }
+
+    return at;
+}
+
+std::int32_t router::match(std::size_t at, std::string_view path, path_params& params) const noexcept
+{
+    if (path.empty()) return nodes[at].methods != 0 ? static_cast<std::int32_t>(at) : -1;
+
+    // Literal text first: there's only one child it could be, by its first character...
+    for (auto child = nodes[at].first_child; child >= 0; child = nodes[static_cast<std::size_t>(child)].next_sibling)
+    {
+        const auto& n = nodes[static_cast<std::size_t>(child)];
+        if (n.lead != path.front()) continue;
+
+        if (auto text = label(n); path.starts_with(text))
+        {
+            auto found = match(static_cast<std::size_t>(child), path.substr(text.size()), params);
+            if (found >= 0) return found;
+        }
+        break;
+    }
+
+    // ...and if that leads nowhere, a wildcard.
+    if (nodes[at].wildcard_child < 0) return -1;
+
+    auto value = path.substr(0, path.find('/'));
+    if (value.empty() || params.count == path_params::max_params) return -1;
+
+    const auto child                = static_cast<std::size_t>(nodes[at].wildcard_child);
+    params.items[params.count++] = {.name = label(nodes[child]), .value = value};
+
+    auto found = match(child, path.substr(value.size()), params);
+    if (found < 0) --params.count;
+
+    return found;
+}
+
+std::expected<const router::route_handler*, status>
+router::find(request_method method, std::string_view path, path_params& params) const noexcept
+{
+    params.count = 0;
+    if (nodes.empty()) return std::unexpected{status::NOT_FOUND};
+    if (path.empty()) path = "/"sv;
+
+    auto at = match(0, path, params);
+    if (at < 0) return std::unexpected{status::NOT_FOUND};
+
+    const auto& n = nodes[static_cast<std::size_t>(at)];
+    const auto  m = static_cast<std::size_t>(method);
+    if (m >= method_count || (n.methods & (1U << m)) == 0) return std::unexpected{status::METHOD_NOT_ALLOWED};
+
+    return &handlers[route_sets[static_cast<std::size_t>(n.route_set)][m]];
+}
+
+coro::task<void> router::operator()(const server_request& req, response_writer& resp) const
+{
+    path_params params;
+
+    auto found = find(req.method, req.uri.path, params);
+    if (!found)
+    {
+        if (fallback_handler) return std::invoke(fallback_handler, req, resp);
+        return reply(resp, found.error());
     }
 
-    return *current;
+    // A plain handler's task is handed straight back, without a frame of the router's own around it.
+    const auto& h = **found;
+    if (h.plain) return std::invoke(h.plain, req, resp);
+    return call_with_params(h, req, resp, params);
 }
 
 }
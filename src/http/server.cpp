@@ -1,13 +1,20 @@
 #include "http/server.hpp"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <exception>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string_view>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "coro/task.hpp"
 #include "exception.hpp"
@@ -16,13 +23,72 @@
 #include "http/request.hpp"
 #include "http/response.hpp"
 #include "http/router.hpp"
+#include "instrument/prometheus/buckets.hpp"
+#include "instrument/prometheus/gauge.hpp"
+#include "instrument/prometheus/histogram.hpp"
+#include "instrument/prometheus/registry.hpp"
 #include "io/buffered_reader.hpp"
 #include "io/buffered_writer.hpp"
 #include "io/io.hpp"
+#include "io/poll.hpp"
 #include "io/scheduler.hpp"
 #include "ip_addr.hpp"
 #include "listen.hpp"
+#include "socket.hpp"
 #include "tcp.hpp"
+#include "unix.hpp"
+#include "util/arena.hpp"
+#include "util/memory_budget.hpp"
+#include "util/string_util.hpp"
+
+namespace
+{
+
+using namespace std::string_view_literals;
+
+using net::coro::task;
+
+// discard reads body to the end, as long as that's no more than limit bytes, and returns whether it got there.
+task<bool> discard(net::io::reader& body, std::size_t limit)
+{
+    std::array<std::byte, 1'024> scratch{};
+
+    for (std::size_t total = 0; total <= limit;)
+    {
+        auto res = co_await body.read(scratch);
+        if (res.err) co_return res.err == net::io::status_condition::closed && total + res.count <= limit;
+
+        total += res.count;
+    }
+
+    co_return false;
+}
+
+// has_whole_head returns whether data starts with at least one request's whole head, i.e. it has a blank line.
+bool has_whole_head(std::span<const std::byte> data) noexcept
+{
+    const std::string_view text{reinterpret_cast<const char*>(data.data()), data.size()};
+    return text.find("\n\r\n"sv) != std::string_view::npos || text.find("\n\n"sv) != std::string_view::npos;
+}
+
+// starts_with_preface reads until it can tell whether the connection opens with HTTP/2's client preface, i.e. the
+// client knows the server speaks it, and skips asking to upgrade.
+task<bool> starts_with_preface(net::io::buffered_reader& reader)
+{
+    const auto preface = std::as_bytes(std::span{net::http::http2::client_preface});
+
+    while (true)
+    {
+        auto data = reader.buffered();
+        auto have = std::min(data.size(), preface.size());
+        if (!std::ranges::equal(data.first(have), preface.first(have))) co_return false;
+        if (have == preface.size()) co_return true;
+
+        if (co_await reader.more() == 0) co_return false;
+    }
+}
+
+}
 
 namespace net::http
 {
@@ -30,27 +96,114 @@ namespace net::http
 using namespace std::string_view_literals;
 
 server::server(io::scheduler* scheduler, router&& handler, const server_config& cfg)
-    : listener{scheduler,
-               cfg.host,
-               cfg.port,
-               network::tcp,
-               protocol::not_care,
-               std::chrono::duration_cast<std::chrono::microseconds>(cfg.header_read_timeout)}
+    : listener{!cfg.unix_path.empty() ? net::listener{scheduler, unix_addr{cfg.unix_path}}
+                                      : net::listener{scheduler,
+                                                      cfg.host,
+                                                      cfg.port,
+                                                      network::tcp,
+                                                      protocol::not_care,
+                                                      std::chrono::duration_cast<std::chrono::microseconds>(
+                                                          cfg.header_read_timeout),
+                                                      cfg.tcp,
+                                                      cfg.logger}}
     , is_serving{false}
     , handler{std::move(handler)}
     , logger{cfg.logger}
     , scheduler{scheduler}
     , max_header_bytes{cfg.max_header_bytes}
+    , header_read_timeout{cfg.header_read_timeout}
+    , idle_timeout{cfg.idle_timeout}
+    , write_timeout{cfg.write_timeout}
+    , idle_shed_after{cfg.idle_shed_after}
+    , max_body_bytes{cfg.max_body_bytes}
+    , budget{cfg.budget != nullptr ? cfg.budget : &util::memory_budget::shared()}
+    , request_arena_bytes{cfg.request_arena_bytes}
+    , max_unread_body_bytes{cfg.max_unread_body_bytes}
+    , max_pipeline_depth{std::max<std::size_t>(cfg.max_pipeline_depth, 1)}
     , max_pending_connections{cfg.max_pending_connections}
-{}
+    , max_accept_batch{cfg.max_accept_batch}
+    , zerocopy_threshold{cfg.zerocopy_threshold}
+    , rx_timestamps{cfg.rx_timestamps}
+    , tcp_info_sample_every{cfg.tcp_info_sample_every}
+    , http2_enabled{cfg.http2}
+    , http2_options{
+          .local             = cfg.http2_settings,
+          .connection_window = cfg.http2_connection_window,
+          .max_header_bytes  = cfg.max_header_bytes,
+          .idle_timeout      = cfg.idle_timeout,
+          .logger            = cfg.logger,
+      }
+{
+    namespace prometheus = instrument::prometheus;
+
+    if (rx_timestamps)
+    {
+        queueing_delay = &prometheus::registry::register_metric(prometheus::histogram{
+            "net_http_request_queueing_seconds",
+            "Time from a request arriving in the kernel to its handler being called",
+            {},
+            prometheus::exponential_buckets(0.000'01, 2, 20), // 10us up to about 5s
+        });
+    }
+
+    if (tcp_info_sample_every > 0)
+    {
+        tcp_rtt = &prometheus::registry::register_metric(prometheus::histogram{
+            "net_tcp_rtt_seconds",
+            "Smoothed round trip time of sampled connections, as they closed",
+            {},
+            prometheus::exponential_buckets(0.000'05, 2, 16), // 50us up to about 1.6s
+        });
+        tcp_retransmits = &prometheus::registry::register_metric(prometheus::histogram{
+            "net_tcp_retransmits",
+            "Segments retransmitted over the lifetime of sampled connections",
+            {},
+            {0, 1, 2, 4, 8, 16, 32, 64, 128},
+        });
+        tcp_cwnd = &prometheus::registry::register_metric(prometheus::histogram{
+            "net_tcp_cwnd_segments",
+            "Congestion window of sampled connections, as they closed",
+            {},
+            prometheus::exponential_buckets(1, 2, 12), // up to 2048 segments
+        });
+    }
+
+    if (cfg.sample_backlog)
+    {
+        auto& queued = prometheus::registry::register_metric(
+            prometheus::gauge{"net_listener_backlog", "Connections waiting to be accepted"});
+        auto& limit = prometheus::registry::register_metric(
+            prometheus::gauge{"net_listener_backlog_limit", "How many connections may wait to be accepted"});
+
+        // NOTE: the collector goes in close(), before the listener does
+        backlog_collector = prometheus::registry::add_collector(
+            [this, &queued, &limit]
+            {
+                auto backlog = listener.backlog();
+                if (!backlog.has_value()) return;
+
+                queued.set(static_cast<double>(backlog->queued));
+                limit.set(static_cast<double>(backlog->limit));
+            });
+    }
+}
 
 server::~server() { close(); }
 
 void server::close()
 {
+    if (backlog_collector.has_value())
+    {
+        instrument::prometheus::registry::remove_collector(*backlog_collector);
+        backlog_collector.reset();
+    }
+
     if (is_serving.exchange(false, std::memory_order::acq_rel))
     {
         listener.shutdown();
+
+        // connections waiting for memory give up instead
+        budget->wake_all();
         logger->flush();
     }
 }
@@ -69,15 +222,23 @@ coro::task<> server::serve()
         try
         {
             logger->trace("waiting for connection");
-            auto client_sock = co_await listener.accept();
-            logger->trace("connection accepted: {} -> {}", client_sock.remote_addr(), client_sock.local_addr());
-            if (!client_sock.valid())
+            auto client_socks = co_await listener.accept_many<socket>(max_accept_batch);
+            if (client_socks.empty())
             {
                 if (!is_serving.load(std::memory_order::acquire)) co_return;
                 else throw std::runtime_error{"listener unexpected closed"};
             }
 
-            scheduler->schedule(serve_connection(std::move(client_sock)));
+            std::vector<coro::task<>> conns;
+            conns.reserve(client_socks.size());
+
+            for (auto& client_sock : client_socks)
+            {
+                logger->trace("connection accepted: {} -> {}", client_sock.remote_addr(), client_sock.local_addr());
+                conns.push_back(serve_connection(std::move(client_sock)));
+            }
+
+            scheduler->schedule(std::move(conns));
         }
         catch (const std::exception& ex)
         {
@@ -86,133 +247,385 @@ coro::task<> server::serve()
     }
 }
 
-coro::task<> server::serve_connection(tcp_socket conn) noexcept
+server::connection::connection(socket& sock, std::size_t arena_bytes)
+    : sock{sock}
+    , reader{&sock}
+    , writer{&sock}
+    , arena{arena_bytes}
+{}
+
+coro::task<> server::serve_connection(socket sock) noexcept
 {
+    num_open.fetch_add(1, std::memory_order::relaxed);
+
     try
     {
-        while (is_serving.load(std::memory_order::acquire) && conn.valid())
+        if (zerocopy_threshold > 0 && !sock.enable_zerocopy(zerocopy_threshold))
         {
-            logger->trace("decoding request");
+            logger->debug("zerocopy not supported for connection");
+        }
 
-            request_decoder decode = nullptr;
-            switch (0) // TODO: determine version of HTTP before full decoding
-            {
-            case 1: decode = http11::request_decode; break;
-            case 2: decode = http2::request_decode; break;
+        if (rx_timestamps && !sock.enable_rx_timestamps())
+        {
+            logger->debug("rx timestamps not supported for connection");
+        }
 
-            default: decode = http11::request_decode; break;
-            }
+        sock.set_write_timeout(write_timeout);
+
+        // NOTE: the buffers last as long as the connection, so that whatever's read past the end of one request is
+        // still there for the next; and everything from the last request is gone by the time the arena's reset.
+        // If the server closes while this waits for room, the loop below finds it's not serving.
+        co_await wait_for_room();
+        connection conn{sock, request_arena_bytes};
+
+        for (bool first = true; is_serving.load(std::memory_order::acquire) && sock.valid(); first = false)
+        {
+            conn.arena.reset();
 
-            auto reader = std::make_unique<io::buffered_reader>(&conn);
-            auto writer = std::make_unique<io::buffered_writer>(&conn);
+            if (!co_await wait_for_request(conn)) break;
 
-            auto req_result = co_await decode(std::move(reader), max_header_bytes);
-            if (!req_result.has_value())
+            if (first && http2_enabled)
             {
-                auto err = req_result.error();
-                if (static_cast<io::status_condition>(err.value()) == io::status_condition::closed)
+                if (header_read_timeout.count() > 0)
                 {
-                    logger->debug("connection closed");
+                    conn.sock.set_read_deadline(socket::clock::now() + header_read_timeout);
                 }
-                else
+
+                auto is_http2 = co_await starts_with_preface(conn.reader);
+                conn.sock.set_read_deadline(socket::clock::time_point::max());
+
+                if (is_http2)
                 {
-                    logger->debug("request decoding error: {} '{}'", err.value(), err.message());
+                    co_await serve_http2(conn, nullptr);
+                    break;
                 }
-                break;
             }
+            if (!co_await serve_request(std::allocator_arg, &conn.arena, conn)) break;
+        }
 
-            logger->trace("request decoded");
+        // responses to pipelined requests can still be waiting, e.g. if the next one couldn't be decoded
+        if (conn.writer.size() > 0) co_await conn.writer.flush();
+    }
+    catch (const std::exception& ex)
+    {
+        logger->error("fatal exception in connection handler: {}", ex.what());
+    }
 
-            auto& req = req_result.value();
-            logger->trace("request {} {} as HTTP/{}.{}",
-                          method_string(req.method),
-                          req.uri.path,
-                          req.version.major,
-                          req.version.minor);
+    logger->trace("connection closing");
+    if (tcp_info_sample_every > 0 && num_closed.fetch_add(1, std::memory_order::relaxed) % tcp_info_sample_every == 0)
+    {
+        sample_tcp_info(sock);
+    }
 
-            bool             unsupported = false;
-            response_encoder encode      = nullptr;
-            switch (req.version.major)
-            {
-            case 1: encode = http11::response_encode; break;
-            case 2: encode = http2::response_encode; break;
-            default:
-                [[unlikely]] unsupported = true;
-                encode                   = http11::response_encode;
-                break;
-            }
+    sock.close();
+    num_open.fetch_sub(1, std::memory_order::relaxed);
+}
 
-            server_response resp{
-                .version = req.version,
-                .body    = writer.get(),
-            };
+// wait_for_room waits while memory's short, and returns whether the server's still serving. Another server on the same
+// budget closing wakes it too, so it checks again whether there's room.
+coro::task<bool> server::wait_for_room()
+{
+    while (is_serving.load(std::memory_order::acquire) && budget->under_pressure())
+    {
+        co_await budget->wait_for_room(scheduler, &is_serving);
+    }
 
-            response_writer rw{writer.get(), &resp, encode};
+    co_return is_serving.load(std::memory_order::acquire);
+}
 
-            if (unsupported)
-            {
-                logger->trace("unsupported http version: {}.{}", req.version.major, req.version.minor);
-                co_await rw.send(status::HTTP_VERSION_NOT_SUPPORTED, 0);
-            }
-            else if (auto upgrade_to = upgrade_to_protocol(req); !upgrade_to.empty())
-            {
-                logger->trace("upgrading to protocol: {}", upgrade_to);
-                resp.headers.set("Upgrade"sv, upgrade_to);
-                resp.headers.set("Connection"sv, "upgrade"sv);
-                co_await rw.send(status::SWITCHING_PROTOCOLS, 0);
-            }
-            else
-            {
-                logger->trace("calling handler");
-                co_await handler(req, rw);
-            }
+coro::task<bool> server::wait_for_request(connection& conn)
+{
+    // A request that came in right behind the last one is already buffered, and there's nothing to wait for.
+    if (conn.reader.size() > 0) co_return true;
+
+    // Between requests, the connection may idle for as long as the idle timeout allows.
+    //
+    // A request that follows right on from the last one finds a buffer ready and waiting. Once the connection has
+    // been quiet for idle_shed_after though, it's most likely idle, and holding on to buffers for it just wastes
+    // memory - so they go back to the pool, and it waits for its next byte without any.
+    //
+    // While memory is short, it doesn't read anything at all until there's room again: whatever the client sends
+    // next waits in the socket, and it's eventually pushed back by TCP flow control.
+    if (!co_await wait_for_room()) co_return false;
+
+    // NOTE: the idle timeout only counts from here, so neither a slow handler nor a long body runs into it
+    const auto idle_until = idle_timeout.count() > 0 ? socket::clock::now() + idle_timeout
+                                                     : socket::clock::time_point::max();
+
+    if (idle_shed_after.count() > 0)
+    {
+        conn.sock.set_read_deadline(std::min(idle_until, socket::clock::now() + idle_shed_after));
+        auto have_next = std::get<1>(co_await conn.reader.peek());
+        conn.sock.set_read_deadline(socket::clock::time_point::max());
 
-            logger->trace("flushing writer");
-            co_await writer->flush();
-            logger->trace("response sent");
+        if (have_next) co_return true;
+
+        if (conn.reader.error() != io::status_condition::timed_out || socket::clock::now() >= idle_until)
+        {
+            logger->debug("connection closed while idle: {}", conn.reader.error().message());
+            co_return false;
         }
     }
-    catch (const std::exception& ex)
+
+    conn.reader.release();
+    conn.writer.release();
+    conn.arena.release();
+
+    num_parked.fetch_add(1, std::memory_order::relaxed);
+    conn.sock.set_read_deadline(idle_until);
+    auto err = co_await conn.sock.wait(io::poll_op::read);
+    num_parked.fetch_sub(1, std::memory_order::relaxed);
+
+    if (err)
     {
-        logger->error("fatal exception in connection handler: {}", ex.what());
+        logger->debug("connection closed while idle: {}", err.message());
+        co_return false;
     }
 
-    logger->trace("connection closing");
+    if (!co_await wait_for_room()) co_return false;
+    auto have_next = std::get<1>(co_await conn.reader.peek());
+    conn.sock.set_read_deadline(socket::clock::time_point::max());
+
+    if (!have_next)
+    {
+        logger->debug("connection closed while idle: {}", conn.reader.error().message());
+        co_return false;
+    }
+
+    co_return true;
 }
 
-void server::serve_http11(tcp_socket conn) noexcept
+coro::task<bool> server::serve_request(std::allocator_arg_t, std::pmr::polymorphic_allocator<> alloc, connection& conn)
 {
-    while (is_serving && conn.valid())
-    {}
+    logger->trace("decoding request");
+
+    request_decoder decode = nullptr;
+    switch (0) // TODO: determine version of HTTP before full decoding
+    {
+    case 1: decode = http11::request_decode; break;
+    case 2: decode = http2::request_decode; break;
+
+    default: decode = http11::request_decode; break;
+    }
+
+    // the reader's first bytes have just been read, and that read's timestamp is when the request arrived
+    auto arrived_at = conn.sock.rx_timestamp();
+
+    // Once a request starts coming in, its headers have to be in within header_read_timeout - this caps slowloris
+    // clients.
+    if (header_read_timeout.count() > 0) conn.sock.set_read_deadline(socket::clock::now() + header_read_timeout);
+
+    auto req_result = co_await decode(std::allocator_arg, alloc, &conn.reader, max_header_bytes);
+    conn.sock.set_read_deadline(socket::clock::time_point::max());
+
+    if (!req_result.has_value())
+    {
+        auto err = req_result.error();
+        if (err == io::status_condition::closed)
+        {
+            logger->debug("connection closed");
+        }
+        else if (err == io::status_condition::timed_out)
+        {
+            logger->debug("timed out reading request");
+        }
+        else
+        {
+            logger->debug("request decoding error: {} '{}'", err.value(), err.message());
+        }
+        co_return false;
+    }
+
+    logger->trace("request decoded");
+
+    auto& req      = req_result.value();
+    req.arrived_at = arrived_at;
+    logger->trace("request {} {} as HTTP/{}.{}",
+                  method_string(req.method),
+                  req.uri.path,
+                  req.version.major,
+                  req.version.minor);
+
+    bool             unsupported = false;
+    response_encoder encode      = nullptr;
+    switch (req.version.major)
+    {
+    case 1: encode = http11::response_encode; break;
+    default:
+        [[unlikely]] unsupported = true;
+        encode                   = http11::response_encode;
+        break;
+    }
+
+    // The body is reserved before any of it is read, so a request that's too big for the memory left is turned away
+    // right away. Its reservation is held for as long as the handler runs.
+    auto body_length = req.headers.get_content_length().value_or(0);
+    if (max_body_bytes > 0 && body_length > max_body_bytes)
+    {
+        logger->debug("request body too large: {} bytes", body_length);
+        co_await refuse_request(conn, req, status::PAYLOAD_TOO_LARGE);
+        co_return false;
+    }
+
+    util::memory_budget::reservation body_reservation;
+    if (body_length > 0)
+    {
+        body_reservation = budget->try_hold(body_length);
+        if (!body_reservation)
+        {
+            logger->debug("no memory for request body: {} bytes", body_length);
+            co_await refuse_request(conn, req, status::SERVICE_UNAVAILABLE);
+            co_return false;
+        }
+    }
+
+    server_response resp{
+        .version = req.version,
+        .headers = headers{alloc},
+        .body    = &conn.writer,
+    };
+
+    response_writer rw{&conn.writer, &resp, encode};
+    bool            upgraded = false;
+    bool            to_http2 = false;
+
+    if (unsupported)
+    {
+        logger->trace("unsupported http version: {}.{}", req.version.major, req.version.minor);
+        co_await rw.send(status::HTTP_VERSION_NOT_SUPPORTED, 0);
+    }
+    else if (auto upgrade_to = upgrade_to_protocol(req); !upgrade_to.empty())
+    {
+        upgraded = true;
+        to_http2 = upgrade_to == "h2c"sv;
+        logger->trace("upgrading to protocol: {}", upgrade_to);
+        resp.headers.set(field::upgrade, upgrade_to);
+        resp.headers.set(field::connection, "upgrade"sv);
+        co_await rw.send(status::SWITCHING_PROTOCOLS, 0);
+    }
+    else
+    {
+        logger->trace("calling handler");
+        if (queueing_delay != nullptr && req.arrived_at.has_value())
+        {
+            // NOTE: the kernel stamps with the wall clock, which could have stepped since - no point recording that
+            std::chrono::duration<double> waited = std::chrono::system_clock::now() - *req.arrived_at;
+            if (waited.count() >= 0) queueing_delay->observe(waited.count());
+        }
+
+        co_await handler(req, rw);
+    }
+
+    const bool has_body = body_length > 0 || req.headers.is_chunked();
+
+    // Clients that pipeline send requests before they've had the responses to earlier ones. While the next request is
+    // already here, this response waits in the writer for that one's - so they all go out in one write, until there
+    // are max_pipeline_depth of them.
+    if (!has_body && !upgraded && conn.pipelined + 1 < max_pipeline_depth && has_whole_head(conn.reader.buffered()))
+    {
+        ++conn.pipelined;
+        co_return true;
+    }
+
+    logger->trace("flushing writer");
+    conn.pipelined = 0;
+    if (auto res = co_await conn.writer.flush(); res.err)
+    {
+        logger->debug("error sending response: {}", res.err.message());
+        co_return false;
+    }
+    logger->trace("response sent");
+
+    // The connection speaks HTTP/2 from here on, and the request is answered again on its first stream.
+    if (to_http2)
+    {
+        co_await serve_http2(conn, &req);
+        co_return false;
+    }
+
+    // The next request starts where this one's body ends, so whatever the handler didn't read of it is read past now.
+    if (has_body)
+    {
+        if (!co_await discard(*req.body, max_unread_body_bytes))
+        {
+            logger->debug("request body left unread, closing connection");
+            co_return false;
+        }
+    }
+
+    co_return true;
+}
+
+coro::task<> server::refuse_request(connection& conn, const server_request& req, status code)
+{
+    // NOTE: the body is never read, so the connection can't be used for another request
+    server_response resp{
+        .version = req.version,
+        .body    = &conn.writer,
+    };
+    resp.headers.set(field::connection, "close"sv);
+    if (code == status::SERVICE_UNAVAILABLE) resp.headers.set(field::retry_after, "1"sv);
+
+    response_writer rw{&conn.writer, &resp, http11::response_encode};
+    co_await rw.send(code, 0);
+    co_await conn.writer.flush();
 }
 
-void server::serve_http2(tcp_socket conn) noexcept
+void server::sample_tcp_info(const socket& conn) noexcept
+{
+    auto info = conn.tcp_info();
+    if (!info.has_value()) return;
+
+    tcp_rtt->observe(std::chrono::duration<double>{info->rtt}.count());
+    tcp_retransmits->observe(static_cast<double>(info->retransmits));
+    tcp_cwnd->observe(static_cast<double>(info->cwnd));
+}
+
+void server::serve_http11(socket conn) noexcept
 {
     while (is_serving && conn.valid())
     {}
 }
 
+coro::task<> server::serve_http2(connection& conn, const server_request* upgraded)
+{
+    logger->trace("serving HTTP/2");
+
+    auto err = co_await http2::serve(conn.sock, conn.reader, handler, http2_options, upgraded);
+    if (err) logger->debug("HTTP/2 connection closed: {}", err.message());
+}
+
 std::string_view server::upgrade_to_protocol(const server_request& req) const noexcept
 {
-    auto upgrade = req.headers.get_all("Upgrade"sv);
+    auto upgrade = req.headers.get_all(field::upgrade);
     if (!upgrade.has_value()) return ""sv;
 
-    std::string_view upgrade_to;
-    for (const auto& protocol : *upgrade)
+    // The request's answered over HTTP/2 once it's been upgraded, and it has to bring its settings with it. One with a
+    // body would have to be read all the way through first, which isn't worth it: it's answered over HTTP/1.1 instead.
+    const bool can_upgrade_to_h2c = req.headers.get("HTTP2-Settings"sv).has_value()
+                                 && req.headers.get_content_length().value_or(0) == 0 && !req.headers.is_chunked();
+
+    for (std::string_view protocols : *upgrade)
     {
-        if (is_protocol_supported(protocol))
+        // one field can list several, e.g. "h2c, HTTP/1.1"
+        while (true)
         {
-            upgrade_to = protocol;
-            break;
+            auto comma    = protocols.find(',');
+            auto protocol = util::trim_string(protocols.substr(0, comma));
+            if (is_protocol_supported(protocol) && (protocol != "h2c"sv || can_upgrade_to_h2c)) return protocol;
+            if (comma == std::string_view::npos) break;
+
+            protocols.remove_prefix(comma + 1);
         }
     }
 
-    return upgrade_to;
+    return ""sv;
 }
 
 bool server::is_protocol_supported(std::string_view protocol) const noexcept
 {
     if (protocol == "HTTP/1.1") return true;
+    if (protocol == "h2c") return http2_enabled;
 
     return false;
 }
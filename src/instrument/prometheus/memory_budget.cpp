@@ -0,0 +1,34 @@
+#include "instrument/prometheus/memory_budget.hpp"
+
+#include <string>
+
+#include "instrument/prometheus/gauge.hpp"
+#include "instrument/prometheus/registry.hpp"
+#include "util/memory_budget.hpp"
+
+namespace net::instrument::prometheus
+{
+
+void export_memory_budget(const util::memory_budget& budget, const std::string& prefix)
+{
+    auto& limit    = registry::register_metric(gauge{prefix + "_limit_bytes", "Memory budget limit, 0 if unlimited"});
+    auto& reserved = registry::register_metric(gauge{prefix + "_reserved_bytes", "Bytes reserved from the budget"});
+    auto& used     = registry::register_metric(gauge{prefix + "_used_bytes", "Bytes allocated out of reservations"});
+    auto& peak     = registry::register_metric(gauge{prefix + "_peak_reserved_bytes", "Most bytes ever reserved"});
+    auto& refused  = registry::register_metric(gauge{prefix + "_refused", "Reservations refused for lack of room"});
+    auto& waiting  = registry::register_metric(gauge{prefix + "_waiting", "Waiting for room in the budget"});
+
+    registry::add_collector(
+        [&]
+        {
+            auto stats = budget.stats();
+            limit.set(static_cast<double>(stats.limit));
+            reserved.set(static_cast<double>(stats.reserved));
+            used.set(static_cast<double>(stats.used));
+            peak.set(static_cast<double>(stats.peak_reserved));
+            refused.set(static_cast<double>(stats.refused));
+            waiting.set(static_cast<double>(stats.waiting));
+        });
+}
+
+}
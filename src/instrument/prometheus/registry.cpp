@@ -9,6 +9,7 @@
 #include <string_view>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "coro/task.hpp"
 #include "instrument/prometheus/counter.hpp"
@@ -27,11 +28,31 @@ std::unique_ptr<registry> registry::instance;
 std::once_flag            registry::initialized;
 // NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
 
+std::size_t registry::add_collector(std::function<void()>&& collect)
+{
+    auto* r = get();
+
+    std::lock_guard lock{r->mutex};
+
+    auto id = r->next_collector_id++;
+    r->collectors.emplace_back(id, std::move(collect));
+    return id;
+}
+
+void registry::remove_collector(std::size_t id)
+{
+    auto* r = get();
+
+    std::lock_guard lock{r->mutex};
+    std::erase_if(r->collectors, [id](const auto& entry) { return entry.first == id; });
+}
+
 coro::task<io::result> registry::record(io::writer& writer)
 {
     auto* r = get();
 
     std::shared_lock lock{r->mutex};
+    for (const auto& [id, collect] : r->collectors) collect();
     return r->record_all(writer);
 }
 
@@ -0,0 +1,106 @@
+#include "io/buffer_policy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "util/buffer_pool.hpp"
+#include "util/memory_budget.hpp"
+
+namespace
+{
+
+std::atomic<std::uint64_t> grows      = 0;
+std::atomic<std::uint64_t> shrinks    = 0;
+std::atomic<std::uint64_t> bytes_held = 0;
+
+}
+
+namespace net::io
+{
+
+buffer_stats buffer_usage() noexcept
+{
+    return {
+        .grows      = grows.load(std::memory_order::relaxed),
+        .shrinks    = shrinks.load(std::memory_order::relaxed),
+        .bytes_held = bytes_held.load(std::memory_order::relaxed),
+    };
+}
+
+namespace detail
+{
+
+std::vector<std::byte> acquire_buffer(const buffer_policy& policy, std::size_t size)
+{
+    std::vector<std::byte> buf;
+
+    if (policy.pool != nullptr) buf = policy.pool->get(size);
+    else buf.reserve(size);
+
+    bytes_held.fetch_add(buf.capacity(), std::memory_order::relaxed);
+    if (policy.budget != nullptr)
+    {
+        policy.budget->reserve(buf.capacity());
+        policy.budget->note_allocated(buf.capacity());
+    }
+
+    return buf;
+}
+
+void release_buffer(const buffer_policy& policy, std::vector<std::byte>& buf) noexcept
+{
+    bytes_held.fetch_sub(buf.capacity(), std::memory_order::relaxed);
+    if (policy.budget != nullptr)
+    {
+        policy.budget->note_freed(buf.capacity());
+        policy.budget->release(buf.capacity());
+    }
+
+    auto old = std::exchange(buf, {});
+    if (policy.pool != nullptr) policy.pool->put(std::move(old));
+}
+
+void resize_buffer(const buffer_policy& policy, std::vector<std::byte>& buf, std::size_t capacity)
+{
+    auto bigger = acquire_buffer(policy, capacity);
+    bigger.assign(buf.begin(), buf.end());
+
+    release_buffer(policy, buf);
+    buf = std::move(bigger);
+}
+
+bool grow_buffer(const buffer_policy& policy, std::vector<std::byte>& buf)
+{
+    if (buf.capacity() >= policy.max) return false;
+
+    auto capacity = std::min(buf.capacity() * 2, policy.max);
+
+    // NOTE: only checks there's room - resize_buffer reserves the bigger buffer itself, and releases the old one
+    if (policy.budget != nullptr)
+    {
+        auto extra = policy.pool != nullptr ? util::sized_buffer_pool::size_class(capacity) : capacity;
+        if (!policy.budget->try_reserve(extra)) return false;
+        policy.budget->release(extra);
+    }
+
+    resize_buffer(policy, buf, capacity);
+    grows.fetch_add(1, std::memory_order::relaxed);
+    return true;
+}
+
+bool shrink_buffer(const buffer_policy& policy, std::vector<std::byte>& buf)
+{
+    if (!buf.empty() || buf.capacity() <= policy.min) return false;
+
+    resize_buffer(policy, buf, policy.min);
+    shrinks.fetch_add(1, std::memory_order::relaxed);
+    return true;
+}
+
+}
+
+}
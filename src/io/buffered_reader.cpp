@@ -3,23 +3,46 @@
 #include <algorithm>
 #include <cstddef>
 #include <functional>
-#include <iterator>
 #include <span>
 #include <system_error>
 #include <tuple>
+#include <utility>
 
 #include "coro/task.hpp"
+#include "io/buffer_policy.hpp"
 #include "io/io.hpp"
 #include "io/reader.hpp"
 
 namespace net::io
 {
 
-buffered_reader::buffered_reader(reader* impl, std::size_t bufsize)
+buffered_reader::buffered_reader(reader* impl, const buffer_policy& policy)
     : impl{impl}
-    , buf{bufsize}
+    , policy{policy}
+    , buf{detail::acquire_buffer(policy, policy.initial)}
+    , last_full{detail::buffer_clock::now()}
+{}
+
+buffered_reader::buffered_reader(reader* impl, std::size_t bufsize)
+    : buffered_reader(impl, buffer_policy::fixed(bufsize))
+{}
+
+buffered_reader::~buffered_reader() { detail::release_buffer(policy, buf); }
+
+buffered_reader& buffered_reader::operator=(buffered_reader&& other) noexcept
 {
-    buf.resize(0);
+    if (this == &other) return *this;
+
+    detail::release_buffer(policy, buf);
+
+    impl      = other.impl;
+    policy    = other.policy;
+    buf       = std::exchange(other.buf, {});
+    head      = std::exchange(other.head, 0);
+    err       = other.err;
+    last_full = other.last_full;
+
+    return *this;
 }
 
 coro::task<result> buffered_reader::read(std::span<std::byte> data)
@@ -27,34 +50,19 @@ coro::task<result> buffered_reader::read(std::span<std::byte> data)
     if (data.empty()) co_return result{.count = 0};
 
     // easy way out
-    if (data.size() <= buf.size())
-    {
-        std::copy_n(buf.begin(), data.size(), data.begin());
-
-        auto end = buf.begin();
-        std::advance(end, data.size());
-
-        auto leftover = buf.size() - data.size();
-        auto new_end  = buf.begin();
-        std::advance(new_end, leftover);
-
-        std::copy_backward(end, buf.end(), new_end);
-        buf.resize(leftover);
-
-        co_return result{.count = data.size()};
-    }
+    if (data.size() <= size()) co_return result{.count = read_buffered(data)};
 
     // Note that we always (try to) read from the inner reader in buf.capacity() increments.
 
+    if (buf.capacity() == 0) buf = detail::acquire_buffer(policy, policy.initial);
+
     std::size_t total = 0;
 
     if (!buf.empty())
     {
         // copy over what we can...
 
-        std::copy_n(buf.begin(), buf.size(), data.begin());
-        total += buf.size();
-        buf.resize(0);
+        total += read_buffered(data);
     }
 
     // At this point, the buffer is empty. As long as length - total is larger
@@ -76,17 +84,9 @@ coro::task<result> buffered_reader::read(std::span<std::byte> data)
 
         // regardless of error, give the user what we can
 
-        auto available = std::min(leftover, buf.size());
-        std::copy_n(buf.begin(), available, data.subspan(total).begin());
-
+        auto available = read_buffered(data.subspan(total));
         total += available;
 
-        auto end = buf.begin();
-        std::advance(end, available);
-        std::copy(end, buf.end(), buf.begin());
-
-        buf.resize(buf.size() - available);
-
         // only report an error if we couldn't fulfill the caller's request
         if (available < leftover) co_return result{.count = total, .err = err};
     }
@@ -94,22 +94,53 @@ coro::task<result> buffered_reader::read(std::span<std::byte> data)
     co_return result{.count = total};
 }
 
+std::size_t buffered_reader::read_buffered(std::span<std::byte> data) noexcept
+{
+    auto amount = std::min(data.size(), size());
+    if (amount == 0) return 0;
+
+    std::copy_n(buf.begin() + static_cast<std::ptrdiff_t>(head), amount, data.begin());
+    consume(amount);
+
+    return amount;
+}
+
+coro::task<std::size_t> buffered_reader::more()
+{
+    auto before = size();
+    co_await fill();
+    co_return size() - before;
+}
+
+void buffered_reader::consume(std::size_t count) noexcept
+{
+    head += std::min(count, size());
+
+    // what's left stays where it is, until fill() needs the room
+    if (head == buf.size())
+    {
+        buf.resize(0);
+        head = 0;
+    }
+}
+
 coro::task<buffered_reader::read_until_result> buffered_reader::read_until(std::span<const std::byte> delim) noexcept
 {
     // do we already have an instance of delim in the buffer?
+    auto begin       = buf.begin() + static_cast<std::ptrdiff_t>(head);
     auto searcher    = std::boyer_moore_searcher{delim.begin(), delim.end()};
-    auto delim_begin = std::search(buf.begin(), buf.end(), searcher);
+    auto delim_begin = std::search(begin, buf.end(), searcher);
     if (delim_begin != buf.end())
     {
         co_return {
-            .data      = {buf.begin(), delim_begin},
+            .data      = {begin, delim_begin},
             .is_prefix = false,
             .err       = err,
         };
     }
 
     co_return {
-        .data      = {buf.begin(), buf.end()},
+        .data      = {begin, buf.end()},
         .is_prefix = true,
         .err       = {},
     };
@@ -119,27 +150,63 @@ coro::task<buffered_reader::read_until_result> buffered_reader::read_until(std::
 {
     using result_t = std::tuple<std::byte, bool>;
 
-    if (!buf.empty()) co_return result_t{buf.front(), true};
+    if (!buf.empty()) co_return result_t{buf[head], true};
     co_await fill();
 
     if (buf.empty()) co_return result_t{static_cast<std::byte>(0), false};
-    co_return result_t{buf.front(), true};
+    co_return result_t{buf[head], true};
 }
 
 void buffered_reader::reset(reader* other)
 {
     if (other != nullptr) impl = other;
     buf.resize(0);
+    head = 0;
     err.clear();
 }
 
-void buffered_reader::reset() { buf.resize(0); }
+void buffered_reader::reset()
+{
+    buf.resize(0);
+    head = 0;
+}
+
+bool buffered_reader::shrink() { return detail::shrink_buffer(policy, buf); }
+
+bool buffered_reader::release() noexcept
+{
+    if (!buf.empty() || buf.capacity() == 0) return false;
+
+    detail::release_buffer(policy, buf);
+    return true;
+}
 
 std::error_condition buffered_reader::error() const { return err; }
 
 coro::task<void> buffered_reader::fill()
 {
-    if (buf.size() == buf.capacity()) co_return;
+    auto now = detail::buffer_clock::now();
+
+    // it was released while idle
+    if (buf.capacity() == 0)
+    {
+        buf       = detail::acquire_buffer(policy, policy.initial);
+        last_full = now;
+    }
+
+    // It's been a while since the buffer was last too small, so it's probably bigger than it needs to be.
+    if (buf.empty() && now - last_full >= policy.shrink_after) shrink();
+
+    // What's been consumed is only moved out of the way once the room it leaves at the back has run out.
+    if (head > 0 && buf.size() == buf.capacity())
+    {
+        std::copy(buf.begin() + static_cast<std::ptrdiff_t>(head), buf.end(), buf.begin());
+        buf.resize(buf.size() - head);
+        head = 0;
+    }
+
+    // Out of room, e.g. a line longer than the buffer: make some, if the policy allows.
+    if (buf.size() == buf.capacity() && !detail::grow_buffer(policy, buf)) co_return;
 
     auto start     = buf.size();
     auto read_more = buf.capacity() - start;
@@ -147,6 +214,13 @@ coro::task<void> buffered_reader::fill()
     auto res = co_await impl->read(std::span{buf.data() + start, read_more});
     buf.resize(start + res.count);
     err = res.err;
+
+    // There was at least as much to read as we had room for, so next time, make more room.
+    if (res.count == read_more)
+    {
+        last_full = now;
+        detail::grow_buffer(policy, buf);
+    }
 }
 
 }
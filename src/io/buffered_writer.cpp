@@ -4,25 +4,59 @@
 #include <cstddef>
 #include <iterator>
 #include <span>
+#include <utility>
 
 #include "coro/task.hpp"
+#include "io/buffer_policy.hpp"
 #include "io/io.hpp"
 #include "io/writer.hpp"
 
 namespace net::io
 {
 
+buffered_writer::buffered_writer(writer* underlying, const buffer_policy& policy)
+    : impl{underlying}
+    , policy{policy}
+    , buf{detail::acquire_buffer(policy, policy.initial)}
+    , last_full{detail::buffer_clock::now()}
+{}
+
 buffered_writer::buffered_writer(writer* underlying, std::size_t bufsize)
-    : impl(underlying)
-    , buf(bufsize)
+    : buffered_writer(underlying, buffer_policy::fixed(bufsize))
+{}
+
+buffered_writer::~buffered_writer() { detail::release_buffer(policy, buf); }
+
+buffered_writer& buffered_writer::operator=(buffered_writer&& other) noexcept
 {
-    buf.resize(0);
+    if (this == &other) return *this;
+
+    detail::release_buffer(policy, buf);
+
+    impl      = other.impl;
+    policy    = other.policy;
+    buf       = std::exchange(other.buf, {});
+    last_full = other.last_full;
+
+    return *this;
 }
 
 coro::task<result> buffered_writer::write(std::span<const std::byte> data)
 {
     if (data.empty()) co_return result{.count = 0};
 
+    auto now = detail::buffer_clock::now();
+
+    // it was released while idle
+    if (buf.capacity() == 0)
+    {
+        buf       = detail::acquire_buffer(policy, policy.initial);
+        last_full = now;
+    }
+
+    // It's been a while since the buffer was last too small, so it's probably bigger than it needs to be.
+    if (buf.empty() && now - last_full >= policy.shrink_after) shrink();
+
     std::size_t total = 0;
 
     // fill up the buffer as much as possible first...
@@ -40,20 +74,26 @@ coro::task<result> buffered_writer::write(std::span<const std::byte> data)
     // we might be done!
     if (total == data.size()) co_return result{.count = data.size()};
 
-    // Note that we always write to the inner reader in buf.capacity() increments.
+    // Note that we always write to the inner writer in multiples of buf.capacity().
 
     // At this point, the buffer is full, and we have more to write, so flush it.
     if (buf.size() == buf.capacity())
     {
         auto res = co_await flush_available();
         if (res.err) co_return res;
+
+        // this didn't fit, so next time, make more room
+        last_full = now;
+        detail::grow_buffer(policy, buf);
     }
 
     // At this point, the buffer is now empty. As long as writes are larger than the capacity, bypass the buffer.
+    // Hand those over in one go, so the inner writer can do something smarter with large writes (e.g. MSG_ZEROCOPY).
 
     while (data.size() - total > buf.capacity())
     {
-        auto res = co_await impl->write(data.subspan(total, buf.capacity()));
+        auto remaining = data.size() - total;
+        auto res       = co_await impl->write(data.subspan(total, remaining - remaining % buf.capacity()));
         if (res.err) co_return result{.count = total + res.count, .err = res.err};
 
         total += res.count;
@@ -104,6 +144,16 @@ void buffered_writer::reset(writer* other)
 // reset clears the buffer.
 void buffered_writer::reset() { buf.resize(0); }
 
+bool buffered_writer::shrink() { return detail::shrink_buffer(policy, buf); }
+
+bool buffered_writer::release() noexcept
+{
+    if (!buf.empty() || buf.capacity() == 0) return false;
+
+    detail::release_buffer(policy, buf);
+    return true;
+}
+
 coro::task<result> buffered_writer::flush_available()
 {
     auto res = co_await impl->write(std::span{buf});
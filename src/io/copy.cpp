@@ -0,0 +1,81 @@
+#include "io/copy.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include "coro/task.hpp"
+#include "io/io.hpp"
+#include "io/reader.hpp"
+#include "io/writer.hpp"
+#include "util/buffer_pool.hpp"
+
+namespace
+{
+
+constexpr std::size_t copy_buffer_size = 32ull * 1024;
+
+net::util::buffer_pool& copy_buffers()
+{
+    static net::util::buffer_pool pool{copy_buffer_size, 16, 256};
+    return pool;
+}
+
+bool is_end_of_input(const net::io::result& res) noexcept
+{
+    return res.err == net::io::status_condition::closed || (!res.err && res.count == 0);
+}
+
+}
+
+namespace net::io
+{
+
+coro::task<result> copy(reader& in, writer& out, std::size_t limit)
+{
+    if (limit == 0) co_return result{};
+
+    auto direct = co_await out.read_from(in, limit);
+    if (direct.err != std::errc::not_supported) co_return direct;
+
+    std::size_t total = direct.count;
+
+    // Don't wait on the pool if it's exhausted - just pay for an allocation instead.
+    auto                   borrowed = copy_buffers().try_get();
+    std::vector<std::byte> fallback;
+    std::span<std::byte>   buf;
+
+    if (borrowed.has_value())
+    {
+        buf = *borrowed->get();
+    }
+    else
+    {
+        fallback.resize(copy_buffer_size);
+        buf = fallback;
+    }
+
+    while (total < limit)
+    {
+        auto read_res = co_await in.read(buf.first(std::min(buf.size(), limit - total)));
+
+        std::size_t written = 0;
+        while (written < read_res.count)
+        {
+            auto write_res = co_await out.write(buf.subspan(written, read_res.count - written));
+            written += write_res.count;
+            if (write_res.err) co_return result{.count = total + written, .err = write_res.err};
+        }
+
+        total += written;
+
+        if (is_end_of_input(read_res)) break;
+        if (read_res.err) co_return result{.count = total, .err = read_res.err};
+    }
+
+    co_return result{.count = total};
+}
+
+}
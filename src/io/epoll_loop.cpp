@@ -6,6 +6,7 @@
 
 // keep parent header above this
 
+#    include <algorithm>
 #    include <array>
 #    include <atomic>
 #    include <cerrno>
@@ -20,6 +21,7 @@
 #    include <string>
 #    include <system_error>
 #    include <type_traits>
+#    include <vector>
 
 #    include <sys/epoll.h>
 #    include <sys/eventfd.h>
@@ -52,24 +54,22 @@ EPOLL_EVENTS convert_poll_op(net::io::poll_op op)
     case poll_op::write: return EPOLLOUT;
     case poll_op::read_write:
         return static_cast<EPOLL_EVENTS>(EPOLLIN | EPOLLOUT);
+    case poll_op::error: return EPOLLERR;
     [[unlikely]] default:
         throw std::runtime_error("invalid poll_op value: "s
                                  + std::to_string(static_cast<std::underlying_type_t<poll_op>>(op)));
     }
 }
 
+// roughly_get_socket_buffer_size is how much there is to read from fd, or 0 if it can't tell.
+// There's no single cheap call for the room left in a send buffer, so writers don't ask: they send first, and only wait
+// here once the kernel has said EAGAIN - at which point there's no room anyway.
 std::size_t roughly_get_socket_buffer_size(int fd, net::io::poll_op op)
 {
-    using net::io::poll_op;
-
-    std::size_t request = 0;
-
-    if (is_readable(op)) request = FIONREAD;
-    else if (is_writable(op)) request = TIOCOUTQ;
-    else return 0;
+    if (!is_readable(op)) return 0;
 
     int  value  = 0;
-    auto status = ioctl(fd, request, &value);
+    auto status = ioctl(fd, FIONREAD, &value);
     if (status == -1) return 0;
 
     return static_cast<std::size_t>(value);
@@ -93,10 +93,10 @@ epoll_loop::epoll_loop(const std::shared_ptr<spdlog::logger>& logger)
 
     epoll_event ev{.events = EPOLLIN};
 
-    ev.data.fd = timer_fd;
+    ev.data.ptr = &timer_fd;
     if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1) throw system_error_from_errno(errno, "add timer fd");
 
-    ev.data.fd = shutdown_fd;
+    ev.data.ptr = &shutdown_fd;
     if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, shutdown_fd, &ev) == -1)
         throw system_error_from_errno(errno, "add shutdown fd");
 }
@@ -111,9 +111,11 @@ epoll_loop::~epoll_loop()
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const, "not really const")
-void epoll_loop::register_handle(handle handle)
+bool epoll_loop::register_handle(handle handle)
 {
-    epoll_event event{.events = 0, .data = {nullptr}};
+    // EPOLLHUP and EPOLLERR are reported even when not asked for, so this keeps them from firing over and over
+    // before anything waits on the handle.
+    epoll_event event{.events = EPOLLONESHOT, .data = {nullptr}};
 
     auto status = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, handle, &event);
     if (status == -1)
@@ -121,7 +123,11 @@ void epoll_loop::register_handle(handle handle)
         auto err = errno;
         if (err != EEXIST) // ignore already added fds
             throw system_error_from_errno(err, "registering handle");
+
+        return false;
     }
+
+    return true;
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const, "not really const")
@@ -163,14 +169,26 @@ coro::generator<event> epoll_loop::dispatch()
 
         if (ev.data.ptr == &timer_fd)
         {
+            // drain the expiration count, otherwise the timer stays readable
+            std::uint64_t expirations = 0;
+            ::read(timer_fd, &expirations, sizeof(expirations));
+
             dispatch_timeouts = true;
             continue;
         }
 
         if (ev.data.ptr == &shutdown_fd) continue;
 
+        // nothing is waiting on this handle (e.g. a hang up before the first wait)
+        if (ev.data.ptr == nullptr) continue;
+
         auto handle = std::coroutine_handle<promise>::from_address(ev.data.ptr);
 
+        {
+            std::lock_guard lock{timeout_list_mu};
+            cancel_timeout(handle);
+        }
+
         // NOTE: epoll doesn't tell us how much data is available. We can get it,
         // but we don't store the fd on the event.
         //
@@ -186,29 +204,37 @@ coro::generator<event> epoll_loop::dispatch()
 
     if (dispatch_timeouts)
     {
-        std::lock_guard lock{timeout_list_mu};
+        std::vector<std::coroutine_handle<promise>> expired;
 
-        auto now = clock::now();
-
-        while (!timeout_list.empty() && timeout_list.top().timeout_at <= now)
         {
-            auto op = timeout_list.top();
-            timeout_list.pop();
+            std::lock_guard lock{timeout_list_mu};
+
+            auto now = clock::now();
+
+            while (!timeout_list.empty() && timeout_list.begin()->first <= now)
+            {
+                auto op = timeout_list.begin()->second;
+                timeout_list.erase(timeout_list.begin());
+                timeouts_by_handle.erase(op.handle.address());
 
-            // drop already completed coroutines
-            if (!op.handle || op.handle.done()) continue;
+                // The event mustn't fire anymore, now that the timeout has. The handle may have been closed already,
+                // in which case there's nothing left to fire anyways.
+                epoll_event disable{.events = EPOLLONESHOT, .data = {nullptr}};
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, op.fd, &disable);
 
+                expired.push_back(op.handle);
+            }
+
+            if (!timeout_list.empty()) update_timer(timeout_list.begin()->first - now);
+        }
+
+        for (auto handle : expired)
+        {
             io::result res = {
                 .count = 0,
                 .err   = make_error_condition(status_condition::timed_out),
             };
-            co_yield event{op.handle, res};
-        }
-
-        if (!timeout_list.empty())
-        {
-            auto next_timeout = timeout_list.top().timeout_at - clock::now();
-            update_timer(std::chrono::duration_cast<std::chrono::milliseconds>(next_timeout));
+            co_yield event{handle, res};
         }
     }
 }
@@ -228,11 +254,9 @@ bool epoll_loop::operation::await_ready() const noexcept
 
 result epoll_loop::operation::await_resume()
 {
-    auto res = awaiting.promise().result();
-    if (res.err == status_condition::timed_out)
-    {
-        loop->disable_events(fd);
-    }
+    // if await_ready() said there was no need to wait, there's no result from the loop
+    result res{};
+    if (awaiting) res = awaiting.promise().result();
 
     auto count = roughly_get_socket_buffer_size(fd, op);
     if (count > 0) res.count = count;
@@ -254,40 +278,50 @@ void epoll_loop::queue(std::coroutine_handle<promise> awaiting,
     epoll_event ev{.events = convert_poll_op(op) | EPOLLONESHOT | EPOLLRDHUP};
     ev.data.ptr = awaiting.address();
 
-    auto status = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handle, &ev);
-    if (status == -1) throw system_error_from_errno(errno);
-
-    // If this timeout is shorter than the current (if any), check if we need to update the timer.
-    if (timeout > decltype(timeout)::zero())
+    if (timeout <= decltype(timeout)::zero())
     {
-        std::lock_guard lock{timeout_list_mu};
+        auto status = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handle, &ev);
+        if (status == -1) throw system_error_from_errno(errno);
+        return;
+    }
 
-        auto timeout_at = timeout + clock::now();
+    // The timeout is tracked before the event is armed, and under the same lock, so that dispatch() always sees
+    // one or the other complete first - never both.
+    std::lock_guard lock{timeout_list_mu};
 
-        if (timeout_list.empty() || timeout_list.top().timeout_at > timeout_at)
-        {
-            update_timer(timeout);
-        }
+    auto timeout_at = timeout + clock::now();
+
+    // If this timeout is shorter than the current (if any), the timer needs to go off sooner.
+    if (timeout_list.empty() || timeout_list.begin()->first > timeout_at) update_timer(timeout);
 
-        timeout_list.push(timeout_operation{
-            .handle     = awaiting,
-            .timeout_at = timeout_at,
-        });
+    auto it = timeout_list.emplace(timeout_at, timeout_operation{.handle = awaiting, .fd = handle});
+    timeouts_by_handle.emplace(awaiting.address(), it);
+
+    auto status = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handle, &ev);
+    if (status == -1)
+    {
+        auto err = errno;
+        cancel_timeout(awaiting);
+        throw system_error_from_errno(err);
     }
 }
 
-// NOLINTNEXTLINE(readability-make-member-function-const, "not really const")
-void epoll_loop::disable_events(handle handle)
+void epoll_loop::cancel_timeout(std::coroutine_handle<promise> handle) noexcept
 {
-    epoll_event ev{.events = 0, .data = {nullptr}};
+    auto it = timeouts_by_handle.find(handle.address());
+    if (it == timeouts_by_handle.end()) return;
 
-    auto status = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handle, &ev);
-    if (status == -1) throw system_error_from_errno(errno);
+    // the timer is left alone: if this was the next to go off, it'll go off early, and find nothing to do
+    timeout_list.erase(it->second);
+    timeouts_by_handle.erase(it);
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const, "not really const")
-void epoll_loop::update_timer(std::chrono::milliseconds timeout)
+void epoll_loop::update_timer(clock::duration timeout)
 {
+    // a zero timer is a disarmed timer, but anything due already should go off right away
+    timeout = std::max(timeout, clock::duration{1});
+
     auto sec  = std::chrono::duration_cast<std::chrono::seconds>(timeout);
     auto nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout) - sec;
 
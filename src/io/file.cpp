@@ -0,0 +1,316 @@
+#include "io/file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "coro/task.hpp"
+#include "coro/thread_pool.hpp"
+#include "detail/fd.hpp"
+#include "detail/resume.hpp"
+#include "exception.hpp"
+#include "io/io.hpp"
+#include "io/scheduler.hpp"
+
+namespace
+{
+
+using net::detail::errno_condition;
+using net::detail::resume_on;
+
+constexpr int invalid_fd = -1;
+
+int open_file(const std::string& path, int flags)
+{
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd == invalid_fd) throw net::system_error_from_errno(errno, "failed to open " + path);
+    return fd;
+}
+
+// read_some reads from fd once, at offset if it isn't null. The end of the file is reported as closed.
+net::io::result read_some(int fd, std::span<std::byte> data, const std::uint64_t* offset) noexcept
+{
+    while (true)
+    {
+        auto num = offset != nullptr ? ::pread(fd, data.data(), data.size(), static_cast<off_t>(*offset))
+                                     : ::read(fd, data.data(), data.size());
+        if (num > 0) return {.count = static_cast<std::size_t>(num)};
+        if (num == 0) return {.err = make_error_condition(net::io::status_condition::closed)};
+
+        auto err = errno;
+        if (err != EINTR) return {.err = errno_condition(err)};
+    }
+}
+
+// write_fully writes all of data to fd, at offset if it isn't null.
+net::io::result write_fully(int fd, std::span<const std::byte> data, const std::uint64_t* offset) noexcept
+{
+    std::size_t total = 0;
+
+    while (total < data.size())
+    {
+        auto rest = data.subspan(total);
+        auto num  = offset != nullptr ? ::pwrite(fd, rest.data(), rest.size(), static_cast<off_t>(*offset + total))
+                                      : ::write(fd, rest.data(), rest.size());
+        if (num < 0)
+        {
+            auto err = errno;
+            if (err == EINTR) continue;
+            return {.count = total, .err = errno_condition(err)};
+        }
+
+        total += static_cast<std::size_t>(num);
+    }
+
+    return {.count = total};
+}
+
+void close_fd(int& fd) noexcept
+{
+    if (fd != invalid_fd) ::close(std::exchange(fd, invalid_fd));
+}
+
+}
+
+namespace net::io
+{
+
+file_reader::file_reader(scheduler* scheduler, std::shared_ptr<coro::thread_pool> pool, const std::string& path)
+    : sched{scheduler}
+    , pool{std::move(pool)}
+    , fd{open_file(path, O_RDONLY)}
+{
+#ifdef NET_IS_LINUX
+    // it's read front to back, so the kernel may as well read ahead aggressively
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+file_reader::file_reader(file_reader&& other) noexcept
+    : sched{other.sched}
+    , pool{std::move(other.pool)}
+    , fd{std::exchange(other.fd, invalid_fd)}
+{}
+
+file_reader& file_reader::operator=(file_reader&& other) noexcept
+{
+    if (this == &other) return *this;
+
+    close_fd(fd);
+
+    sched = other.sched;
+    pool  = std::move(other.pool);
+    fd    = std::exchange(other.fd, invalid_fd);
+
+    return *this;
+}
+
+file_reader::~file_reader() { close_fd(fd); }
+
+coro::task<result> file_reader::read(std::span<std::byte> data)
+{
+    if (data.empty()) co_return result{};
+
+    co_await pool->schedule();
+    auto res = read_some(fd, data, nullptr);
+    co_await resume_on{sched};
+    co_return res;
+}
+
+coro::task<result> file_reader::read_at(std::span<std::byte> data, std::uint64_t offset)
+{
+    if (data.empty()) co_return result{};
+
+    co_await pool->schedule();
+    auto res = read_some(fd, data, &offset);
+    co_await resume_on{sched};
+    co_return res;
+}
+
+std::uint64_t file_reader::size() const noexcept
+{
+    struct stat info{};
+    if (::fstat(fd, &info) == -1) return 0;
+    return static_cast<std::uint64_t>(info.st_size);
+}
+
+mapped_file_reader::mapped_file_reader(const std::string& path, std::size_t readahead)
+    : fd{open_file(path, O_RDONLY)}
+    , readahead{readahead}
+{
+    struct stat info{};
+    if (::fstat(fd, &info) == -1)
+    {
+        auto err = errno;
+        close_fd(fd);
+        throw system_error_from_errno(err, "failed to stat " + path);
+    }
+
+    length = static_cast<std::size_t>(info.st_size);
+
+    // there's nothing to map for an empty file (and mmap(2) won't map 0 bytes)
+    if (length == 0) return;
+
+    void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        auto err = errno;
+        close_fd(fd);
+        throw system_error_from_errno(err, "failed to map " + path);
+    }
+
+    base = static_cast<std::byte*>(addr);
+
+    // only a hint, so failing is no big deal
+    ::madvise(base, length, MADV_SEQUENTIAL);
+    advise();
+}
+
+mapped_file_reader::mapped_file_reader(mapped_file_reader&& other) noexcept
+    : fd{std::exchange(other.fd, invalid_fd)}
+    , base{std::exchange(other.base, nullptr)}
+    , length{std::exchange(other.length, 0)}
+    , position{std::exchange(other.position, 0)}
+    , advised{std::exchange(other.advised, 0)}
+    , readahead{other.readahead}
+{}
+
+mapped_file_reader& mapped_file_reader::operator=(mapped_file_reader&& other) noexcept
+{
+    if (this == &other) return *this;
+
+    if (base != nullptr) ::munmap(base, length);
+    close_fd(fd);
+
+    fd        = std::exchange(other.fd, invalid_fd);
+    base      = std::exchange(other.base, nullptr);
+    length    = std::exchange(other.length, 0);
+    position  = std::exchange(other.position, 0);
+    advised   = std::exchange(other.advised, 0);
+    readahead = other.readahead;
+
+    return *this;
+}
+
+mapped_file_reader::~mapped_file_reader()
+{
+    if (base != nullptr) ::munmap(base, length);
+    close_fd(fd);
+}
+
+coro::task<result> mapped_file_reader::read(std::span<std::byte> data)
+{
+    if (data.empty()) co_return result{};
+
+    auto chunk = next(data.size());
+    if (chunk.empty()) co_return result{.err = make_error_condition(status_condition::closed)};
+
+    std::memcpy(data.data(), chunk.data(), chunk.size());
+    co_return result{.count = chunk.size()};
+}
+
+std::span<const std::byte> mapped_file_reader::next(std::size_t max) noexcept
+{
+    auto amount = std::min(max, length - position);
+
+    std::span<const std::byte> chunk{base + position, amount};
+    position += amount;
+    advise();
+
+    return chunk;
+}
+
+void mapped_file_reader::advise() noexcept
+{
+    if (readahead == 0 || advised >= length) return;
+
+    // ask for the next window once we're half way through the last one, so it has time to come in
+    if (advised > position && advised - position > readahead / 2) return;
+
+    static const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    // madvise(2) wants a page aligned start
+    auto start = std::max(advised, position) / page_size * page_size;
+    auto end   = std::min(length, position + readahead);
+
+    if (end > start) ::madvise(base + start, end - start, MADV_WILLNEED);
+    advised = end;
+}
+
+file_writer::file_writer(scheduler*                         scheduler,
+                         std::shared_ptr<coro::thread_pool> pool,
+                         const std::string&                 path,
+                         mode                               how)
+    : sched{scheduler}
+    , pool{std::move(pool)}
+    , fd{open_file(path, O_WRONLY | O_CREAT | (how == mode::append ? O_APPEND : O_TRUNC))}
+{}
+
+file_writer::file_writer(file_writer&& other) noexcept
+    : sched{other.sched}
+    , pool{std::move(other.pool)}
+    , fd{std::exchange(other.fd, invalid_fd)}
+{}
+
+file_writer& file_writer::operator=(file_writer&& other) noexcept
+{
+    if (this == &other) return *this;
+
+    close_fd(fd);
+
+    sched = other.sched;
+    pool  = std::move(other.pool);
+    fd    = std::exchange(other.fd, invalid_fd);
+
+    return *this;
+}
+
+file_writer::~file_writer() { close_fd(fd); }
+
+coro::task<result> file_writer::write(std::span<const std::byte> data)
+{
+    if (data.empty()) co_return result{};
+
+    co_await pool->schedule();
+    auto res = write_fully(fd, data, nullptr);
+    co_await resume_on{sched};
+    co_return res;
+}
+
+coro::task<result> file_writer::write_at(std::span<const std::byte> data, std::uint64_t offset)
+{
+    if (data.empty()) co_return result{};
+
+    co_await pool->schedule();
+    auto res = write_fully(fd, data, &offset);
+    co_await resume_on{sched};
+    co_return res;
+}
+
+coro::task<std::error_condition> file_writer::sync()
+{
+    co_await pool->schedule();
+#ifdef NET_IS_LINUX
+    auto ret = ::fdatasync(fd);
+#else
+    auto ret = ::fsync(fd);
+#endif
+    auto err = ret == -1 ? errno_condition(errno) : std::error_condition{};
+    co_await resume_on{sched};
+    co_return err;
+}
+
+}
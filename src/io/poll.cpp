@@ -25,5 +25,6 @@ poll_op operator|(poll_op lhs, poll_op rhs) noexcept
 
 bool is_readable(poll_op op) noexcept { return (op & poll_op::read) == poll_op::read; }
 bool is_writable(poll_op op) noexcept { return (op & poll_op::write) == poll_op::write; }
+bool is_error(poll_op op) noexcept { return (op & poll_op::error) == poll_op::error; }
 
 }
@@ -7,6 +7,7 @@
 #include <memory>
 #include <mutex>
 #include <utility>
+#include <vector>
 
 #include <spdlog/logger.h>
 
@@ -26,7 +27,7 @@ scheduler::scheduler(std::shared_ptr<coro::thread_pool> workers, const std::shar
 
 scheduler::~scheduler() noexcept { shutdown(); }
 
-void scheduler::register_handle(handle handle) { loop.register_handle(handle); }
+bool scheduler::register_handle(handle handle) { return loop.register_handle(handle); }
 void scheduler::deregister_handle(handle handle) { loop.deregister_handle(handle); }
 
 bool scheduler::schedule(coro::task<>&& task) noexcept
@@ -41,6 +42,20 @@ bool scheduler::schedule(coro::task<>&& task) noexcept
     return workers->resume(handle);
 }
 
+std::size_t scheduler::schedule(std::vector<coro::task<>>&& batch)
+{
+    std::vector<std::coroutine_handle<>> handles;
+    handles.reserve(batch.size());
+
+    {
+        std::lock_guard lock{tasks_mu};
+        for (auto& task : batch) handles.emplace_back(tasks.emplace_back(std::move(task)).get_handle());
+    }
+
+    // hand them to the workers all at once, so they get spread out instead of trickling in one at a time
+    return workers->resume(handles);
+}
+
 bool scheduler::resume(std::coroutine_handle<> handle) noexcept
 {
     if (handle == nullptr) return false;
@@ -3,9 +3,14 @@
 #include <atomic>
 #include <cerrno>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <system_error>
 #include <utility>
+#include <vector>
 
 #include <fcntl.h>
 #include <netdb.h>
@@ -13,26 +18,70 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <spdlog/logger.h>
+
+#include "config.hpp"
 #include "coro/task.hpp"
+#include "detail/fd.hpp"
 #include "exception.hpp"
 #include "io/poll.hpp"
 #include "io/scheduler.hpp"
 #include "ip_addr.hpp"
+#include "socket.hpp"
 #include "tcp.hpp"
+#include "unix.hpp"
+
+namespace
+{
+
+using net::detail::would_block;
+using net::detail::set_nonblocking;
+
+// the connection went away before it could be accepted, or a signal got in the way - just try again
+bool is_transient(int err) noexcept { return err == EINTR || err == ECONNABORTED; }
+
+// accept_one accepts a pending connection without blocking.
+// Returns -1 and sets errno if there isn't one.
+int accept_one(int fd) noexcept
+{
+#ifdef NET_IS_LINUX
+    return ::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int conn = ::accept(fd, nullptr, nullptr);
+    if (conn == -1) return -1;
+
+    if (!set_nonblocking(conn))
+    {
+        auto err = errno;
+        ::close(conn);
+        errno = err;
+        return -1;
+    }
+
+    return conn;
+#endif
+}
+
+}
 
 namespace net
 {
 
 constexpr int invalid_fd = -1;
 
-listener::listener(io::scheduler*            scheduler,
-                   const std::string&        host,
-                   const std::string&        port,
-                   network                   net,
-                   protocol                  proto,
-                   std::chrono::microseconds timeout)
+listener::listener(io::scheduler*                  scheduler,
+                   const std::string&              host,
+                   const std::string&              port,
+                   network                         net,
+                   protocol                        proto,
+                   std::chrono::microseconds       timeout,
+                   const tcp_options&              options,
+                   std::shared_ptr<spdlog::logger> logger)
     : scheduler{scheduler}
     , main_fd{invalid_fd}
+    , net{net}
+    , options{options}
+    , logger{std::move(logger)}
 {
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wmissing-field-initializers"
@@ -67,6 +116,14 @@ listener::listener(io::scheduler*            scheduler,
         main_fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
         if (main_fd < 0) continue;
 
+        // so accepting can go until there's nothing left, instead of blocking
+        if (!set_nonblocking(main_fd))
+        {
+            ::close(main_fd);
+            main_fd = invalid_fd;
+            continue;
+        }
+
         int yes = 1;
         sts     = ::setsockopt(main_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int));
         if (sts != 0)
@@ -76,6 +133,20 @@ listener::listener(io::scheduler*            scheduler,
             continue;
         }
 
+        if (net == network::tcp)
+        {
+            try
+            {
+                options.apply_listener(main_fd);
+            }
+            catch (...)
+            {
+                ::close(main_fd);
+                ::freeaddrinfo(servinfo);
+                throw;
+            }
+        }
+
         /* struct timeval tv = { */
         /*     .tv_sec  = 0, */
         /*     .tv_usec = static_cast<decltype(tv.tv_usec)>(timeout.count()), */
@@ -108,11 +179,45 @@ listener::listener(io::scheduler*            scheduler,
     scheduler->register_handle(main_fd);
 }
 
+listener::listener(io::scheduler* scheduler, const unix_addr& addr, network net)
+    : scheduler{scheduler}
+    , main_fd{invalid_fd}
+    , net{net}
+{
+    int type = 0;
+    switch (net)
+    {
+    case network::unix_stream: type = SOCK_STREAM; break;
+    case network::unix_seqpacket: type = SOCK_SEQPACKET; break;
+    default: throw exception{"invalid network type for a unix listener"};
+    }
+
+    main_fd = ::socket(AF_UNIX, type, 0);
+    if (main_fd == invalid_fd) throw system_error_from_errno(errno, "failed to create unix socket");
+
+    if (!set_nonblocking(main_fd) || ::bind(main_fd, addr.native(), addr.native_size()) != 0)
+    {
+        auto err = errno;
+        ::close(std::exchange(main_fd, invalid_fd));
+        throw system_error_from_errno(err, "failed to bind to " + addr.to_string());
+    }
+
+    if (!addr.is_abstract()) unix_path = addr.to_string();
+
+    scheduler->register_handle(main_fd);
+}
+
 listener::listener(listener&& other) noexcept
     : scheduler{std::exchange(other.scheduler, nullptr)}
     , is_listening{other.is_listening.exchange(false, std::memory_order::acq_rel)}
     , main_fd{std::exchange(other.main_fd, invalid_fd)}
-{}
+    , net{other.net}
+    , options{std::move(other.options)}
+    , logger{other.logger}
+    , unix_path{std::move(other.unix_path)}
+{
+    other.unix_path.clear();
+}
 
 listener& listener::operator=(listener&& other) noexcept
 {
@@ -121,6 +226,10 @@ listener& listener::operator=(listener&& other) noexcept
     scheduler    = std::exchange(other.scheduler, nullptr);
     is_listening = other.is_listening.exchange(false, std::memory_order::acq_rel);
     main_fd      = std::exchange(other.main_fd, invalid_fd);
+    net          = other.net;
+    options      = std::move(other.options);
+    logger       = other.logger;
+    unix_path    = std::exchange(other.unix_path, {});
 
     return *this;
 }
@@ -143,37 +252,108 @@ void listener::listen(std::uint16_t max_backlog)
     /* }); */
 }
 
-coro::task<tcp_socket> listener::accept() const
+std::optional<listener::backlog_statistics> listener::backlog() const noexcept
 {
-    if (!is_listening.load(std::memory_order::acquire)) throw exception{"not listening"};
+    if (net != network::tcp || !is_listening.load(std::memory_order::acquire)) return std::nullopt;
 
-    sockaddr_storage inc{};
-    socklen_t        inc_size = sizeof(inc);
+    // on a listening socket, TCP_INFO has the accept queue where a connection has its unacknowledged segments
+    return tcp_statistics::of(main_fd).transform(
+        [](const tcp_statistics& stats) { return backlog_statistics{.queued = stats.unacked, .limit = stats.sacked}; });
+}
 
-    auto res = co_await scheduler->schedule(native_handle(), io::poll_op::read, 0ms);
-    if (res.err) throw res.err;
-    if (res.count == 0) co_return tcp_socket{scheduler};
+template<typename Socket>
+coro::task<Socket> listener::accept() const
+{
+    if (!is_listening.load(std::memory_order::acquire)) throw exception{"not listening"};
 
-    int inc_fd = ::accept(main_fd, reinterpret_cast<sockaddr*>(&inc), &inc_size);
-    if (inc_fd == -1)
+    while (true)
     {
+        int inc_fd = accept_one(main_fd);
+        if (inc_fd != -1) co_return make_connection<Socket>(inc_fd);
+
+        auto err = errno;
+        if (is_transient(err)) continue;
+
         // return invalid socket to indicate shutdown
-        if (!is_listening.load(std::memory_order::acquire)) co_return tcp_socket{scheduler};
+        if (!is_listening.load(std::memory_order::acquire)) co_return Socket{scheduler, invalid_fd};
+
+        if (!would_block(err)) throw system_error_from_errno(err);
 
-        throw system_error_from_errno(errno);
+        auto res = co_await scheduler->schedule(native_handle(), io::poll_op::read, 0ms);
+        if (!is_listening.load(std::memory_order::acquire)) co_return Socket{scheduler, invalid_fd};
+        if (res.err && res.count == 0) throw res.err;
     }
+}
 
-    co_return tcp_socket{scheduler, inc_fd};
+template<typename Socket>
+coro::task<std::vector<Socket>> listener::accept_many(std::size_t max) const
+{
+    if (!is_listening.load(std::memory_order::acquire)) throw exception{"not listening"};
+
+    std::vector<Socket> conns;
+
+    while (true)
+    {
+        while (conns.size() < max)
+        {
+            int inc_fd = accept_one(main_fd);
+            if (inc_fd == -1)
+            {
+                auto err = errno;
+                if (is_transient(err)) continue;
+                if (would_block(err)) break;
+
+                // hand over what we have - the error will come up again next time, if it sticks around
+                if (!conns.empty() || !is_listening.load(std::memory_order::acquire)) co_return conns;
+
+                throw system_error_from_errno(err);
+            }
+
+            conns.push_back(make_connection<Socket>(inc_fd));
+        }
+
+        if (!conns.empty()) co_return conns;
+
+        auto res = co_await scheduler->schedule(native_handle(), io::poll_op::read, 0ms);
+        if (!is_listening.load(std::memory_order::acquire)) co_return conns;
+        if (res.err && res.count == 0) throw res.err;
+    }
 }
 
+template<typename Socket>
+Socket listener::make_connection(int fd) const
+{
+    Socket conn{scheduler, fd};
+
+    // the connection's still worth serving without them
+    if (net == network::tcp)
+    {
+        options.try_apply(fd,
+                          [&](const char* what, int err)
+                          {
+                              logger->warn("{} on accepted connection: {}", what, std::generic_category().message(err));
+                          });
+    }
+
+    return conn;
+}
+
+template coro::task<socket>                   listener::accept<socket>() const;
+template coro::task<tcp_socket>               listener::accept<tcp_socket>() const;
+template coro::task<unix_socket>              listener::accept<unix_socket>() const;
+template coro::task<std::vector<socket>>      listener::accept_many<socket>(std::size_t) const;
+template coro::task<std::vector<tcp_socket>>  listener::accept_many<tcp_socket>(std::size_t) const;
+template coro::task<std::vector<unix_socket>> listener::accept_many<unix_socket>(std::size_t) const;
+
 void listener::shutdown() noexcept
 {
     if (is_listening.exchange(false, std::memory_order::acq_rel) && main_fd != invalid_fd)
     {
-        ::close(main_fd);
         scheduler->deregister_handle(main_fd);
-        main_fd = invalid_fd;
+        ::close(std::exchange(main_fd, invalid_fd));
     }
+
+    if (!unix_path.empty()) ::unlink(std::exchange(unix_path, {}).c_str());
 }
 
 }
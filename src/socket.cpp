@@ -1,35 +1,63 @@
 #include "socket.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cerrno>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <optional>
 #include <span>
 #include <string>
 #include <system_error>
 #include <utility>
+#include <vector>
 
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/select.h>
 #include <sys/signal.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include "config.hpp"
+
+#ifdef NET_IS_LINUX
+#    include <sys/sendfile.h>
+
+#    include <linux/errqueue.h>
+#    include <linux/net_tstamp.h>
+#endif
+
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include "coro/task.hpp"
 #include "exception.hpp"
 #include "io/io.hpp"
 #include "io/poll.hpp"
+#include "io/reader.hpp"
 #include "io/scheduler.hpp"
+#include "util/defer.hpp"
 
 namespace
 {
 
+using namespace std::chrono_literals;
+
+// how much to ask the kernel to move per sendfile/splice call
+constexpr std::size_t direct_copy_chunk = 256ull * 1024;
+
+// sent_before is whether send a came before send b. The kernel's counter of zerocopy sends wraps, so it compares by
+// distance.
+constexpr bool sent_before(std::uint32_t a, std::uint32_t b) noexcept { return static_cast<std::int32_t>(a - b) < 0; }
+
 std::string addr_name(sockaddr_storage* addr)
 {
     std::string ret;
@@ -46,6 +74,14 @@ std::string addr_name(sockaddr_storage* addr)
         addr_type = &reinterpret_cast<sockaddr_in6*>(addr)->sin6_addr;
         break;
 
+    case AF_UNIX:
+    {
+        // the peer of a unix socket is usually unnamed, leaving an empty path
+        const auto* path = reinterpret_cast<sockaddr_un*>(addr)->sun_path;
+        if (path[0] == '\0' && path[1] != '\0') return "@" + std::string{path + 1};
+        return std::string{path};
+    }
+
     default:
         [[unlikely]]
 #ifdef __cpp_lib_unreachable
@@ -69,12 +105,23 @@ socket::socket(io::scheduler* scheduler, io::handle fd)
     : scheduler{scheduler}
     , fd{fd}
 {
-    scheduler->register_handle(fd);
+    if (fd != invalid_fd) scheduler->register_handle(fd);
 }
 
 socket::socket(socket&& other) noexcept
     : scheduler{std::exchange(other.scheduler, nullptr)}
     , fd{std::exchange(other.fd, invalid_fd)}
+    , read_timeout{other.read_timeout}
+    , write_timeout{other.write_timeout}
+    , idle_timeout{other.idle_timeout}
+    , read_deadline{other.read_deadline}
+    , last_active{other.last_active}
+    , zerocopy_threshold{std::exchange(other.zerocopy_threshold, 0)}
+    , zerocopy_sent{other.zerocopy_sent}
+    , zerocopy_done{other.zerocopy_done}
+    , zerocopy_ahead{std::move(other.zerocopy_ahead)}
+    , rx_timestamps{std::exchange(other.rx_timestamps, false)}
+    , last_rx{other.last_rx}
 {}
 
 socket& socket::operator=(socket&& other) noexcept
@@ -84,11 +131,86 @@ socket& socket::operator=(socket&& other) noexcept
     fd        = std::exchange(other.fd, invalid_fd);
     scheduler = std::exchange(other.scheduler, nullptr);
 
+    read_timeout  = other.read_timeout;
+    write_timeout = other.write_timeout;
+    idle_timeout  = other.idle_timeout;
+    read_deadline = other.read_deadline;
+    last_active   = other.last_active;
+
+    zerocopy_threshold = std::exchange(other.zerocopy_threshold, 0);
+    zerocopy_sent      = other.zerocopy_sent;
+    zerocopy_done      = other.zerocopy_done;
+    zerocopy_ahead     = std::move(other.zerocopy_ahead);
+
+    rx_timestamps = std::exchange(other.rx_timestamps, false);
+    last_rx       = other.last_rx;
+
     return *this;
 }
 
 socket::~socket() { close(); }
 
+socket socket::duplicate() const
+{
+    int other = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (other == -1) throw system_error_from_errno(errno, "failed to duplicate socket");
+
+    socket dup{scheduler, other};
+    dup.read_timeout  = read_timeout;
+    dup.write_timeout = write_timeout;
+    dup.idle_timeout  = idle_timeout;
+    dup.last_active   = last_active;
+
+    return dup;
+}
+
+void socket::set_idle_timeout(std::chrono::milliseconds timeout) noexcept
+{
+    idle_timeout = timeout;
+    last_active  = clock::now();
+}
+
+socket::clock::time_point socket::deadline_for(std::chrono::milliseconds timeout,
+                                               clock::time_point         deadline) const noexcept
+{
+    if (timeout > 0ms) deadline = std::min(deadline, clock::now() + timeout);
+    if (idle_timeout > 0ms) deadline = std::min(deadline, last_active + idle_timeout);
+    return deadline;
+}
+
+std::chrono::milliseconds socket::time_left(clock::time_point deadline) noexcept
+{
+    if (deadline == clock::time_point::max()) return 0ms;
+
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - clock::now());
+    return left > 0ms ? left : -1ms;
+}
+
+coro::task<std::error_condition> socket::wait(io::poll_op op) noexcept
+{
+    const auto deadline = io::is_readable(op) ? deadline_for(read_timeout, read_deadline)
+                                              : deadline_for(write_timeout, clock::time_point::max());
+
+    auto wait = time_left(deadline);
+    if (wait < 0ms) co_return make_error_condition(io::status_condition::timed_out);
+
+    auto res = co_await scheduler->schedule(fd, op, wait);
+    if (res.err && res.count == 0) co_return res.err;
+
+    co_return std::error_condition{};
+}
+
+coro::task<std::error_condition> socket::wait_writable(clock::time_point deadline)
+{
+    auto wait = time_left(deadline);
+    if (wait < 0ms) co_return make_error_condition(io::status_condition::timed_out);
+
+    auto res = co_await scheduler->schedule(fd, io::poll_op::write, wait);
+    if (res.err && res.count == 0) co_return res.err;
+
+    co_return std::error_condition{};
+}
+
 bool socket::valid() const noexcept
 {
     if (fd == invalid_fd || scheduler == nullptr) return false;
@@ -120,19 +242,24 @@ std::string socket::remote_addr() const
     return addr_name(&addr);
 }
 
-// TODO: timeout
 coro::task<net::io::result> socket::read(std::span<std::byte> data) noexcept
 {
+    const auto deadline = deadline_for(read_timeout, read_deadline);
+
     std::size_t received = 0;
 
     while (received < data.size())
     {
-        auto res = co_await scheduler->schedule(native_handle(), io::poll_op::read, 0ms);
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return {.count = received, .err = make_error_condition(io::status_condition::timed_out)};
+
+        auto res = co_await scheduler->schedule(native_handle(), io::poll_op::read, wait);
         if (res.err && res.count == 0) co_return res;
 
         auto read_amount = std::min(res.count, data.size() - received);
 
-        const std::int64_t num = ::recv(fd, data.data() + received, read_amount, 0);
+        const std::int64_t num = rx_timestamps ? recv_timestamped(data.data() + received, read_amount)
+                                               : ::recv(fd, data.data() + received, read_amount, 0);
         if (num < 0)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
@@ -153,6 +280,7 @@ coro::task<net::io::result> socket::read(std::span<std::byte> data) noexcept
         }
 
         received += static_cast<std::size_t>(num);
+        touch();
         break;
     }
 
@@ -161,20 +289,26 @@ coro::task<net::io::result> socket::read(std::span<std::byte> data) noexcept
 
 coro::task<io::result> socket::write(std::span<const std::byte> data) noexcept
 {
+    if (zerocopy_threshold > 0 && data.size() >= zerocopy_threshold) co_return co_await write_zerocopy(data);
+
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
     std::size_t total_written = 0;
 
     while (total_written < data.size())
     {
-        auto res = co_await scheduler->schedule(native_handle(), io::poll_op::write, 0ms);
-        if (res.err && res.count == 0) co_return res;
-
-        auto write_amount = std::min(res.count, data.size() - total_written);
-
-        const std::int64_t num = ::send(fd, data.data() + total_written, write_amount, 0);
+        // send first, and only wait for room once there isn't any
+        const std::int64_t num = ::send(fd, data.data() + total_written, data.size() - total_written, MSG_DONTWAIT);
         if (num < 0)
         {
             auto err = errno;
-            if (err == EAGAIN || err == EWOULDBLOCK) continue;
+            if (err == EAGAIN || err == EWOULDBLOCK)
+            {
+                auto res = co_await wait_writable(deadline);
+                if (res) co_return {.count = total_written, .err = res};
+                continue;
+            }
+
             co_return {
                 .count = total_written,
                 .err   = std::make_error_condition(static_cast<std::errc>(err)),
@@ -191,12 +325,405 @@ coro::task<io::result> socket::write(std::span<const std::byte> data) noexcept
         }
 
         total_written += static_cast<std::size_t>(num);
+        touch();
     }
 
     co_return {.count = total_written};
 }
 
-void socket::close(bool graceful, std::chrono::seconds graceful_timeout) const noexcept
+coro::task<io::result> socket::read_from(io::reader& in, std::size_t limit)
+{
+#ifdef NET_IS_LINUX
+    auto src = in.direct_handle();
+    if (src == -1) co_return {.err = std::make_error_condition(std::errc::not_supported)};
+
+    struct stat info{};
+    if (::fstat(src, &info) == -1) co_return {.err = std::make_error_condition(static_cast<std::errc>(errno))};
+
+    if (S_ISREG(info.st_mode)) co_return co_await send_file(src, limit);
+    if (S_ISSOCK(info.st_mode) || S_ISFIFO(info.st_mode)) co_return co_await splice_from(src, limit);
+#endif
+
+    co_return {.err = std::make_error_condition(std::errc::not_supported)};
+}
+
+coro::task<io::result> socket::send_file(io::handle src, std::size_t limit)
+{
+#ifdef NET_IS_LINUX
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
+    std::size_t total = 0;
+
+    while (total < limit)
+    {
+        // a null offset means the file's own position is used (and advanced), same as read() would
+        const auto num = ::sendfile(fd, src, nullptr, std::min(direct_copy_chunk, limit - total));
+        if (num < 0)
+        {
+            auto err = errno;
+            if (err == EAGAIN || err == EWOULDBLOCK)
+            {
+                auto res = co_await wait_writable(deadline);
+                if (res) co_return {.count = total, .err = res};
+                continue;
+            }
+
+            // e.g. a file system without sendfile support - nothing has been consumed, so the caller can fall back
+            if ((err == EINVAL || err == ENOSYS) && total == 0)
+                co_return {.err = std::make_error_condition(std::errc::not_supported)};
+
+            co_return {
+                .count = total,
+                .err   = std::make_error_condition(static_cast<std::errc>(err)),
+            };
+        }
+
+        // end of file
+        if (num == 0) break;
+
+        total += static_cast<std::size_t>(num);
+        touch();
+    }
+
+    co_return {.count = total};
+#else
+    co_return {.err = std::make_error_condition(std::errc::not_supported)};
+#endif
+}
+
+coro::task<io::result> socket::splice_from(io::handle src, std::size_t limit)
+{
+#ifdef NET_IS_LINUX
+    // splice(2) needs a pipe on one end, so bytes go src -> pipe -> fd, without ever being copied into user space.
+    std::array<int, 2> pipe_fds{-1, -1};
+    if (::pipe2(pipe_fds.data(), O_CLOEXEC | O_NONBLOCK) == -1)
+        co_return {.err = std::make_error_condition(static_cast<std::errc>(errno))};
+
+    // src may well be a socket on this scheduler already, in which case it's left registered
+    const bool registered = scheduler->register_handle(src);
+
+    util::defer clean_up{[&] noexcept
+                         {
+                             if (registered) scheduler->deregister_handle(src);
+                             ::close(pipe_fds[0]);
+                             ::close(pipe_fds[1]);
+                         }};
+
+    // waiting on src counts against the write too: it's all one write, as far as the caller is concerned
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
+    std::size_t total = 0;
+
+    while (total < limit)
+    {
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return {.count = total, .err = make_error_condition(io::status_condition::timed_out)};
+
+        auto res = co_await scheduler->schedule(src, io::poll_op::read, wait);
+        if (res.err && res.count == 0)
+        {
+            if (res.err == io::status_condition::closed) break;
+            co_return {.count = total, .err = res.err};
+        }
+
+        const auto in_pipe = ::splice(src,
+                                      nullptr,
+                                      pipe_fds[1],
+                                      nullptr,
+                                      std::min(direct_copy_chunk, limit - total),
+                                      SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (in_pipe < 0)
+        {
+            auto err = errno;
+            if (err == EAGAIN || err == EWOULDBLOCK) continue;
+
+            if (err == EINVAL && total == 0) co_return {.err = std::make_error_condition(std::errc::not_supported)};
+
+            co_return {
+                .count = total,
+                .err   = std::make_error_condition(static_cast<std::errc>(err)),
+            };
+        }
+
+        // end of input
+        if (in_pipe == 0) break;
+
+        auto pending = static_cast<std::size_t>(in_pipe);
+        while (pending > 0)
+        {
+            const auto out_pipe =
+                ::splice(pipe_fds[0], nullptr, fd, nullptr, pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+            if (out_pipe < 0)
+            {
+                auto err = errno;
+
+                std::error_condition failed;
+                if (err == EAGAIN || err == EWOULDBLOCK) failed = co_await wait_writable(deadline);
+                else failed = std::make_error_condition(static_cast<std::errc>(err));
+
+                if (!failed) continue;
+
+                // What's left in the pipe has been taken out of src already, and goes with the pipe: it's counted
+                // as moved, and failed says the write came up short of it.
+                co_return {.count = total + pending, .err = failed};
+            }
+
+            pending -= static_cast<std::size_t>(out_pipe);
+            total += static_cast<std::size_t>(out_pipe);
+            touch();
+        }
+    }
+
+    co_return {.count = total};
+#else
+    co_return {.err = std::make_error_condition(std::errc::not_supported)};
+#endif
+}
+
+bool socket::enable_zerocopy(std::size_t threshold) noexcept
+{
+#ifdef NET_IS_LINUX
+    int enable = 1;
+    if (!set_option(fd, SO_ZEROCOPY, &enable)) return false;
+
+    zerocopy_threshold = std::max<std::size_t>(threshold, 1);
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::optional<tcp_statistics> tcp_statistics::of(int fd) noexcept
+{
+#ifdef NET_IS_LINUX
+    ::tcp_info info{};
+    socklen_t  size = sizeof(info);
+    if (::getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &size) == -1) return std::nullopt;
+
+    return tcp_statistics{
+        .rtt         = std::chrono::microseconds{info.tcpi_rtt},
+        .rtt_var     = std::chrono::microseconds{info.tcpi_rttvar},
+        .rto         = std::chrono::microseconds{info.tcpi_rto},
+        .mss         = info.tcpi_snd_mss,
+        .cwnd        = info.tcpi_snd_cwnd,
+        .ssthresh    = info.tcpi_snd_ssthresh,
+        .unacked     = info.tcpi_unacked,
+        .sacked      = info.tcpi_sacked,
+        .lost        = info.tcpi_lost,
+        .retransmits = info.tcpi_total_retrans,
+    };
+#else
+    return std::nullopt;
+#endif
+}
+
+bool socket::enable_rx_timestamps() noexcept
+{
+#ifdef NET_IS_LINUX
+    int flags  = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    int enable = 1;
+    if (!set_option(fd, SO_TIMESTAMPING, &flags) && !set_option(fd, SO_TIMESTAMPNS, &enable)) return false;
+
+    rx_timestamps = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::int64_t socket::recv_timestamped(std::byte* data, std::size_t length) noexcept
+{
+#ifdef NET_IS_LINUX
+    iovec iov{.iov_base = data, .iov_len = length};
+
+    // room for either kind of timestamp
+    alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(scm_timestamping))> control{};
+
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = control.size();
+
+    auto num = ::recvmsg(fd, &msg, 0);
+    if (num <= 0) return num;
+
+    for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET) continue;
+        if (cmsg->cmsg_type != SCM_TIMESTAMPING && cmsg->cmsg_type != SCM_TIMESTAMPNS) continue;
+
+        // either way, it starts with the software timestamp
+        timespec stamp{};
+        std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+        if (stamp.tv_sec == 0 && stamp.tv_nsec == 0) continue;
+
+        last_rx = std::chrono::system_clock::time_point{std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds{stamp.tv_sec} + std::chrono::nanoseconds{stamp.tv_nsec})};
+        break;
+    }
+
+    return num;
+#else
+    return ::recv(fd, data, length, 0);
+#endif
+}
+
+coro::task<io::result> socket::write_zerocopy(std::span<const std::byte> data)
+{
+#ifdef NET_IS_LINUX
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
+    std::size_t          total_written = 0;
+    std::error_condition write_err;
+
+    while (total_written < data.size())
+    {
+        auto remaining = data.size() - total_written;
+
+        // send first, and only wait for room once there isn't any
+        auto num = ::send(fd, data.data() + total_written, remaining, MSG_ZEROCOPY | MSG_DONTWAIT);
+        if (num > 0) ++zerocopy_sent;
+        else if (num < 0 && errno == ENOBUFS)
+        {
+            // out of memory to pin pages with - copying still works though
+            num = ::send(fd, data.data() + total_written, remaining, MSG_DONTWAIT);
+        }
+
+        if (num < 0)
+        {
+            auto err = errno;
+            if (err == EAGAIN || err == EWOULDBLOCK)
+            {
+                write_err = co_await wait_writable(deadline);
+                if (write_err) break;
+                continue;
+            }
+
+            write_err = std::make_error_condition(static_cast<std::errc>(err));
+            break;
+        }
+
+        // client closed connection
+        if (num == 0)
+        {
+            write_err = make_error_condition(io::status_condition::closed);
+            break;
+        }
+
+        total_written += static_cast<std::size_t>(num);
+        touch();
+    }
+
+    // Even if the write failed part way, the kernel may still be holding on to parts of data, so it's waited for all
+    // the same - but only for this write's sends, and no longer than the write may take. The kernel keeps the pages
+    // pinned until it's done, so giving up early can change what's sent, but never touches freed memory.
+    auto done_err = co_await wait_zerocopy_completions(zerocopy_sent, deadline);
+    if (!write_err) write_err = done_err;
+
+    co_return {
+        .count = total_written,
+        .err   = write_err,
+    };
+#else
+    co_return {.err = std::make_error_condition(std::errc::not_supported)};
+#endif
+}
+
+// wait_zerocopy_completions waits for the kernel to be done with every send before until, or for deadline to pass.
+coro::task<std::error_condition> socket::wait_zerocopy_completions(std::uint32_t until, clock::time_point deadline)
+{
+    while (sent_before(zerocopy_done, until))
+    {
+        if (read_zerocopy_completions()) continue;
+
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return make_error_condition(io::status_condition::timed_out);
+
+        auto res = co_await scheduler->schedule(native_handle(), io::poll_op::error, wait);
+        if (read_zerocopy_completions()) continue;
+
+        // woken up for something other than a completion
+        int       error_code = 0;
+        socklen_t size       = sizeof(error_code);
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error_code, &size) == 0 && error_code != 0)
+            co_return std::make_error_condition(static_cast<std::errc>(error_code));
+
+        if (res.err == io::status_condition::closed || res.err == io::status_condition::timed_out) co_return res.err;
+    }
+
+    co_return std::error_condition{};
+}
+
+// zerocopy_completed notes the kernel is done with the sends [first, last).
+void socket::zerocopy_completed(std::uint32_t first, std::uint32_t last) noexcept
+{
+    if (sent_before(zerocopy_done, first))
+    {
+        zerocopy_ahead.emplace_back(first, last);
+        return;
+    }
+
+    if (sent_before(zerocopy_done, last)) zerocopy_done = last;
+
+    // whatever completed ahead may have been caught up with now
+    for (auto it = zerocopy_ahead.begin(); it != zerocopy_ahead.end();)
+    {
+        if (sent_before(zerocopy_done, it->first))
+        {
+            ++it;
+            continue;
+        }
+
+        if (sent_before(zerocopy_done, it->second)) zerocopy_done = it->second;
+
+        zerocopy_ahead.erase(it);
+        it = zerocopy_ahead.begin();
+    }
+}
+
+// read_zerocopy_completions drains the socket's error queue, returning true if there was anything in it.
+bool socket::read_zerocopy_completions() noexcept
+{
+#ifdef NET_IS_LINUX
+    bool read_any = false;
+
+    while (true)
+    {
+        std::array<std::byte, CMSG_SPACE(sizeof(sock_extended_err))> control{};
+
+        msghdr msg{};
+        msg.msg_control    = control.data();
+        msg.msg_controllen = control.size();
+
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) return read_any;
+
+        read_any = true;
+
+        for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            bool is_recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                           || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!is_recverr) continue;
+
+            sock_extended_err err{};
+            std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // [ee_info, ee_data] is the (inclusive) range of sends the kernel is done with
+            zerocopy_completed(err.ee_info, err.ee_data + 1);
+
+            // The kernel had to copy anyway (e.g. loopback, or a device without scatter-gather), so all zerocopy does
+            // here is add the completion round trip.
+            if ((err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) zerocopy_threshold = 0;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+void socket::close(bool graceful, std::chrono::seconds graceful_timeout) noexcept
 {
     if (!valid()) return;
 
@@ -210,7 +737,7 @@ void socket::close(bool graceful, std::chrono::seconds graceful_timeout) const n
     }
 
     scheduler->deregister_handle(fd);
-    ::close(fd);
+    ::close(std::exchange(fd, invalid_fd));
 }
 
 }
@@ -1,70 +1,340 @@
 #include "tcp.hpp"
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include <netdb.h>
+#include <poll.h>
 #include <sys/fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
+#include "config.hpp"
+#include "coro/task.hpp"
+#include "coro/thread_pool.hpp"
+#include "detail/resume.hpp"
 #include "exception.hpp"
+#include "io/poll.hpp"
 #include "io/scheduler.hpp"
 #include "ip_addr.hpp"
 #include "socket.hpp"
-#include "util/defer.hpp"
 
-namespace net
+#ifdef NET_HAS_EPOLL
+#    include <sys/epoll.h>
+#elifdef NET_HAS_KQUEUE
+#    include <sys/event.h>
+#endif
+
+namespace
 {
 
-int tcp_socket::open(
-    std::string_view host, std::string_view port, protocol proto, bool keepalive, std::chrono::microseconds timeout)
+using net::detail::resume_on;
+
+using addrinfo_ptr = std::unique_ptr<addrinfo, decltype(&::freeaddrinfo)>;
+
+void set_option_or_throw(int fd, int level, int flag, int value, const char* what)
 {
-    // TODO: should be using net::dns_lookup() instead of getaddrinfo()...
+    if (::setsockopt(fd, level, flag, &value, sizeof(value)) != 0) throw net::system_error_from_errno(errno, what);
+}
 
+addrinfo_ptr resolve(std::string_view host, std::string_view port, net::protocol proto)
+{
     addrinfo hints = {};
 
     switch (proto)
     {
-    case protocol::not_care: hints.ai_family = AF_UNSPEC; break;
-    case protocol::ipv4: hints.ai_family = AF_INET; break;
-    case protocol::ipv6: hints.ai_family = AF_INET6; break;
+    case net::protocol::not_care: hints.ai_family = AF_UNSPEC; break;
+    case net::protocol::ipv4: hints.ai_family = AF_INET; break;
+    case net::protocol::ipv6: hints.ai_family = AF_INET6; break;
     }
 
     hints.ai_flags    = AI_PASSIVE;
     hints.ai_socktype = SOCK_STREAM;
 
+    const std::string host_str{host};
+    const std::string port_str{port};
+
     addrinfo* servinfo = nullptr;
-    auto      sts      = ::getaddrinfo(!host.empty() ? host.data() : nullptr, port.data(), &hints, &servinfo);
-    if (sts != 0) throw_for_gai_error(sts);
+    auto      sts      = ::getaddrinfo(!host.empty() ? host_str.c_str() : nullptr, port_str.c_str(), &hints, &servinfo);
+    if (sts != 0) net::throw_for_gai_error(sts);
 
-    util::defer freeservinfo{[=] noexcept { freeaddrinfo(servinfo); }};
+    return {servinfo, &::freeaddrinfo};
+}
 
-    // find first valid addr, and use it!
-    int fd       = invalid_fd;
-    int last_err = 0;
+// resolver_pool is where connect() resolves hosts when it isn't given a pool of its own.
+std::shared_ptr<net::coro::thread_pool> resolver_pool()
+{
+    static auto pool = std::make_shared<net::coro::thread_pool>(2);
+    return pool;
+}
+
+// open_socket makes a socket for connecting to info. Returns -1 and sets errno if the system can't make one, and
+// throws if it can't be set up as asked.
+int open_socket(const addrinfo& info, bool keepalive, const net::tcp_options& options, bool nonblocking)
+{
+    int fd = ::socket(info.ai_family, info.ai_socktype, info.ai_protocol);
+    if (fd == -1) return -1;
 
-    for (auto* info = servinfo; info != nullptr; info = info->ai_next)
+    try
     {
-        fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
-        if (fd == -1)
+        if (::fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+            throw net::system_error_from_errno(errno, "failed to set close-on-exec");
+
+        if (nonblocking && ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) == -1)
+            throw net::system_error_from_errno(errno, "failed to set non-blocking");
+
+        set_option_or_throw(fd, SOL_SOCKET, SO_REUSEADDR, 1, "failed to set reuseaddr");
+        if (keepalive) set_option_or_throw(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "failed to set keepalive");
+
+        options.apply(fd);
+
+#ifdef TCP_FASTOPEN_CONNECT
+        if (options.fastopen_connect.has_value())
         {
-            last_err = errno;
-            continue;
+            set_option_or_throw(fd,
+                                IPPROTO_TCP,
+                                TCP_FASTOPEN_CONNECT,
+                                *options.fastopen_connect ? 1 : 0,
+                                "failed to set TCP_FASTOPEN_CONNECT");
         }
+#endif
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+
+    return fd;
+}
+
+// interleave_families orders addresses the way RFC 8305 (section 4) asks: alternating between address families,
+// starting with whichever getaddrinfo() put first.
+std::vector<const addrinfo*> interleave_families(const addrinfo* list)
+{
+    std::vector<const addrinfo*> preferred;
+    std::vector<const addrinfo*> others;
+
+    for (const auto* info = list; info != nullptr; info = info->ai_next)
+    {
+        if (info->ai_family == list->ai_family) preferred.push_back(info);
+        else others.push_back(info);
+    }
+
+    std::vector<const addrinfo*> ordered;
+    ordered.reserve(preferred.size() + others.size());
+
+    for (std::size_t i = 0; i < std::max(preferred.size(), others.size()); ++i)
+    {
+        if (i < preferred.size()) ordered.push_back(preferred[i]);
+        if (i < others.size()) ordered.push_back(others[i]);
+    }
+
+    return ordered;
+}
 
+// connect_race holds the connection attempts in flight, behind a single handle the scheduler can wait on: an epoll
+// (or kqueue) instance is readable whenever any of the sockets in it are.
+class connect_race
+{
+public:
+    explicit connect_race(net::io::scheduler* scheduler)
+        : scheduler{scheduler}
+#ifdef NET_HAS_EPOLL
+        , fd{::epoll_create1(EPOLL_CLOEXEC)}
+#elifdef NET_HAS_KQUEUE
+        , fd{::kqueue()}
+#endif
+    {
+        if (fd == -1) throw net::system_error_from_errno(errno, "failed to create connect race");
+        scheduler->register_handle(fd);
+    }
+
+    connect_race(const connect_race&)            = delete;
+    connect_race& operator=(const connect_race&) = delete;
+
+    connect_race(connect_race&&)            = delete;
+    connect_race& operator=(connect_race&&) = delete;
+
+    ~connect_race() noexcept
+    {
+        for (int attempt : attempts) ::close(attempt);
+
+        scheduler->deregister_handle(fd);
+        ::close(fd);
+    }
+
+    [[nodiscard]] int  native_handle() const noexcept { return fd; }
+    [[nodiscard]] bool empty() const noexcept { return attempts.empty(); }
+
+    // add watches attempt until it connects or fails. Returns false and sets errno if it can't.
+    bool add(int attempt)
+    {
+#ifdef NET_HAS_EPOLL
+        epoll_event ev{.events = EPOLLOUT, .data = {.fd = attempt}};
+        if (::epoll_ctl(fd, EPOLL_CTL_ADD, attempt, &ev) == -1) return false;
+#elifdef NET_HAS_KQUEUE
+        struct kevent ev{};
+        EV_SET(&ev, attempt, EVFILT_WRITE, EV_ADD, 0, 0, nullptr);
+        if (::kevent(fd, &ev, 1, nullptr, 0, nullptr) == -1) return false;
+#endif
+
+        attempts.push_back(attempt);
+        return true;
+    }
+
+    // settle takes every attempt that's done out of the race, and returns the first one that connected, if any.
+    // The rest failed, and the last of their errors is left in last_err.
+    int settle(int& last_err)
+    {
+        std::vector<pollfd> polls;
+        polls.reserve(attempts.size());
+        for (int attempt : attempts) polls.push_back({.fd = attempt, .events = POLLOUT, .revents = 0});
+
+        if (::poll(polls.data(), polls.size(), 0) <= 0) return -1;
+
+        int winner = -1;
+
+        for (const auto& poll : polls)
         {
-            int yes = 1;
-            if (!set_option(fd, SO_REUSEADDR, &yes))
+            // a second winner is just another attempt to close
+            if (poll.revents == 0 || winner != -1) continue;
+
+            int       err  = 0;
+            socklen_t size = sizeof(err);
+            if (::getsockopt(poll.fd, SOL_SOCKET, SO_ERROR, &err, &size) == -1) err = errno;
+            else if (err == 0 && (poll.revents & POLLOUT) == 0) err = ECONNRESET;
+
+            std::erase(attempts, poll.fd);
+
+            if (err == 0)
             {
-                auto err = errno;
-                ::close(fd);
-                throw system_error_from_errno(err, "failed to set reuseaddr");
+                winner = poll.fd;
             }
+            else
+            {
+                last_err = err;
+                ::close(poll.fd);
+            }
+        }
+
+        return winner;
+    }
+
+private:
+    net::io::scheduler* scheduler;
+    int                 fd;
+    std::vector<int>    attempts;
+};
+
+}
+
+namespace net
+{
+
+tcp_options tcp_options::low_latency() noexcept
+{
+    return {
+        .no_delay      = true,
+        .notsent_lowat = 16 * 1024,
+        .defer_accept  = 1s,
+        .quick_ack     = true,
+    };
+}
+
+void tcp_options::apply(int fd) const
+{
+    try_apply(fd, [](const char* what, int err) { throw system_error_from_errno(err, what); });
+}
+
+void tcp_options::try_apply(int fd, const std::function<void(const char* what, int err)>& failed) const
+{
+    auto set = [&](int level, int flag, int value, const char* what)
+    {
+        if (::setsockopt(fd, level, flag, &value, sizeof(value)) != 0) failed(what, errno);
+    };
+
+    if (recv_buffer.has_value()) set(SOL_SOCKET, SO_RCVBUF, *recv_buffer, "failed to set SO_RCVBUF");
+    if (send_buffer.has_value()) set(SOL_SOCKET, SO_SNDBUF, *send_buffer, "failed to set SO_SNDBUF");
+    if (recv_lowat.has_value()) set(SOL_SOCKET, SO_RCVLOWAT, *recv_lowat, "failed to set SO_RCVLOWAT");
+
+    if (no_delay.has_value()) set(IPPROTO_TCP, TCP_NODELAY, *no_delay ? 1 : 0, "failed to set TCP_NODELAY");
+
+#ifdef TCP_CORK
+    if (cork.has_value()) set(IPPROTO_TCP, TCP_CORK, *cork ? 1 : 0, "failed to set TCP_CORK");
+#endif
+
+#ifdef TCP_NOTSENT_LOWAT
+    if (notsent_lowat.has_value())
+    {
+        set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, static_cast<int>(*notsent_lowat), "failed to set TCP_NOTSENT_LOWAT");
+    }
+#endif
+
+#ifdef TCP_QUICKACK
+    if (quick_ack.has_value()) set(IPPROTO_TCP, TCP_QUICKACK, *quick_ack ? 1 : 0, "failed to set TCP_QUICKACK");
+#endif
+}
+
+void tcp_options::apply_listener(int fd) const
+{
+    // accepted connections inherit these from the listener, and the window scale is settled in the handshake,
+    // before there's an accepted socket to set them on
+    if (recv_buffer.has_value())
+        set_option_or_throw(fd, SOL_SOCKET, SO_RCVBUF, *recv_buffer, "failed to set SO_RCVBUF");
+    if (send_buffer.has_value())
+        set_option_or_throw(fd, SOL_SOCKET, SO_SNDBUF, *send_buffer, "failed to set SO_SNDBUF");
+
+#ifdef TCP_FASTOPEN
+    if (fastopen_queue.has_value())
+        set_option_or_throw(fd, IPPROTO_TCP, TCP_FASTOPEN, *fastopen_queue, "failed to set TCP_FASTOPEN");
+#endif
+
+#ifdef TCP_DEFER_ACCEPT
+    if (defer_accept.has_value())
+    {
+        set_option_or_throw(fd,
+                            IPPROTO_TCP,
+                            TCP_DEFER_ACCEPT,
+                            static_cast<int>(defer_accept->count()),
+                            "failed to set TCP_DEFER_ACCEPT");
+    }
+#endif
+}
+
+int tcp_socket::open(std::string_view          host,
+                     std::string_view          port,
+                     protocol                  proto,
+                     bool                      keepalive,
+                     std::chrono::microseconds timeout,
+                     const tcp_options&        options)
+{
+    // TODO: should be using net::dns_lookup() instead of getaddrinfo()...
+    auto servinfo = resolve(host, port, proto);
+
+    // find first valid addr, and use it!
+    int fd       = invalid_fd;
+    int last_err = 0;
+
+    for (auto* info = servinfo.get(); info != nullptr; info = info->ai_next)
+    {
+        fd = open_socket(*info, keepalive, options, false);
+        if (fd == invalid_fd)
+        {
+            last_err = errno;
+            continue;
         }
 
         if (timeout.count() != 0)
@@ -85,18 +355,7 @@ int tcp_socket::open(
             }
         }
 
-        if (keepalive)
-        {
-            int yes = 1;
-            if (!set_option(fd, SO_KEEPALIVE, &yes))
-            {
-                auto err = errno;
-                ::close(fd);
-                throw system_error_from_errno(err, "failed to set keepalive");
-            }
-        }
-
-        sts = ::connect(fd, info->ai_addr, info->ai_addrlen);
+        auto sts = ::connect(fd, info->ai_addr, info->ai_addrlen);
         if (sts == 0) break;
 
         last_err = errno;
@@ -110,6 +369,95 @@ int tcp_socket::open(
     return fd;
 }
 
+coro::task<tcp_socket> tcp_socket::connect(io::scheduler*   scheduler,
+                                           std::string_view host,
+                                           std::string_view port,
+                                           connect_options  options)
+{
+    using clock = std::chrono::steady_clock;
+
+    // NOTE: copied, as they're used across the hop to the resolver pool
+    const std::string host_str{host};
+    const std::string port_str{port};
+
+    auto               pool = options.resolver ? options.resolver : resolver_pool();
+    addrinfo_ptr       servinfo{nullptr, &::freeaddrinfo};
+    std::exception_ptr failed;
+
+    co_await pool->schedule();
+    try
+    {
+        servinfo = resolve(host_str, port_str, options.proto);
+    }
+    catch (...)
+    {
+        failed = std::current_exception();
+    }
+    co_await resume_on{scheduler};
+
+    if (failed) std::rethrow_exception(failed);
+
+    auto candidates = interleave_families(servinfo.get());
+
+    const auto deadline = options.timeout.count() != 0 ? clock::now() + options.timeout : clock::time_point::max();
+
+    connect_race race{scheduler};
+    std::size_t  next     = 0;
+    int          last_err = 0;
+
+    while (true)
+    {
+        // Start the next attempt: right away if nothing else is in flight, or once the others had their head start.
+        while (next < candidates.size())
+        {
+            const auto& info = *candidates[next++];
+
+            int fd = open_socket(info, options.keepalive, options.tcp, true);
+            if (fd == invalid_fd)
+            {
+                last_err = errno;
+                continue;
+            }
+
+            if (::connect(fd, info.ai_addr, info.ai_addrlen) == 0) co_return tcp_socket{scheduler, fd};
+
+            auto err = errno;
+            if (err != EINPROGRESS || !race.add(fd))
+            {
+                last_err = err != EINPROGRESS ? err : errno;
+                ::close(fd);
+                continue;
+            }
+
+            break;
+        }
+
+        if (race.empty()) break;
+
+        auto now = clock::now();
+        if (now >= deadline)
+        {
+            last_err = ETIMEDOUT;
+            break;
+        }
+
+        // once every address has been tried, there's nothing left to do but wait for the ones in flight
+        auto wait = next < candidates.size() ? options.attempt_delay : std::chrono::milliseconds::zero();
+        if (deadline != clock::time_point::max())
+        {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+            if (wait.count() == 0 || remaining < wait) wait = remaining;
+        }
+
+        co_await scheduler->schedule(race.native_handle(), io::poll_op::read, wait);
+
+        int fd = race.settle(last_err);
+        if (fd != invalid_fd) co_return tcp_socket{scheduler, fd};
+    }
+
+    throw system_error_from_errno(last_err, "failed to connect");
+}
+
 tcp_socket::tcp_socket(io::scheduler* scheduler) noexcept
     : socket{scheduler, invalid_fd}
 {}
@@ -123,8 +471,11 @@ tcp_socket::tcp_socket(io::scheduler*            scheduler,
                        std::string_view          port,
                        protocol                  proto,
                        bool                      keepalive,
-                       std::chrono::microseconds timeout)
-    : socket{scheduler, open(host, port, proto, keepalive, timeout)}
+                       std::chrono::microseconds timeout,
+                       const tcp_options&        options)
+    : socket{scheduler, open(host, port, proto, keepalive, timeout, options)}
 {}
 
+void tcp_socket::set_options(const tcp_options& options) const { options.apply(fd); }
+
 }
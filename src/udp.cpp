@@ -1,6 +1,16 @@
 #include "udp.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
 #include <string_view>
+#include <system_error>
 
 #include <netdb.h>
 #include <unistd.h>
@@ -8,15 +18,244 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include "coro/task.hpp"
+#include "detail/fd.hpp"
+#include "io/io.hpp"
+#include "io/poll.hpp"
 #include "io/scheduler.hpp"
+#include "util/defer.hpp"
 
+#include "config.hpp"
 #include "exception.hpp"
 #include "ip_addr.hpp"
 #include "socket.hpp"
 
+namespace
+{
+
+using net::detail::would_block;
+using net::detail::errno_condition;
+
+using namespace std::chrono_literals;
+
+// room for the one cmsg we ever send or receive per datagram: UDP_SEGMENT or UDP_GRO
+constexpr std::size_t control_size = CMSG_SPACE(sizeof(int));
+
+using control_buffer = std::array<std::byte, control_size>;
+
+void prepare_receive(msghdr& hdr, iovec& iov, control_buffer& control, net::incoming_datagram& msg) noexcept
+{
+    iov = {.iov_base = msg.data.data(), .iov_len = msg.data.size()};
+
+    hdr                = {};
+    hdr.msg_name       = msg.from.native();
+    hdr.msg_namelen    = sizeof(sockaddr_storage);
+    hdr.msg_iov        = &iov;
+    hdr.msg_iovlen     = 1;
+    hdr.msg_control    = control.data();
+    hdr.msg_controllen = control.size();
+}
+
+void finish_receive(msghdr& hdr, std::size_t size, net::incoming_datagram& msg) noexcept
+{
+    msg.size         = size;
+    msg.truncated    = (hdr.msg_flags & MSG_TRUNC) != 0;
+    msg.segment_size = 0;
+
+#ifdef NET_IS_LINUX
+    for (auto* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int segment_size = 0;
+            std::memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+            msg.segment_size = static_cast<std::uint16_t>(segment_size);
+        }
+    }
+#endif
+}
+
+void prepare_send(msghdr& hdr, iovec& iov, control_buffer& control, const net::outgoing_datagram& msg) noexcept
+{
+    iov = {.iov_base = const_cast<std::byte*>(msg.data.data()), .iov_len = msg.data.size()};
+
+    hdr            = {};
+    hdr.msg_iov    = &iov;
+    hdr.msg_iovlen = 1;
+
+    if (msg.to != nullptr)
+    {
+        hdr.msg_name    = const_cast<sockaddr*>(msg.to->native());
+        hdr.msg_namelen = msg.to->native_size();
+    }
+
+#ifdef NET_IS_LINUX
+    if (msg.segment_size != 0)
+    {
+        hdr.msg_control    = control.data();
+        hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+
+        auto* cmsg       = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type  = UDP_SEGMENT;
+        cmsg->cmsg_len   = CMSG_LEN(sizeof(std::uint16_t));
+        std::memcpy(CMSG_DATA(cmsg), &msg.segment_size, sizeof(msg.segment_size));
+    }
+#else
+    (void)control;
+#endif
+}
+
+// receive_batch receives up to msgs.size() (at most udp_socket::max_batch) datagrams without blocking.
+// Returns how many were received, or -1 and sets errno.
+int receive_batch(int fd, std::span<net::incoming_datagram> msgs) noexcept
+{
+#ifdef NET_IS_LINUX
+    std::array<mmsghdr, net::udp_socket::max_batch>        hdrs{};
+    std::array<iovec, net::udp_socket::max_batch>          iovs{};
+    std::array<control_buffer, net::udp_socket::max_batch> controls{};
+
+    auto count = std::min(msgs.size(), net::udp_socket::max_batch);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        prepare_receive(hdrs[i].msg_hdr, iovs[i], controls[i], msgs[i]);
+    }
+
+    auto num = ::recvmmsg(fd, hdrs.data(), static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+    if (num < 0) return -1;
+
+    for (std::size_t i = 0; i < static_cast<std::size_t>(num); ++i)
+    {
+        finish_receive(hdrs[i].msg_hdr, hdrs[i].msg_len, msgs[i]);
+        msgs[i].from.set_native_size(hdrs[i].msg_hdr.msg_namelen);
+    }
+
+    return num;
+#else
+    if (msgs.empty()) return 0;
+
+    msghdr         hdr{};
+    iovec          iov{};
+    control_buffer control{};
+    prepare_receive(hdr, iov, control, msgs[0]);
+
+    auto num = ::recvmsg(fd, &hdr, MSG_DONTWAIT);
+    if (num < 0) return -1;
+
+    finish_receive(hdr, static_cast<std::size_t>(num), msgs[0]);
+    msgs[0].from.set_native_size(hdr.msg_namelen);
+    return 1;
+#endif
+}
+
+// send_batch sends up to msgs.size() (at most udp_socket::max_batch) datagrams without blocking.
+// Returns how many were sent, or -1 and sets errno.
+int send_batch(int fd, std::span<const net::outgoing_datagram> msgs) noexcept
+{
+#ifdef NET_IS_LINUX
+    std::array<mmsghdr, net::udp_socket::max_batch>        hdrs{};
+    std::array<iovec, net::udp_socket::max_batch>          iovs{};
+    std::array<control_buffer, net::udp_socket::max_batch> controls{};
+
+    auto count = std::min(msgs.size(), net::udp_socket::max_batch);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        prepare_send(hdrs[i].msg_hdr, iovs[i], controls[i], msgs[i]);
+    }
+
+    return ::sendmmsg(fd, hdrs.data(), static_cast<unsigned int>(count), MSG_DONTWAIT);
+#else
+    if (msgs.empty()) return 0;
+
+    msghdr         hdr{};
+    iovec          iov{};
+    control_buffer control{};
+    prepare_send(hdr, iov, control, msgs[0]);
+
+    if (::sendmsg(fd, &hdr, MSG_DONTWAIT) < 0) return -1;
+    return 1;
+#endif
+}
+
+}
+
 namespace net
 {
 
+udp_addr::udp_addr(const ip_addr& ip, std::uint16_t port) noexcept
+{
+    // ip_addr keeps the least significant byte first, the reverse of network byte order
+    const auto* bytes = static_cast<const std::uint8_t*>(ip);
+
+    if (ip.is_ipv4())
+    {
+        auto* addr       = reinterpret_cast<sockaddr_in*>(&storage);
+        addr->sin_family = AF_INET;
+        addr->sin_port   = htons(port);
+        std::reverse_copy(bytes, bytes + 4, reinterpret_cast<std::uint8_t*>(&addr->sin_addr));
+        size = sizeof(sockaddr_in);
+    }
+    else
+    {
+        auto* addr        = reinterpret_cast<sockaddr_in6*>(&storage);
+        addr->sin6_family = AF_INET6;
+        addr->sin6_port   = htons(port);
+        std::reverse_copy(bytes, bytes + 16, reinterpret_cast<std::uint8_t*>(&addr->sin6_addr));
+        size = sizeof(sockaddr_in6);
+    }
+}
+
+std::optional<ip_addr> udp_addr::ip() const noexcept
+{
+    switch (storage.ss_family)
+    {
+    case AF_INET:
+    {
+        const auto* addr =
+            reinterpret_cast<const std::uint8_t*>(&reinterpret_cast<const sockaddr_in*>(&storage)->sin_addr);
+
+        std::array<std::uint8_t, 4> bytes{};
+        std::reverse_copy(addr, addr + bytes.size(), bytes.begin());
+        return ipv4_addr{bytes};
+    }
+
+    case AF_INET6:
+    {
+        const auto* addr =
+            reinterpret_cast<const std::uint8_t*>(&reinterpret_cast<const sockaddr_in6*>(&storage)->sin6_addr);
+
+        std::array<std::uint8_t, 16> bytes{};
+        std::reverse_copy(addr, addr + bytes.size(), bytes.begin());
+        return ipv6_addr{bytes};
+    }
+
+    default: return std::nullopt;
+    }
+}
+
+std::uint16_t udp_addr::port() const noexcept
+{
+    switch (storage.ss_family)
+    {
+    case AF_INET: return ntohs(reinterpret_cast<const sockaddr_in*>(&storage)->sin_port);
+    case AF_INET6: return ntohs(reinterpret_cast<const sockaddr_in6*>(&storage)->sin6_port);
+    default: return 0;
+    }
+}
+
+std::string udp_addr::to_string() const
+{
+    auto addr = ip();
+    if (!addr.has_value()) return "";
+
+    if (addr->is_ipv6()) return "[" + addr->to_string() + "]:" + std::to_string(port());
+    return addr->to_string() + ":" + std::to_string(port());
+}
+
 udp_socket::udp_socket(io::scheduler* scheduler, int fd) noexcept
     : socket{scheduler, fd}
 {}
@@ -29,12 +268,150 @@ udp_socket::udp_socket(io::scheduler* scheduler, std::string_view host, std::str
     : socket{scheduler, open(host, port, proto)}
 {}
 
+udp_addr udp_socket::local_udp_addr() const
+{
+    udp_addr addr;
+
+    if (::getsockname(fd, addr.native(), &addr.size) != 0)
+        throw system_error_from_errno(errno, "failed to get local address");
+
+    return addr;
+}
+
+coro::task<io::result> udp_socket::send_to(std::span<const std::byte> data, const udp_addr& to)
+{
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
+    while (true)
+    {
+        auto num = ::sendto(fd, data.data(), data.size(), MSG_DONTWAIT, to.native(), to.native_size());
+        if (num >= 0)
+        {
+            touch();
+            co_return {.count = static_cast<std::size_t>(num)};
+        }
+
+        auto err = errno;
+        if (!would_block(err)) co_return {.err = errno_condition(err)};
+
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return {.err = make_error_condition(io::status_condition::timed_out)};
+
+        auto res = co_await scheduler->schedule(fd, io::poll_op::write, wait);
+        if (res.err && res.count == 0) co_return res;
+    }
+}
+
+coro::task<io::result> udp_socket::recv_from(std::span<std::byte> data, udp_addr& from)
+{
+    const auto deadline = deadline_for(read_timeout, read_deadline);
+
+    while (true)
+    {
+        from.size = sizeof(from.storage);
+
+        auto num = ::recvfrom(fd, data.data(), data.size(), MSG_DONTWAIT, from.native(), &from.size);
+        if (num >= 0)
+        {
+            touch();
+            co_return {.count = static_cast<std::size_t>(num)};
+        }
+
+        auto err = errno;
+        if (!would_block(err)) co_return {.err = errno_condition(err)};
+
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return {.err = make_error_condition(io::status_condition::timed_out)};
+
+        auto res = co_await scheduler->schedule(fd, io::poll_op::read, wait);
+        if (res.err && res.count == 0) co_return res;
+    }
+}
+
+coro::task<io::result> udp_socket::recv_many(std::span<incoming_datagram> msgs)
+{
+    const auto deadline = deadline_for(read_timeout, read_deadline);
+
+    std::size_t received = 0;
+
+    // Try first, and only wait if there's nothing there: under load, there nearly always is.
+    while (received < msgs.size())
+    {
+        auto window = msgs.subspan(received, std::min(msgs.size() - received, max_batch));
+
+        auto num = receive_batch(fd, window);
+        if (num < 0)
+        {
+            auto err = errno;
+            if (err == EINTR) continue;
+            if (!would_block(err)) co_return {.count = received, .err = errno_condition(err)};
+
+            // got some already, don't wait for more
+            if (received > 0) break;
+
+            auto wait = time_left(deadline);
+            if (wait < 0ms) co_return {.err = make_error_condition(io::status_condition::timed_out)};
+
+            auto res = co_await scheduler->schedule(fd, io::poll_op::read, wait);
+            if (res.err && res.count == 0) co_return res;
+            continue;
+        }
+
+        received += static_cast<std::size_t>(num);
+        touch();
+
+        // drained the socket
+        if (static_cast<std::size_t>(num) < window.size()) break;
+    }
+
+    co_return {.count = received};
+}
+
+coro::task<io::result> udp_socket::send_many(std::span<const outgoing_datagram> msgs)
+{
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
+    std::size_t sent = 0;
+
+    while (sent < msgs.size())
+    {
+        auto window = msgs.subspan(sent, std::min(msgs.size() - sent, max_batch));
+
+        auto num = send_batch(fd, window);
+        if (num < 0)
+        {
+            auto err = errno;
+            if (err == EINTR) continue;
+            if (!would_block(err)) co_return {.count = sent, .err = errno_condition(err)};
+
+            auto wait = time_left(deadline);
+            if (wait < 0ms) co_return {.count = sent, .err = make_error_condition(io::status_condition::timed_out)};
+
+            auto res = co_await scheduler->schedule(fd, io::poll_op::write, wait);
+            if (res.err && res.count == 0) co_return {.count = sent, .err = res.err};
+            continue;
+        }
+
+        sent += static_cast<std::size_t>(num);
+        touch();
+    }
+
+    co_return {.count = sent};
+}
+
+bool udp_socket::enable_gro() noexcept
+{
+#ifdef NET_IS_LINUX
+    int enable = 1;
+    return set_option(fd, SOL_UDP, UDP_GRO, &enable);
+#else
+    return false;
+#endif
+}
+
 int udp_socket::open(std::string_view host, std::string_view port, protocol proto)
 {
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wmissing-field-initializers"
-    ::addrinfo hints = {0};
-#pragma clang diagnostic pop
+    addrinfo hints = {};
 
     if (host.empty()) hints.ai_flags = AI_PASSIVE;
 
@@ -47,22 +424,38 @@ int udp_socket::open(std::string_view host, std::string_view port, protocol prot
 
     hints.ai_socktype = SOCK_DGRAM;
 
+    // NOTE: copied, as getaddrinfo() wants them null-terminated
+    const std::string host_str{host};
+    const std::string port_str{port};
+
     addrinfo* servinfo = nullptr;
-    int       sts      = ::getaddrinfo(!host.empty() ? host.data() : nullptr, port.data(), &hints, &servinfo);
+    int       sts      = ::getaddrinfo(!host.empty() ? host_str.c_str() : nullptr, port_str.c_str(), &hints, &servinfo);
     if (sts != 0) throw_for_gai_error(sts);
 
-    // find first valid addr, and use it!
-    int fd = -1;
+    util::defer freeservinfo{[=] noexcept { freeaddrinfo(servinfo); }};
+
+    // find first valid addr, and bind to it!
+    int fd       = invalid_fd;
+    int last_err = 0;
 
     for (::addrinfo* info = servinfo; info != nullptr; info = info->ai_next)
     {
-        fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
-        if (fd > -1) break;
-    }
+        fd = ::socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+        if (fd == invalid_fd)
+        {
+            last_err = errno;
+            continue;
+        }
+
+        if (::bind(fd, info->ai_addr, info->ai_addrlen) == 0) break;
 
-    freeaddrinfo(servinfo);
+        last_err = errno;
+
+        ::close(fd);
+        fd = invalid_fd;
+    }
 
-    if (fd == -1) throw exception{"failed to bind"};
+    if (fd == invalid_fd) throw system_error_from_errno(last_err, "failed to open and bind socket");
 
     return fd;
 }
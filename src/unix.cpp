@@ -0,0 +1,275 @@
+#include "unix.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "coro/task.hpp"
+#include "detail/fd.hpp"
+#include "exception.hpp"
+#include "io/io.hpp"
+#include "io/poll.hpp"
+#include "io/scheduler.hpp"
+#include "socket.hpp"
+
+namespace
+{
+
+using net::detail::would_block;
+using net::detail::errno_condition;
+using net::detail::set_nonblocking;
+
+int socket_type(net::network net)
+{
+    switch (net)
+    {
+    case net::network::unix_stream: return SOCK_STREAM;
+    case net::network::unix_seqpacket: return SOCK_SEQPACKET;
+    default: throw net::exception{"invalid network type for a unix socket"};
+    }
+}
+
+// fds_space is how much control message space it takes to send or receive count descriptors.
+constexpr std::size_t fds_space(std::size_t count) noexcept { return CMSG_SPACE(sizeof(int) * count); }
+
+}
+
+namespace net
+{
+
+unix_addr::unix_addr(std::string_view path)
+{
+    if (path.size() >= sizeof(storage.sun_path)) throw exception{"unix socket path too long"};
+
+    std::ranges::copy(path, std::begin(storage.sun_path));
+
+    // An abstract name starts with a null byte instead, and isn't null terminated - it's exactly as long as the
+    // address says, so an extra null would be part of the name.
+    if (path.starts_with('@'))
+    {
+        storage.sun_path[0] = '\0';
+        size                = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size());
+    }
+    else
+    {
+        size = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+    }
+}
+
+bool unix_addr::is_abstract() const noexcept
+{
+    return size > offsetof(sockaddr_un, sun_path) && storage.sun_path[0] == '\0';
+}
+
+std::string unix_addr::to_string() const
+{
+    auto len = size > offsetof(sockaddr_un, sun_path) ? size - offsetof(sockaddr_un, sun_path) : 0;
+    if (len == 0) return {};
+
+    if (is_abstract()) return "@" + std::string{storage.sun_path + 1, len - 1};
+    return std::string{storage.sun_path, ::strnlen(storage.sun_path, len)};
+}
+
+unix_socket::unix_socket(io::scheduler* scheduler) noexcept
+    : socket{scheduler, invalid_fd}
+{}
+
+unix_socket::unix_socket(io::scheduler* scheduler, int fd) noexcept
+    : socket{scheduler, fd}
+{}
+
+coro::task<unix_socket> unix_socket::connect(io::scheduler* scheduler, const unix_addr& addr, network net)
+{
+    int fd = ::socket(AF_UNIX, socket_type(net), 0);
+    if (fd == -1) throw system_error_from_errno(errno, "failed to create unix socket");
+
+    if (!set_nonblocking(fd))
+    {
+        auto err = errno;
+        ::close(fd);
+        throw system_error_from_errno(err, "failed to set non-blocking");
+    }
+
+    unix_socket conn{scheduler, fd};
+
+    if (::connect(fd, addr.native(), addr.native_size()) == 0) co_return conn;
+
+    auto err = errno;
+    if (err != EINPROGRESS) throw system_error_from_errno(err, "failed to connect to " + addr.to_string());
+
+    auto res = co_await scheduler->schedule(fd, io::poll_op::write, 0ms);
+    if (res.err && res.err != io::status_condition::closed)
+        throw std::system_error{res.err.value(), res.err.category(), "failed to connect to " + addr.to_string()};
+
+    socklen_t size = sizeof(err);
+    if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &size) == -1) err = errno;
+    if (err != 0) throw system_error_from_errno(err, "failed to connect to " + addr.to_string());
+
+    co_return conn;
+}
+
+std::array<unix_socket, 2> unix_socket::pair(io::scheduler* scheduler, network net)
+{
+    std::array<int, 2> fds{invalid_fd, invalid_fd};
+    if (::socketpair(AF_UNIX, socket_type(net), 0, fds.data()) == -1)
+        throw system_error_from_errno(errno, "failed to create socket pair");
+
+    if (!set_nonblocking(fds[0]) || !set_nonblocking(fds[1]))
+    {
+        auto err = errno;
+        ::close(fds[0]);
+        ::close(fds[1]);
+        throw system_error_from_errno(err, "failed to set non-blocking");
+    }
+
+    return {unix_socket{scheduler, fds[0]}, unix_socket{scheduler, fds[1]}};
+}
+
+coro::task<io::result> unix_socket::send_fds(std::span<const std::byte> data, std::span<const int> fds)
+{
+    if (data.empty() || fds.size() > max_fds) co_return {.err = errno_condition(EINVAL)};
+
+    const auto deadline = deadline_for(write_timeout, clock::time_point::max());
+
+    std::array<std::byte, fds_space(max_fds)> control{};
+
+    iovec iov{
+        .iov_base = const_cast<std::byte*>(data.data()), // NOLINT(cppcoreguidelines-pro-type-const-cast)
+        .iov_len  = data.size(),
+    };
+
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = fds_space(fds.size());
+
+    auto* cmsg       = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    while (true)
+    {
+        auto num = ::sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (num >= 0)
+        {
+            touch();
+
+            // the descriptors went with the first byte, the rest of a stream can go like any other write
+            auto sent = static_cast<std::size_t>(num);
+            if (sent == data.size()) co_return {.count = sent};
+
+            auto res = co_await write(data.subspan(sent));
+            co_return {.count = sent + res.count, .err = res.err};
+        }
+
+        auto err = errno;
+        if (err == EINTR) continue;
+        if (!would_block(err)) co_return {.err = errno_condition(err)};
+
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return {.err = make_error_condition(io::status_condition::timed_out)};
+
+        auto res = co_await scheduler->schedule(fd, io::poll_op::write, wait);
+        if (res.err && res.count == 0) co_return {.err = res.err};
+    }
+}
+
+coro::task<io::result> unix_socket::recv_fds(std::span<std::byte> data, std::span<int> fds, std::size_t& num_fds)
+{
+    num_fds = 0;
+
+    const auto deadline = deadline_for(read_timeout, read_deadline);
+
+    std::array<std::byte, fds_space(max_fds)> control{};
+
+    iovec iov{
+        .iov_base = data.data(),
+        .iov_len  = data.size(),
+    };
+
+    msghdr msg{};
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+
+    ssize_t num = 0;
+
+    while (true)
+    {
+        msg.msg_control    = control.data();
+        msg.msg_controllen = control.size();
+
+        int flags = MSG_DONTWAIT;
+#ifdef MSG_CMSG_CLOEXEC
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+        num = ::recvmsg(fd, &msg, flags);
+        if (num >= 0) break;
+
+        auto err = errno;
+        if (err == EINTR) continue;
+        if (!would_block(err)) co_return {.err = errno_condition(err)};
+
+        auto wait = time_left(deadline);
+        if (wait < 0ms) co_return {.err = make_error_condition(io::status_condition::timed_out)};
+
+        auto res = co_await scheduler->schedule(fd, io::poll_op::read, wait);
+        if (res.err && res.count == 0) co_return {.err = res.err};
+    }
+
+    if (num == 0 && !data.empty()) co_return {.err = make_error_condition(io::status_condition::closed)};
+
+    touch();
+
+    io::result res{.count = static_cast<std::size_t>(num)};
+
+    for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+        const auto  count   = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const auto* payload = CMSG_DATA(cmsg);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            int received = 0;
+            std::memcpy(&received, payload + i * sizeof(int), sizeof(int));
+
+#ifndef MSG_CMSG_CLOEXEC
+            ::fcntl(received, F_SETFD, FD_CLOEXEC);
+#endif
+
+            if (num_fds < fds.size())
+            {
+                fds[num_fds++] = received;
+            }
+            else
+            {
+                ::close(received);
+                res.err = errno_condition(EMSGSIZE);
+            }
+        }
+    }
+
+    // the kernel had more for us than fit in the control buffer, and has closed the rest already
+    if ((msg.msg_flags & MSG_CTRUNC) != 0) res.err = errno_condition(EMSGSIZE);
+
+    co_return res;
+}
+
+}
@@ -0,0 +1,93 @@
+#include "util/arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace net::util
+{
+
+arena::arena(std::size_t block_size, std::pmr::memory_resource* upstream) noexcept
+    : upstream{upstream}
+    , block_size{std::max(block_size, sizeof(block) * 2)}
+{}
+
+void arena::reset() noexcept
+{
+    in_use = 0;
+    if (blocks == nullptr) return;
+
+    // Several blocks mean it outgrew the first, so they're swapped for one that would have held everything.
+    if (blocks->next != nullptr)
+    {
+        auto total = held;
+        release();
+
+        try
+        {
+            grow(total - sizeof(block), alignof(std::max_align_t));
+        }
+        catch (const std::bad_alloc&)
+        {
+            // it starts over from nothing next time instead, as after release()
+        }
+
+        return;
+    }
+
+    next = reinterpret_cast<std::byte*>(blocks + 1);
+    left = blocks->size - sizeof(block);
+}
+
+void arena::release() noexcept
+{
+    while (blocks != nullptr)
+    {
+        auto* b = std::exchange(blocks, blocks->next);
+        upstream->deallocate(b, b->size, alignof(std::max_align_t));
+    }
+
+    next   = nullptr;
+    left   = 0;
+    in_use = 0;
+    held   = 0;
+}
+
+void* arena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    void* ptr = next;
+    if (std::align(alignment, bytes, ptr, left) == nullptr)
+    {
+        grow(bytes, alignment);
+
+        ptr = next;
+        std::align(alignment, bytes, ptr, left);
+    }
+
+    next = static_cast<std::byte*>(ptr) + bytes;
+    left -= bytes;
+    in_use += bytes;
+
+    return ptr;
+}
+
+void arena::grow(std::size_t bytes, std::size_t alignment)
+{
+    // blocks double, so a request that needs many small allocations only goes upstream a few times
+    auto size = std::max({block_size, held, sizeof(block) + bytes + alignment});
+
+    auto* b = static_cast<block*>(upstream->allocate(size, alignof(std::max_align_t)));
+    b->next = blocks;
+    b->size = size;
+
+    blocks = b;
+    next   = reinterpret_cast<std::byte*>(b + 1);
+    left   = size - sizeof(block);
+    held += size;
+}
+
+}
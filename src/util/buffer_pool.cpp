@@ -1,5 +1,14 @@
 #include "util/buffer_pool.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "util/memory_budget.hpp"
+
 namespace net::util
 {
 
@@ -7,4 +16,109 @@ buffer_pool::buffer_pool(std::size_t buffer_size, std::size_t num_buffers, std::
     : buffers{num_buffers, max_buffers, [=] { return std::make_unique<buffer_t>(buffer_size); }}
 {}
 
+sized_buffer_pool::sized_buffer_pool(std::size_t max_cached)
+    : max_cached{max_cached}
+{}
+
+sized_buffer_pool& sized_buffer_pool::shared()
+{
+    static sized_buffer_pool pool;
+    [[maybe_unused]] static auto shrinker = memory_budget::shared().add_shrinker([] { pool.trim(); });
+    return pool;
+}
+
+sized_buffer_pool::buffer_t sized_buffer_pool::get(std::size_t size)
+{
+    auto capacity = size_class(size);
+
+    if (capacity <= max_class)
+    {
+        std::unique_lock lock{mu};
+
+        auto& list = free[class_index(capacity)];
+        if (!list.empty())
+        {
+            auto buf = std::move(list.back());
+            list.pop_back();
+            lock.unlock();
+
+            hits.fetch_add(1, std::memory_order::relaxed);
+            cached.fetch_sub(capacity, std::memory_order::relaxed);
+            return buf;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order::relaxed);
+
+    buffer_t buf;
+    buf.reserve(capacity);
+    return buf;
+}
+
+void sized_buffer_pool::put(buffer_t&& buf) noexcept
+{
+    auto capacity = buf.capacity();
+    if (capacity < min_class || capacity > max_class || !std::has_single_bit(capacity)) return;
+
+    buf.clear();
+
+    {
+        std::lock_guard lock{mu};
+
+        auto& list = free[class_index(capacity)];
+        if (list.size() >= max_cached) return;
+
+        // NOTE: can only throw if the list has to grow, in which case the buffer is simply freed with buf
+        try
+        {
+            list.push_back(std::move(buf));
+        }
+        catch (...)
+        {
+            return;
+        }
+    }
+
+    cached.fetch_add(capacity, std::memory_order::relaxed);
+}
+
+std::size_t sized_buffer_pool::size_class(std::size_t size) noexcept
+{
+    if (size <= min_class) return min_class;
+    if (size > max_class) return size;
+    return std::bit_ceil(size);
+}
+
+void sized_buffer_pool::trim() noexcept
+{
+    std::array<std::vector<buffer_t>, num_classes> dropped;
+
+    {
+        std::lock_guard lock{mu};
+        dropped.swap(free);
+    }
+
+    std::size_t freed = 0;
+    for (auto& list : dropped)
+    {
+        for (auto& buf : list) freed += buf.capacity();
+    }
+
+    cached.fetch_sub(freed, std::memory_order::relaxed);
+}
+
+sized_buffer_pool::statistics sized_buffer_pool::stats() const noexcept
+{
+    return {
+        .hits   = hits.load(std::memory_order::relaxed),
+        .misses = misses.load(std::memory_order::relaxed),
+        .cached = cached.load(std::memory_order::relaxed),
+    };
+}
+
+std::size_t sized_buffer_pool::class_index(std::size_t size_class) noexcept
+{
+    return static_cast<std::size_t>(std::countr_zero(size_class) - std::countr_zero(min_class));
+}
+
 }
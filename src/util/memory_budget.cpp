@@ -0,0 +1,188 @@
+#include "util/memory_budget.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "detail/resume.hpp"
+#include "io/scheduler.hpp"
+
+namespace net::util
+{
+
+memory_budget::memory_budget(std::size_t limit, double pressure_ratio) noexcept
+    : pressure_ratio{std::clamp(pressure_ratio, 0.0, 1.0)}
+    , max_bytes{limit}
+{}
+
+memory_budget& memory_budget::shared()
+{
+    static memory_budget budget;
+    return budget;
+}
+
+void memory_budget::set_limit(std::size_t limit) noexcept
+{
+    max_bytes.store(limit, std::memory_order::relaxed);
+
+    if (under_pressure()) shrink();
+    else wake_waiters();
+}
+
+bool memory_budget::try_reserve(std::size_t bytes) noexcept
+{
+    auto limit   = max_bytes.load(std::memory_order::relaxed);
+    auto current = reserved.load(std::memory_order::relaxed);
+
+    do
+    {
+        if (limit != 0 && (current > limit || bytes > limit - current))
+        {
+            refused.fetch_add(1, std::memory_order::relaxed);
+
+            // maybe there's room next time round
+            shrink();
+            return false;
+        }
+    } while (!reserved.compare_exchange_weak(current, current + bytes, std::memory_order::relaxed));
+
+    added(current, current + bytes);
+    return true;
+}
+
+void memory_budget::reserve(std::size_t bytes) noexcept
+{
+    auto old_total = reserved.fetch_add(bytes, std::memory_order::relaxed);
+    added(old_total, old_total + bytes);
+}
+
+void memory_budget::release(std::size_t bytes) noexcept
+{
+    reserved.fetch_sub(bytes, std::memory_order::seq_cst);
+
+    // NOTE: pairs with the increment in room_awaitable::await_suspend, so either this sees the waiter, or the waiter
+    // sees there's room and doesn't wait
+    if (num_waiting.load(std::memory_order::seq_cst) != 0) wake_waiters();
+}
+
+bool memory_budget::under_pressure() const noexcept
+{
+    auto limit = max_bytes.load(std::memory_order::relaxed);
+    return limit != 0 && reserved.load(std::memory_order::seq_cst) > pressure_point(limit);
+}
+
+memory_budget::reservation memory_budget::try_hold(std::size_t bytes) noexcept
+{
+    if (!try_reserve(bytes)) return {};
+    return {this, bytes};
+}
+
+std::coroutine_handle<> memory_budget::room_awaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard lock{budget->waiters_mu};
+
+        budget->num_waiting.fetch_add(1, std::memory_order::seq_cst);
+        if (budget->under_pressure() && !gave_up())
+        {
+            budget->waiters.push_back({.handle = handle, .scheduler = scheduler});
+            return std::noop_coroutine();
+        }
+
+        budget->num_waiting.fetch_sub(1, std::memory_order::relaxed);
+    }
+
+    // there's room after all
+    return handle;
+}
+
+std::size_t memory_budget::add_shrinker(shrinker&& shrink)
+{
+    std::lock_guard lock{shrinkers_mu};
+
+    auto id = next_shrinker_id++;
+    shrinkers.emplace_back(id, std::move(shrink));
+    return id;
+}
+
+void memory_budget::remove_shrinker(std::size_t id)
+{
+    std::lock_guard lock{shrinkers_mu};
+    std::erase_if(shrinkers, [id](const auto& entry) { return entry.first == id; });
+}
+
+memory_budget::statistics memory_budget::stats() const noexcept
+{
+    return {
+        .limit         = max_bytes.load(std::memory_order::relaxed),
+        .reserved      = reserved.load(std::memory_order::relaxed),
+        .used          = used.load(std::memory_order::relaxed),
+        .peak_reserved = peak_reserved.load(std::memory_order::relaxed),
+        .refused       = refused.load(std::memory_order::relaxed),
+        .waiting       = num_waiting.load(std::memory_order::relaxed),
+    };
+}
+
+std::size_t memory_budget::pressure_point(std::size_t limit) const noexcept
+{
+    return static_cast<std::size_t>(static_cast<double>(limit) * pressure_ratio);
+}
+
+void memory_budget::added(std::size_t old_total, std::size_t new_total) noexcept
+{
+    auto peak = peak_reserved.load(std::memory_order::relaxed);
+    while (peak < new_total && !peak_reserved.compare_exchange_weak(peak, new_total, std::memory_order::relaxed)) {}
+
+    auto limit = max_bytes.load(std::memory_order::relaxed);
+    if (limit == 0) return;
+
+    // only when it comes under pressure, not on every reservation while it is
+    auto point = pressure_point(limit);
+    if (old_total <= point && new_total > point) shrink();
+}
+
+void memory_budget::wake_all() noexcept { wake_waiters(true); }
+
+void memory_budget::wake_waiters(bool even_under_pressure) noexcept
+{
+    std::vector<waiter> ready;
+
+    {
+        std::lock_guard lock{waiters_mu};
+        if (waiters.empty() || (under_pressure() && !even_under_pressure)) return;
+
+        ready.swap(waiters);
+        num_waiting.fetch_sub(ready.size(), std::memory_order::relaxed);
+    }
+
+    for (auto& w : ready) net::detail::resume_on_or_here(w.scheduler, w.handle);
+}
+
+void memory_budget::shrink() noexcept
+{
+    // someone's already on it
+    if (shrinking.test_and_set(std::memory_order::acquire)) return;
+
+    {
+        std::lock_guard lock{shrinkers_mu};
+        for (auto& [id, shrink] : shrinkers)
+        {
+            try
+            {
+                shrink();
+            }
+            catch (...)
+            {
+                // a shrinker that can't shrink just doesn't free anything
+            }
+        }
+    }
+
+    shrinking.clear(std::memory_order::release);
+}
+
+}
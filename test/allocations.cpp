@@ -0,0 +1,54 @@
+#include "allocations.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+thread_local std::size_t count = 0;
+
+}
+
+namespace net::test
+{
+
+std::size_t allocations() noexcept { return count; }
+
+}
+
+#if !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+
+// NOTE: replaces operator new for the whole test binary, but only to count - it allocates just as the default does
+
+void* operator new(std::size_t size)
+{
+    ++count;
+
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr; // NOLINT(cppcoreguidelines-no-malloc)
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); } // NOLINT(cppcoreguidelines-no-malloc)
+
+void operator delete(void* ptr, std::size_t /* size */) noexcept { std::free(ptr); } // NOLINT
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    ++count;
+
+    // aligned_alloc wants the size to be a multiple of the alignment
+    auto align = static_cast<std::size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (size + align - 1) / align * align)) return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr, std::align_val_t /* alignment */) noexcept { std::free(ptr); } // NOLINT
+
+void operator delete(void* ptr, std::size_t /* size */, std::align_val_t /* alignment */) noexcept
+{
+    std::free(ptr); // NOLINT(cppcoreguidelines-no-malloc)
+}
+
+#endif
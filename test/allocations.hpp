@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace net::test
+{
+
+// Sanitizers bring their own operator new, which can't be swapped out for one that counts.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+inline constexpr bool allocations_counted = false;
+#else
+inline constexpr bool allocations_counted = true;
+#endif
+
+// allocations is how many times this thread has called operator new so far. Tests count what something allocates by
+// taking the difference before and after.
+std::size_t allocations() noexcept;
+
+}
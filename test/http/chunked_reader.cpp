@@ -0,0 +1,83 @@
+#include "http/chunked_reader.hpp"
+
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <catch2/generators/catch_generators.hpp>
+
+#include "coro/task.hpp"
+#include "io/buffered_reader.hpp"
+#include "io/run.hpp"
+#include "io/string_reader.hpp"
+
+using namespace std::string_view_literals;
+
+using net::test::run;
+
+TEST_CASE("decodes chunks out of a buffered reader", "[http][1.1][chunked_reader]")
+{
+    net::io::string_reader<char> string{"3\r\nfoo\r\n6\r\nbarbaz\r\n0\r\n\r\n"sv};
+
+    net::http::http11::basic_chunked_reader<std::unique_ptr<net::io::buffered_reader>> chunked{
+        std::make_unique<net::io::buffered_reader>(&string)};
+
+    std::string buf(16, 0);
+    auto        res = run(chunked.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 9);
+    REQUIRE(buf.substr(0, 9) == "foobarbaz"sv);
+}
+
+TEST_CASE("stops at the last chunk", "[http][1.1][chunked_reader]")
+{
+    net::io::string_reader<char> string{"3\r\nfoo\r\n0\r\n\r\nGET / HTTP/1.1\r\n"sv};
+    net::io::buffered_reader     buffered{&string};
+
+    net::http::http11::basic_chunked_reader<net::io::buffered_reader*> chunked{&buffered};
+
+    std::string buf(16, 0);
+    auto        res = run(chunked.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 3);
+
+    // what comes after belongs to whatever's reading next
+    res = run(chunked.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE(res.err == net::io::status_condition::closed);
+    REQUIRE(buffered.size() == 16);
+}
+
+TEST_CASE("chunk sizes are hex, and may have extensions", "[http][1.1][chunked_reader]")
+{
+    net::io::string_reader<char> string{
+        "a;name=value\r\n0123456789\r\n1A \r\nabcdefghijklmnopqrstuvwxyz\r\n0;last\r\n\r\n"sv};
+    net::io::buffered_reader     buffered{&string};
+
+    net::http::http11::basic_chunked_reader<net::io::buffered_reader*> chunked{&buffered};
+
+    std::string buf(64, 0);
+    auto        res = run(chunked.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 36);
+    REQUIRE(buf.substr(0, 36) == "0123456789abcdefghijklmnopqrstuvwxyz"sv);
+}
+
+TEST_CASE("rejects malformed framing", "[http][1.1][chunked_reader]")
+{
+    auto body = GENERATE("3\r\nfooX\n0\r\n\r\n"sv, "3\r\nfoo\rX0\r\n\r\n"sv, "g\r\n"sv, ";ext\r\n"sv, "1 2\r\n"sv);
+
+    net::io::string_reader<char> string{body};
+    net::io::buffered_reader     buffered{&string};
+
+    net::http::http11::basic_chunked_reader<net::io::buffered_reader*> chunked{&buffered};
+
+    std::string buf(16, 0);
+    auto        res = run(chunked.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE(res.err == std::errc::illegal_byte_sequence);
+}
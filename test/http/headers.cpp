@@ -0,0 +1,193 @@
+#include "http/headers.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "http/field.hpp"
+#include "string_makers.hpp"
+
+using namespace std::string_view_literals;
+
+namespace http = net::http;
+
+namespace
+{
+
+std::vector<std::string_view> all(const http::headers& headers, std::string_view name)
+{
+    std::vector<std::string_view> out;
+
+    auto values = headers.get_all(name);
+    if (values.has_value())
+    {
+        for (auto value : *values) out.push_back(value);
+    }
+
+    return out;
+}
+
+}
+
+TEST_CASE("well-known header names are found whatever their case", "[http][headers]")
+{
+    REQUIRE(http::find_field("Content-Length"sv) == http::field::content_length);
+    REQUIRE(http::find_field("content-length"sv) == http::field::content_length);
+    REQUIRE(http::find_field("HOST"sv) == http::field::host);
+    REQUIRE(http::find_field("etag"sv) == http::field::etag);
+    REQUIRE(http::find_field("X-Custom"sv) == http::field::unknown);
+    REQUIRE(http::find_field(""sv) == http::field::unknown);
+
+    for (auto i = 0; i < static_cast<int>(http::field::unknown); ++i)
+    {
+        auto f = static_cast<http::field>(i);
+        REQUIRE(http::find_field(http::field_name(f)) == f);
+    }
+}
+
+TEST_CASE("headers are looked up by name or by field", "[http][headers]")
+{
+    http::headers headers;
+    headers.add("content-type"sv, "text/plain"sv);
+    headers.add("X-Custom"sv, "one"sv);
+    headers.add("x-custom"sv, "two"sv);
+
+    REQUIRE(headers.size() == 3);
+    REQUIRE(headers.get("Content-Type"sv) == "text/plain"sv);
+    REQUIRE(headers.get(http::field::content_type) == "text/plain"sv);
+    REQUIRE(headers.get("X-CUSTOM"sv) == "one"sv);
+    REQUIRE(all(headers, "x-custom"sv) == std::vector{"one"sv, "two"sv});
+    REQUIRE_FALSE(headers.get("Host"sv).has_value());
+    REQUIRE_FALSE(headers.get_all("X-Other"sv).has_value());
+
+    SECTION("set replaces every value")
+    {
+        headers.set("X-Custom"sv, "three"sv);
+        REQUIRE(all(headers, "X-Custom"sv) == std::vector{"three"sv});
+        REQUIRE(headers.size() == 2);
+    }
+
+    SECTION("erase removes every value")
+    {
+        REQUIRE(headers.erase("X-CUSTOM"sv) == 2);
+        REQUIRE(headers.erase(http::field::content_type) == 1);
+        REQUIRE(headers.empty());
+    }
+
+    SECTION("well-known names are written the usual way, others as they were given")
+    {
+        std::vector<std::pair<std::string_view, std::string_view>> fields;
+        for (auto [name, value] : headers) fields.emplace_back(name, value);
+
+        REQUIRE(fields.size() == 3);
+        REQUIRE(fields[0] == std::pair{"Content-Type"sv, "text/plain"sv});
+        REQUIRE(fields[1] == std::pair{"X-Custom"sv, "one"sv});
+        REQUIRE(fields[2] == std::pair{"x-custom"sv, "two"sv});
+    }
+}
+
+TEST_CASE("headers can be set from their own values", "[http][headers]")
+{
+    http::headers headers;
+    headers.add("X-Long"sv, std::string(100, 'a'));
+
+    for (auto i = 0; i < 8; ++i) headers.set("X-Long"sv, *headers.get("X-Long"sv));
+    REQUIRE(headers.get("X-Long"sv) == std::string(100, 'a'));
+
+    headers.add("X-Copy"sv, *headers.get("X-Long"sv));
+    REQUIRE(headers.get("X-Copy"sv) == std::string(100, 'a'));
+}
+
+TEST_CASE("headers can be added under a name taken from themselves", "[http][headers]")
+{
+    const std::string name = "X-" + std::string(100, 'n');
+
+    http::headers headers;
+    headers.add(name, "value"sv);
+
+    // with the value too, so the name has to survive text growing for it
+    for (auto i = 0; i < 8; ++i)
+    {
+        auto first = *headers.begin();
+        headers.add(first.name, first.value);
+    }
+
+    REQUIRE(headers.size() == 9);
+    for (auto field : headers) REQUIRE(field.name == name);
+
+    // and with only the name, while there's enough of what's been erased to compact it away
+    headers.add("X-Other"sv, std::string(1'000, 'o'));
+    headers.erase("X-Other"sv);
+
+    auto first = *headers.begin();
+    headers.add(first.name, "last"sv);
+    REQUIRE(headers.size() == 10);
+    for (auto field : headers) REQUIRE(field.name == name);
+    REQUIRE(all(headers, name).back() == "last"sv);
+}
+
+TEST_CASE("headers keep going past their inline room", "[http][headers]")
+{
+    http::headers headers;
+
+    for (std::size_t i = 0; i < http::headers::inline_fields * 3; ++i)
+    {
+        headers.add("X-Header-" + std::to_string(i), std::to_string(i));
+    }
+
+    REQUIRE(headers.size() == http::headers::inline_fields * 3);
+    REQUIRE(headers.get("x-header-0"sv) == "0"sv);
+    REQUIRE(headers.get("X-Header-47"sv) == "47"sv);
+
+    auto copy = headers;
+    REQUIRE(copy == headers);
+
+    auto moved = std::move(headers);
+    REQUIRE(moved == copy);
+    REQUIRE(headers.empty()); // NOLINT(bugprone-use-after-move)
+
+    headers.set("Host"sv, "example.com"sv);
+    REQUIRE(headers.get(http::field::host) == "example.com"sv);
+}
+
+TEST_CASE("headers with the same values are equal, whatever order their names come in", "[http][headers]")
+{
+    const http::headers headers{
+        {  "Accept", {"text/html", "application/json"}},
+        {"X-Hello",                    {"hello world"}},
+    };
+
+    http::headers same;
+    same.add("x-hello"sv, "hello world"sv);
+    same.add("ACCEPT"sv, "text/html"sv);
+    same.add("accept"sv, "application/json"sv);
+
+    REQUIRE(headers == same);
+
+    http::headers reordered;
+    reordered.add("Accept"sv, "application/json"sv);
+    reordered.add("Accept"sv, "text/html"sv);
+    reordered.add("X-Hello"sv, "hello world"sv);
+
+    REQUIRE_FALSE(headers == reordered);
+}
+
+TEST_CASE("common headers are read for what they mean", "[http][headers]")
+{
+    http::headers headers;
+    headers.set_content_length(1234);
+    headers.add(http::field::transfer_encoding, "gzip"sv);
+    headers.add("Transfer-Encoding"sv, "Chunked"sv);
+
+    REQUIRE(headers.get_content_length() == 1234);
+    REQUIRE(headers.is_chunked());
+
+    headers.set(http::field::transfer_encoding, "gzip, identity"sv);
+    REQUIRE_FALSE(headers.is_chunked());
+}
@@ -0,0 +1,428 @@
+#include "http/hpack.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "http/headers.hpp"
+
+using namespace std::string_view_literals;
+
+namespace hpack = net::http::hpack;
+
+namespace
+{
+
+using fields = std::vector<std::pair<std::string, std::string>>;
+
+std::vector<std::byte> from_hex(std::string_view hex)
+{
+    std::vector<std::byte> out;
+    for (std::size_t i = 0; i + 1 < hex.size();)
+    {
+        if (hex[i] == ' ')
+        {
+            ++i;
+            continue;
+        }
+
+        out.push_back(static_cast<std::byte>(std::stoi(std::string{hex.substr(i, 2)}, nullptr, 16)));
+        i += 2;
+    }
+
+    return out;
+}
+
+fields decode(hpack::decoder& decoder, const std::vector<std::byte>& block)
+{
+    fields out;
+    auto   err = decoder.decode(block,
+                                [&](std::string_view name, std::string_view value) { out.emplace_back(name, value); });
+    REQUIRE_FALSE(err);
+
+    return out;
+}
+
+}
+
+TEST_CASE("hpack decodes the examples from the RFC", "[http][hpack]")
+{
+    hpack::decoder decoder;
+
+    SECTION("without Huffman coding")
+    {
+        // https://httpwg.org/specs/rfc7541.html#request.examples.without.huffman.coding
+        REQUIRE(decode(decoder, from_hex("8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d"))
+                == fields{{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}});
+        REQUIRE(decoder.table_size() == 57);
+
+        REQUIRE(decode(decoder, from_hex("8286 84be 5808 6e6f 2d63 6163 6865"))
+                == fields{{":method", "GET"},
+                          {":scheme", "http"},
+                          {":path", "/"},
+                          {":authority", "www.example.com"},
+                          {"cache-control", "no-cache"}});
+        REQUIRE(decoder.table_size() == 110);
+
+        REQUIRE(decode(decoder,
+                       from_hex("8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65"))
+                == fields{{":method", "GET"},
+                          {":scheme", "https"},
+                          {":path", "/index.html"},
+                          {":authority", "www.example.com"},
+                          {"custom-key", "custom-value"}});
+        REQUIRE(decoder.table_size() == 164);
+    }
+
+    SECTION("with Huffman coding")
+    {
+        // https://httpwg.org/specs/rfc7541.html#request.examples.with.huffman.coding
+        REQUIRE(decode(decoder, from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"))
+                == fields{{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}});
+
+        REQUIRE(decode(decoder, from_hex("8286 84be 5886 a8eb 1064 9cbf")).back()
+                == std::pair<std::string, std::string>{"cache-control", "no-cache"});
+
+        REQUIRE(decode(decoder,
+                       from_hex("8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"))
+                == fields{{":method", "GET"},
+                          {":scheme", "https"},
+                          {":path", "/index.html"},
+                          {":authority", "www.example.com"},
+                          {"custom-key", "custom-value"}});
+        REQUIRE(decoder.table_size() == 164);
+    }
+}
+
+TEST_CASE("hpack Huffman codes text both ways", "[http][hpack]")
+{
+    std::vector<std::byte> coded;
+    hpack::huffman_encode("www.example.com"sv, coded);
+    REQUIRE(coded == from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    REQUIRE(hpack::huffman_encoded_size("www.example.com"sv) == coded.size());
+
+    std::string every;
+    for (int c = 0; c < 256; ++c) every.push_back(static_cast<char>(c));
+
+    coded.clear();
+    hpack::huffman_encode(every, coded);
+
+    std::string decoded;
+    REQUIRE(hpack::huffman_decode(coded, decoded));
+    REQUIRE(decoded == every);
+
+    SECTION("padding has to be short, and all ones")
+    {
+        decoded.clear();
+        REQUIRE_FALSE(hpack::huffman_decode(from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4fe"), decoded));
+        REQUIRE_FALSE(hpack::huffman_decode(from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4ff ff"), decoded));
+    }
+}
+
+TEST_CASE("hpack encodes fields for any decoder to read back", "[http][hpack]")
+{
+    hpack::encoder         encoder;
+    std::vector<std::byte> block;
+
+    encoder.encode(":status"sv, "200"sv, block);
+    encoder.encode("Content-Type"sv, "text/plain"sv, block);
+    encoder.encode("X-Request-Id"sv, "0123456789abcdef"sv, block);
+
+    // :status 200 is in the static table
+    REQUIRE(block.front() == std::byte{0x88});
+
+    hpack::decoder decoder;
+    REQUIRE(decode(decoder, block)
+            == fields{{":status", "200"}, {"content-type", "text/plain"}, {"x-request-id", "0123456789abcdef"}});
+}
+
+TEST_CASE("hpack turns away malformed blocks", "[http][hpack]")
+{
+    hpack::decoder decoder;
+
+    auto fails = [&](std::string_view hex)
+    { return static_cast<bool>(decoder.decode(from_hex(hex), [](std::string_view, std::string_view) {})); };
+
+    REQUIRE(fails("80"));             // index 0
+    REQUIRE(fails("be"));             // past the end of the dynamic table
+    REQUIRE(fails("410f 7777"));      // a value cut short
+    REQUIRE(fails("3fe2 1f"));        // a table bigger than allowed
+    REQUIRE(fails("82 3f01"));        // a size update after a field
+    REQUIRE(fails("ffff ffff ffff")); // an index that never ends
+}
+
+TEST_CASE("hpack's dynamic table drops the oldest fields as new ones need the room", "[http][hpack]")
+{
+    // room for three fields of 32 + 10 bytes
+    hpack::dynamic_table table{130};
+
+    auto field = [](int i) { return std::pair{"name-" + std::to_string(i % 10), "val" + std::to_string(i % 10)}; };
+
+    // round and round the ring, many times over
+    for (int i = 0; i < 100; ++i)
+    {
+        auto [name, value] = field(i);
+        table.insert(name, value);
+
+        REQUIRE(table.count() == std::min(i + 1, 3));
+        REQUIRE(table.size() == table.count() * 42);
+
+        for (int back = 0; back < static_cast<int>(table.count()); ++back)
+        {
+            auto got      = table.get(back);
+            auto expected = field(i - back);
+            REQUIRE(got);
+            REQUIRE(got->name == expected.first);
+            REQUIRE(got->value == expected.second);
+        }
+        REQUIRE_FALSE(table.get(table.count()));
+    }
+
+    SECTION("finding fields by name and value, or just name")
+    {
+        bool exact = false;
+        REQUIRE(table.find("name-9", "val9", exact) == 0);
+        REQUIRE(exact);
+        REQUIRE(table.find("name-8", "other", exact) == 1);
+        REQUIRE_FALSE(exact);
+        REQUIRE_FALSE(table.find("name-6", "val6", exact));
+    }
+
+    SECTION("a field can reuse the name of one that's dropped to make room for it")
+    {
+        auto oldest = table.get(2);
+        table.insert(oldest->name, "something else");
+
+        REQUIRE(table.get(0)->name == "name-7");
+        REQUIRE(table.get(0)->value == "something else");
+    }
+
+    SECTION("a field bigger than the whole table empties it")
+    {
+        table.insert("big", std::string(200, 'x'));
+        REQUIRE(table.count() == 0);
+        REQUIRE(table.size() == 0);
+    }
+
+    SECTION("shrinking drops the oldest, and growing keeps what's there")
+    {
+        table.set_capacity(90);
+        REQUIRE(table.count() == 2);
+        REQUIRE(table.get(1)->name == "name-8");
+
+        table.set_capacity(1'000);
+        REQUIRE(table.count() == 2);
+        REQUIRE(table.get(0)->name == "name-9");
+
+        for (int i = 0; i < 20; ++i) table.insert("name-" + std::to_string(i), "value");
+        REQUIRE(table.count() == 22);
+        REQUIRE(table.get(19)->name == "name-0");
+        REQUIRE(table.get(21)->name == "name-8");
+    }
+}
+
+TEST_CASE("hpack sends fields it's sent before as just their index", "[http][hpack]")
+{
+    hpack::encoder encoder;
+    hpack::decoder decoder;
+
+    const fields response{
+        {      ":status",                     "200"},
+        { "content-type",        "application/json"},
+        {"cache-control",      "private, max-age=0"},
+        {       "server",                     "net"},
+        { "x-request-id", "5b0c0d61-4b6f-4a8e-9d4d"},
+        {         "vary", "accept-encoding, origin"},
+    };
+
+    auto encode = [&]
+    {
+        std::vector<std::byte> block;
+        for (const auto& [name, value] : response) encoder.encode(name, value, block);
+        return block;
+    };
+
+    auto first  = encode();
+    auto second = encode();
+
+    REQUIRE(decode(decoder, first) == response);
+    REQUIRE(decode(decoder, second) == response);
+
+    // the second time round, each field is one byte
+    REQUIRE(second.size() == response.size());
+    REQUIRE(encoder.table_size() == decoder.table_size());
+
+    SECTION("but not those whose values keep changing")
+    {
+        std::vector<std::byte> block;
+        encoder.encode("content-length"sv, "1234"sv, block);
+        encoder.encode("content-length"sv, "1234"sv, block);
+        REQUIRE(block.size() > 2);
+
+        REQUIRE(decode(decoder, block) == fields{{"content-length", "1234"}, {"content-length", "1234"}});
+        REQUIRE(encoder.table_size() == decoder.table_size());
+    }
+}
+
+TEST_CASE("hpack never indexes credentials", "[http][hpack]")
+{
+    hpack::encoder encoder;
+    hpack::decoder decoder;
+
+    for (auto [name, value] : {std::pair{"authorization"sv, "Bearer 0123456789"sv},
+                               std::pair{"set-cookie"sv, "session=0123456789; HttpOnly"sv},
+                               std::pair{"cookie"sv, "id=42"sv},
+                               std::pair{"x-anything"sv, "secret"sv}})
+    {
+        std::vector<std::byte> block;
+        encoder.encode(name, value, block, name == "x-anything"sv);
+        encoder.encode(name, value, block, name == "x-anything"sv);
+
+        // a literal never indexed, both times
+        REQUIRE((std::to_integer<unsigned>(block.front()) & 0xf0U) == 0x10);
+        REQUIRE(block.size() > 4);
+
+        const std::pair<std::string, std::string> field{name, value};
+        REQUIRE(decode(decoder, block) == fields{field, field});
+    }
+
+    REQUIRE(encoder.table_size() == 0);
+    REQUIRE(decoder.table_size() == 0);
+}
+
+TEST_CASE("hpack keeps both ends' tables in step as their size changes", "[http][hpack]")
+{
+    hpack::encoder encoder;
+    hpack::decoder decoder{256};
+
+    // the decoder only allows 256 bytes, which the encoder hears about between blocks
+    encoder.set_max_table_size(256);
+
+    std::vector<std::byte> block;
+    encoder.encode("x-first"sv, "one"sv, block);
+
+    // a dynamic table size update (001) to 256 comes first
+    REQUIRE(block.at(0) == std::byte{0x3f});
+    REQUIRE(block.at(1) == std::byte{0xe1});
+    REQUIRE(block.at(2) == std::byte{0x01});
+    REQUIRE(decode(decoder, block) == fields{{"x-first", "one"}});
+
+    SECTION("shrinking and growing again between blocks sends both, so the decoder evicts what the encoder did")
+    {
+        encoder.set_max_table_size(0);
+        encoder.set_max_table_size(256);
+
+        block.clear();
+        encoder.encode("x-second"sv, "two"sv, block);
+        REQUIRE(block.at(0) == std::byte{0x20});
+        REQUIRE(decode(decoder, block) == fields{{"x-second", "two"}});
+
+        block.clear();
+        encoder.encode("x-first"sv, "one"sv, block);
+        encoder.encode("x-second"sv, "two"sv, block);
+        REQUIRE(decode(decoder, block) == fields{{"x-first", "one"}, {"x-second", "two"}});
+    }
+
+    REQUIRE(encoder.table_size() == decoder.table_size());
+}
+
+TEST_CASE("hpack decodes into headers", "[http][hpack]")
+{
+    hpack::decoder decoder;
+
+    net::http::headers out;
+    REQUIRE_FALSE(decoder.decode(from_hex("8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d 5808 6e6f 2d63 6163 6865"),
+                                 out));
+
+    REQUIRE(out.size() == 5);
+    REQUIRE(out.get(":authority"sv) == "www.example.com");
+    REQUIRE(out.get("cache-control"sv) == "no-cache");
+}
+
+TEST_CASE("hpack coding", "[http][hpack][!benchmark]")
+{
+    const net::http::headers request{
+        {        ":method",                                                                    {"GET"}},
+        {        ":scheme",                                                                  {"https"}},
+        {     ":authority",                                                        {"www.example.com"}},
+        {          ":path",                                         {"/api/v1/orders?page=2&limit=50"}},
+        {     "user-agent", {"Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0"}},
+        {         "accept",                                      {"application/json, text/plain, */*"}},
+        {"accept-language",                                                         {"en-GB,en;q=0.5"}},
+        {"accept-encoding",                                                {"gzip, deflate, br, zstd"}},
+        {        "referer",                                         {"https://www.example.com/orders"}},
+        {         "cookie",      {"session=7f4c1d5e9a2b4c8d9e0f1a2b3c4d5e6f; theme=dark; consent=yes"}},
+    };
+
+    const net::http::headers response{
+        {       ":status",                             {"200"}},
+        {  "content-type", {"application/json; charset=utf-8"}},
+        {"content-length",                            {"5123"}},
+        { "cache-control",              {"private, max-age=0"}},
+        {          "date",   {"Mon, 19 Oct 2026 07:28:00 GMT"}},
+        {        "server",                             {"net"}},
+        {          "vary",         {"accept-encoding, origin"}},
+    };
+
+    // as a connection goes on, with the tables holding what was sent before
+    hpack::encoder         encoder;
+    std::vector<std::byte> block;
+
+    BENCHMARK("encoding a request")
+    {
+        block.clear();
+        encoder.encode(request, block);
+        return block.size();
+    };
+
+    BENCHMARK("encoding a response")
+    {
+        block.clear();
+        encoder.encode(response, block);
+        return block.size();
+    };
+
+    // as the first on a connection, so every field's a literal
+    std::vector<std::byte> literal;
+    hpack::encoder{}.encode(request, literal);
+
+    BENCHMARK("decoding a request")
+    {
+        hpack::decoder     fresh;
+        net::http::headers out;
+        return fresh.decode(literal, out).value();
+    };
+
+    // and as a second, sent the same fields as the first
+    hpack::encoder         sender;
+    hpack::decoder         in_step;
+    std::vector<std::byte> first;
+    std::vector<std::byte> indexed;
+    sender.encode(request, first);
+    sender.encode(request, indexed);
+    REQUIRE_FALSE(in_step.decode(first, [](std::string_view, std::string_view) {}));
+
+    BENCHMARK("decoding a request that's been sent before")
+    {
+        net::http::headers out;
+        in_step.decode(indexed, out);
+        return out.size();
+    };
+
+    std::vector<std::byte> coded;
+    hpack::huffman_encode(request.get("user-agent"sv).value(), coded);
+
+    BENCHMARK("Huffman decoding")
+    {
+        std::string out;
+        hpack::huffman_decode(coded, out);
+        return out.size();
+    };
+}
@@ -1,6 +1,10 @@
 #include "http/http11.hpp"
 
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -9,17 +13,23 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include "allocations.hpp"
+#include "coro/task.hpp"
 #include "http/headers.hpp"
 #include "http/http.hpp"
 #include "http/request.hpp"
 #include "io/buffered_reader.hpp"
+#include "io/run.hpp"
 #include "io/string_reader.hpp"
 #include "string_makers.hpp"
 #include "url.hpp"
+#include "util/arena.hpp"
 #include "util/string_util.hpp"
 
 using namespace std::string_view_literals;
 
+using net::test::run;
+
 TEST_CASE("just a request line", "[http][1.1][request_decode]")
 {
     net::io::string_reader<char> content("GET /some/resource HTTP/1.1\r\n\r\n");
@@ -185,3 +195,53 @@ TEST_CASE("chunked", "[http][1.1][request_decode]")
 {
     // TODO
 }
+
+TEST_CASE("a simple GET allocates next to nothing outside its arena", "[http][1.1][request_decode][allocations]")
+{
+    if constexpr (!net::test::allocations_counted) return;
+
+    constexpr auto request = "GET /index.html HTTP/1.1\r\n"
+                             "Host: example.com\r\n"
+                             "User-Agent: curl/8.5.0\r\n"
+                             "Accept: */*\r\n"
+                             "\r\n"sv;
+
+    // decode decodes request, reads its (empty) body, and returns how many allocations that took
+    auto decode = [&](std::pmr::memory_resource* resource)
+    {
+        net::io::string_reader<char> content(request);
+        net::io::buffered_reader     reader{&content};
+
+        // NOTE: nothing's checked until the end, since checks allocate too
+        std::size_t               fields = 0;
+        std::size_t               read   = 1;
+        std::array<std::byte, 16> body{};
+
+        auto before = net::test::allocations();
+        {
+            auto result = run(net::http::http11::request_decode(std::allocator_arg, resource, &reader));
+            if (result.has_value())
+            {
+                fields = result->headers.size();
+                read   = run(result->body->read(body)).count;
+            }
+        }
+        auto allocated = net::test::allocations() - before;
+
+        REQUIRE(fields == 3);
+        REQUIRE(read == 0);
+        return allocated;
+    };
+
+    net::util::arena arena;
+    decode(&arena);
+    arena.reset();
+
+    // What's left is the frames of the reads from the reader, which belongs to the connection rather than the request.
+    auto in_arena = decode(&arena);
+    CHECK(in_arena <= 4);
+    CHECK(arena.capacity() == net::util::arena::default_block_size);
+
+    auto on_heap = decode(std::pmr::new_delete_resource());
+    CHECK(on_heap > in_arena);
+}
@@ -0,0 +1,452 @@
+#include "http/http2.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "http/hpack.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "http/router.hpp"
+#include "http/server.hpp"
+#include "io/io.hpp"
+#include "unix.hpp"
+
+#include "io/reactor.hpp"
+
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
+namespace http  = net::http;
+namespace hpack = net::http::hpack;
+
+namespace
+{
+
+// frame types and flags, as they go over the wire
+constexpr std::uint8_t DATA          = 0x0;
+constexpr std::uint8_t HEADERS       = 0x1;
+constexpr std::uint8_t RST_STREAM    = 0x3;
+constexpr std::uint8_t SETTINGS      = 0x4;
+constexpr std::uint8_t PING          = 0x6;
+constexpr std::uint8_t GOAWAY        = 0x7;
+constexpr std::uint8_t WINDOW_UPDATE = 0x8;
+
+constexpr std::uint8_t END_STREAM  = 0x1;
+constexpr std::uint8_t ACK         = 0x1;
+constexpr std::uint8_t END_HEADERS = 0x4;
+
+using fields = std::vector<std::pair<std::string, std::string>>;
+
+net::coro::task<void> hello(const http::server_request& /* req */, http::response_writer& resp)
+{
+    auto* body = co_await resp.send(http::status::OK, 5);
+    co_await body->write("hello"sv);
+}
+
+// echo sends the request's body back.
+net::coro::task<void> echo(const http::server_request& req, http::response_writer& resp)
+{
+    std::string body;
+    while (true)
+    {
+        char buf[4];
+        auto res = co_await req.body->read(std::span{buf});
+        body.append(buf, res.count);
+        if (res.err) break;
+    }
+
+    auto* out = co_await resp.send(http::status::OK, body.size());
+    co_await out->write(body);
+}
+
+// elsewhere has a coroutine resumed on a thread of its own, a little later - like a timer, or another connection.
+struct elsewhere
+{
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        std::thread{[handle]
+                    {
+                        std::this_thread::sleep_for(20ms);
+                        handle.resume();
+                    }}
+            .detach();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// later sends its body once it's been elsewhere, while the connection's waiting on the client.
+net::coro::task<void> later(const http::server_request& /* req */, http::response_writer& resp)
+{
+    auto* body = co_await resp.send(http::status::OK, 5);
+    co_await elsewhere{};
+    co_await body->write("later"sv);
+}
+
+http::router test_router()
+{
+    http::router router;
+    router.GET("/", hello);
+    router.GET("/later", later);
+    router.POST("/echo", echo);
+    return router;
+}
+
+std::string test_path(std::string_view name)
+{
+    return "@net-test-h2-" + std::string{name} + std::to_string(::getpid());
+}
+
+template<typename Predicate>
+bool eventually(Predicate&& pred, std::chrono::milliseconds timeout = 5s)
+{
+    const auto until = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > until) return false;
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+struct frame
+{
+    std::uint8_t           type  = 0;
+    std::uint8_t           flags = 0;
+    std::uint32_t          id    = 0;
+    std::vector<std::byte> payload;
+
+    [[nodiscard]] std::string text() const { return {reinterpret_cast<const char*>(payload.data()), payload.size()}; }
+};
+
+// client speaks just enough HTTP/2 to test the server with, one frame at a time.
+struct client
+{
+    explicit client(const std::string& path)
+    {
+        net::unix_addr addr{path};
+
+        for (int attempt = 0; attempt < 1'000; ++attempt)
+        {
+            fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            REQUIRE(fd != -1);
+
+            if (::connect(fd, addr.native(), addr.native_size()) == 0) break;
+
+            ::close(std::exchange(fd, -1));
+            std::this_thread::sleep_for(1ms);
+        }
+
+        REQUIRE(fd != -1);
+
+        // a server that never answers fails the test, instead of hanging it
+        timeval timeout{.tv_sec = 5, .tv_usec = 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    client(const client&)            = delete;
+    client& operator=(const client&) = delete;
+
+    ~client() { ::close(fd); }
+
+    void write(std::string_view data) const
+    {
+        REQUIRE(::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    }
+
+    void send(std::uint8_t type, std::uint8_t flags, std::uint32_t id, std::span<const std::byte> payload = {}) const
+    {
+        std::vector<std::byte> out{
+            static_cast<std::byte>(payload.size() >> 16U),
+            static_cast<std::byte>(payload.size() >> 8U),
+            static_cast<std::byte>(payload.size()),
+            static_cast<std::byte>(type),
+            static_cast<std::byte>(flags),
+            static_cast<std::byte>(id >> 24U),
+            static_cast<std::byte>(id >> 16U),
+            static_cast<std::byte>(id >> 8U),
+            static_cast<std::byte>(id),
+        };
+        out.insert(out.end(), payload.begin(), payload.end());
+
+        write({reinterpret_cast<const char*>(out.data()), out.size()});
+    }
+
+    void send(std::uint8_t type, std::uint8_t flags, std::uint32_t id, std::string_view payload) const
+    {
+        send(type, flags, id, std::as_bytes(std::span{payload}));
+    }
+
+    // start sends the client preface, and settings.
+    void start(std::string_view settings = {}) const
+    {
+        write(http::http2::client_preface);
+        send(SETTINGS, 0, 0, settings);
+    }
+
+    void request(std::uint32_t id, std::string_view method, std::string_view path, bool end_stream, fields extra = {})
+    {
+        std::vector<std::byte> block;
+        encoder.encode(":method"sv, method, block);
+        encoder.encode(":scheme"sv, "http"sv, block);
+        encoder.encode(":path"sv, path, block);
+        encoder.encode(":authority"sv, "test"sv, block);
+        for (const auto& [name, value] : extra) encoder.encode(name, value, block);
+
+        send(HEADERS, END_HEADERS | (end_stream ? END_STREAM : 0), id, block);
+    }
+
+    // receive reads the next frame.
+    frame receive()
+    {
+        while (true)
+        {
+            auto byte = [&](std::size_t i) { return static_cast<std::uint8_t>(in[i]); };
+
+            auto length = in.size() >= 9 ? (byte(0) << 16U) | (byte(1) << 8U) | byte(2) : 0U;
+            if (in.size() >= 9 && in.size() >= 9 + length)
+            {
+                frame f{
+                    .type    = byte(3),
+                    .flags   = byte(4),
+                    .id      = ((byte(5) & 0x7fU) << 24U) | (byte(6) << 16U) | (byte(7) << 8U) | byte(8),
+                    .payload = {reinterpret_cast<const std::byte*>(in.data() + 9),
+                                reinterpret_cast<const std::byte*>(in.data() + 9 + length)},
+                };
+                in.erase(0, 9 + length);
+                return f;
+            }
+
+            fill();
+        }
+    }
+
+    // receive_until reads frames until one of type on stream id comes in, and returns it.
+    frame receive_until(std::uint8_t type, std::uint32_t id)
+    {
+        while (true)
+        {
+            auto f = receive();
+            if (f.type == type && f.id == id) return f;
+        }
+    }
+
+    // response reads frames until stream id's response is all in, and returns its fields and body.
+    std::pair<fields, std::string> response(std::uint32_t id)
+    {
+        std::pair<fields, std::string> res;
+        while (true)
+        {
+            auto f = receive();
+            if (f.id != id) continue;
+
+            REQUIRE(f.type != RST_STREAM);
+            if (f.type == HEADERS)
+            {
+                auto err = decoder.decode(f.payload,
+                                          [&](std::string_view name, std::string_view value)
+                                          { res.first.emplace_back(name, value); });
+                REQUIRE_FALSE(err);
+            }
+            else if (f.type == DATA) res.second += f.text();
+
+            if ((f.flags & END_STREAM) != 0) return res;
+        }
+    }
+
+    // head reads an HTTP/1.1 response's head, and leaves whatever followed it to be read as frames.
+    std::string head()
+    {
+        while (in.find("\r\n\r\n") == std::string::npos) fill();
+
+        auto end    = in.find("\r\n\r\n") + 4;
+        auto result = in.substr(0, end);
+        in.erase(0, end);
+        return result;
+    }
+
+    void fill()
+    {
+        char buf[4'096];
+        auto num = ::read(fd, buf, sizeof(buf));
+        REQUIRE(num > 0);
+        in.append(buf, static_cast<std::size_t>(num));
+    }
+
+    int            fd = -1;
+    std::string    in;
+    hpack::encoder encoder;
+    hpack::decoder decoder;
+};
+
+std::string settings_payload(std::uint16_t id, std::uint32_t value)
+{
+    return {static_cast<char>(id >> 8U),
+            static_cast<char>(id),
+            static_cast<char>(value >> 24U),
+            static_cast<char>(value >> 16U),
+            static_cast<char>(value >> 8U),
+            static_cast<char>(value)};
+}
+
+std::string u32(std::uint32_t value) { return settings_payload(0, value).substr(2); }
+
+}
+
+TEST_CASE("HTTP/2 clients with prior knowledge are served", "[http][http2][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("prior-knowledge");
+
+    http::server server{&r.sched, test_router(), {.http2 = true, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    client c{path};
+    c.start();
+
+    // the server's settings come first
+    REQUIRE(c.receive().type == SETTINGS);
+
+    SECTION("requests on several streams at once")
+    {
+        c.request(1, "GET"sv, "/"sv, true);
+        c.request(3, "GET"sv, "/"sv, true);
+
+        for (std::uint32_t id : {1U, 3U})
+        {
+            auto [head, body] = c.response(id);
+            REQUIRE(head.front() == std::pair<std::string, std::string>{":status", "200"});
+            REQUIRE(body == "hello");
+        }
+    }
+
+    SECTION("with a body")
+    {
+        c.request(1, "POST"sv, "/echo"sv, false, {{"content-length", "11"}});
+        c.send(DATA, 0, 1, "hello "sv);
+        c.send(DATA, END_STREAM, 1, "world"sv);
+
+        REQUIRE(c.response(1).second == "hello world");
+    }
+
+    SECTION("handlers that wait on something else send when they're done")
+    {
+        c.request(1, "GET"sv, "/later"sv, true);
+        REQUIRE(c.response(1).second == "later");
+    }
+
+    SECTION("pings are answered")
+    {
+        c.send(PING, 0, 0, "12345678"sv);
+
+        auto pong = c.receive_until(PING, 0);
+        REQUIRE(pong.flags == ACK);
+        REQUIRE(pong.text() == "12345678");
+    }
+
+    SECTION("requests that break the rules are reset")
+    {
+        c.request(1, "GET"sv, "/"sv, true, {{"connection", "keep-alive"}});
+        REQUIRE(c.receive_until(RST_STREAM, 1).text() == u32(0x1)); // PROTOCOL_ERROR
+
+        // the connection carries on
+        c.request(3, "GET"sv, "/"sv, true);
+        REQUIRE(c.response(3).second == "hello");
+    }
+
+    ::close(std::exchange(c.fd, -1));
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("HTTP/2 responses wait for the client to make room for them", "[http][http2][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("flow-control");
+
+    http::server server{&r.sched, test_router(), {.http2 = true, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    client c{path};
+    c.start(settings_payload(0x4, 2)); // SETTINGS_INITIAL_WINDOW_SIZE
+    c.request(1, "GET"sv, "/"sv, true);
+
+    auto first = c.receive_until(DATA, 1);
+    REQUIRE(first.text() == "he");
+    REQUIRE((first.flags & END_STREAM) == 0);
+
+    c.send(WINDOW_UPDATE, 0, 1, u32(3));
+    REQUIRE(c.response(1).second == "llo");
+
+    ::close(std::exchange(c.fd, -1));
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("HTTP/1.1 connections upgrade to HTTP/2", "[http][http2][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("upgrade");
+
+    http::server server{&r.sched, test_router(), {.http2 = true, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    client c{path};
+    c.write("GET / HTTP/1.1\r\nHost: test\r\nConnection: Upgrade, HTTP2-Settings\r\nUpgrade: h2c\r\n"
+            "HTTP2-Settings: AAMAAABkAARAAAAAAAIAAAAA\r\n\r\n"sv);
+
+    REQUIRE(c.head().starts_with("HTTP/1.1 101"));
+
+    // the request is answered on stream 1, once the client's said its preface
+    c.start();
+    REQUIRE(c.response(1).second == "hello");
+
+    // and it carries on from there as any other HTTP/2 connection
+    c.request(3, "GET"sv, "/"sv, true);
+    REQUIRE(c.response(3).second == "hello");
+
+    ::close(std::exchange(c.fd, -1));
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("HTTP/2 connections without any streams open are closed once idle", "[http][http2][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("idle");
+
+    http::server server{&r.sched, test_router(), {.http2 = true, .idle_timeout = 1s, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    client c{path};
+    c.start();
+    c.request(1, "GET"sv, "/"sv, true);
+    REQUIRE(c.response(1).second == "hello");
+
+    REQUIRE(c.receive_until(GOAWAY, 0).text().substr(4) == u32(0x0)); // NO_ERROR
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
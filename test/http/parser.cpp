@@ -0,0 +1,227 @@
+#include "http/parser.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <catch.hpp>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "http/http.hpp"
+#include "http/http11.hpp"
+#include "http/request.hpp"
+#include "io/buffered_reader.hpp"
+#include "io/run.hpp"
+#include "io/string_reader.hpp"
+
+using namespace std::string_view_literals;
+
+namespace http = net::http;
+
+namespace
+{
+
+using net::test::run;
+
+constexpr auto request = "GET /some/resource?a=b HTTP/1.1\r\n"
+                         "Host: example.com\r\n"
+                         "Accept: text/html, application/json\r\n"
+                         "X-Padded: \t lots of room around this one \t \r\n"
+                         "\r\n"sv;
+
+}
+
+TEST_CASE("parses a request head in place", "[http][1.1][parser]")
+{
+    http::http11::request_parser parser;
+
+    auto res = parser.parse(request);
+    REQUIRE(res.has_value());
+    REQUIRE(*res == request.size());
+
+    const auto& head = parser.head();
+    REQUIRE(head.method == "GET"sv);
+    REQUIRE(head.target == "/some/resource?a=b"sv);
+    REQUIRE(head.version == http::protocol_version{.major = 1, .minor = 1});
+
+    REQUIRE(head.fields.size() == 3);
+    REQUIRE(head.fields[0].name == "Host"sv);
+    REQUIRE(head.fields[0].value == "example.com"sv);
+    REQUIRE(head.fields[1].name == "Accept"sv);
+    REQUIRE(head.fields[1].value == "text/html, application/json"sv);
+    REQUIRE(head.fields[2].value == "lots of room around this one"sv);
+
+    // nothing's copied
+    REQUIRE(head.target.data() == request.data() + 4);
+}
+
+TEST_CASE("parses a request head that comes in bit by bit", "[http][1.1][parser]")
+{
+    http::http11::request_parser parser;
+
+    for (std::size_t i = 0; i < request.size(); ++i)
+    {
+        auto res = parser.parse(request.substr(0, i));
+        REQUIRE(res.has_value());
+        REQUIRE(*res == 0);
+    }
+
+    auto res = parser.parse(request);
+    REQUIRE(res.has_value());
+    REQUIRE(*res == request.size());
+    REQUIRE(parser.head().fields.size() == 3);
+}
+
+TEST_CASE("leaves what follows the head alone", "[http][1.1][parser]")
+{
+    const std::string data = std::string{request} + "GET / HTTP/1.1\r\n\r\n";
+
+    http::http11::request_parser parser;
+
+    auto res = parser.parse(data);
+    REQUIRE(res.has_value());
+    REQUIRE(*res == request.size());
+
+    parser.reset();
+    res = parser.parse(std::string_view{data}.substr(request.size()));
+    REQUIRE(res.has_value());
+    REQUIRE(parser.head().target == "/"sv);
+    REQUIRE(parser.head().fields.empty());
+}
+
+TEST_CASE("takes bare line feeds, and skips empty lines before the request", "[http][1.1][parser]")
+{
+    http::http11::request_parser parser;
+
+    auto res = parser.parse("\r\nPOST /x HTTP/1.0\nContent-Length: 0\n\n"sv);
+    REQUIRE(res.has_value());
+    REQUIRE(parser.head().method == "POST"sv);
+    REQUIRE(parser.head().version == http::protocol_version{.major = 1, .minor = 0});
+    REQUIRE(parser.head().fields.size() == 1);
+    REQUIRE(parser.head().fields[0].value == "0"sv);
+}
+
+TEST_CASE("holds heads to their maximum size exactly", "[http][1.1][parser]")
+{
+    SECTION("right at the limit")
+    {
+        http::http11::request_parser parser{request.size()};
+        REQUIRE(parser.parse(request).has_value());
+    }
+
+    SECTION("one byte over")
+    {
+        http::http11::request_parser parser{request.size() - 1};
+        auto                         res = parser.parse(request);
+        REQUIRE_FALSE(res.has_value());
+        REQUIRE(res.error() == std::errc::value_too_large);
+    }
+
+    SECTION("before the end is in")
+    {
+        http::http11::request_parser parser{16};
+        REQUIRE(parser.parse(request.substr(0, 15)).value() == 0);
+
+        auto res = parser.parse(request.substr(0, 16));
+        REQUIRE_FALSE(res.has_value());
+        REQUIRE(res.error() == std::errc::value_too_large);
+    }
+}
+
+TEST_CASE("rejects malformed heads", "[http][1.1][parser]")
+{
+    auto malformed = [](std::string_view head)
+    {
+        http::http11::request_parser parser;
+
+        auto res = parser.parse(head);
+        return !res.has_value() && res.error() == std::errc::illegal_byte_sequence;
+    };
+
+    CHECK(malformed("GET\r\n\r\n"sv));
+    CHECK(malformed("GET / \r\n\r\n"sv));
+    CHECK(malformed("GET / HTTP/x.1\r\n\r\n"sv));
+    CHECK(malformed("G(T / HTTP/1.1\r\n\r\n"sv));
+    CHECK(malformed("GET / HTTP/1.1\r\nNo-Colon\r\n\r\n"sv));
+    CHECK(malformed("GET / HTTP/1.1\r\nSpace : before colon\r\n\r\n"sv));
+    CHECK(malformed("GET / HTTP/1.1\r\nFolded: line\r\n  continued\r\n\r\n"sv));
+    CHECK(malformed("GET / HTTP/1.1\r\nBare: carriage\rreturn\r\n\r\n"sv));
+
+    // control characters are caught wherever they are in a long value, not just in its first 16 bytes
+    CHECK(malformed("GET / HTTP/1.1\r\nLong: 0123456789abcdef0123456789\x01"
+                    "abcdef\r\n\r\n"sv));
+    CHECK(malformed("GET /0123456789abcdef\x7f HTTP/1.1\r\n\r\n"sv));
+}
+
+TEST_CASE("request_decode reads the head and leaves the body", "[http][1.1][parser][request_decode]")
+{
+    net::io::string_reader<char> content("POST /submit HTTP/1.1\r\n"
+                                         "Host: example.com\r\n"
+                                         "Transfer-Encoding: gzip, chunked\r\n"
+                                         "\r\n"
+                                         "3\r\nabc\r\n0\r\n\r\n");
+
+    auto result = run(http::http11::request_decode(std::make_unique<net::io::buffered_reader>(&content)));
+    REQUIRE(result.has_value());
+
+    auto& req = result.value();
+    REQUIRE(req.method == http::request_method::POST);
+    REQUIRE(req.uri.path == "/submit");
+    REQUIRE(req.uri.host == "example.com");
+    REQUIRE(req.headers.get("Transfer-Encoding"sv) == "gzip, chunked"sv);
+    REQUIRE(req.headers.is_chunked());
+
+    std::string body(16, 0);
+    auto        read = run(req.body->read(std::as_writable_bytes(std::span{body})));
+    REQUIRE(read.count == 3);
+    REQUIRE(body.substr(0, 3) == "abc"sv);
+}
+
+TEST_CASE("request_decode turns away heads that are too large", "[http][1.1][parser][request_decode]")
+{
+    net::io::string_reader<char> content(request);
+
+    auto result = run(http::http11::request_decode(std::make_unique<net::io::buffered_reader>(&content), 32));
+    REQUIRE_FALSE(result.has_value());
+    REQUIRE(result.error() == std::errc::value_too_large);
+}
+
+TEST_CASE("request head parsing", "[http][1.1][parser][!benchmark]")
+{
+    constexpr auto browser = "GET /wp-content/uploads/2010/03/hello-kitty-darth-vader-pink.jpg HTTP/1.1\r\n"
+                             "Host: www.kittyhell.com\r\n"
+                             "User-Agent: Mozilla/5.0 (Macintosh; U; Intel Mac OS X 10_6_6; ja-JP-mac; rv:1.9.2.3) "
+                             "Gecko/20100401 Firefox/3.6.3 Pathtraq/0.9\r\n"
+                             "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+                             "Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"
+                             "Accept-Encoding: gzip,deflate\r\n"
+                             "Accept-Charset: Shift_JIS,utf-8;q=0.7,*;q=0.7\r\n"
+                             "Keep-Alive: 115\r\n"
+                             "Connection: keep-alive\r\n"
+                             "Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "
+                             "__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "
+                             "__utmz=xxxxxxxxx.xxxxxxxxxx.x.x.utmccn=(referral)|utmcsr=reader.livedoor.com|"
+                             "utmcct=/reader/|utmcmd=referral\r\n"
+                             "\r\n"sv;
+
+    http::http11::request_parser parser;
+
+    BENCHMARK("in place")
+    {
+        parser.reset();
+        return parser.parse(browser).value();
+    };
+
+    BENCHMARK("through request_decode")
+    {
+        net::io::string_reader<char> content{browser};
+        return run(http::http11::request_decode(std::make_unique<net::io::buffered_reader>(&content))).has_value();
+    };
+}
@@ -0,0 +1,452 @@
+#include "http/response_cache.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "http/http11.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "http/router.hpp"
+#include "io/run.hpp"
+#include "io/string_writer.hpp"
+#include "io/writer.hpp"
+#include "util/memory_budget.hpp"
+
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
+namespace http = net::http;
+
+namespace
+{
+
+using net::test::run;
+
+// encode stands in for a protocol other than HTTP/1.1, which sends nothing of the head.
+net::coro::task<http::response_encoder_result> encode(net::io::writer* writer,
+                                                      const http::server_response& /* resp */) noexcept
+{
+    co_return writer;
+}
+
+http::server_request get(std::string_view path)
+{
+    http::server_request req;
+    req.method   = http::request_method::GET;
+    req.version  = {.major = 1, .minor = 1};
+    req.uri.path = path;
+    req.headers.set(http::field::host, "example.com"sv);
+
+    return req;
+}
+
+struct reply
+{
+    http::server_response resp;
+    std::string           sent;
+};
+
+// call calls handler as the server would for HTTP/1.1, and returns what it sent.
+template<typename Handler>
+reply call(const Handler& handler, const http::server_request& req)
+{
+    net::io::string_writer<char> out;
+
+    reply r;
+    r.resp.version = req.version;
+    r.resp.body    = &out;
+
+    http::response_writer writer{&out, &r.resp, http::http11::response_encode};
+    run(handler(req, writer));
+    r.sent = out.build();
+
+    return r;
+}
+
+// gate holds a handler up, until held is resumed.
+struct gate
+{
+    std::coroutine_handle<>* held;
+
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+    void               await_suspend(std::coroutine_handle<> handle) const noexcept { *held = handle; }
+    void               await_resume() const noexcept {}
+};
+
+// page is a handler that answers with its body, and with the fields it's given, and counts how often it's called.
+struct page
+{
+    int*                                                       calls;
+    std::string                                                body;
+    std::vector<std::pair<std::string_view, std::string_view>> fields;
+
+    net::coro::task<void> operator()(const http::server_request& req, http::response_writer& resp) const
+    {
+        ++*calls;
+        for (auto [name, value] : fields) resp.headers().add(name, value);
+
+        auto out = body;
+        if (auto lang = req.headers.get(http::field::accept_language)) out += *lang;
+
+        auto* w = co_await resp.send(http::status::OK, out.size());
+        co_await w->write(out);
+    }
+};
+
+}
+
+TEST_CASE("response_cache answers from what it's kept", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int  calls   = 0;
+    auto handler = cache.wrap(page{.calls = &calls, .body = "hello", .fields = {{"cache-control", "max-age=60"}}});
+
+    auto first = call(handler, get("/hello"));
+    REQUIRE(calls == 1);
+    REQUIRE(first.resp.status_code == http::status::OK);
+    REQUIRE(first.sent.starts_with("HTTP/1.1 200 OK\r\n"));
+    REQUIRE(first.sent.ends_with("\r\n\r\nhello"));
+
+    SECTION("the same bytes, without the handler")
+    {
+        auto second = call(handler, get("/hello"));
+        REQUIRE(calls == 1);
+        REQUIRE(second.resp.status_code == http::status::OK);
+        REQUIRE(second.sent == first.sent);
+        REQUIRE(cache.stats().hits == 1);
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("by host, path and query, in any order")
+    {
+        auto req = get("/hello");
+        req.uri.query["b"].push_back("2");
+        req.uri.query["a"].push_back("1");
+        call(handler, req);
+        REQUIRE(calls == 2);
+
+        auto reordered = get("/hello");
+        reordered.uri.query["a"].push_back("1");
+        reordered.uri.query["b"].push_back("2");
+        call(handler, reordered);
+        REQUIRE(calls == 2);
+
+        call(handler, get("/hello/"));
+        REQUIRE(calls == 3);
+
+        auto elsewhere = get("/hello");
+        elsewhere.headers.set(http::field::host, "example.org"sv);
+        call(handler, elsewhere);
+        REQUIRE(calls == 4);
+    }
+
+    SECTION("requests that mustn't be answered from it")
+    {
+        auto no_store = get("/hello");
+        no_store.headers.set(http::field::cache_control, "no-store"sv);
+        call(handler, no_store);
+        REQUIRE(calls == 2);
+
+        auto credentials = get("/hello");
+        credentials.headers.set(http::field::authorization, "Bearer x"sv);
+        call(handler, credentials);
+        REQUIRE(calls == 3);
+
+        auto head   = get("/hello");
+        head.method = http::request_method::HEAD;
+        call(handler, head);
+        REQUIRE(calls == 4);
+    }
+
+    SECTION("sent again, for other protocols")
+    {
+        net::io::string_writer<char> out;
+        http::server_response        resp{.version = {.major = 2, .minor = 0}, .body = &out};
+        http::response_writer        writer{&out, &resp, encode};
+
+        auto req = get("/hello");
+        run(handler(req, writer));
+        REQUIRE(calls == 1);
+        REQUIRE(resp.status_code == http::status::OK);
+        REQUIRE(resp.headers.get(http::field::cache_control) == "max-age=60");
+        REQUIRE(resp.headers.get_content_length() == 5);
+        REQUIRE(out.build() == "hello");
+    }
+}
+
+TEST_CASE("response_cache keeps what responses say it can", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int calls = 0;
+
+    auto twice = [&](page p)
+    {
+        auto handler = cache.wrap(std::move(p));
+        call(handler, get("/"));
+        call(handler, get("/"));
+        cache.purge();
+
+        return std::exchange(calls, 0);
+    };
+
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "public, max-age=60"}}}) == 1);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "s-maxage=60, max-age=0"}}}) == 1);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "max-age=0"}}}) == 2);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "no-store"}}}) == 2);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "private, max-age=60"}}}) == 2);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "max-age=60"}, {"vary", "*"}}})
+            == 2);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {{"cache-control", "max-age=60"}, {"set-cookie", "a"}}})
+            == 2);
+    REQUIRE(twice(page{.calls = &calls, .body = "x", .fields = {}}) == 2);
+
+    SECTION("for as long as it's told to by default")
+    {
+        http::response_cache defaults{{.default_max_age = 60s}};
+
+        auto handler = defaults.wrap(page{.calls = &calls, .body = "x", .fields = {}});
+        call(handler, get("/"));
+        call(handler, get("/"));
+        REQUIRE(calls == 1);
+    }
+
+    SECTION("no bigger than max_entry_bytes")
+    {
+        http::response_cache small{{.max_entry_bytes = 64}};
+
+        auto handler = small.wrap(
+            page{.calls = &calls, .body = std::string(100, 'x'), .fields = {{"cache-control", "max-age=60"}}});
+        auto first   = call(handler, get("/"));
+        auto second  = call(handler, get("/"));
+        REQUIRE(calls == 2);
+        REQUIRE(second.sent == first.sent);
+        REQUIRE(small.size() == 0);
+    }
+}
+
+TEST_CASE("response_cache keeps one response for each value of what it varies by", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int  calls   = 0;
+    auto handler = cache.wrap(page{
+        .calls  = &calls,
+        .body   = "hello ",
+        .fields = {{"cache-control", "max-age=60"}, {"vary", "Accept-Language"}},
+    });
+
+    auto in = [](std::string_view lang)
+    {
+        auto req = get("/");
+        req.headers.set(http::field::accept_language, lang);
+        return req;
+    };
+
+    REQUIRE(call(handler, in("en")).sent.ends_with("hello en"));
+    REQUIRE(call(handler, in("fr")).sent.ends_with("hello fr"));
+    REQUIRE(calls == 2);
+
+    REQUIRE(call(handler, in("en")).sent.ends_with("hello en"));
+    REQUIRE(call(handler, in("fr")).sent.ends_with("hello fr"));
+    REQUIRE(calls == 2);
+
+    call(handler, get("/"));
+    REQUIRE(calls == 3);
+}
+
+TEST_CASE("response_cache revalidates by ETag", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int  calls   = 0;
+    auto tagged  = page{
+         .calls  = &calls,
+         .body   = "hello",
+         .fields = {{"cache-control", "max-age=60"}, {"etag", "\"v1\""}},
+    };
+    auto handler = cache.wrap(
+        [tagged, &calls](const http::server_request& req, http::response_writer& resp) -> net::coro::task<void>
+        {
+            if (req.headers.get(http::field::if_none_match) == "\"v1\"")
+            {
+                ++calls;
+                co_await resp.send(http::status::NOT_MODIFIED, 0);
+                co_return;
+            }
+            co_await tagged(req, resp);
+        });
+
+    auto first = call(handler, get("/"));
+    REQUIRE(calls == 1);
+
+    SECTION("answering 304 for a client that has it")
+    {
+        auto req = get("/");
+        req.headers.set(http::field::if_none_match, "W/\"v1\", \"v0\""sv);
+
+        auto again = call(handler, req);
+        REQUIRE(calls == 1);
+        REQUIRE(again.resp.status_code == http::status::NOT_MODIFIED);
+        REQUIRE(again.resp.headers.get(http::field::etag) == "\"v1\"");
+    }
+
+    SECTION("asking the handler whether it's still good")
+    {
+        auto req = get("/");
+        req.headers.set(http::field::cache_control, "no-cache"sv);
+
+        auto again = call(handler, req);
+        REQUIRE(calls == 2);
+        REQUIRE(again.sent == first.sent);
+        REQUIRE(cache.stats().revalidated == 1);
+
+        call(handler, get("/"));
+        REQUIRE(calls == 2);
+    }
+}
+
+TEST_CASE("response_cache calls the handler once for requests that arrive together", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int                     calls = 0;
+    std::coroutine_handle<> held;
+
+    auto handler = cache.wrap(
+        [&calls, &held](const http::server_request& /* req */, http::response_writer& resp) -> net::coro::task<void>
+        {
+            ++calls;
+            co_await gate{&held};
+
+            resp.headers().set(http::field::cache_control, "max-age=60"sv);
+            auto* w = co_await resp.send(http::status::OK, 5);
+            co_await w->write("hello"sv);
+        });
+
+    net::io::string_writer<char> out1;
+    net::io::string_writer<char> out2;
+    http::server_response        resp1{.version = {.major = 1, .minor = 1}, .body = &out1};
+    http::server_response        resp2{.version = {.major = 1, .minor = 1}, .body = &out2};
+    http::response_writer        writer1{&out1, &resp1, http::http11::response_encode};
+    http::response_writer        writer2{&out2, &resp2, http::http11::response_encode};
+
+    auto req   = get("/");
+    auto first = handler(req, writer1);
+    auto other = handler(req, writer2);
+
+    REQUIRE(first.resume());
+    REQUIRE(held);
+    REQUIRE(other.resume());
+
+    held.resume();
+    REQUIRE(first.is_ready());
+    REQUIRE(other.is_ready());
+
+    REQUIRE(calls == 1);
+    REQUIRE(out1.build() == out2.build());
+    REQUIRE(cache.stats().collapsed == 1);
+}
+
+TEST_CASE("response_cache tells apart requests that arrive together by what they vary by", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int                     calls = 0;
+    std::coroutine_handle<> held;
+
+    auto handler = cache.wrap(
+        [&calls, &held](const http::server_request& req, http::response_writer& resp) -> net::coro::task<void>
+        {
+            // only the first is held up, so the second has to wait for it in the cache, not here
+            if (++calls == 1) co_await gate{&held};
+
+            std::string out{req.headers.get(http::field::accept_language).value_or("")};
+            resp.headers().set(http::field::cache_control, "max-age=60"sv);
+            resp.headers().set(http::field::vary, "accept-language"sv);
+            auto* w = co_await resp.send(http::status::OK, out.size());
+            co_await w->write(out);
+        });
+
+    net::io::string_writer<char> out_en;
+    net::io::string_writer<char> out_fr;
+    http::server_response        resp_en{.version = {.major = 1, .minor = 1}, .body = &out_en};
+    http::server_response        resp_fr{.version = {.major = 1, .minor = 1}, .body = &out_fr};
+    http::response_writer        writer_en{&out_en, &resp_en, http::http11::response_encode};
+    http::response_writer        writer_fr{&out_fr, &resp_fr, http::http11::response_encode};
+
+    auto en = get("/");
+    en.headers.set(http::field::accept_language, "en"sv);
+    auto fr = get("/");
+    fr.headers.set(http::field::accept_language, "fr"sv);
+
+    auto first = handler(en, writer_en);
+    auto other = handler(fr, writer_fr);
+
+    REQUIRE(first.resume());
+    REQUIRE(held);
+    REQUIRE(other.resume());
+
+    held.resume();
+    REQUIRE(first.is_ready());
+    REQUIRE(other.is_ready());
+
+    REQUIRE(calls == 2);
+    REQUIRE(out_en.build().ends_with("\r\n\r\nen"));
+    REQUIRE(out_fr.build().ends_with("\r\n\r\nfr"));
+
+    // and each is kept, for its own
+    REQUIRE(call(handler, fr).sent.ends_with("\r\n\r\nfr"));
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("response_cache lets go of what it's kept under memory pressure", "[http][response_cache]")
+{
+    net::util::memory_budget budget{4'096};
+    http::response_cache     cache{{.budget = &budget}};
+
+    int  calls   = 0;
+    auto handler = cache.wrap(page{.calls = &calls, .body = "hello", .fields = {{"cache-control", "max-age=60"}}});
+
+    call(handler, get("/"));
+    REQUIRE(cache.size() == 1);
+    REQUIRE(budget.stats().reserved > 0);
+
+    {
+        auto pressure = budget.try_hold(3'800);
+        REQUIRE(pressure);
+        REQUIRE(cache.size() == 0);
+        REQUIRE(budget.stats().reserved == pressure.size());
+    }
+
+    call(handler, get("/"));
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("response_cache in front of a router", "[http][response_cache]")
+{
+    http::response_cache cache;
+
+    int          calls = 0;
+    http::router inner;
+    inner.GET("/hello", page{.calls = &calls, .body = "hello", .fields = {{"cache-control", "max-age=60"}}});
+
+    http::router outer;
+    outer.fallback(cache.wrap(std::move(inner)));
+
+    call(outer, get("/hello"));
+    call(outer, get("/hello"));
+    REQUIRE(calls == 1);
+    REQUIRE(call(outer, get("/nowhere")).resp.status_code == http::status::NOT_FOUND);
+}
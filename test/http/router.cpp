@@ -0,0 +1,202 @@
+#include "http/router.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "io/run.hpp"
+#include "io/writer.hpp"
+
+using namespace std::string_view_literals;
+
+namespace http = net::http;
+
+namespace
+{
+
+using net::test::run;
+
+net::coro::task<http::response_encoder_result> encode(net::io::writer* writer,
+                                                      const http::server_response& /* resp */) noexcept
+{
+    co_return writer;
+}
+
+net::coro::task<void> answer(http::response_writer& resp, std::string route)
+{
+    resp.headers().set("x-route"sv, route);
+    co_await resp.send(http::status::OK, 0);
+}
+
+// named is a handler that answers with its name, and what the route's wildcards matched.
+auto named(std::string name)
+{
+    return [name](const http::server_request& /* req */, http::response_writer& resp, const http::path_params& params)
+    {
+        auto route = name;
+        for (auto [key, value] : params) route += " " + std::string{key} + "=" + std::string{value};
+        return answer(resp, std::move(route));
+    };
+}
+
+http::server_response call(const http::router& router, http::request_method method, std::string_view path)
+{
+    http::server_request req;
+    req.method   = method;
+    req.uri.path = path;
+
+    http::server_response resp;
+    http::response_writer writer{nullptr, &resp, encode};
+    run(router(req, writer));
+
+    return resp;
+}
+
+std::string route_of(const http::server_response& resp)
+{
+    auto route = resp.headers.get("x-route"sv);
+    return route ? std::string{*route} : std::to_string(static_cast<int>(resp.status_code));
+}
+
+}
+
+TEST_CASE("router routes by path and method", "[http][router]")
+{
+    using enum http::request_method;
+
+    http::router router;
+    router.GET("/", named("index"));
+    router.GET("/users", named("users"));
+    router.POST("/users", named("new user"));
+    router.GET("/users/me", named("me"));
+    router.GET("/users/:id", named("user"));
+    router.GET("/users/:id/posts/:post", named("post"));
+    router.GET("/uploads", named("uploads"));
+    router.GET("plain", [](const http::server_request&, http::response_writer& resp) { return answer(resp, "plain"); });
+
+    REQUIRE(route_of(call(router, GET, "/")) == "index");
+    REQUIRE(route_of(call(router, GET, "")) == "index");
+    REQUIRE(route_of(call(router, GET, "/users")) == "users");
+    REQUIRE(route_of(call(router, POST, "/users")) == "new user");
+    REQUIRE(route_of(call(router, GET, "/uploads")) == "uploads");
+    REQUIRE(route_of(call(router, GET, "/plain")) == "plain");
+
+    SECTION("wildcards hand what they matched to the handler")
+    {
+        REQUIRE(route_of(call(router, GET, "/users/42")) == "user id=42");
+        REQUIRE(route_of(call(router, GET, "/users/42/posts/hello")) == "post id=42 post=hello");
+
+        http::path_params params;
+        auto              found = router.find(GET, "/users/7/posts/x"sv, params);
+        REQUIRE(found.has_value());
+        REQUIRE(params.size() == 2);
+        REQUIRE(params.get("id"sv) == "7");
+        REQUIRE(params.get("post"sv) == "x");
+        REQUIRE_FALSE(params.get("other"sv));
+    }
+
+    SECTION("literal text is tried before a wildcard, whole segments at a time")
+    {
+        REQUIRE(route_of(call(router, GET, "/users/me")) == "me");
+        REQUIRE(route_of(call(router, GET, "/users/mexico")) == "user id=mexico");
+        REQUIRE(route_of(call(router, GET, "/users/m")) == "user id=m");
+    }
+
+    SECTION("paths that lead nowhere, and methods that aren't there")
+    {
+        REQUIRE(call(router, GET, "/nowhere").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/user").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/42/posts").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/42/posts/").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, DELETE, "/users").status_code == http::status::METHOD_NOT_ALLOWED);
+        REQUIRE(call(router, POST, "/users/42").status_code == http::status::METHOD_NOT_ALLOWED);
+    }
+
+    SECTION("adding a route again replaces it")
+    {
+        router.GET("/users/:id", named("replaced"));
+        REQUIRE(route_of(call(router, GET, "/users/42")) == "replaced id=42");
+        REQUIRE(route_of(call(router, GET, "/users/42/posts/hello")) == "post id=42 post=hello");
+    }
+
+    SECTION("subrouters add their routes under a prefix")
+    {
+        router.subrouter("/api/v1/",
+                         [](http::router& api)
+                         {
+                             api.GET("/", named("api"));
+                             api.PUT("/things/:thing", named("thing"));
+                         });
+
+        REQUIRE(route_of(call(router, GET, "/api/v1/")) == "api");
+        REQUIRE(route_of(call(router, PUT, "/api/v1/things/lamp")) == "thing thing=lamp");
+        REQUIRE(route_of(call(router, GET, "/users/me")) == "me");
+    }
+
+    SECTION("wildcards have to have the same name in the same place")
+    {
+        REQUIRE_THROWS_AS(router.GET("/users/:name", named("")), std::runtime_error);
+        REQUIRE_THROWS_AS(router.GET("/things/:", named("")), std::runtime_error);
+    }
+}
+
+TEST_CASE("routing", "[http][router][!benchmark]")
+{
+    using enum http::request_method;
+
+    // a few hundred routes, in the shape of a REST API: each resource with its collection, its items, and some of
+    // the other resources under those
+    const std::vector<std::string> resources{
+        "accounts", "addresses", "alerts",   "apps",     "assets",   "audits",   "backups",  "builds",   "carts",
+        "channels", "comments",  "coupons",  "devices",  "domains",  "events",   "files",    "groups",   "invoices",
+        "jobs",     "keys",      "labels",   "messages", "metrics",  "notes",    "orders",   "payments", "projects",
+        "queues",   "releases",  "reports",  "roles",    "sessions", "settings", "tags",     "teams",    "tickets",
+        "tokens",   "uploads",   "users",    "webhooks",
+    };
+
+    http::router router;
+    std::size_t  routes = 0;
+    for (const auto& resource : resources)
+    {
+        auto base = "/api/v1/" + resource;
+        router.GET(base, named(resource));
+        router.POST(base, named(resource));
+        router.GET(base + "/:id", named(resource));
+        router.PUT(base + "/:id", named(resource));
+        router.DELETE(base + "/:id", named(resource));
+        router.GET(base + "/:id/history", named(resource));
+        router.GET(base + "/:id/comments", named(resource));
+        router.GET(base + "/:id/comments/:comment", named(resource));
+        routes += 8;
+    }
+    REQUIRE(routes >= 300);
+
+    http::path_params params;
+
+    BENCHMARK("a literal route")
+    {
+        return router.find(GET, "/api/v1/tickets"sv, params).has_value();
+    };
+
+    BENCHMARK("a route with wildcards")
+    {
+        return router.find(GET, "/api/v1/tickets/8213/comments/77"sv, params).has_value();
+    };
+
+    BENCHMARK("a path that isn't there")
+    {
+        return router.find(GET, "/api/v1/tickets/8213/attachments"sv, params).has_value();
+    };
+}
@@ -0,0 +1,403 @@
+#include "http/server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "http/router.hpp"
+#include "unix.hpp"
+
+#include "io/reactor.hpp"
+
+using namespace std::chrono_literals;
+using namespace std::string_view_literals;
+
+namespace http = net::http;
+
+namespace
+{
+
+net::coro::task<void> hello(const http::server_request& /* req */, http::response_writer& resp)
+{
+    auto* body = co_await resp.send(http::status::OK, 5);
+    co_await body->write("hello"sv);
+}
+
+http::router hello_router()
+{
+    http::router router;
+    router.GET("/", hello);
+    router.POST("/", hello); // never reads the body
+    return router;
+}
+
+std::string test_path(std::string_view name) { return "@net-test-" + std::string{name} + std::to_string(::getpid()); }
+
+// connect_to makes a plain blocking connection, like any client would, retrying until the server is listening.
+int connect_to(const std::string& path)
+{
+    net::unix_addr addr{path};
+
+    for (int attempt = 0; attempt < 1'000; ++attempt)
+    {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        REQUIRE(fd != -1);
+
+        if (::connect(fd, addr.native(), addr.native_size()) == 0) return fd;
+
+        ::close(fd);
+        std::this_thread::sleep_for(1ms);
+    }
+
+    FAIL("server never started listening");
+    return -1;
+}
+
+// get sends a request over fd, and returns the response's body.
+std::string get(int fd)
+{
+    constexpr auto request = "GET / HTTP/1.1\r\nHost: test\r\n\r\n"sv;
+    REQUIRE(::write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()));
+
+    std::string response;
+    while (!response.ends_with("hello"))
+    {
+        char buf[256];
+        auto num = ::read(fd, buf, sizeof(buf));
+        if (num <= 0) break;
+        response.append(buf, static_cast<std::size_t>(num));
+    }
+
+    auto body = response.find("\r\n\r\n");
+    return body == std::string::npos ? std::string{} : response.substr(body + 4);
+}
+
+// exchange sends request over fd, and returns everything that comes back until the server closes the connection.
+std::string exchange(int fd, std::string_view request)
+{
+    REQUIRE(::write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()));
+
+    std::string response;
+    while (true)
+    {
+        char buf[256];
+        auto num = ::read(fd, buf, sizeof(buf));
+        if (num <= 0) break;
+        response.append(buf, static_cast<std::size_t>(num));
+    }
+
+    return response;
+}
+
+// count_hellos returns how many of hello's responses there are in response.
+std::size_t count_hellos(std::string_view response)
+{
+    std::size_t found = 0;
+    for (auto pos = response.find("hello"sv); pos != std::string_view::npos; pos = response.find("hello"sv, pos + 1))
+    {
+        ++found;
+    }
+
+    return found;
+}
+
+// read_responses reads from fd until count responses from hello have come in, or the server closes the connection, and
+// returns how many did.
+std::size_t read_responses(int fd, std::size_t count)
+{
+    std::string response;
+    std::size_t found = 0;
+    while (found < count)
+    {
+        char buf[256];
+        auto num = ::read(fd, buf, sizeof(buf));
+        if (num <= 0) break;
+        response.append(buf, static_cast<std::size_t>(num));
+        found = count_hellos(response);
+    }
+
+    return found;
+}
+
+template<typename Predicate>
+bool eventually(Predicate&& pred, std::chrono::milliseconds timeout = 5s)
+{
+    const auto until = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > until) return false;
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// resident_bytes returns how much of this process is in memory right now.
+std::size_t resident_bytes()
+{
+    std::size_t   size     = 0;
+    std::size_t   resident = 0;
+    std::ifstream statm{"/proc/self/statm"};
+    statm >> size >> resident;
+    return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+}
+
+TEST_CASE("idle connections shed their buffers", "[http][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("idle");
+
+    http::server server{&r.sched, hello_router(), {.idle_shed_after = 20ms, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    int client = connect_to(path);
+
+    REQUIRE(get(client) == "hello");
+
+    // nothing's come in for a while, so the connection has let go of its buffers...
+    REQUIRE(eventually([&] { return server.parked_connections() == 1; }));
+
+    // ...and picks up right where it left off once something does
+    REQUIRE(get(client) == "hello");
+    REQUIRE(server.parked_connections() == 0);
+
+    ::close(client);
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("the idle timeout only counts between requests", "[http][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("idle-timeout");
+
+    // NOTE: the handler holds its worker up for longer than the idle timeout, which is as slow as a handler gets
+    http::router router;
+    router.GET("/",
+               [](const http::server_request& req, http::response_writer& resp)
+               {
+                   std::this_thread::sleep_for(1'200ms);
+                   return hello(req, resp);
+               });
+
+    http::server server{&r.sched, std::move(router), {.idle_timeout = 1s, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    int client = connect_to(path);
+
+    // a slow handler's response still goes out...
+    REQUIRE(get(client) == "hello");
+
+    // ...and it's only once the connection's been quiet for the idle timeout that it's closed
+    char buf[16];
+    REQUIRE(::read(client, buf, sizeof(buf)) == 0);
+
+    ::close(client);
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("keep-alive connections carry on from where the last request ended", "[http][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("keep-alive");
+
+    http::server server{&r.sched, hello_router(), {.max_unread_body_bytes = 64, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    int client = connect_to(path);
+
+    auto send = [&](std::string_view requests)
+    { REQUIRE(::write(client, requests.data(), requests.size()) == static_cast<ssize_t>(requests.size())); };
+
+    SECTION("requests that arrive together are all answered")
+    {
+        send("GET / HTTP/1.1\r\nHost: test\r\n\r\nGET / HTTP/1.1\r\nHost: test\r\n\r\n"sv);
+        REQUIRE(read_responses(client, 2) == 2);
+        REQUIRE(get(client) == "hello");
+    }
+
+    SECTION("bodies the handler left unread are read past")
+    {
+        send("POST / HTTP/1.1\r\nHost: test\r\nContent-Length: 5\r\n\r\nworld"sv);
+        send("POST / HTTP/1.1\r\nHost: test\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nworld\r\n0\r\n\r\n"sv);
+        send("GET / HTTP/1.1\r\nHost: test\r\n\r\n"sv);
+        REQUIRE(read_responses(client, 3) == 3);
+    }
+
+    SECTION("a body too large to read past closes the connection")
+    {
+        send("POST / HTTP/1.1\r\nHost: test\r\nContent-Length: 100\r\n\r\n"sv);
+        send(std::string(100, 'x'));
+        send("GET / HTTP/1.1\r\nHost: test\r\n\r\n"sv);
+        REQUIRE(read_responses(client, 2) == 1);
+    }
+
+    ::close(client);
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("responses to pipelined requests go out together", "[http][server]")
+{
+    net::test::reactor r;
+
+    const auto path = test_path("pipelined");
+
+    http::server server{&r.sched, hello_router(), {.unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    int client = connect_to(path);
+
+    constexpr auto request  = "GET / HTTP/1.1\r\nHost: test\r\n\r\n"sv;
+    const auto     requests = std::string{request} + std::string{request} + std::string{request};
+    REQUIRE(::write(client, requests.data(), requests.size()) == static_cast<ssize_t>(requests.size()));
+
+    // all three responses are written at once, so they're all there to be read at once
+    std::string response(4'096, 0);
+    auto        num = ::read(client, response.data(), response.size());
+    REQUIRE(num > 0);
+    response.resize(static_cast<std::size_t>(num));
+
+    REQUIRE(count_hellos(response) == 3);
+
+    // and the connection carries on as usual after
+    REQUIRE(get(client) == "hello");
+
+    ::close(client);
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("requests too large for memory are turned away", "[http][server]")
+{
+    // the budget has to outlive the reactor, which still has the connections' buffers to give back when it goes
+    net::util::memory_budget budget{64ull * 1'024};
+    net::test::reactor       r;
+
+    const auto path = test_path("budget");
+
+    http::server server{&r.sched, hello_router(), {.max_body_bytes = 1'024, .budget = &budget, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    SECTION("over the configured maximum")
+    {
+        int client = connect_to(path);
+        auto response = exchange(client, "POST / HTTP/1.1\r\nHost: test\r\nContent-Length: 2048\r\n\r\n"sv);
+        REQUIRE(response.starts_with("HTTP/1.1 413"));
+        ::close(client);
+    }
+
+    SECTION("more than the budget has room for")
+    {
+        server.close();
+        REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+
+        http::server unlimited{&r.sched, hello_router(), {.budget = &budget, .unix_path = path + "-unlimited"}};
+        r.sched.schedule(unlimited.serve());
+
+        int client = connect_to(path + "-unlimited");
+        auto response = exchange(client, "POST / HTTP/1.1\r\nHost: test\r\nContent-Length: 1000000\r\n\r\n"sv);
+        REQUIRE(response.starts_with("HTTP/1.1 503"));
+        REQUIRE(response.find("Retry-After: 1") != std::string::npos);
+        REQUIRE(budget.stats().refused == 1);
+        ::close(client);
+
+        REQUIRE(eventually([&] { return unlimited.open_connections() == 0; }));
+        unlimited.close();
+    }
+
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    server.close();
+}
+
+TEST_CASE("connections waiting for memory give up when the server closes", "[http][server]")
+{
+    net::util::memory_budget budget{64ull * 1'024};
+    net::test::reactor       r;
+
+    const auto path = test_path("budget-close");
+
+    http::server server{&r.sched, hello_router(), {.budget = &budget, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    budget.reserve(64ull * 1'024);
+
+    int client = connect_to(path);
+    REQUIRE(eventually([&] { return budget.stats().waiting == 1; }));
+
+    server.close();
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+    REQUIRE(budget.stats().waiting == 0);
+
+    ::close(client);
+    budget.release(64ull * 1'024);
+}
+
+TEST_CASE("memory per idle connection", "[http][server][!benchmark]")
+{
+    std::size_t num_connections = 100'000;
+
+    // both ends of every connection live in this process
+    rlimit limit{};
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, 2 * num_connections + 1'024);
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+
+    if (limit.rlim_cur < 2 * num_connections + 1'024)
+    {
+        num_connections = (limit.rlim_cur - 1'024) / 2;
+        WARN("file descriptor limit only allows " << num_connections << " connections");
+    }
+
+    net::test::reactor r;
+
+    const auto path = test_path("rss");
+
+    http::server server{&r.sched, hello_router(), {.idle_shed_after = 0ms, .unix_path = path}};
+    r.sched.schedule(server.serve());
+
+    // let the server settle first, so the baseline has everything but the connections in it
+    ::close(connect_to(path));
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }));
+
+    const auto before = resident_bytes();
+
+    std::vector<int> clients;
+    clients.reserve(num_connections);
+    for (std::size_t i = 0; i < num_connections; ++i) clients.push_back(connect_to(path));
+
+    REQUIRE(eventually([&] { return server.parked_connections() == num_connections; }, 60s));
+
+    const auto after = resident_bytes();
+
+    WARN(num_connections << " idle connections: " << (after - before) / num_connections << " bytes each");
+
+    for (int fd : clients) ::close(fd);
+    REQUIRE(eventually([&] { return server.open_connections() == 0; }, 60s));
+    server.close();
+}
@@ -0,0 +1,152 @@
+#include "http/static_router.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "http/request.hpp"
+#include "http/response.hpp"
+#include "http/router.hpp"
+#include "io/run.hpp"
+#include "io/writer.hpp"
+
+using namespace std::string_view_literals;
+
+namespace http = net::http;
+
+namespace
+{
+
+using net::test::run;
+
+net::coro::task<http::response_encoder_result> encode(net::io::writer* writer,
+                                                      const http::server_response& /* resp */) noexcept
+{
+    co_return writer;
+}
+
+net::coro::task<void> answer(http::response_writer& resp, std::string route)
+{
+    resp.headers().set("x-route"sv, route);
+    co_await resp.send(http::status::OK, 0);
+}
+
+net::coro::task<void> index(const http::server_request& /* req */, http::response_writer& resp)
+{
+    return answer(resp, "index");
+}
+
+net::coro::task<void> me(const http::server_request& /* req */, http::response_writer& resp)
+{
+    return answer(resp, "me");
+}
+
+net::coro::task<void> show_user(const http::server_request& /* req */, http::response_writer& resp, std::uint32_t id)
+{
+    return answer(resp, "user " + std::to_string(id));
+}
+
+net::coro::task<void> show_post(const http::server_request& /* req */,
+                                http::response_writer& resp,
+                                std::uint32_t          id,
+                                std::string_view       slug)
+{
+    return answer(resp, "post " + std::to_string(id) + " " + std::string{slug});
+}
+
+// NOTE: captures taken by reference are only read once the handler's task runs, after the router's returned it
+net::coro::task<void> show_tag(const http::server_request& /* req */,
+                               http::response_writer&      resp,
+                               const std::string&          tag,
+                               const std::uint32_t&        page)
+{
+    co_await answer(resp, "tag " + tag + " " + std::to_string(page));
+}
+
+constexpr auto save_user = [](const http::server_request& /* req */, http::response_writer& resp, std::string id)
+{ return answer(resp, "saved " + id); };
+
+using api = http::static_router<http::route<http::request_method::GET, "/", index>,
+                                http::route<http::request_method::GET, "/users/me", me>,
+                                http::route<http::request_method::GET, "/users/:id", show_user>,
+                                http::route<http::request_method::PUT, "/users/:id", save_user>,
+                                http::route<http::request_method::GET, "/users/:id/posts/:slug", show_post>,
+                                http::route<http::request_method::GET, "/tags/:tag/:page", show_tag>>;
+
+template<typename Router>
+http::server_response call(const Router& router, http::request_method method, std::string_view path)
+{
+    http::server_request req;
+    req.method   = method;
+    req.uri.path = path;
+
+    http::server_response resp;
+    http::response_writer writer{nullptr, &resp, encode};
+    run(router(req, writer));
+
+    return resp;
+}
+
+std::string route_of(const http::server_response& resp) { return std::string{resp.headers.get("x-route"sv).value()}; }
+
+}
+
+TEST_CASE("static_router routes by a table fixed at compile time", "[http][router]")
+{
+    using enum http::request_method;
+
+    const api router;
+
+    REQUIRE(route_of(call(router, GET, "/")) == "index");
+    REQUIRE(route_of(call(router, GET, "/users/42")) == "user 42");
+    REQUIRE(route_of(call(router, PUT, "/users/42")) == "saved 42");
+    REQUIRE(route_of(call(router, GET, "/users/7/posts/hello-world")) == "post 7 hello-world");
+
+    SECTION("captures taken by reference last as long as the handler")
+    {
+        REQUIRE(route_of(call(router, GET, "/tags/a-tag-too-long-for-a-small-string/3"))
+                == "tag a-tag-too-long-for-a-small-string 3");
+    }
+
+    SECTION("a literal segment is tried before a capture")
+    {
+        REQUIRE(route_of(call(router, GET, "/users/me")) == "me");
+        REQUIRE(call(router, PUT, "/users/me").status_code == http::status::METHOD_NOT_ALLOWED);
+    }
+
+    SECTION("captures have to be what their handler takes")
+    {
+        REQUIRE(call(router, GET, "/users/someone").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/99999999999").status_code == http::status::NOT_FOUND);
+        REQUIRE(route_of(call(router, PUT, "/users/someone")) == "saved someone");
+    }
+
+    SECTION("paths that lead nowhere")
+    {
+        REQUIRE(call(router, GET, "/nowhere").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/7/posts").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, GET, "/users/7/posts/hello/more").status_code == http::status::NOT_FOUND);
+        REQUIRE(call(router, DELETE, "/").status_code == http::status::METHOD_NOT_ALLOWED);
+    }
+
+    SECTION("as what a router falls back to")
+    {
+        http::router dynamic;
+        dynamic.GET("/added",
+                    [](const http::server_request& /* req */, http::response_writer& resp)
+                    { return answer(resp, "added"); });
+        dynamic.fallback(api{});
+
+        REQUIRE(route_of(call(dynamic, GET, "/added")) == "added");
+        REQUIRE(route_of(call(dynamic, GET, "/users/42")) == "user 42");
+        REQUIRE(call(dynamic, GET, "/nowhere").status_code == http::status::NOT_FOUND);
+    }
+}
@@ -14,17 +14,11 @@ struct StringMaker<net::http::headers>
     {
         std::string build;
 
-        for (const auto& header : headers)
+        for (auto [name, value] : headers)
         {
-            build += header.first;
-            build += ':';
-
-            for (const auto& value : header.second)
-            {
-                build += ' ';
-                build += value;
-            }
-
+            build += name;
+            build += ": ";
+            build += value;
             build += '\n';
         }
 
@@ -1,14 +1,20 @@
 #include "io/buffered_reader.hpp"
 
+#include <chrono>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include <catch.hpp>
 
 #include <catch2/catch_test_macros.hpp>
 
+#include "coro/task.hpp"
+#include "io/buffer_policy.hpp"
+#include "io/run.hpp"
 #include "io/string_reader.hpp"
 
+using namespace std::chrono_literals;
 using namespace std::string_view_literals;
 
 TEST_CASE("buffer reads to capacity as needed", "[io][buffered_reader]")
@@ -48,3 +54,141 @@ TEST_CASE("0-length read", "[io][buffered_reader]")
     REQUIRE_FALSE(res.err);
     REQUIRE(res.count == 0);
 }
+
+TEST_CASE("buffer grows while reads fill it", "[io][buffered_reader][adaptive]")
+{
+    std::string            input(6'000, 'x');
+    net::io::string_reader string{std::string_view{input}};
+
+    net::io::buffered_reader reader{&string, net::io::buffer_policy{.initial = 1'024, .min = 1'024, .max = 4'096}};
+    REQUIRE(reader.capacity() == 1'024);
+
+    auto before = net::io::buffer_usage();
+
+    std::string buf(100, 0);
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == 100);
+    REQUIRE(reader.capacity() == 2'048);
+
+    // it keeps growing as long as there's more to read, but no further than the policy allows
+    while (net::test::run(reader.read(std::span{buf})).count > 0) {}
+    REQUIRE(reader.capacity() == 4'096);
+
+    REQUIRE(net::io::buffer_usage().grows - before.grows == 2);
+}
+
+TEST_CASE("buffer shrinks back down", "[io][buffered_reader][adaptive]")
+{
+    std::string            input(3'000, 'x');
+    net::io::string_reader string{std::string_view{input}};
+
+    net::io::buffered_reader reader{&string, net::io::buffer_policy{.initial = 1'024, .min = 1'024, .max = 4'096}};
+
+    std::string buf(100, 0);
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == 100);
+    REQUIRE(reader.capacity() == 2'048);
+
+    // still holding on to data, so it has to stay as it is
+    REQUIRE_FALSE(reader.shrink());
+
+    buf.resize(reader.size());
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == buf.size());
+
+    REQUIRE(reader.shrink());
+    REQUIRE(reader.capacity() == 1'024);
+    REQUIRE_FALSE(reader.shrink());
+}
+
+TEST_CASE("buffer shrinks once idle", "[io][buffered_reader][adaptive]")
+{
+    std::string            input(3'000, 'x');
+    net::io::string_reader string{std::string_view{input}};
+
+    net::io::buffered_reader reader{
+        &string,
+        net::io::buffer_policy{.initial = 1'024, .min = 1'024, .max = 4'096, .shrink_after = 0ms}};
+
+    std::string buf(100, 0);
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == 100);
+    REQUIRE(reader.capacity() == 2'048);
+
+    buf.resize(reader.size());
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == buf.size());
+
+    // the buffer is empty, and it's been long enough: it shrinks before reading any more
+    auto before = net::io::buffer_usage();
+    REQUIRE(std::get<1>(net::test::run(reader.peek())));
+    REQUIRE(net::io::buffer_usage().shrinks - before.shrinks == 1);
+}
+
+TEST_CASE("buffer is given back while idle, and taken again for the next read", "[io][buffered_reader][adaptive]")
+{
+    net::io::string_reader string{"hello world"sv};
+
+    net::io::buffered_reader reader{&string, net::io::buffer_policy{.initial = 1'024, .min = 1'024, .max = 4'096}};
+
+    std::string buf(5, 0);
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == 5);
+
+    // still holding on to the rest
+    REQUIRE_FALSE(reader.release());
+
+    buf.resize(reader.size());
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == 6);
+    REQUIRE(buf == " world");
+
+    auto before = net::io::buffer_usage();
+    REQUIRE(reader.release());
+    REQUIRE(reader.capacity() == 0);
+    REQUIRE(before.bytes_held - net::io::buffer_usage().bytes_held == 1'024);
+
+    REQUIRE_FALSE(std::get<1>(net::test::run(reader.peek())));
+    REQUIRE(reader.capacity() == 1'024);
+}
+
+TEST_CASE("fixed size buffer never changes", "[io][buffered_reader][adaptive]")
+{
+    std::string            input(3'000, 'x');
+    net::io::string_reader string{std::string_view{input}};
+    net::io::buffered_reader reader(&string, 16);
+
+    std::string buf(10, 0);
+    while (net::test::run(reader.read(std::span{buf})).count > 0) {}
+
+    REQUIRE(reader.capacity() == 16);
+}
+
+TEST_CASE("moving over a reader gives its buffer back", "[io][buffered_reader]")
+{
+    net::io::string_reader string{"hello world"sv};
+
+    net::io::buffered_reader reader{&string, 1'024};
+    net::io::buffered_reader other{&string, 2'048};
+
+    auto before = net::io::buffer_usage();
+    reader      = std::move(other);
+    REQUIRE(before.bytes_held - net::io::buffer_usage().bytes_held == 1'024);
+    REQUIRE(reader.capacity() == 2'048);
+}
+
+TEST_CASE("what's left after consuming stays where it is until there's no room", "[io][buffered_reader]")
+{
+    net::io::string_reader   string{"foobarbaz"sv};
+    net::io::buffered_reader reader{&string, 6};
+
+    REQUIRE(net::test::run(reader.more()) == 6);
+    const auto* at = reader.buffered().data();
+
+    reader.consume(2);
+    REQUIRE(reader.size() == 4);
+    REQUIRE(reader.buffered().data() == at + 2);
+
+    std::string buf(2, 0);
+    REQUIRE(net::test::run(reader.read(std::span{buf})).count == 2);
+    REQUIRE(buf == "ob"sv);
+    REQUIRE(reader.buffered().data() == at + 4);
+
+    // the buffer's full up to the back, so what's left is moved down to make room for the rest
+    REQUIRE(net::test::run(reader.more()) == 3);
+    REQUIRE(reader.buffered().data() == at);
+    REQUIRE(std::string_view{reinterpret_cast<const char*>(at), reader.size()} == "arbaz"sv);
+}
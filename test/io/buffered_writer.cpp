@@ -2,11 +2,15 @@
 
 #include <exception> // IWYU pragma: keep
 #include <string_view>
+#include <utility>
 
 #include <catch.hpp>
 
 #include <catch2/catch_test_macros.hpp>
 
+#include "coro/task.hpp"
+#include "io/buffer_policy.hpp"
+#include "io/run.hpp"
 #include "io/string_writer.hpp"
 
 TEST_CASE("buffer fills up and flushes", "[io][buffered_writer]")
@@ -53,3 +57,42 @@ TEST_CASE("0-length write", "[io][buffered_writer]")
     auto out = builder.build();
     REQUIRE(out.empty());
 }
+
+TEST_CASE("buffer grows when writes don't fit", "[io][buffered_writer][adaptive]")
+{
+    using namespace std::string_view_literals;
+
+    net::io::string_writer<char> builder;
+    net::io::buffered_writer     writer{&builder, net::io::buffer_policy{.initial = 1'024, .min = 1'024, .max = 4'096}};
+    REQUIRE(writer.capacity() == 1'024);
+
+    std::string chunk(600, 'x');
+
+    REQUIRE(net::test::run(writer.write(chunk)).count == 600);
+    REQUIRE(writer.capacity() == 1'024);
+
+    REQUIRE(net::test::run(writer.write(chunk)).count == 600);
+    REQUIRE(writer.capacity() == 2'048);
+
+    for (int i = 0; i < 10; ++i) REQUIRE(net::test::run(writer.write(chunk)).count == 600);
+    REQUIRE(writer.capacity() == 4'096);
+
+    REQUIRE_FALSE(net::test::run(writer.flush()).err);
+    REQUIRE(builder.build() == std::string(12 * 600, 'x'));
+
+    REQUIRE(writer.shrink());
+    REQUIRE(writer.capacity() == 1'024);
+}
+
+TEST_CASE("moving over a writer gives its buffer back", "[io][buffered_writer]")
+{
+    net::io::string_writer<char> builder;
+
+    net::io::buffered_writer writer{&builder, 1'024};
+    net::io::buffered_writer other{&builder, 2'048};
+
+    auto before = net::io::buffer_usage();
+    writer      = std::move(other);
+    REQUIRE(before.bytes_held - net::io::buffer_usage().bytes_held == 1'024);
+    REQUIRE(writer.capacity() == 2'048);
+}
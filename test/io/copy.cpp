@@ -0,0 +1,220 @@
+#include "io/copy.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "io/io.hpp"
+#include "io/reader.hpp"
+#include "io/string_reader.hpp"
+#include "io/string_writer.hpp"
+#include "socket.hpp"
+
+#include "reactor.hpp"
+#include "run.hpp"
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+// fd_reader reads straight from a file descriptor, so writers are allowed to bypass it.
+class fd_reader : public net::io::reader
+{
+public:
+    explicit fd_reader(int fd)
+        : fd{fd}
+    {}
+
+    net::coro::task<net::io::result> read(std::span<std::byte> data) override
+    {
+        auto num = ::read(fd, data.data(), data.size());
+        if (num < 0) co_return {.err = std::make_error_condition(static_cast<std::errc>(errno))};
+        co_return {.count = static_cast<std::size_t>(num)};
+    }
+
+    [[nodiscard]] net::io::handle native_handle() const noexcept override { return fd; }
+    [[nodiscard]] net::io::handle direct_handle() const noexcept override { return fd; }
+
+private:
+    int fd;
+};
+
+// opaque_reader is the same as fd_reader, but doesn't advertise it, forcing io::copy through its buffered loop.
+class opaque_reader : public fd_reader
+{
+public:
+    using fd_reader::fd_reader;
+
+    [[nodiscard]] net::io::handle direct_handle() const noexcept override { return -1; }
+};
+
+// temp_file is an unlinked file filled with size bytes.
+struct temp_file
+{
+    explicit temp_file(std::size_t size)
+        : file{std::tmpfile()}
+    {
+        std::vector<char> data(size);
+        std::iota(data.begin(), data.end(), 0);
+        std::fwrite(data.data(), 1, data.size(), file);
+        std::fflush(file);
+        rewind();
+    }
+
+    ~temp_file() { std::fclose(file); }
+
+    void rewind() const { ::lseek(fd(), 0, SEEK_SET); }
+
+    [[nodiscard]] int fd() const { return ::fileno(file); }
+
+    std::FILE* file;
+};
+
+}
+
+TEST_CASE("copies everything without a fast path", "[io][copy]")
+{
+    net::io::string_reader       reader("foobarbaz"sv);
+    net::io::string_writer<char> writer;
+
+    auto res = net::test::run(net::io::copy(reader, writer));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 9);
+    REQUIRE(writer.build() == "foobarbaz");
+}
+
+TEST_CASE("copies no more than the limit", "[io][copy]")
+{
+    net::io::string_reader       reader("foobarbaz"sv);
+    net::io::string_writer<char> writer;
+
+    auto res = net::test::run(net::io::copy(reader, writer, 6));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 6);
+    REQUIRE(writer.build() == "foobar");
+
+    res = net::test::run(net::io::copy(reader, writer, 0));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 0);
+}
+
+TEST_CASE("sends a file over a socket", "[io][copy]")
+{
+    constexpr std::size_t size = 1024ull * 1024;
+
+    net::test::reactor r;
+    temp_file          file{size};
+
+    std::array<int, 2> fds{};
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()) == 0);
+
+    auto received = net::test::drain(fds[1]);
+
+    {
+        net::socket out{&r.sched, fds[0]};
+        fd_reader   in{file.fd()};
+
+        auto res = r.run(net::io::copy(in, out, size));
+        REQUIRE_FALSE(res.err);
+        REQUIRE(res.count == size);
+
+        out.close(false);
+    }
+
+    REQUIRE(received.get() == size);
+    ::close(fds[1]);
+}
+
+TEST_CASE("relays between sockets", "[io][copy]")
+{
+    constexpr std::size_t size = 1024ull * 1024;
+
+    net::test::reactor r;
+
+    std::array<int, 2> from{};
+    std::array<int, 2> to{};
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, from.data()) == 0);
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, to.data()) == 0);
+
+    std::thread feeder{[fd = from[1]]
+                       {
+                           std::vector<char> data(size, 'x');
+                           std::size_t       sent = 0;
+                           while (sent < data.size())
+                           {
+                               auto num = ::write(fd, data.data() + sent, data.size() - sent);
+                               if (num <= 0) break;
+                               sent += static_cast<std::size_t>(num);
+                           }
+                           ::shutdown(fd, SHUT_WR);
+                       }};
+
+    auto received = net::test::drain(to[1]);
+
+    {
+        net::socket in{&r.sched, from[0]};
+        net::socket out{&r.sched, to[0]};
+
+        auto res = r.run(net::io::copy(in, out, size));
+        REQUIRE_FALSE(res.err);
+        REQUIRE(res.count == size);
+
+        in.close(false);
+        out.close(false);
+    }
+
+    feeder.join();
+    REQUIRE(received.get() == size);
+    ::close(from[1]);
+    ::close(to[1]);
+}
+
+TEST_CASE("copy throughput", "[io][copy][!benchmark]")
+{
+    constexpr std::size_t size = 64ull * 1024 * 1024;
+
+    net::test::reactor r;
+    temp_file          file{size};
+
+    std::array<int, 2> fds{};
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()) == 0);
+
+    // keep the other end drained for the whole benchmark, so it only ever measures the sending side
+    std::thread drainer{[fd = fds[1]] { net::test::drain(fd).get(); }};
+
+    net::socket out{&r.sched, fds[0]};
+
+    BENCHMARK("sendfile")
+    {
+        file.rewind();
+        fd_reader in{file.fd()};
+        return r.run(net::io::copy(in, out, size)).count;
+    };
+
+    BENCHMARK("read/write loop")
+    {
+        file.rewind();
+        opaque_reader in{file.fd()};
+        return r.run(net::io::copy(in, out, size)).count;
+    };
+
+    out.close(false);
+    drainer.join();
+    ::close(fds[1]);
+}
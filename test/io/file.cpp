@@ -0,0 +1,188 @@
+#include "io/file.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/thread_pool.hpp"
+#include "io/buffered_reader.hpp"
+#include "io/io.hpp"
+#include "io/limit_reader.hpp"
+
+#include "io/reactor.hpp"
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+// temp_file is a file that's removed again at the end of the test.
+struct temp_file
+{
+    explicit temp_file(std::string_view contents = {})
+        : path{(std::filesystem::temp_directory_path() / ("net-file-test-" + std::to_string(next++))).string()}
+    {
+        std::ofstream{path, std::ios::binary} << contents;
+    }
+
+    ~temp_file() { std::filesystem::remove(path); }
+
+    [[nodiscard]] std::string contents() const
+    {
+        std::ifstream in{path, std::ios::binary};
+        return {std::istreambuf_iterator<char>{in}, {}};
+    }
+
+    std::string path;
+
+    static inline int next = 0;
+};
+
+std::string_view as_string(std::span<const std::byte> data)
+{
+    return {reinterpret_cast<const char*>(data.data()), data.size()};
+}
+
+}
+
+TEST_CASE("reads a file through a buffered reader", "[io][file]")
+{
+    net::test::reactor r;
+    temp_file          file{"first\nsecond\nthird"};
+
+    auto pool = std::make_shared<net::coro::thread_pool>(1);
+
+    net::io::file_reader     in{&r.sched, pool, file.path};
+    net::io::buffered_reader buffered{&in, 8};
+
+    REQUIRE(in.size() == 18);
+
+    auto line = r.run(
+        [&] -> net::coro::task<std::string>
+        {
+            co_await buffered.peek();
+            auto res = co_await buffered.read_until("\n"sv);
+            co_return std::string{as_string(res.data)};
+        }());
+    REQUIRE(line == "first");
+
+    std::string all(18, '\0');
+    auto        res = r.run(buffered.read(std::span{all}));
+    REQUIRE(res.count == 18);
+    REQUIRE(all == "first\nsecond\nthird");
+
+    std::string rest(8, '\0');
+
+    // the end of the file reads as closed, like a socket would
+    res = r.run(in.read(std::span{rest}));
+    REQUIRE(res.count == 0);
+    REQUIRE(res.err == net::io::status_condition::closed);
+}
+
+TEST_CASE("reads at an offset", "[io][file]")
+{
+    net::test::reactor r;
+    temp_file          file{"foobarbaz"};
+
+    net::io::file_reader in{&r.sched, std::make_shared<net::coro::thread_pool>(1), file.path};
+
+    std::string buf(3, '\0');
+
+    auto res = r.run(in.read_at(std::as_writable_bytes(std::span{buf}), 3));
+    REQUIRE(res.count == 3);
+    REQUIRE(buf == "bar");
+
+    // read() still starts at the beginning
+    res = r.run(in.read(std::span{buf}));
+    REQUIRE(res.count == 3);
+    REQUIRE(buf == "foo");
+}
+
+TEST_CASE("maps a file", "[io][file][mapped]")
+{
+    net::test::reactor r;
+    temp_file          file{"foobarbaz"};
+
+    net::io::mapped_file_reader in{file.path};
+    REQUIRE(in.size() == 9);
+    REQUIRE(as_string(in.data()) == "foobarbaz");
+
+    REQUIRE(as_string(in.next(3)) == "foo");
+    REQUIRE(in.remaining() == 6);
+
+    std::string buf(4, '\0');
+    auto        res = r.run(in.read(std::span{buf}));
+    REQUIRE(res.count == 4);
+    REQUIRE(buf == "barb");
+
+    REQUIRE(as_string(in.next(100)) == "az");
+    REQUIRE(in.next(100).empty());
+
+    res = r.run(in.read(std::span{buf}));
+    REQUIRE(res.err == net::io::status_condition::closed);
+}
+
+TEST_CASE("maps an empty file", "[io][file][mapped]")
+{
+    temp_file file;
+
+    net::io::mapped_file_reader in{file.path};
+    REQUIRE(in.size() == 0);
+    REQUIRE(in.next(10).empty());
+}
+
+TEST_CASE("limits a mapped file", "[io][file][mapped]")
+{
+    net::test::reactor r;
+    temp_file          file{"foobarbaz"};
+
+    net::io::limit_reader in{std::make_unique<net::io::mapped_file_reader>(file.path), 4};
+
+    std::string buf(9, '\0');
+    auto        res = r.run(in.read(std::span{buf}));
+    REQUIRE(res.count == 4);
+    REQUIRE(buf.substr(0, 4) == "foob");
+
+    res = r.run(in.read(std::span{buf}));
+    REQUIRE(res.err == net::io::status_condition::closed);
+}
+
+TEST_CASE("fails to open a missing file", "[io][file]")
+{
+    REQUIRE_THROWS(net::io::mapped_file_reader{"/nonexistent/net-file-test"});
+}
+
+TEST_CASE("writes a file", "[io][file]")
+{
+    net::test::reactor r;
+    temp_file          file{"old contents"};
+
+    auto pool = std::make_shared<net::coro::thread_pool>(1);
+
+    {
+        net::io::file_writer out{&r.sched, pool, file.path};
+
+        REQUIRE(r.run(out.write("hello "sv)).count == 6);
+        REQUIRE(r.run(out.write("world"sv)).count == 5);
+        REQUIRE(r.run(out.write_at(std::as_bytes(std::span{"J"sv}), 0)).count == 1);
+        REQUIRE_FALSE(r.run(out.sync()));
+    }
+
+    REQUIRE(file.contents() == "Jello world");
+
+    {
+        net::io::file_writer out{&r.sched, pool, file.path, net::io::file_writer::mode::append};
+        REQUIRE(r.run(out.write("!"sv)).count == 1);
+    }
+
+    REQUIRE(file.contents() == "Jello world!");
+}
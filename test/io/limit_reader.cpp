@@ -0,0 +1,88 @@
+#include "io/limit_reader.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "io/buffered_reader.hpp"
+#include "io/concepts.hpp"
+#include "io/dynamic.hpp"
+#include "io/reader.hpp"
+#include "io/run.hpp"
+#include "io/string_reader.hpp"
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+using net::test::run;
+
+using string_reader = net::io::string_reader<char>;
+
+}
+
+static_assert(net::io::async_reader<string_reader>);
+static_assert(net::io::buffered_source<net::io::buffered_reader>);
+static_assert(!net::io::buffered_source<string_reader>);
+static_assert(net::io::async_reader<net::io::basic_limit_reader<string_reader>>);
+
+TEST_CASE("composes by value", "[io][limit_reader]")
+{
+    net::io::basic_limit_reader<string_reader> limited{string_reader{"foobarbaz"sv}, 6};
+
+    std::string buf(4, 0);
+
+    auto res = run(limited.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE(res.count == 4);
+    REQUIRE(buf == "foob"sv);
+    REQUIRE(limited.remaining() == 2);
+
+    res = run(limited.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE(res.count == 2);
+    REQUIRE(buf.substr(0, 2) == "ar"sv);
+
+    res = run(limited.read(std::as_writable_bytes(std::span{buf})));
+    REQUIRE(res.count == 0);
+    REQUIRE(res.err == net::io::status_condition::closed);
+}
+
+TEST_CASE("leaves what's past the limit buffered", "[io][limit_reader]")
+{
+    string_reader string{"foobarbaz"sv};
+
+    auto buffered = std::make_unique<net::io::buffered_reader>(&string);
+    auto* under   = buffered.get();
+
+    net::io::basic_limit_reader<std::unique_ptr<net::io::buffered_reader>> limited{std::move(buffered), 3};
+
+    std::string buf(9, 0);
+    REQUIRE(run(limited.read(std::as_writable_bytes(std::span{buf}))).count == 3);
+    REQUIRE(buf.substr(0, 3) == "foo"sv);
+
+    // the rest is still there for whoever reads next
+    REQUIRE(under->read_buffered(std::as_writable_bytes(std::span{buf})) == 6);
+    REQUIRE(buf.substr(0, 6) == "barbaz"sv);
+}
+
+TEST_CASE("type-erases at the boundary", "[io][limit_reader]")
+{
+    std::unique_ptr<net::io::reader> body =
+        net::io::make_dynamic_reader(net::io::basic_limit_reader<string_reader>{string_reader{"foobarbaz"sv}, 3});
+
+    std::string buf(9, 0);
+    REQUIRE(run(body->read(std::span{buf})).count == 3);
+    REQUIRE(buf.substr(0, 3) == "foo"sv);
+
+    // the dynamic flavour, as before
+    net::io::limit_reader legacy{std::make_unique<string_reader>("foobarbaz"sv), 4};
+    REQUIRE(run(legacy.read(std::span{buf})).count == 4);
+    REQUIRE(buf.substr(0, 4) == "foob"sv);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <spdlog/logger.h>
+#include <spdlog/sinks/null_sink.h>
+
+#include "coro/task.hpp"
+#include "coro/thread_pool.hpp"
+#include "io/scheduler.hpp"
+
+namespace net::test
+{
+
+// reactor runs a scheduler on its own thread, for tests that need real I/O.
+struct reactor
+{
+    reactor()
+        : workers{std::make_shared<coro::thread_pool>(2)}
+        , sched{workers, std::make_shared<spdlog::logger>("reactor", std::make_shared<spdlog::sinks::null_sink_mt>())}
+        , loop{[this] { sched.run(); }}
+    {
+        // shutting down before run() has started would be a no-op, leaving the loop thread running forever
+        while (!sched.is_running()) std::this_thread::yield();
+    }
+
+    ~reactor()
+    {
+        sched.shutdown();
+        loop.join();
+        workers->shutdown();
+    }
+
+    // run blocks until task has finished on the scheduler, and returns its result (or rethrows what it threw).
+    template<typename T>
+    T run(coro::task<T>&& task)
+    {
+        std::promise<T> done;
+        auto            future = done.get_future();
+
+        auto wrapper = complete(done, std::move(task));
+        workers->resume(wrapper.get_handle());
+
+        // The wrapper may still be finishing up on a worker thread, even once it looks done (or has thrown), so it's
+        // only freed after the workers are gone.
+        {
+            std::lock_guard lock{finished_mu};
+            finished.push_back(std::move(wrapper));
+        }
+
+        return future.get();
+    }
+
+    // declared first, so these go last: after the workers that could still be touching them
+    std::mutex                finished_mu;
+    std::vector<coro::task<>> finished;
+
+    std::shared_ptr<coro::thread_pool> workers;
+    io::scheduler                      sched;
+    std::thread                        loop;
+
+private:
+    template<typename T>
+    static coro::task<> complete(std::promise<T>& done, coro::task<T> task)
+    {
+        try
+        {
+            done.set_value(co_await std::move(task));
+        }
+        catch (...)
+        {
+            done.set_exception(std::current_exception());
+        }
+    }
+};
+
+// drain reads everything from fd until the other end is closed, and returns the number of bytes it read.
+inline std::future<std::size_t> drain(int fd)
+{
+    return std::async(std::launch::async,
+                      [fd]
+                      {
+                          std::array<char, 64ull * 1024> buf{};
+
+                          std::size_t total = 0;
+                          while (true)
+                          {
+                              auto num = ::read(fd, buf.data(), buf.size());
+                              if (num <= 0) return total;
+                              total += static_cast<std::size_t>(num);
+                          }
+                      });
+}
+
+}
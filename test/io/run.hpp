@@ -0,0 +1,19 @@
+#pragma once
+
+#include <utility>
+
+#include "coro/task.hpp"
+
+namespace net::test
+{
+
+// run resumes task on the calling thread until it's done, and returns its result (or rethrows what it threw). It's for
+// tasks that never wait on I/O; those that do need a reactor.
+template<typename T>
+T run(coro::task<T>&& task)
+{
+    while (task.resume()) {}
+    return std::move(task.get_promise()).result();
+}
+
+}
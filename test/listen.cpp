@@ -0,0 +1,131 @@
+#include "listen.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "io/reactor.hpp"
+#include "tcp.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+net::listener make_listener(net::test::reactor& r)
+{
+    net::listener listener{&r.sched, "127.0.0.1", "0", net::network::tcp, net::protocol::ipv4, 5s};
+    listener.listen(64);
+    return listener;
+}
+
+// connect_to makes a plain blocking connection, like any client would.
+int connect_to(const net::listener& listener)
+{
+    sockaddr_in addr{};
+    socklen_t   size = sizeof(addr);
+    REQUIRE(::getsockname(listener.native_handle(), reinterpret_cast<sockaddr*>(&addr), &size) == 0);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&addr), size) == 0);
+    return fd;
+}
+
+}
+
+TEST_CASE("accepts a connection", "[listener]")
+{
+    net::test::reactor r;
+
+    auto listener = make_listener(r);
+    int  client   = connect_to(listener);
+
+    auto conn = r.run(listener.accept());
+    REQUIRE(conn.valid());
+
+    // accepted sockets never block, and don't leak into child processes
+    REQUIRE((::fcntl(conn.native_handle(), F_GETFL) & O_NONBLOCK) != 0);
+    REQUIRE((::fcntl(conn.native_handle(), F_GETFD) & FD_CLOEXEC) != 0);
+
+    conn.close(false);
+    ::close(client);
+}
+
+TEST_CASE("accepts everything pending at once", "[listener]")
+{
+    constexpr std::size_t num_clients = 10;
+
+    net::test::reactor r;
+
+    auto listener = make_listener(r);
+
+    std::vector<int> clients;
+    for (std::size_t i = 0; i < num_clients; ++i) clients.push_back(connect_to(listener));
+
+    auto conns = r.run(listener.accept_many());
+    REQUIRE(conns.size() == num_clients);
+    for (const auto& conn : conns) REQUIRE(conn.valid());
+
+    for (auto& conn : conns) conn.close(false);
+    for (int fd : clients) ::close(fd);
+}
+
+TEST_CASE("accepts no more than asked for", "[listener]")
+{
+    constexpr std::size_t num_clients = 5;
+
+    net::test::reactor r;
+
+    auto listener = make_listener(r);
+
+    std::vector<int> clients;
+    for (std::size_t i = 0; i < num_clients; ++i) clients.push_back(connect_to(listener));
+
+    auto first = r.run(listener.accept_many(3));
+    REQUIRE(first.size() == 3);
+
+    // the rest are still waiting for the next round
+    auto rest = r.run(listener.accept_many(3));
+    REQUIRE(rest.size() == 2);
+
+    for (auto& conn : first) conn.close(false);
+    for (auto& conn : rest) conn.close(false);
+    for (int fd : clients) ::close(fd);
+}
+
+TEST_CASE("reports how many connections are waiting", "[listener][backlog]")
+{
+    constexpr std::size_t num_clients = 3;
+
+    net::test::reactor r;
+
+    auto listener = make_listener(r);
+
+    auto before = listener.backlog();
+    REQUIRE(before.has_value());
+    REQUIRE(before->queued == 0);
+    REQUIRE(before->limit == 64);
+
+    std::vector<int> clients;
+    for (std::size_t i = 0; i < num_clients; ++i) clients.push_back(connect_to(listener));
+
+    REQUIRE(listener.backlog()->queued == num_clients);
+
+    auto conns = r.run(listener.accept_many());
+    REQUIRE(listener.backlog()->queued == 0);
+
+    for (auto& conn : conns) conn.close(false);
+    for (int fd : clients) ::close(fd);
+}
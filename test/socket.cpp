@@ -0,0 +1,266 @@
+#include "socket.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "io/io.hpp"
+#include "io/poll.hpp"
+#include "io/reactor.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+// tcp_pair returns both ends of a loopback TCP connection.
+std::array<int, 2> tcp_pair()
+{
+    int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(listener != -1);
+
+    sockaddr_in addr{
+        .sin_family = AF_INET,
+        .sin_port   = 0,
+        .sin_addr   = {.s_addr = htonl(INADDR_LOOPBACK)},
+        .sin_zero   = {},
+    };
+    socklen_t size = sizeof(addr);
+
+    REQUIRE(::bind(listener, reinterpret_cast<sockaddr*>(&addr), size) == 0);
+    REQUIRE(::listen(listener, 1) == 0);
+    REQUIRE(::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &size) == 0);
+
+    int client = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&addr), size) == 0);
+
+    int server = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    REQUIRE(server != -1);
+
+    ::close(listener);
+    return {client, server};
+}
+
+}
+
+TEST_CASE("zerocopy writes send everything", "[socket]")
+{
+    constexpr std::size_t size = 4ull * 1024 * 1024;
+
+    net::test::reactor r;
+
+    auto fds      = tcp_pair();
+    auto received = net::test::drain(fds[1]);
+
+    {
+        net::socket sock{&r.sched, fds[0]};
+        REQUIRE(sock.enable_zerocopy(1024));
+
+        std::vector<std::byte> data(size, std::byte{'z'});
+
+        auto res = r.run(sock.write(std::span{data}));
+        REQUIRE_FALSE(res.err);
+        REQUIRE(res.count == size);
+
+        // loopback always ends up copying, which turns zerocopy back off - the next write has to work either way
+        res = r.run(sock.write(std::span{data}));
+        REQUIRE_FALSE(res.err);
+        REQUIRE(res.count == size);
+
+        sock.close(false);
+    }
+
+    REQUIRE(received.get() == 2 * size);
+    ::close(fds[1]);
+}
+
+TEST_CASE("zerocopy isn't available on unix sockets", "[socket]")
+{
+    net::test::reactor r;
+
+    std::array<int, 2> fds{};
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()) == 0);
+
+    net::socket sock{&r.sched, fds[0]};
+    REQUIRE_FALSE(sock.enable_zerocopy());
+
+    sock.close(false);
+    ::close(fds[1]);
+}
+
+TEST_CASE("reads are stamped with when the data arrived", "[socket][timestamp]")
+{
+    net::test::reactor r;
+
+    auto fds = tcp_pair();
+
+    net::socket sock{&r.sched, fds[1]};
+    REQUIRE(sock.enable_rx_timestamps());
+    REQUIRE_FALSE(sock.rx_timestamp().has_value());
+
+    const auto sent_after = std::chrono::system_clock::now();
+    REQUIRE(::write(fds[0], "hi", 2) == 2);
+
+    // leave it sitting in the socket for a while before reading it
+    std::this_thread::sleep_for(20ms);
+    const auto read_after = std::chrono::system_clock::now();
+
+    std::array<std::byte, 2> buf{};
+    REQUIRE(r.run(sock.read(std::span{buf})).count == 2);
+
+    auto arrived = sock.rx_timestamp();
+    REQUIRE(arrived.has_value());
+    REQUIRE(*arrived >= sent_after - 1ms);
+    REQUIRE(*arrived <= read_after);
+
+    sock.close(false);
+    ::close(fds[0]);
+}
+
+TEST_CASE("tcp connections report their statistics", "[socket][tcp_info]")
+{
+    net::test::reactor r;
+
+    auto fds = tcp_pair();
+
+    net::socket sock{&r.sched, fds[1]};
+
+    REQUIRE(::write(fds[0], "hi", 2) == 2);
+    std::array<std::byte, 2> buf{};
+    REQUIRE(r.run(sock.read(std::span{buf})).count == 2);
+
+    auto info = sock.tcp_info();
+    REQUIRE(info.has_value());
+    REQUIRE(info->mss > 0);
+    REQUIRE(info->cwnd > 0);
+    REQUIRE(info->retransmits == 0);
+
+    sock.close(false);
+    ::close(fds[0]);
+}
+
+TEST_CASE("only tcp connections have tcp statistics", "[socket][tcp_info]")
+{
+    net::test::reactor r;
+
+    std::array<int, 2> fds{};
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()) == 0);
+
+    net::socket sock{&r.sched, fds[0]};
+    REQUIRE_FALSE(sock.tcp_info().has_value());
+
+    sock.close(false);
+    ::close(fds[1]);
+}
+
+TEST_CASE("waits time out, and can wait again after", "[socket][scheduler]")
+{
+    net::test::reactor r;
+
+    std::array<int, 2> fds{};
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds.data()) == 0);
+
+    net::socket sock{&r.sched, fds[0]};
+
+    auto res = r.run(r.sched.schedule(fds[0], net::io::poll_op::read, 20ms));
+    REQUIRE(res.err == net::io::status_condition::timed_out);
+
+    // a wait that completes first mustn't be woken up again by its timeout later
+    REQUIRE(::write(fds[1], "x", 1) == 1);
+    res = r.run(r.sched.schedule(fds[0], net::io::poll_op::read, 20ms));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 1);
+
+    std::this_thread::sleep_for(50ms);
+
+    sock.close(false);
+    ::close(fds[1]);
+}
+
+TEST_CASE("reads give up at the read timeout", "[socket][timeout]")
+{
+    net::test::reactor r;
+
+    auto [client, server] = tcp_pair();
+
+    net::socket sock{&r.sched, server};
+    sock.set_read_timeout(20ms);
+
+    std::array<std::byte, 16> buf{};
+
+    auto res = r.run(sock.read(buf));
+    REQUIRE(res.err == net::io::status_condition::timed_out);
+    REQUIRE(res.count == 0);
+
+    // the timeout is per read: the next one gets its own
+    REQUIRE(::write(client, "hi", 2) == 2);
+    res = r.run(sock.read(buf));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 2);
+
+    sock.close(false);
+    ::close(client);
+}
+
+TEST_CASE("a read deadline spans reads", "[socket][timeout]")
+{
+    net::test::reactor r;
+
+    auto [client, server] = tcp_pair();
+
+    net::socket sock{&r.sched, server};
+    sock.set_read_deadline(net::socket::clock::now() + 50ms);
+
+    std::array<std::byte, 16> buf{};
+
+    REQUIRE(::write(client, "a", 1) == 1);
+    auto res = r.run(sock.read(buf));
+    REQUIRE_FALSE(res.err);
+
+    // trickling in bytes doesn't buy any more time
+    std::this_thread::sleep_for(60ms);
+    res = r.run(sock.read(buf));
+    REQUIRE(res.err == net::io::status_condition::timed_out);
+
+    sock.set_read_deadline(net::socket::clock::time_point::max());
+    REQUIRE(::write(client, "b", 1) == 1);
+    res = r.run(sock.read(buf));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 1);
+
+    sock.close(false);
+    ::close(client);
+}
+
+TEST_CASE("idle sockets time out", "[socket][timeout]")
+{
+    net::test::reactor r;
+
+    auto [client, server] = tcp_pair();
+
+    net::socket sock{&r.sched, server};
+    sock.set_idle_timeout(30ms);
+
+    std::array<std::byte, 16> buf{};
+
+    auto start = net::socket::clock::now();
+    auto res   = r.run(sock.read(buf));
+    REQUIRE(res.err == net::io::status_condition::timed_out);
+    REQUIRE(net::socket::clock::now() - start >= 30ms);
+
+    sock.close(false);
+    ::close(client);
+}
@@ -0,0 +1,192 @@
+#include "tcp.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/thread_pool.hpp"
+#include "io/reactor.hpp"
+#include "listen.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+int get_option(int fd, int level, int flag)
+{
+    int       value = 0;
+    socklen_t size  = sizeof(value);
+    REQUIRE(::getsockopt(fd, level, flag, &value, &size) == 0);
+    return value;
+}
+
+std::string port_of(int fd)
+{
+    sockaddr_in addr{};
+    socklen_t   size = sizeof(addr);
+    REQUIRE(::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &size) == 0);
+    return std::to_string(ntohs(addr.sin_port));
+}
+
+}
+
+TEST_CASE("unset options are left alone", "[tcp][tcp_options]")
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+
+    auto before = get_option(fd, IPPROTO_TCP, TCP_NODELAY);
+    net::tcp_options{}.apply(fd);
+    REQUIRE(get_option(fd, IPPROTO_TCP, TCP_NODELAY) == before);
+
+    ::close(fd);
+}
+
+TEST_CASE("low latency options are applied", "[tcp][tcp_options]")
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+
+    auto options = net::tcp_options::low_latency();
+    options.apply(fd);
+
+    REQUIRE(get_option(fd, IPPROTO_TCP, TCP_NODELAY) != 0);
+#ifdef TCP_NOTSENT_LOWAT
+    REQUIRE(get_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT) == static_cast<int>(*options.notsent_lowat));
+#endif
+
+    options = {.no_delay = false};
+    options.apply(fd);
+    REQUIRE(get_option(fd, IPPROTO_TCP, TCP_NODELAY) == 0);
+
+    ::close(fd);
+}
+
+TEST_CASE("buffer sizes are applied", "[tcp][tcp_options]")
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    REQUIRE(fd != -1);
+
+    net::tcp_options{.recv_buffer = 64 * 1024, .send_buffer = 32 * 1024}.apply(fd);
+
+    // the kernel may adjust what was asked for (Linux doubles it for bookkeeping), but never below it
+    REQUIRE(get_option(fd, SOL_SOCKET, SO_RCVBUF) >= 64 * 1024);
+    REQUIRE(get_option(fd, SOL_SOCKET, SO_SNDBUF) >= 32 * 1024);
+
+    ::close(fd);
+}
+
+TEST_CASE("options the system rejects are skipped over", "[tcp][tcp_options]")
+{
+    // a unix socket has buffers, but none of TCP's own options
+    int fds[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+
+    std::vector<std::string> failed;
+    net::tcp_options{.no_delay = true, .cork = true, .send_buffer = 32 * 1024}.try_apply(
+        fds[0], [&](const char* what, int /* err */) { failed.emplace_back(what); });
+
+    REQUIRE(get_option(fds[0], SOL_SOCKET, SO_SNDBUF) >= 32 * 1024);
+    REQUIRE(failed.size() == 2);
+    REQUIRE(failed.front() == "failed to set TCP_NODELAY");
+
+    REQUIRE_THROWS_AS(net::tcp_options{.no_delay = true}.apply(fds[0]), std::system_error);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_CASE("listener sets listener options", "[tcp][tcp_options][listener]")
+{
+    net::test::reactor r;
+
+    net::listener listener{&r.sched,
+                           "127.0.0.1",
+                           "0",
+                           net::network::tcp,
+                           net::protocol::ipv4,
+                           5s,
+                           net::tcp_options{.defer_accept = 1s, .recv_buffer = 128 * 1024}};
+
+    REQUIRE(get_option(listener.native_handle(), SOL_SOCKET, SO_RCVBUF) >= 128 * 1024);
+#ifdef TCP_DEFER_ACCEPT
+    REQUIRE(get_option(listener.native_handle(), IPPROTO_TCP, TCP_DEFER_ACCEPT) > 0);
+#endif
+}
+
+TEST_CASE("connects without blocking", "[tcp][connect]")
+{
+    net::test::reactor r;
+
+    net::listener listener{&r.sched, "127.0.0.1", "0", net::network::tcp, net::protocol::ipv4, 5s};
+    listener.listen(8);
+
+    auto conn = r.run(net::tcp_socket::connect(&r.sched, "127.0.0.1", port_of(listener.native_handle())));
+    REQUIRE(conn.valid());
+
+    auto accepted = r.run(listener.accept());
+    REQUIRE(accepted.valid());
+    REQUIRE(accepted.remote_addr() == conn.local_addr());
+}
+
+TEST_CASE("falls back to the next address", "[tcp][connect]")
+{
+    net::test::reactor r;
+
+    net::listener listener{&r.sched, "127.0.0.1", "0", net::network::tcp, net::protocol::ipv4, 5s};
+    listener.listen(8);
+
+    // "localhost" may well resolve to ::1 first, where nothing is listening, which has to lose the race
+    auto conn = r.run(net::tcp_socket::connect(&r.sched,
+                                               "localhost",
+                                               port_of(listener.native_handle()),
+                                               {.attempt_delay = 50ms}));
+    REQUIRE(conn.valid());
+}
+
+TEST_CASE("reports a refused connection", "[tcp][connect]")
+{
+    net::test::reactor r;
+
+    std::string port;
+    {
+        // take a port nothing is listening on
+        net::listener listener{&r.sched, "127.0.0.1", "0", net::network::tcp, net::protocol::ipv4, 5s};
+        port = port_of(listener.native_handle());
+    }
+
+    REQUIRE_THROWS_AS(r.run(net::tcp_socket::connect(&r.sched, "127.0.0.1", port)), std::system_error);
+}
+
+TEST_CASE("resolves on the pool it's given", "[tcp][connect]")
+{
+    net::test::reactor r;
+
+    net::listener listener{&r.sched, "127.0.0.1", "0", net::network::tcp, net::protocol::ipv4, 5s};
+    listener.listen(8);
+
+    auto resolver = std::make_shared<net::coro::thread_pool>(1);
+
+    auto conn = r.run(net::tcp_socket::connect(&r.sched,
+                                               "localhost",
+                                               port_of(listener.native_handle()),
+                                               {.resolver = resolver}));
+    REQUIRE(conn.valid());
+
+    // what resolving throws is thrown on the scheduler, like anything else
+    REQUIRE_THROWS(r.run(net::tcp_socket::connect(&r.sched, "127.0.0.1", "no-such-service", {.resolver = resolver})));
+}
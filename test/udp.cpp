@@ -0,0 +1,121 @@
+#include "udp.hpp"
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "io/reactor.hpp"
+#include "ip_addr.hpp"
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+const net::ip_addr loopback = net::ip_addr::parse("127.0.0.1").value();
+
+net::udp_addr loopback_addr(const net::udp_socket& sock)
+{
+    return net::udp_addr{loopback, sock.local_udp_addr().port()};
+}
+
+}
+
+TEST_CASE("binds to the requested address", "[udp]")
+{
+    net::test::reactor r;
+    net::udp_socket    sock{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+
+    auto addr = sock.local_udp_addr();
+    REQUIRE(addr.ip() == loopback);
+    REQUIRE(addr.port() != 0);
+}
+
+TEST_CASE("send_to and recv_from carry the peer address", "[udp]")
+{
+    net::test::reactor r;
+    net::udp_socket    sender{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+    net::udp_socket    receiver{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+
+    auto msg = std::as_bytes(std::span{"hello"sv});
+    auto res = r.run(sender.send_to(msg, loopback_addr(receiver)));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == msg.size());
+
+    std::array<std::byte, 64> buf{};
+    net::udp_addr             from;
+
+    res = r.run(receiver.recv_from(buf, from));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == msg.size());
+    REQUIRE(from.port() == sender.local_udp_addr().port());
+    REQUIRE(from.to_string() == "127.0.0.1:" + std::to_string(from.port()));
+}
+
+TEST_CASE("send_many and recv_many batch datagrams", "[udp]")
+{
+    constexpr std::size_t count = 100;
+
+    net::test::reactor r;
+    net::udp_socket    sender{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+    net::udp_socket    receiver{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+
+    auto to = loopback_addr(receiver);
+
+    std::vector<std::array<std::byte, 8>> payloads(count);
+    std::vector<net::outgoing_datagram>   out(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        payloads[i].fill(static_cast<std::byte>(i));
+        out[i] = {.data = payloads[i], .to = &to};
+    }
+
+    auto res = r.run(sender.send_many(out));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == count);
+
+    std::vector<std::array<std::byte, 16>> buffers(count);
+    std::vector<net::incoming_datagram>    in(count);
+    for (std::size_t i = 0; i < count; ++i) in[i].data = buffers[i];
+
+    std::size_t received = 0;
+    while (received < count)
+    {
+        res = r.run(receiver.recv_many(std::span{in}.subspan(received)));
+        REQUIRE_FALSE(res.err);
+        REQUIRE(res.count > 0);
+        received += res.count;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        REQUIRE(in[i].size == 8);
+        REQUIRE_FALSE(in[i].truncated);
+        REQUIRE(in[i].data[0] == static_cast<std::byte>(i));
+        REQUIRE(in[i].from.port() == sender.local_udp_addr().port());
+    }
+}
+
+TEST_CASE("recv_many flags truncated datagrams", "[udp]")
+{
+    net::test::reactor r;
+    net::udp_socket    sender{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+    net::udp_socket    receiver{&r.sched, "127.0.0.1", "0", net::protocol::ipv4};
+
+    std::array<std::byte, 32> payload{};
+    REQUIRE_FALSE(r.run(sender.send_to(payload, loopback_addr(receiver))).err);
+
+    std::array<std::byte, 8>              buf{};
+    std::array<net::incoming_datagram, 1> in{net::incoming_datagram{.data = buf}};
+
+    auto res = r.run(receiver.recv_many(in));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 1);
+    REQUIRE(in[0].truncated);
+}
@@ -0,0 +1,152 @@
+#include "unix.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "io/io.hpp"
+#include "listen.hpp"
+#include "socket.hpp"
+
+#include "io/reactor.hpp"
+
+using namespace std::string_view_literals;
+
+namespace
+{
+
+std::span<const std::byte> bytes(std::string_view str) { return std::as_bytes(std::span{str}); }
+
+std::string_view as_string(std::span<const std::byte> data)
+{
+    return {reinterpret_cast<const char*>(data.data()), data.size()};
+}
+
+}
+
+TEST_CASE("unix addresses", "[unix][unix_addr]")
+{
+    net::unix_addr path{"/tmp/foo.sock"};
+    REQUIRE_FALSE(path.is_abstract());
+    REQUIRE(path.to_string() == "/tmp/foo.sock");
+
+    net::unix_addr abstract{"@foo"};
+    REQUIRE(abstract.is_abstract());
+    REQUIRE(abstract.to_string() == "@foo");
+
+    REQUIRE_THROWS(net::unix_addr{std::string(200, 'x')});
+}
+
+TEST_CASE("socket pairs talk to each other", "[unix]")
+{
+    net::test::reactor r;
+
+    auto [left, right] = net::unix_socket::pair(&r.sched);
+
+    auto res = r.run(left.write(bytes("hello")));
+    REQUIRE_FALSE(res.err);
+
+    std::array<std::byte, 16> buf{};
+    res = r.run(right.read(buf));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(as_string(std::span{buf}.first(res.count)) == "hello");
+}
+
+TEST_CASE("listens on an abstract address", "[unix][listener]")
+{
+    net::test::reactor r;
+
+    net::unix_addr addr{"@net-test-" + std::to_string(::getpid())};
+
+    net::listener listener{&r.sched, addr};
+    listener.listen(8);
+
+    auto client = r.run(net::unix_socket::connect(&r.sched, addr));
+    REQUIRE(client.valid());
+
+    auto server = r.run(listener.accept<net::unix_socket>());
+    REQUIRE(server.valid());
+
+    REQUIRE_FALSE(r.run(client.write(bytes("ping"))).err);
+
+    std::array<std::byte, 4> buf{};
+    auto                      res = r.run(server.read(buf));
+    REQUIRE(as_string(std::span{buf}.first(res.count)) == "ping");
+}
+
+TEST_CASE("removes its socket file on shutdown", "[unix][listener]")
+{
+    net::test::reactor r;
+
+    auto path = "/tmp/net-test-" + std::to_string(::getpid()) + ".sock";
+
+    {
+        net::listener listener{&r.sched, net::unix_addr{path}};
+        listener.listen(8);
+        REQUIRE(::access(path.c_str(), F_OK) == 0);
+    }
+
+    REQUIRE(::access(path.c_str(), F_OK) != 0);
+}
+
+TEST_CASE("seqpacket keeps message boundaries", "[unix]")
+{
+    net::test::reactor r;
+
+    auto [left, right] = net::unix_socket::pair(&r.sched, net::network::unix_seqpacket);
+
+    REQUIRE_FALSE(r.run(left.write(bytes("one"))).err);
+    REQUIRE_FALSE(r.run(left.write(bytes("two"))).err);
+
+    std::array<std::byte, 16> buf{};
+
+    auto res = r.run(right.read(buf));
+    REQUIRE(as_string(std::span{buf}.first(res.count)) == "one");
+
+    res = r.run(right.read(buf));
+    REQUIRE(as_string(std::span{buf}.first(res.count)) == "two");
+}
+
+TEST_CASE("passes file descriptors", "[unix][fds]")
+{
+    net::test::reactor r;
+
+    auto [left, right] = net::unix_socket::pair(&r.sched);
+
+    std::array<int, 2> pipe_fds{};
+    REQUIRE(::pipe(pipe_fds.data()) == 0);
+
+    auto res = r.run(left.send_fds(bytes("x"), std::span{&pipe_fds[1], 1}));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 1);
+
+    // the receiver gets its own copy, so the sender's can go
+    ::close(pipe_fds[1]);
+
+    std::array<std::byte, 1> buf{};
+    std::array<int, 4>       fds{};
+    std::size_t              num_fds = 0;
+
+    res = r.run(right.recv_fds(buf, fds, num_fds));
+    REQUIRE_FALSE(res.err);
+    REQUIRE(res.count == 1);
+    REQUIRE(num_fds == 1);
+    REQUIRE((::fcntl(fds[0], F_GETFD) & FD_CLOEXEC) != 0);
+
+    REQUIRE(::write(fds[0], "hi", 2) == 2);
+    ::close(fds[0]);
+
+    std::array<char, 2> got{};
+    REQUIRE(::read(pipe_fds[0], got.data(), got.size()) == 2);
+    REQUIRE(std::string_view{got.data(), got.size()} == "hi");
+    ::close(pipe_fds[0]);
+}
@@ -0,0 +1,134 @@
+#include "util/arena.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+
+using net::util::arena;
+
+namespace
+{
+
+// counting_resource counts what goes through it to the heap.
+struct counting_resource final : std::pmr::memory_resource
+{
+    std::size_t allocated   = 0;
+    std::size_t deallocated = 0;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        ++allocated;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        ++deallocated;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+net::coro::task<int> add(std::allocator_arg_t, std::pmr::polymorphic_allocator<> /* alloc */, int a, int b)
+{
+    co_return a + b;
+}
+
+}
+
+TEST_CASE("arenas hand out aligned memory from upstream blocks", "[util][arena]")
+{
+    counting_resource upstream;
+    arena             a{1024, &upstream};
+
+    REQUIRE(a.capacity() == 0);
+
+    auto* one = a.allocate(3, 1);
+    auto* two = a.allocate(8, 8);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(two) % 8 == 0);
+    REQUIRE(static_cast<std::byte*>(two) >= static_cast<std::byte*>(one) + 3);
+    REQUIRE(upstream.allocated == 1);
+
+    // deallocating is free, and gives nothing back
+    a.deallocate(two, 8, 8);
+    REQUIRE(upstream.deallocated == 0);
+
+    SECTION("and more, once they run out")
+    {
+        a.allocate(4096, 16);
+        REQUIRE(upstream.allocated == 2);
+    }
+
+    a.release();
+    REQUIRE(upstream.deallocated == upstream.allocated);
+    REQUIRE(a.capacity() == 0);
+}
+
+TEST_CASE("arenas settle into one block across resets", "[util][arena]")
+{
+    counting_resource upstream;
+    arena             a{256, &upstream};
+
+    auto use = [&]
+    {
+        std::pmr::vector<std::pmr::string> strings{&a};
+        for (auto i = 0; i < 32; ++i) strings.emplace_back("a string too long to fit in place");
+    };
+
+    use();
+    REQUIRE(upstream.allocated > 1);
+
+    a.reset();
+    auto settled = upstream.allocated;
+
+    for (auto i = 0; i < 10; ++i)
+    {
+        use();
+        a.reset();
+    }
+
+    REQUIRE(upstream.allocated == settled);
+    REQUIRE(upstream.deallocated == settled - 1);
+    REQUIRE(a.used() == 0);
+}
+
+TEST_CASE("coroutines can have their frames allocated from an arena", "[util][arena][task]")
+{
+    counting_resource upstream;
+    arena             a{1024, &upstream};
+
+    auto task = add(std::allocator_arg, &a, 1, 2);
+    REQUIRE(a.used() > 0);
+
+    while (task.resume()) {}
+    REQUIRE(task.get_promise().result() == 3);
+
+    task.destroy();
+    REQUIRE(upstream.allocated == 1);
+    REQUIRE(upstream.deallocated == 0);
+}
+
+TEST_CASE("things can be made in an arena", "[util][arena]")
+{
+    arena a;
+
+    auto str = net::util::allocate_unique<std::string>(&a, "hello");
+    REQUIRE(*str == "hello");
+    REQUIRE(a.used() >= sizeof(std::string));
+
+    // and still own things made with new
+    net::util::resource_ptr<std::string> owned = std::make_unique<std::string>("world");
+    REQUIRE(*owned == "world");
+}
@@ -0,0 +1,56 @@
+#include "util/buffer_pool.hpp"
+
+#include <cstddef>
+#include <utility>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+using net::util::sized_buffer_pool;
+
+TEST_CASE("rounds up to size classes", "[util][buffer_pool]")
+{
+    REQUIRE(sized_buffer_pool::size_class(0) == sized_buffer_pool::min_class);
+    REQUIRE(sized_buffer_pool::size_class(1'000) == 1'024);
+    REQUIRE(sized_buffer_pool::size_class(1'024) == 1'024);
+    REQUIRE(sized_buffer_pool::size_class(1'025) == 2'048);
+
+    // too big to pool, so exactly what was asked for
+    REQUIRE(sized_buffer_pool::size_class(sized_buffer_pool::max_class + 1) == sized_buffer_pool::max_class + 1);
+}
+
+TEST_CASE("re-uses returned buffers", "[util][buffer_pool]")
+{
+    sized_buffer_pool pool{2};
+
+    auto buf = pool.get(3'000);
+    REQUIRE(buf.empty());
+    REQUIRE(buf.capacity() == 4'096);
+
+    const auto* data = buf.data();
+    buf.resize(10);
+    pool.put(std::move(buf));
+    REQUIRE(pool.stats().cached == 4'096);
+
+    auto again = pool.get(4'000);
+    REQUIRE(again.empty());
+    REQUIRE(again.data() == data);
+
+    auto stats = pool.stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.cached == 0);
+}
+
+TEST_CASE("caches no more than it's allowed to", "[util][buffer_pool]")
+{
+    sized_buffer_pool pool{1};
+
+    auto first  = pool.get(1'024);
+    auto second = pool.get(1'024);
+    pool.put(std::move(first));
+    pool.put(std::move(second));
+
+    REQUIRE(pool.stats().cached == 1'024);
+}
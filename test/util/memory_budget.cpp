@@ -0,0 +1,189 @@
+#include "util/memory_budget.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <catch.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "coro/task.hpp"
+#include "io/buffer_policy.hpp"
+#include "io/buffered_reader.hpp"
+#include "io/string_reader.hpp"
+
+#include "io/reactor.hpp"
+#include "io/run.hpp"
+
+using namespace std::chrono_literals;
+
+using net::util::memory_budget;
+
+using net::test::run;
+
+TEST_CASE("refuses reservations over the limit", "[util][memory_budget]")
+{
+    memory_budget budget{1'000};
+
+    REQUIRE(budget.try_reserve(600));
+    REQUIRE_FALSE(budget.try_reserve(600));
+    REQUIRE(budget.try_reserve(400));
+    REQUIRE(budget.stats().reserved == 1'000);
+    REQUIRE(budget.stats().refused == 1);
+
+    budget.release(600);
+    REQUIRE(budget.try_reserve(600));
+
+    // must-haves go over the limit regardless
+    budget.reserve(500);
+    REQUIRE(budget.stats().reserved == 1'500);
+    REQUIRE(budget.stats().peak_reserved == 1'500);
+    REQUIRE_FALSE(budget.try_reserve(1));
+}
+
+TEST_CASE("no limit never refuses", "[util][memory_budget]")
+{
+    memory_budget budget;
+
+    REQUIRE(budget.try_reserve(1ull << 40));
+    REQUIRE_FALSE(budget.under_pressure());
+    REQUIRE(budget.stats().reserved == 1ull << 40);
+}
+
+TEST_CASE("reservations release what they hold", "[util][memory_budget]")
+{
+    memory_budget budget{1'000};
+
+    {
+        auto held = budget.try_hold(800);
+        REQUIRE(held);
+        REQUIRE(held.size() == 800);
+
+        auto refused = budget.try_hold(800);
+        REQUIRE_FALSE(refused);
+
+        auto moved = std::move(held);
+        REQUIRE(budget.stats().reserved == 800);
+    }
+
+    REQUIRE(budget.stats().reserved == 0);
+}
+
+TEST_CASE("shrinkers are asked to let go under pressure", "[util][memory_budget]")
+{
+    memory_budget budget{1'000, 0.5};
+
+    int  calls = 0;
+    auto id    = budget.add_shrinker([&] { ++calls; });
+
+    REQUIRE(budget.try_reserve(400));
+    REQUIRE(calls == 0);
+
+    REQUIRE(budget.try_reserve(200));
+    REQUIRE(budget.under_pressure());
+    REQUIRE(calls == 1);
+
+    // only on the way in, not for every reservation while it is
+    REQUIRE(budget.try_reserve(100));
+    REQUIRE(calls == 1);
+
+    // but whenever one is refused
+    REQUIRE_FALSE(budget.try_reserve(1'000));
+    REQUIRE(calls == 2);
+
+    budget.remove_shrinker(id);
+    REQUIRE_FALSE(budget.try_reserve(1'000));
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("waits for room until there is some", "[util][memory_budget]")
+{
+    net::test::reactor r;
+    memory_budget      budget{1'000};
+
+    budget.reserve(950);
+    REQUIRE(budget.under_pressure());
+
+    std::atomic_bool resumed = false;
+
+    auto wait = [&]() -> net::coro::task<bool>
+    {
+        co_await budget.wait_for_room(&r.sched);
+        co_return true;
+    };
+
+    std::thread waiter{[&] { resumed = r.run(wait()); }};
+
+    while (budget.stats().waiting == 0) std::this_thread::sleep_for(1ms);
+    REQUIRE_FALSE(resumed);
+
+    budget.release(950);
+    waiter.join();
+
+    REQUIRE(resumed);
+    REQUIRE(budget.stats().waiting == 0);
+}
+
+TEST_CASE("those waiting for room can give up", "[util][memory_budget]")
+{
+    net::test::reactor r;
+    memory_budget      budget{1'000};
+
+    budget.reserve(950);
+
+    std::atomic_bool keep_waiting = true;
+    std::atomic_bool resumed      = false;
+
+    auto wait = [&]() -> net::coro::task<bool>
+    {
+        co_await budget.wait_for_room(&r.sched, &keep_waiting);
+        co_return true;
+    };
+
+    std::thread waiter{[&] { resumed = r.run(wait()); }};
+
+    while (budget.stats().waiting == 0) std::this_thread::sleep_for(1ms);
+
+    keep_waiting = false;
+    budget.wake_all();
+    waiter.join();
+
+    REQUIRE(resumed);
+    REQUIRE(budget.under_pressure());
+
+    // and once they have, they don't wait at all
+    REQUIRE(run(wait()));
+    REQUIRE(budget.stats().waiting == 0);
+}
+
+TEST_CASE("buffers don't grow past the budget", "[util][memory_budget]")
+{
+    memory_budget budget{4'000};
+
+    std::string            input(16'384, 'x');
+    net::io::string_reader string{std::string_view{input}};
+
+    {
+        net::io::buffered_reader reader{
+            &string,
+            net::io::buffer_policy{.initial = 1'024, .min = 1'024, .max = 16'384, .budget = &budget}};
+        REQUIRE(budget.stats().reserved == 1'024);
+        REQUIRE(budget.stats().used == 1'024);
+
+        // 1KiB and 2KiB buffers fit in the budget together, while it grows - but 2KiB and 4KiB don't
+        std::string buf(100, 0);
+        while (run(reader.read(std::span{buf})).count > 0) {}
+        REQUIRE(reader.capacity() == 2'048);
+        REQUIRE(budget.stats().reserved == 2'048);
+        REQUIRE(budget.stats().refused > 0);
+    }
+
+    REQUIRE(budget.stats().reserved == 0);
+    REQUIRE(budget.stats().used == 0);
+}